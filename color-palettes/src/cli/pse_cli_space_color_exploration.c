@@ -58,7 +58,8 @@ HelpPrint()
     MAX_LOCKED_COUNT
   );
   fprintf(stdout,
-    "  --dfeps=e                Epsilon used during the automatic numerical differential computation (default to %f).\n",
+    "  --dfeps=e                Epsilon used during the automatic numerical differential computation (default to %f).\n"
+    "  --sparse                 Use a sparse Jacobian matrix in the solver.\n",
     DEFAULT_DF_EPSILON
   );
   fprintf(stdout,
@@ -78,6 +79,7 @@ struct options_t {
   const char* driver_filepath;
   bool log;
   pse_real_t df_eps;
+  bool sparse;
 
   size_t locked_count;
   float locked_ratio_default;
@@ -97,7 +99,7 @@ struct options_t {
 
 #define OPTIONS_DEFAULT_                                                       \
   { DEFAULT_COLORS_COUNT, DEFAULT_RAND_SEED, DEFAULT_DRIVER, false,            \
-    DEFAULT_DF_EPSILON,                                                        \
+    DEFAULT_DF_EPSILON, false,                                                 \
     0, DEFAULT_LOCK_RATIO, { 0 }, { DEFAULT_LOCK_RATIO },                      \
     0, { PSE_CVD_DEUTERANOPIA_Troiano2008 },                                   \
     CNSTR_OPTIONS_INVALID_, CNSTR_OPTIONS_INVALID_, NULL }
@@ -257,6 +259,10 @@ ParametersParse
          "No value given to --dfeps option");
       sscanf(&argv[i][8],"%lf", &opts->df_eps);
 
+    /******************/
+    } else if( strcmp(argv[i], "--sparse") == 0 ) {
+      opts->sparse = true;
+
     /******************/
     } else if( strcmp(argv[i], "--log") == 0 ) {
       opts->log = true;
@@ -420,6 +426,9 @@ int main(int argc, char* argv[])
   /* Create the exploration context. For some drivers, this call will trigger
    * internal precomputations. */
   excp.options.auto_df_epsilon = opts.df_eps;
+  excp.options.jacobian = opts.sparse
+    ? PSE_CPSPACE_EXPLORATION_JACOBIAN_SPARSE
+    : PSE_CPSPACE_EXPLORATION_JACOBIAN_DENSE;
   PSE_CALL(pseColorPaletteExplorationContextCreate(cp, &excp, &exc));
 
   /* Initialize the contexts of the costs functors using the initial colors. */
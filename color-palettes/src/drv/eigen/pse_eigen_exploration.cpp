@@ -7,11 +7,16 @@
 #include <stretchy_buffer.h>
 
 #include <Eigen/Dense>
+#include <Eigen/Sparse>
 #include <unsupported/Eigen/LevenbergMarquardt>
 
-#include <unordered_map>
-#include <unordered_set>
+#include <algorithm>
 #include <inttypes.h>
+#include <limits>
+
+#ifdef _OPENMP
+  #include <omp.h>
+#endif
 
 //#define PSE_EIGEN_REF
 
@@ -38,59 +43,65 @@ struct pse_costs_mem_chunk_t {
   size_t count;
 };
 
-struct pse_eigen_relshps_for_ppoint_precomputations_t {
-  pse_clt_ppoint_variation_uid_t variation;
-  std::vector<pse_relshp_id_t> relshps;
-  std::vector<pse_clt_cost_func_ctxt_t> relshps_ctxt;
-  std::vector<pse_clt_cost_func_ctxt_config_t> relshps_config;
-  std::vector<const struct pse_eval_relshp_data_t*> relshps_eval_data;
-  std::vector<struct pse_costs_mem_chunk_t> relshps_costs_chunks;
-  size_t costs_count;
+/* Lists of relationships stored contiguously, as the rows of a CSR matrix:
+ * the relationships of the list 'i' are in [offsets[i], offsets[i+1]) of the
+ * relationships arrays, and their costs are in the chunks of the same range of
+ * the chunks array, with at most one chunk per relationship. The arrays are
+ * allocated with the allocator of the device. */
+struct pse_eigen_relshps_lists_t {
+  size_t lists_count;
+  size_t* offsets;  /* lists_count + 1 */
+  size_t* relshps_counts;
+  size_t* chunks_counts;
+  size_t* costs_counts;
+  pse_relshp_id_t* relshps;
+  pse_clt_cost_func_ctxt_t* relshps_ctxt;
+  pse_clt_cost_func_ctxt_config_t* relshps_config;
+  const struct pse_eval_relshp_data_t** relshps_eval_data;
+  struct pse_costs_mem_chunk_t* chunks;
 };
 
-/* TODO: use our allocator */
-typedef std::unordered_set<
-  pse_ppoint_id_t
-> pse_eigen_ppoint_id_set_t;
-
-struct pse_eigen_relshp_precomputations_t {
-  const struct pse_cpspace_instance_relshp_data_t* idata;
-  pse_eigen_ppoint_id_set_t ppoints_involved_set;
+/* One of the lists above, as given to the cost functors */
+struct pse_eigen_relshps_list_t {
+  struct pse_eval_relshps_t relshps;
+  const struct pse_costs_mem_chunk_t* chunks;
+  size_t chunks_count;
   size_t costs_count;
 };
 
-/* TODO: use our allocator */
-typedef std::pair<
-  pse_ppoint_id_t,
-  pse_clt_ppoint_variation_uid_t
-> pse_variated_ppoint_id_t;
-typedef std::map<
-  pse_variated_ppoint_id_t,
-  struct pse_eigen_relshps_for_ppoint_precomputations_t
-> pse_eigen_variated_ppoint_to_relshps_t;
-
 struct pse_eigen_relshp_cost_func_t {
   const struct pse_cpspace_instance_cost_func_data_t* idata;
+  /* Costs of the enabled relationships only, the disabled ones having no cost
+   * in the costs of the variations */
   size_t costs_count_per_variation;
-  pse_eigen_variated_ppoint_to_relshps_t relshps_per_ppoint;
+  /* Number of gradients filled by compute_df, per coordinate component: one per
+   * cost per point, one per cost and ppoint of its relationship otherwise */
+  size_t gradients_count_per_component;
+  /* Enabled relationships using each ppoint, for each variation: the list of
+   * the variation 'v' for the ppoint 'ppid' is the list v*ppoints_count + ppid.
+   * Updated when the state of the relationships changes. */
+  struct pse_eigen_relshps_lists_t relshps_per_ppoint;
+  /* Enabled relationships of each variation 'v' with at least one optimizable
+   * ppoint, in the list 3*v, the enabled ones whose ppoints are all locked,
+   * whose costs do not change during a solve, in the list 3*v+1, and the
+   * disabled ones in the list 3*v+2. Updated when the
+   * lock status of the ppoints or the state of the relationships changes. The
+   * disabled relationships have no costs, hence no chunks. */
+  struct pse_eigen_relshps_lists_t relshps_split;
 };
 
-/* TODO: use our allocator */
-typedef std::unordered_map<
-  pse_relshp_cost_func_id_t,
-  struct pse_eigen_relshp_cost_func_t
-> pse_eigen_relshp_cost_funcs_precomputations_t;
-
-/* TODO: use our allocator */
-typedef std::unordered_map<
-  pse_relshp_id_t,
-  struct pse_eigen_relshp_precomputations_t
-> pse_eigen_relshps_precomputations_t;
-
 struct pse_eigen_cps_precomputations_t {
-  pse_eigen_relshp_cost_funcs_precomputations_t relshp_cost_funcs;
-  pse_eigen_relshps_precomputations_t relshps;
+  size_t relshp_cost_funcs_count;
+  struct pse_eigen_relshp_cost_func_t* relshp_cost_funcs;
+  size_t ppoints_count;
+  /* Costs of the enabled relationships of all the functors */
   size_t costs_needed;
+  /* Optimizable ppoints and revision of the relationships states used to split
+   * the relationships of the functors */
+  size_t relshps_split_ppoints_count;
+  pse_ppoint_id_t* relshps_split_ppoints;
+  size_t relshps_split_states_revision;
+  bool relshps_split;
 };
 
 struct pse_eigen_cps_exploration_solver_context_t;
@@ -116,6 +127,7 @@ struct PseEigenExplorationFunctor {
 
   PSE_INLINE PseEigenExplorationFunctor()
     : exp(nullptr)
+    , precomp()
     , ctxt(nullptr)
     , last_res(RES_OK)
   {}
@@ -132,38 +144,170 @@ struct PseEigenExplorationFunctor {
   /* Main function used by Eigen to compute the costs, given the input */
   PSE_FINLINE int operator()(const InputType& input, ValueType& costs) const;
 
-  /* Do the computation for one cost function */
+  /* Do the computation for one cost function, whose costs start at
+   * 'costs_start_idx' */
   PSE_FINLINE enum pse_res_t
   compute
     (const struct pse_eigen_relshp_cost_func_t& rcf,
+     const size_t costs_start_idx,
      typename ValueType::SegmentReturnType costs) const;
 
+  /* Compute the costs of a subset of the relationships of a variation, and
+   * scatter them in the costs of the variation */
+  PSE_FINLINE enum pse_res_t
+  subset_compute
+    (const struct pse_eigen_relshp_cost_func_t& rcf,
+     const size_t variation_idx,
+     const struct pse_eigen_relshps_list_t& subset,
+     Scalar* costs) const;
+
+  /* Compute the costs of the relationships whose ppoints are all locked */
+  PSE_FINLINE enum pse_res_t locked_costs_compute() const;
+
 #ifndef PSE_EIGEN_REF
-  /* Specific version used by df() to compute costs only for a modified value */
+  /* Specific version used by df() to compute costs only for a modified value.
+   * The gradients are written in a dense Jacobian matrix, or as the triplets
+   * of a sparse one. */
+  template<typename Jacobian>
   PSE_FINLINE enum pse_res_t
   finite_diffs_compute_df
     (const struct pse_eigen_relshp_cost_func_t& rcf,
      const InputType& x,
-     JacobianType& jac,
+     Jacobian& jac,
+     size_t costs_start_idx) const;
+
+  /* Use the compute_df function of the cost functor to fill its gradients */
+  template<typename Jacobian>
+  PSE_FINLINE enum pse_res_t
+  analytic_compute_df
+    (const struct pse_eigen_relshp_cost_func_t& rcf,
+     Jacobian& jac,
      size_t costs_start_idx) const;
+
+  /* Compute the gradients of all the cost functors, the Jacobian being set to
+   * zero. */
+  template<typename Jacobian>
+  PSE_FINLINE int jacobian_compute(const InputType& x, Jacobian& jac) const;
 #endif
 
   /* Needed by Eigen LM to compute the gradients. */
   PSE_FINLINE int df(const InputType& x, JacobianType& jac) const;
 };
 
+/* The same problem for the LM working on a sparse Jacobian matrix: each cost
+ * only depends on the parametric points of its relationship, so only these
+ * derivatives are stored. */
+struct PseEigenExplorationSparseFunctor {
+  /* NOTE: these declarations are required by Eigen */
+  static constexpr int InputsAtCompileTime = Eigen::Dynamic;
+  static constexpr int ValuesAtCompileTime = Eigen::Dynamic;
+  using Scalar       = pse_real_t;
+  using FakeBase     = Eigen::SparseFunctor<Scalar, int>;
+  using InputType    = typename FakeBase::InputType;
+  using ValueType    = typename FakeBase::ValueType;
+  using JacobianType = typename FakeBase::JacobianType;
+  using Triplet      = Eigen::Triplet<Scalar, int>;
+
+  PseEigenExplorationFunctor* pb;
+
+  PSE_INLINE PseEigenExplorationSparseFunctor
+    (PseEigenExplorationFunctor* pb)
+    : pb(pb)
+  {}
+
+  PSE_FINLINE int values() const { return pb->values(); }
+  PSE_FINLINE int operator()(const InputType& input, ValueType& costs) const
+  {
+    return (*pb)(input, costs);
+  }
+  PSE_FINLINE int df(const InputType& x, JacobianType& jac) const;
+};
+
 using PseEigenExplorationProblem = PseEigenExplorationFunctor;
 using PseEigenExplorationSolver = Eigen::LevenbergMarquardt<PseEigenExplorationProblem>;
+using PseEigenExplorationSparseProblem = PseEigenExplorationSparseFunctor;
+
+/* Levenberg-Marquardt working on the sparse Jacobian matrix. The one of Eigen
+ * does a sparse QR factorization of the Jacobian matrix at each step, then
+ * walks through the whole R factor for each value of its damping parameter,
+ * what grows much faster than the count of nonzeros. This one runs the same
+ * steps, but solves the damped normal equations (Jt.J + par.D^2).h = -Jt.f
+ * with a sparse Cholesky factorization, whose pattern is analyzed once per
+ * Jacobian matrix. The interface, the tolerances and the statuses are the
+ * ones of the Eigen LM. */
+class PseEigenSparseLevenbergMarquardt
+{
+public:
+  using FunctorType  = PseEigenExplorationSparseFunctor;
+  using Scalar       = FunctorType::Scalar;
+  using FVectorType  = FunctorType::InputType;
+  using JacobianType = FunctorType::JacobianType;
+  using Status       = Eigen::LevenbergMarquardtSpace::Status;
+
+  explicit PseEigenSparseLevenbergMarquardt(FunctorType& functor);
+
+  Status minimizeInit(FVectorType& x);
+  Status minimizeOneStep(FVectorType& x);
+  Status minimize(FVectorType& x);
+
+  Eigen::ComputationInfo info() const { return computation_info; }
+  Eigen::Index nfev() const { return nfev_count; }
+  Eigen::Index iterations() const { return iterations_count; }
+
+private:
+  /* Factorizes Jt.J + damping.D^2 and solves the step with it */
+  bool damped_solve(const Scalar damping);
+  /* The parameter of the step bounded by delta, as the lmpar of MINPACK */
+  bool lmpar();
+
+  FunctorType& functor;
+  JacobianType fjac;
+  JacobianType jtj;
+  JacobianType scaling; /* D^2, on the diagonal */
+  JacobianType damped;  /* jtj + par.D^2 */
+  Eigen::SimplicialLDLT<JacobianType> ldlt;
+  FVectorType fvec;
+  FVectorType fvec_next;
+  FVectorType x_next;
+  FVectorType gradient; /* Jt.f */
+  FVectorType col_norms;
+  FVectorType diag;     /* D */
+  FVectorType step;
+  FVectorType wa;
+  Scalar fnorm;
+  Scalar delta;
+  Scalar par;
+  Scalar factor;
+  Scalar ftol;
+  Scalar xtol;
+  Scalar gtol;
+  Eigen::Index maxfev;
+  Eigen::Index nfev_count;
+  Eigen::Index iterations_count;
+  Eigen::ComputationInfo computation_info;
+};
+
+using PseEigenExplorationSparseSolver = PseEigenSparseLevenbergMarquardt;
+
+/* Buffers of one thread computing finite differences: its own copy of the
+ * inputs, where it moves the value of its current column, the costs on both
+ * sides of this value and, for a sparse Jacobian, the triplets it found. */
+struct pse_eigen_finite_diffs_scratch_t {
+  PseEigenExplorationProblem::InputType input;
+  PseEigenExplorationProblem::ValueType costs_minus;
+  PseEigenExplorationProblem::ValueType costs_plus;
+  std::vector<PseEigenExplorationSparseFunctor::Triplet> triplets;
+};
 
-/* TODO: use our allocator */
-typedef std::pair<
-  pse_clt_pspace_uid_t,
-  pse_clt_ppoint_variation_uid_t
-> pse_eigen_cps_inputs_version_t;
-typedef std::map<
-  pse_eigen_cps_inputs_version_t,
-  PseEigenExplorationProblem::InputType
-> pse_eigen_cps_inputs_by_pspace_t;
+/* Inputs variated and/or converted in another pspace. Their buffers are kept
+ * from one costs evaluation to the next, only the ones computed for the
+ * current evaluation being valid. */
+struct pse_eigen_cps_converted_input_t {
+  pse_clt_pspace_uid_t pspace;
+  pse_clt_ppoint_variation_uid_t variation;
+  bool valid;
+  PseEigenExplorationProblem::InputType input;
+};
 
 /*! Stores the information related to a specific exploration computation,
  * allowing to work independently from the world and to store the results for
@@ -173,10 +317,15 @@ struct pse_eigen_cps_exploration_solver_context_t {
   PseEigenExplorationProblem::InputType input_full;
   PseEigenExplorationProblem::InputType input;  /*!< in the main pspace */
   PseEigenExplorationProblem::ValueType costs_ref;
-  PseEigenExplorationProblem::ValueType costs_tmp1;
-  PseEigenExplorationProblem::ValueType costs_tmp2;
-  pse_eigen_cps_inputs_by_pspace_t input_full_by_pspace;
+  PseEigenExplorationProblem::ValueType costs_locked; /*!< once per solve */
+  PseEigenExplorationProblem::ValueType costs_subset;
+  std::vector<struct pse_eigen_finite_diffs_scratch_t> finite_diffs_scratch; /*!< per thread */
+  std::vector<struct pse_eigen_cps_converted_input_t> converted_inputs;
+  std::vector<PseEigenExplorationSparseFunctor::Triplet> jacobian_triplets; /*!< sparse df */
+  PseEigenExplorationProblem::ValueType gradients; /*!< filled by compute_df */
+  std::vector<size_t> input_idx_per_ppoint; /*!< invalid for locked ppoints */
   bool need_costs_ref;
+  bool need_costs_locked;
   size_t components_count;
   size_t costs_count;
   pse_ppoint_id_t* optimizable_ppoints; /* stretchy buffer */
@@ -193,6 +342,8 @@ struct pse_eigen_cps_exploration_t {
 
   PseEigenExplorationProblem* problem;
   PseEigenExplorationSolver* lm;  /* Levenberg-Marquardt */
+  PseEigenExplorationSparseProblem* sparse_problem;
+  PseEigenExplorationSparseSolver* sparse_lm;  /* Used instead of lm */
 
   /*! We use triple buffering to allow the user to get the last results during
    * an exploration. This allow the user to get the results when it wants, and
@@ -216,23 +367,22 @@ struct pse_eigen_cps_exploration_t {
   ((size_t)-1)
 #define PSE_COSTS_MEM_CHUNK_EMPTY_                                             \
   { PSE_OFFSET_INVALID, 0 }
-#define PSE_EIGEN_RELSHPS_FOR_PPOINT_PRECOMPUTATIONS_EMPTY_                    \
-  { PSE_CLT_PPOINT_VARIATION_UID_INVALID_, {}, {}, {}, {}, {}, 0 }
-#define PSE_EIGEN_RELSHP_PRECOMPUTATIONS_EMPTY_                                \
-  { nullptr, {}, 0 }
+#define PSE_EIGEN_RELSHPS_LISTS_NULL_                                          \
+  { 0, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, \
+    nullptr }
 #define PSE_EIGEN_RELSHP_COST_FUNC_NULL_                                       \
-  { nullptr, 0, {} }
+  { nullptr, 0, 0, PSE_EIGEN_RELSHPS_LISTS_NULL_, PSE_EIGEN_RELSHPS_LISTS_NULL_ }
 #define PSE_EIGEN_CPS_PRECOMPUTATIONS_EMPTY_                                   \
-  { {}, {}, 0 }
+  { 0, nullptr, 0, 0, 0, nullptr, 0, false }
 #define PSE_EIGEN_CPS_EXPLORATION_SOLVER_CONTEXT_NULL_                         \
   { PSE_EVAL_CTXT_NULL_,                                                       \
-    {}, {}, {}, {}, {}, {}, true, 0, 0, nullptr,                               \
+    {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, true, true, 0, 0, nullptr,         \
     Eigen::NoConvergence,                                                      \
     Eigen::LevenbergMarquardtSpace::NotStarted,                                \
     PSE_CPSPACE_EXPLORATION_EXTRA_RESULTS_NULL_ }
 #define PSE_EIGEN_CPS_EXPLORATION_NULL_                                        \
   { nullptr, PSE_CPSPACE_EXPLORATION_CTXT_PARAMS_NULL_, nullptr, nullptr,      \
-    nullptr, nullptr,                                                          \
+    nullptr, nullptr, nullptr, nullptr,                                        \
     { PSE_EIGEN_CPS_EXPLORATION_SOLVER_CONTEXT_NULL_,                          \
       PSE_EIGEN_CPS_EXPLORATION_SOLVER_CONTEXT_NULL_,                          \
       PSE_EIGEN_CPS_EXPLORATION_SOLVER_CONTEXT_NULL_ },                        \
@@ -241,10 +391,8 @@ struct pse_eigen_cps_exploration_t {
 
 static const struct pse_costs_mem_chunk_t PSE_COSTS_MEM_CHUNK_EMPTY =
   PSE_COSTS_MEM_CHUNK_EMPTY_;
-static const struct pse_eigen_relshps_for_ppoint_precomputations_t PSE_EIGEN_RELSHPS_FOR_PPOINT_PRECOMPUTATIONS_EMPTY =
-  PSE_EIGEN_RELSHPS_FOR_PPOINT_PRECOMPUTATIONS_EMPTY_;
-static const struct pse_eigen_relshp_precomputations_t PSE_EIGEN_RELSHP_PRECOMPUTATIONS_EMPTY =
-  PSE_EIGEN_RELSHP_PRECOMPUTATIONS_EMPTY_;
+static const struct pse_eigen_relshps_lists_t PSE_EIGEN_RELSHPS_LISTS_NULL =
+  PSE_EIGEN_RELSHPS_LISTS_NULL_;
 static const struct pse_eigen_relshp_cost_func_t PSE_EIGEN_RELSHP_COST_FUNC_NULL =
   PSE_EIGEN_RELSHP_COST_FUNC_NULL_;
 static const struct pse_eigen_cps_precomputations_t PSE_EIGEN_CPS_PRECOMPUTATIONS_EMPTY =
@@ -254,6 +402,165 @@ static const struct pse_eigen_cps_exploration_solver_context_t PSE_EIGEN_CPS_EXP
 static const struct pse_eigen_cps_exploration_t PSE_EIGEN_CPS_EXPLORATION_NULL =
   PSE_EIGEN_CPS_EXPLORATION_NULL_;
 
+/******************************************************************************
+ *
+ * RELATIONSHIPS LISTS
+ *
+ ******************************************************************************/
+
+/* Number of costs of a relationship for the cost functor 'rcfp' */
+static PSE_FINLINE size_t
+pseEigenRelationshipCostsCount
+  (const struct pse_relshp_cost_func_params_t* rcfp,
+   const struct pse_eval_relshp_data_t* data)
+{
+  return rcfp->cost_arity_mode == PSE_COST_ARITY_MODE_PER_POINT
+    ? rcfp->costs_count * data->ppoints_count
+    : rcfp->costs_count;
+}
+
+static PSE_INLINE void
+pseEigenRelshpsListsRelease
+  (struct pse_allocator_t* allocator,
+   struct pse_eigen_relshps_lists_t& lists)
+{
+  if( lists.offsets ) PSE_FREE(allocator, lists.offsets);
+  if( lists.relshps_counts ) PSE_FREE(allocator, lists.relshps_counts);
+  if( lists.chunks_counts ) PSE_FREE(allocator, lists.chunks_counts);
+  if( lists.costs_counts ) PSE_FREE(allocator, lists.costs_counts);
+  if( lists.relshps ) PSE_FREE(allocator, lists.relshps);
+  if( lists.relshps_ctxt ) PSE_FREE(allocator, lists.relshps_ctxt);
+  if( lists.relshps_config ) PSE_FREE(allocator, lists.relshps_config);
+  if( lists.relshps_eval_data ) PSE_FREE(allocator, lists.relshps_eval_data);
+  if( lists.chunks ) PSE_FREE(allocator, lists.chunks);
+  lists = PSE_EIGEN_RELSHPS_LISTS_NULL;
+}
+
+/* Create 'lists_count' empty lists. The number of relationships of each list
+ * is then counted in relshps_counts, before pseEigenRelshpsListsAllocate. */
+static PSE_INLINE enum pse_res_t
+pseEigenRelshpsListsCreate
+  (struct pse_allocator_t* allocator,
+   const size_t lists_count,
+   struct pse_eigen_relshps_lists_t& lists)
+{
+  enum pse_res_t res = RES_OK;
+  lists = PSE_EIGEN_RELSHPS_LISTS_NULL;
+  lists.lists_count = lists_count;
+  lists.offsets = PSE_TYPED_ALLOC_ARRAY(allocator, size_t, lists_count + 1);
+  lists.relshps_counts = PSE_TYPED_ALLOC_ARRAY(allocator, size_t, lists_count + 1);
+  lists.chunks_counts = PSE_TYPED_ALLOC_ARRAY(allocator, size_t, lists_count + 1);
+  lists.costs_counts = PSE_TYPED_ALLOC_ARRAY(allocator, size_t, lists_count + 1);
+  PSE_VERIFY_OR_ELSE
+    (lists.offsets && lists.relshps_counts
+  && lists.chunks_counts && lists.costs_counts,
+     res = RES_MEM_ERR; goto error);
+  std::fill(lists.relshps_counts, lists.relshps_counts + lists_count, 0);
+  std::fill(lists.chunks_counts, lists.chunks_counts + lists_count, 0);
+  std::fill(lists.costs_counts, lists.costs_counts + lists_count, 0);
+
+exit:
+  return res;
+error:
+  pseEigenRelshpsListsRelease(allocator, lists);
+  goto exit;
+}
+
+/* Allocate the relationships of the lists from their counts. The lists are
+ * then filled by pseEigenRelshpsListsAppend. */
+static PSE_INLINE enum pse_res_t
+pseEigenRelshpsListsAllocate
+  (struct pse_allocator_t* allocator,
+   struct pse_eigen_relshps_lists_t& lists)
+{
+  enum pse_res_t res = RES_OK;
+  size_t i, count;
+
+  lists.offsets[0] = 0;
+  for(i = 0; i < lists.lists_count; ++i) {
+    lists.offsets[i+1] = lists.offsets[i] + lists.relshps_counts[i];
+    lists.relshps_counts[i] = 0;
+  }
+  count = PSE_MAX(lists.offsets[lists.lists_count], 1);
+  lists.relshps = PSE_TYPED_ALLOC_ARRAY
+    (allocator, pse_relshp_id_t, count);
+  lists.relshps_ctxt = PSE_TYPED_ALLOC_ARRAY
+    (allocator, pse_clt_cost_func_ctxt_t, count);
+  lists.relshps_config = PSE_TYPED_ALLOC_ARRAY
+    (allocator, pse_clt_cost_func_ctxt_config_t, count);
+  lists.relshps_eval_data = PSE_TYPED_ALLOC_ARRAY
+    (allocator, const struct pse_eval_relshp_data_t*, count);
+  lists.chunks = PSE_TYPED_ALLOC_ARRAY
+    (allocator, struct pse_costs_mem_chunk_t, count);
+  PSE_VERIFY_OR_ELSE
+    (lists.relshps && lists.relshps_ctxt && lists.relshps_config
+  && lists.relshps_eval_data && lists.chunks,
+     res = RES_MEM_ERR; goto error);
+
+exit:
+  return res;
+error:
+  pseEigenRelshpsListsRelease(allocator, lists);
+  goto exit;
+}
+
+/* Append the relationship 'j' of a variated cost functor to the list
+ * 'list_idx', its costs starting at 'costs_start_idx' in the costs of the
+ * variation. The relationships of a list are appended in the order of their
+ * costs, so that contiguous costs are merged in the same chunk. */
+static PSE_FINLINE void
+pseEigenRelshpsListsAppend
+  (struct pse_eigen_relshps_lists_t& lists,
+   const size_t list_idx,
+   const struct pse_cpspace_instance_variated_cost_func_data_t* ivcfd,
+   const size_t j,
+   const size_t costs_start_idx,
+   const size_t costs_count)
+{
+  const size_t offset = lists.offsets[list_idx];
+  const size_t k = offset + lists.relshps_counts[list_idx]++;
+  assert(k < lists.offsets[list_idx+1]);
+  lists.relshps[k] = ivcfd->relshps_ids[j];
+  lists.relshps_ctxt[k] = ivcfd->relshps_ctxts[j];
+  lists.relshps_config[k] = ivcfd->relshps_configs[j];
+  lists.relshps_eval_data[k] = ivcfd->relshps_data[j];
+  if( costs_count <= 0 )
+    return;
+
+  struct pse_costs_mem_chunk_t* chunks = lists.chunks + offset;
+  size_t& chunks_count = lists.chunks_counts[list_idx];
+  if( chunks_count > 0
+   && chunks[chunks_count-1].offset + chunks[chunks_count-1].count
+   == costs_start_idx ) {
+    chunks[chunks_count-1].count += costs_count;
+  } else {
+    chunks[chunks_count].offset = costs_start_idx;
+    chunks[chunks_count].count = costs_count;
+    ++chunks_count;
+  }
+  lists.costs_counts[list_idx] += costs_count;
+}
+
+static PSE_FINLINE struct pse_eigen_relshps_list_t
+pseEigenRelshpsListGet
+  (const struct pse_eigen_relshps_lists_t& lists,
+   const size_t list_idx)
+{
+  struct pse_eigen_relshps_list_t list;
+  const size_t offset = lists.offsets[list_idx];
+  assert(list_idx < lists.lists_count);
+  list.relshps = PSE_EVAL_RELSHPS_NULL;
+  list.relshps.count = lists.relshps_counts[list_idx];
+  list.relshps.ids = lists.relshps + offset;
+  list.relshps.data = lists.relshps_eval_data + offset;
+  list.relshps.ctxts = lists.relshps_ctxt + offset;
+  list.relshps.configs = lists.relshps_config + offset;
+  list.chunks = lists.chunks + offset;
+  list.chunks_count = lists.chunks_counts[list_idx];
+  list.costs_count = lists.costs_counts[list_idx];
+  return list;
+}
+
 /******************************************************************************
  *
  * EXPLORATION FUNCTOR IMPLEMENTATION
@@ -267,6 +574,27 @@ PseEigenExplorationFunctor::values() const
   return (int)ctxt->costs_count;
 }
 
+/* Index of the buffer of the input in 'pspace' for 'variation', added if it
+ * does not exist yet */
+static PSE_FINLINE size_t
+pseEigenConvertedInputFind
+  (struct pse_eigen_cps_exploration_solver_context_t* ctxt,
+   const pse_clt_pspace_uid_t pspace,
+   const pse_clt_ppoint_variation_uid_t variation)
+{
+  size_t i;
+  for(i = 0; i < ctxt->converted_inputs.size(); ++i) {
+    const struct pse_eigen_cps_converted_input_t& ci = ctxt->converted_inputs[i];
+    if( ci.pspace == pspace && ci.variation == variation )
+      return i;
+  }
+  ctxt->converted_inputs.emplace_back();
+  ctxt->converted_inputs.back().pspace = pspace;
+  ctxt->converted_inputs.back().variation = variation;
+  ctxt->converted_inputs.back().valid = false;
+  return i;
+}
+
 PSE_FINLINE enum pse_res_t
 PseEigenExplorationFunctor::converted_inputs_get
   (const pse_clt_ppoint_variation_uid_t var,
@@ -275,53 +603,57 @@ PseEigenExplorationFunctor::converted_inputs_get
 {
   const pse_clt_pspace_uid_t from = exp->params.pspace.explore_in;
   enum pse_res_t res = RES_OK;
-  const pse_eigen_cps_inputs_version_t key(to,var);
-  const pse_eigen_cps_inputs_version_t key_var_only(from,var);
   const bool need_pspace_variation =
-    (key.second != PSE_CLT_PPOINT_VARIATION_UID_INVALID);
-  const bool need_pspace_conversion = (key.first != from);
+    (var != PSE_CLT_PPOINT_VARIATION_UID_INVALID);
+  const bool need_pspace_conversion = (to != from);
 
   if( need_pspace_variation || need_pspace_conversion ) {
-    /* We have to do a variation and/or a conversion */
+    /* We have to do a variation and/or a conversion. The buffers are found
+     * first, as adding one moves the others. */
+    const size_t variated_idx = need_pspace_variation
+      ? pseEigenConvertedInputFind(ctxt, from, var)
+      : PSE_INDEX_INVALID;
+    const size_t converted_idx = need_pspace_conversion
+      ? pseEigenConvertedInputFind(ctxt, to, var)
+      : PSE_INDEX_INVALID;
     PseEigenExplorationFunctor::InputType* input = &ctxt->input_full;
-    PseEigenExplorationFunctor::InputType* output = nullptr;
 
     if( need_pspace_variation ) {
-      const bool has_done_variation =
-        (ctxt->input_full_by_pspace.count(key_var_only) > 0);
-      output = &ctxt->input_full_by_pspace[key_var_only];
-
-      if( !has_done_variation ) {
+      struct pse_eigen_cps_converted_input_t& ci =
+        ctxt->converted_inputs[variated_idx];
+      if( !ci.valid ) {
         assert(exp->params.variations.apply);
 
         /* Get the buffer of the main pspace for the given variation. */
-        *output = *input;
+        ci.input = *input;
         PSE_CALL_OR_RETURN(res, exp->params.variations.apply
           (exp->params.variations.apply_user_data,
            from, var, sb_count(exp->cpsi->ppoints),
-           input->data(), output->data()));
+           input->data(), ci.input.data()));
+        ci.valid = true;
       }
+      input = &ci.input;
     }
 
     if( need_pspace_conversion ) {
-      const bool has_done_conversion =
-        (ctxt->input_full_by_pspace.count(key) > 0);
-      output = &ctxt->input_full_by_pspace[key];
-
-      if( !has_done_conversion ) {
+      struct pse_eigen_cps_converted_input_t& ci =
+        ctxt->converted_inputs[converted_idx];
+      if( !ci.valid ) {
         assert(exp->params.pspace.convert);
 
         /* Get the buffer of the given pspace for the given variation. */
-        *output = *input;
+        ci.input = *input;
         PSE_CALL_OR_RETURN(res, exp->params.pspace.convert
           (exp->params.pspace.convert_user_data,
            from, to, sb_count(exp->cpsi->ppoints),
-           input->data(), output->data()));
+           input->data(), ci.input.data()));
+        ci.valid = true;
       }
+      input = &ci.input;
     }
 
     /* The last output is our input variated and/or converted */
-    input_converted = output;
+    input_converted = input;
   } else {
     /* No variation in the main pspace: return the main buffer. */
     to = from;
@@ -340,11 +672,9 @@ PseEigenExplorationFunctor::operator()
   size_t i, j, costs_start_idx = 0;
   assert(ctxt);
 
-  /* We entering a new computation, clear the spaces conversion cache */
-  ctxt->input_full_by_pspace.clear();
-
-  /* TODO: check if relationships are needed and avoid to compute them if not:
-   * If the ppoints implied are all locked, the relationship is not needed. */
+  /* We entering a new computation, invalidate the spaces conversion cache */
+  for(auto& ci: ctxt->converted_inputs)
+    ci.valid = false;
 
   /* Copy the input buffer to our internal buffer in order to have all ppoint
    * (locked and optimizable) in the same buffer. Note that the locked ppoints
@@ -364,15 +694,21 @@ PseEigenExplorationFunctor::operator()
   /* Converted inputs will use ctxt->input_full as the up-to-date values. */
 
   last_res = RES_OK;
-  for(const auto& fpcp: precomp.relshp_cost_funcs) {
-    const struct pse_eigen_relshp_cost_func_t& rcf = fpcp.second;
+  /* The relationships whose ppoints are all locked are only computed once */
+  if( ctxt->need_costs_locked ) {
+    PSE_CALL_OR_GOTO(last_res,exit, locked_costs_compute());
+    ctxt->need_costs_locked = false;
+  }
+
+  for(i = 0; i < precomp.relshp_cost_funcs_count; ++i) {
+    const struct pse_eigen_relshp_cost_func_t& rcf = precomp.relshp_cost_funcs[i];
     const size_t costs_count =
       rcf.costs_count_per_variation * rcf.idata->variations_count;
     if( costs_count <= 0 )
       continue;
     assert(costs_start_idx + costs_count <= ctxt->costs_count);
     PSE_CALL_OR_GOTO(last_res,exit, compute
-      (rcf, costs.segment(costs_start_idx, costs_count)));
+      (rcf, costs_start_idx, costs.segment(costs_start_idx, costs_count)));
     costs_start_idx += costs_count;
   }
   assert(costs_start_idx <= ctxt->costs_count);
@@ -391,6 +727,7 @@ exit:
 PSE_FINLINE enum pse_res_t
 PseEigenExplorationFunctor::compute
   (const struct pse_eigen_relshp_cost_func_t& rcf,
+   const size_t costs_start_idx,
    typename ValueType::SegmentReturnType costs) const
 {
   enum pse_res_t res = RES_OK;
@@ -401,6 +738,30 @@ PseEigenExplorationFunctor::compute
   for(size_t i = 0; i < rcf.idata->variations_count; ++i) {
     const struct pse_cpspace_instance_variated_cost_func_data_t* ivcfd =
       &rcf.idata->variations[i];
+    const size_t var_costs_start_idx = i*rcf.costs_count_per_variation;
+
+    /* Some relationships have all their ppoints locked: their costs are the
+     * ones computed at the beginning of the solve. The disabled ones have no
+     * costs and are not given to the functor. */
+    const struct pse_eigen_relshps_list_t locked =
+      pseEigenRelshpsListGet(rcf.relshps_split, 3*i+1);
+    const struct pse_eigen_relshps_list_t disabled =
+      pseEigenRelshpsListGet(rcf.relshps_split, 3*i+2);
+    if( locked.relshps.count > 0 || disabled.relshps.count > 0 ) {
+      for(size_t k = 0; k < locked.chunks_count; ++k) {
+        const struct pse_costs_mem_chunk_t& chunk = locked.chunks[k];
+        costs.segment(var_costs_start_idx + chunk.offset, chunk.count) =
+          ctxt->costs_locked.segment
+            (costs_start_idx + var_costs_start_idx + chunk.offset, chunk.count);
+      }
+      PSE_CALL_OR_RETURN(res, subset_compute
+        (rcf, i, pseEigenRelshpsListGet(rcf.relshps_split, 3*i),
+         costs.segment
+           (var_costs_start_idx,
+            rcf.costs_count_per_variation).data()));
+      continue;
+    }
+
     PSE_CALL_OR_RETURN(res, converted_inputs_get
       (ivcfd->uid, func_pspace, input_converted));
 
@@ -419,12 +780,76 @@ PseEigenExplorationFunctor::compute
     PSE_CALL_OR_RETURN(last_res, rcf.idata->params.compute
       (&ctxt->eval_ctxt, &eval_coords, &eval_relshps,
        costs.segment
-         (i*rcf.costs_count_per_variation,
+         (var_costs_start_idx,
           rcf.costs_count_per_variation).data()));
   }
   return RES_OK;
 }
 
+PSE_FINLINE enum pse_res_t
+PseEigenExplorationFunctor::subset_compute
+  (const struct pse_eigen_relshp_cost_func_t& rcf,
+   const size_t variation_idx,
+   const struct pse_eigen_relshps_list_t& subset,
+   Scalar* costs) const
+{
+  enum pse_res_t res = RES_OK;
+  size_t k, relshp_costs_start_idx = 0;
+  if( subset.costs_count <= 0 )
+    return RES_OK;
+
+  pse_clt_pspace_uid_t func_pspace = rcf.idata->params.expected_pspace;
+  PseEigenExplorationFunctor::InputType* input_converted = nullptr;
+  PSE_CALL_OR_RETURN(res, converted_inputs_get
+    (rcf.idata->variations[variation_idx].uid, func_pspace, input_converted));
+
+  struct pse_eval_relshps_t eval_relshps = subset.relshps;
+
+  struct pse_eval_coordinates_t eval_coords = PSE_EVAL_COORDINATES_NULL;
+  eval_coords.pspace_uid = func_pspace;
+  eval_coords.scalars_count = input_converted->size();
+  eval_coords.coords = input_converted->data();
+
+  ctxt->costs_subset.resize(subset.costs_count);
+  PSE_CALL_OR_RETURN(res, rcf.idata->params.compute
+    (&ctxt->eval_ctxt, &eval_coords, &eval_relshps, ctxt->costs_subset.data()));
+
+  /* Scatter the costs of the subset in the costs of the variation */
+  for(k = 0; k < subset.chunks_count; ++k) {
+    const struct pse_costs_mem_chunk_t& chunk = subset.chunks[k];
+    Eigen::Map<ValueType>(costs + chunk.offset, (Eigen::Index)chunk.count) =
+      ctxt->costs_subset.segment(relshp_costs_start_idx, chunk.count);
+    relshp_costs_start_idx += chunk.count;
+  }
+  assert(relshp_costs_start_idx == subset.costs_count);
+  return res;
+}
+
+PSE_FINLINE enum pse_res_t
+PseEigenExplorationFunctor::locked_costs_compute() const
+{
+  enum pse_res_t res = RES_OK;
+  size_t costs_start_idx = 0;
+
+  for(size_t f = 0; f < precomp.relshp_cost_funcs_count; ++f) {
+    const struct pse_eigen_relshp_cost_func_t& rcf = precomp.relshp_cost_funcs[f];
+    const size_t costs_count =
+      rcf.costs_count_per_variation * rcf.idata->variations_count;
+    if( costs_count <= 0 )
+      continue;
+    assert(rcf.relshps_split.lists_count == 3*rcf.idata->variations_count);
+    assert(costs_start_idx + costs_count <= (size_t)ctxt->costs_locked.size());
+    for(size_t i = 0; i < rcf.idata->variations_count; ++i) {
+      PSE_CALL_OR_RETURN(res, subset_compute
+        (rcf, i, pseEigenRelshpsListGet(rcf.relshps_split, 3*i+1),
+         ctxt->costs_locked.data()
+         + costs_start_idx + i*rcf.costs_count_per_variation));
+    }
+    costs_start_idx += costs_count;
+  }
+  return res;
+}
+
 #ifdef PSE_EIGEN_REF
 // Sligthly adjusted df function of Eigen::NumericalDiff class, for easier
 // tweaking purpose in order to compare with our own implementation.
@@ -467,49 +892,130 @@ PSE_FINLINE int
 PseEigenExplorationFunctor::df
   (const InputType& x,
    JacobianType& jac) const
+{
+  jac.setZero();
+  return jacobian_compute(x, jac);
+}
+
+/* Store the gradients of a costs chunk, for the input value at 'col', in the
+ * dense Jacobian matrix. */
+static PSE_FINLINE void
+pseEigenJacobianChunkSet
+  (PseEigenExplorationFunctor::JacobianType& jac,
+   const size_t col,
+   const size_t row,
+   const Eigen::Ref<const PseEigenExplorationFunctor::ValueType>& grads)
+{
+  jac.col(col).segment(row, grads.size()) = grads;
+}
+
+/* Same as above, but the gradients are kept as the triplets of the sparse
+ * Jacobian matrix. The null gradients are not stored. */
+static PSE_FINLINE void
+pseEigenJacobianChunkSet
+  (std::vector<PseEigenExplorationSparseFunctor::Triplet>& jac,
+   const size_t col,
+   const size_t row,
+   const Eigen::Ref<const PseEigenExplorationFunctor::ValueType>& grads)
+{
+  for(Eigen::Index i = 0; i < grads.size(); ++i) {
+    if( grads[i] != 0 )
+      jac.emplace_back((int)(row + i), (int)col, grads[i]);
+  }
+}
+
+/* The columns of a dense Jacobian matrix are written in place by each thread,
+ * whereas the triplets found by each thread are merged once all the columns
+ * are computed. */
+static PSE_FINLINE PseEigenExplorationFunctor::JacobianType&
+pseEigenFiniteDiffsJacobianGet
+  (PseEigenExplorationFunctor::JacobianType& jac,
+   struct pse_eigen_finite_diffs_scratch_t& /*scratch*/)
+{
+  return jac;
+}
+
+static PSE_FINLINE std::vector<PseEigenExplorationSparseFunctor::Triplet>&
+pseEigenFiniteDiffsJacobianGet
+  (std::vector<PseEigenExplorationSparseFunctor::Triplet>& /*jac*/,
+   struct pse_eigen_finite_diffs_scratch_t& scratch)
+{
+  return scratch.triplets;
+}
+
+static PSE_FINLINE void
+pseEigenFiniteDiffsJacobianMerge
+  (PseEigenExplorationFunctor::JacobianType& /*jac*/,
+   struct pse_eigen_finite_diffs_scratch_t& /*scratch*/)
+{
+}
+
+static PSE_FINLINE void
+pseEigenFiniteDiffsJacobianMerge
+  (std::vector<PseEigenExplorationSparseFunctor::Triplet>& jac,
+   struct pse_eigen_finite_diffs_scratch_t& scratch)
+{
+  jac.insert(jac.end(), scratch.triplets.begin(), scratch.triplets.end());
+  scratch.triplets.clear();
+}
+
+template<typename Jacobian>
+PSE_FINLINE int
+PseEigenExplorationFunctor::jacobian_compute
+  (const InputType& x,
+   Jacobian& jac) const
 {
   /* Local variables */
   int nfev = 0;
-  jac.setZero();
+  bool finite_diffs = false;
 
   assert(ctxt->input.size() == x.size());
 
   size_t cost_start_idx = 0;
-  for(auto& fpcp: precomp.relshp_cost_funcs) {
-    const struct pse_eigen_relshp_cost_func_t& rcf = fpcp.second;
+  for(size_t f = 0; f < precomp.relshp_cost_funcs_count; ++f) {
+    const struct pse_eigen_relshp_cost_func_t& rcf = precomp.relshp_cost_funcs[f];
     if( rcf.costs_count_per_variation <= 0 )
       continue;
-    if( rcf.idata->params.compute_df ) {
-      // TODO: call the compute_df function
-      ++nfev;
+
+    // First, compute the cost for the given input, as precomputed costs
+    // that we will need to keep for later use.
+    if( ctxt->need_costs_ref ) {
+      // This call will fill the 'input_full' buffer with values of 'x'
+      // TODO: we should separate the initialization of the 'input_full'
+      // buffer from the computation of the costs as here, we know which
+      // function we want to evaluate.
+      if( this->operator ()(x, ctxt->costs_ref) < 0 )
+        return -1;
+    }
+    // It's only the first time, whichever the cost function we want to
+    // evaluate.
+    ctxt->need_costs_ref = false;
+
+    // The gradients given by compute_df are in the pspace of the cost
+    // function: they are only usable as is without conversion nor variation.
+    if( rcf.idata->params.compute_df
+     && rcf.idata->params.expected_pspace == exp->params.pspace.explore_in
+     && rcf.idata->variations_count == 1 ) {
+      PSE_CALL_OR_GOTO(last_res,error, analytic_compute_df
+        (rcf, jac, cost_start_idx));
     } else {
       // The cost function do not provide a compute_df function, so we do this
       // computation "by hand" by using finite differences.
-
-      // First, compute the cost for the given input, as precomputed costs
-      // that we will need to keep for later use.
-      if( ctxt->need_costs_ref ) {
-        // This call will fill the 'input_full' buffer with values of 'x'
-        // TODO: we should separate the initialization of the 'input_full'
-        // buffer from the computation of the costs as here, we know which
-        // function we want to evaluate.
-        if( this->operator ()(x, ctxt->costs_ref) < 0 )
-          return -1;
-      }
-      // It's only the first time, whichever the cost function we want to
-      // evaluate.
-      ctxt->need_costs_ref = false;
-
       PSE_CALL_OR_GOTO(last_res,error, finite_diffs_compute_df
         (rcf, x, jac, cost_start_idx));
+      finite_diffs = true;
     }
     cost_start_idx +=
       rcf.costs_count_per_variation * rcf.idata->variations_count;
   }
 
   // fake number of function evaluation in order to have the same behavior than
-  // before.
-  nfev += 2 * (int)x.size();
+  // before. With analytic gradients only, 0 tells Eigen that the Jacobian was
+  // evaluated without any cost evaluation.
+  if( finite_diffs ) {
+    nfev += 2 * (int)x.size();
+    ctxt->extra.finite_diffs_columns_count = (size_t)x.size();
+  }
 exit:
   ctxt->need_costs_ref = true;  // Next time, 'x' will be different!
   return nfev;
@@ -518,22 +1024,158 @@ error:
   goto exit;
 }
 
+/* Add the gradient of the cost at 'row' for the input value at 'col'. A same
+ * parametric point may appear more than once in a relationship. */
+static PSE_FINLINE void
+pseEigenJacobianValueAdd
+  (PseEigenExplorationFunctor::JacobianType& jac,
+   const size_t row,
+   const size_t col,
+   const pse_real_t grad)
+{
+  jac((Eigen::Index)row, (Eigen::Index)col) += grad;
+}
+
+/* Same as above for the triplets, whose duplicates are summed */
+static PSE_FINLINE void
+pseEigenJacobianValueAdd
+  (std::vector<PseEigenExplorationSparseFunctor::Triplet>& jac,
+   const size_t row,
+   const size_t col,
+   const pse_real_t grad)
+{
+  if( grad != 0 )
+    jac.emplace_back((int)row, (int)col, grad);
+}
+
+template<typename Jacobian>
+PSE_FINLINE enum pse_res_t
+PseEigenExplorationFunctor::analytic_compute_df
+  (const struct pse_eigen_relshp_cost_func_t& rcf,
+   Jacobian& jac,
+   size_t costs_start_idx) const
+{
+  enum pse_res_t res = RES_OK;
+  size_t i, c, p, k;
+  size_t grads_idx = 0;
+  const size_t comps_count = ctxt->components_count;
+  const bool per_point =
+    rcf.idata->params.cost_arity_mode == PSE_COST_ARITY_MODE_PER_POINT;
+  const struct pse_cpspace_instance_variated_cost_func_data_t* ivcfd =
+    &rcf.idata->variations[0];
+  assert(ivcfd->uid == PSE_CLT_PPOINT_VARIATION_UID_INVALID);
+
+  /* The relationships whose ppoints are all locked, and the disabled ones, have
+   * no gradient in the Jacobian matrix: only the active ones are given to
+   * compute_df, their costs being in the chunks of the active subset. */
+  const struct pse_eigen_relshps_list_t active =
+    pseEigenRelshpsListGet(rcf.relshps_split, 0);
+  const bool all_active = (rcf.relshps_split.relshps_counts[1] == 0)
+                       && (rcf.relshps_split.relshps_counts[2] == 0);
+  if( !all_active && active.costs_count <= 0 )
+    return RES_OK;
+  const struct pse_costs_mem_chunk_t all_costs =
+    { 0, rcf.costs_count_per_variation };
+  const struct pse_costs_mem_chunk_t* chunks = all_active
+    ? &all_costs
+    : active.chunks;
+  size_t chunk_idx = 0;
+  size_t row = chunks[0].offset;
+
+  struct pse_eval_relshps_t eval_relshps = PSE_EVAL_RELSHPS_NULL;
+  if( all_active ) {
+    eval_relshps.count = ivcfd->relshps_count;
+    eval_relshps.ids = ivcfd->relshps_ids;
+    eval_relshps.data = ivcfd->relshps_data;
+    eval_relshps.ctxts = ivcfd->relshps_ctxts;
+    eval_relshps.configs = ivcfd->relshps_configs;
+  } else {
+    eval_relshps = active.relshps;
+  }
+
+  struct pse_eval_coordinates_t eval_coords = PSE_EVAL_COORDINATES_NULL;
+  eval_coords.pspace_uid = rcf.idata->params.expected_pspace;
+  eval_coords.scalars_count = ctxt->input_full.size();
+  eval_coords.coords = ctxt->input_full.data();
+
+  ctxt->gradients.resize(rcf.gradients_count_per_component * comps_count);
+  PSE_CALL_OR_RETURN(res, rcf.idata->params.compute_df
+    (&ctxt->eval_ctxt, &eval_coords, &eval_relshps, ctxt->gradients.data()));
+
+  /* Scatter the gradients block of each relationship in the rows of its costs
+   * and the columns of its optimizable ppoints. Per point, the costs of a ppoint
+   * only have gradients for this ppoint. */
+  for(i = 0; i < eval_relshps.count; ++i) {
+    const struct pse_eval_relshp_data_t* data = eval_relshps.data[i];
+    const size_t costs_count =
+      pseEigenRelationshipCostsCount(&rcf.idata->params, data);
+    if( costs_count > 0 ) {
+      while( row == chunks[chunk_idx].offset + chunks[chunk_idx].count )
+        row = chunks[++chunk_idx].offset;
+    }
+    if( per_point ) {
+      for(p = 0; p < data->ppoints_count; ++p) {
+        const size_t col = ctxt->input_idx_per_ppoint[data->ppoints[p]];
+        for(c = 0; c < rcf.idata->params.costs_count; ++c) {
+          if( col != PSE_INDEX_INVALID ) {
+            for(k = 0; k < comps_count; ++k) {
+              pseEigenJacobianValueAdd
+                (jac, costs_start_idx + row + c, col + k,
+                 ctxt->gradients[grads_idx + k]);
+            }
+          }
+          grads_idx += comps_count;
+        }
+        row += rcf.idata->params.costs_count;
+      }
+      continue;
+    }
+    for(c = 0; c < costs_count; ++c) {
+      for(p = 0; p < data->ppoints_count; ++p) {
+        const size_t col = ctxt->input_idx_per_ppoint[data->ppoints[p]];
+        if( col != PSE_INDEX_INVALID ) {
+          for(k = 0; k < comps_count; ++k) {
+            pseEigenJacobianValueAdd
+              (jac, costs_start_idx + row + c, col + k,
+               ctxt->gradients[grads_idx + k]);
+          }
+        }
+        grads_idx += comps_count;
+      }
+    }
+    row += costs_count;
+  }
+  assert(grads_idx <= (size_t)ctxt->gradients.size());
+  return res;
+}
+
+template<typename Jacobian>
 PSE_FINLINE enum pse_res_t
 PseEigenExplorationFunctor::finite_diffs_compute_df
   (const struct pse_eigen_relshp_cost_func_t& rcf,
    const InputType& x,
-   JacobianType& jac,
+   Jacobian& jac,
    size_t costs_start_idx) const
 {
   enum pse_res_t res = RES_OK;
-  pse_real_t h, ref_value;
-  size_t i, j, k, v;
-  size_t input_val_idx_in_x, input_val_idx_in_full;
-  size_t relshp_costs_start_idx;
-  pse_ppoint_id_t ppid;
+  size_t t, v;
   const Scalar func_eps = PSE_REAL_EPS; // TODO: get the function epsilon
   const Scalar scalar_eps = Eigen::NumTraits<Scalar>::epsilon();
   const Scalar eps = std::sqrt(PSE_MAX(func_eps, scalar_eps));
+  const Eigen::Index ppoints_count =
+    (Eigen::Index)sb_count(ctxt->optimizable_ppoints);
+
+  /* The columns of each ppoint are independent: they are computed in parallel
+   * by the threads of OpenMP, each one with its own scratch buffers. */
+  size_t threads_count = 1;
+#ifdef _OPENMP
+  threads_count = (size_t)PSE_MAX(1, PSE_MIN
+    ((Eigen::Index)omp_get_max_threads(), ppoints_count));
+#endif
+  if( ctxt->finite_diffs_scratch.size() < threads_count )
+    ctxt->finite_diffs_scratch.resize(threads_count);
+  ctxt->extra.finite_diffs_threads_count = PSE_MAX
+    (ctxt->extra.finite_diffs_threads_count, threads_count);
 
   /* Get the converted inputs if needed, for each variation */
   pse_clt_pspace_uid_t func_pspace = rcf.idata->params.expected_pspace;
@@ -542,90 +1184,420 @@ PseEigenExplorationFunctor::finite_diffs_compute_df
     const pse_clt_ppoint_variation_uid_t variation = rcf.idata->variations[v].uid;
     PSE_CALL_OR_RETURN(res, converted_inputs_get
       (variation, func_pspace, input_converted));
-
-    struct pse_eval_coordinates_t eval_coords = PSE_EVAL_COORDINATES_NULL;
-    eval_coords.pspace_uid = func_pspace;
-    eval_coords.scalars_count = input_converted->size();
-    eval_coords.coords = input_converted->data();
+    for(t = 0; t < threads_count; ++t)
+      ctxt->finite_diffs_scratch[t].input = *input_converted;
 
     assert(costs_start_idx + rcf.costs_count_per_variation <= ctxt->costs_count);
 
-    for(i = 0; i < sb_count(ctxt->optimizable_ppoints); ++i) {
-      ppid = ctxt->optimizable_ppoints[i];
-
-      const pse_variated_ppoint_id_t vppid(ppid, variation);
-      assert(rcf.relshps_per_ppoint.count(vppid) > 0);
+#ifdef _OPENMP
+    #pragma omp parallel for num_threads((int)threads_count) schedule(dynamic)
+#endif
+    for(Eigen::Index i = 0; i < ppoints_count; ++i) {
+      enum pse_res_t col_res = RES_OK;
+      size_t j, k;
+#ifdef _OPENMP
+      struct pse_eigen_finite_diffs_scratch_t& scratch =
+        ctxt->finite_diffs_scratch[(size_t)omp_get_thread_num()];
+#else
+      struct pse_eigen_finite_diffs_scratch_t& scratch =
+        ctxt->finite_diffs_scratch[0];
+#endif
+      const pse_ppoint_id_t ppid = ctxt->optimizable_ppoints[i];
+      assert(ppid < precomp.ppoints_count);
 
-      const struct pse_eigen_relshps_for_ppoint_precomputations_t& rfppp =
-        rcf.relshps_per_ppoint.at(vppid);
+      const struct pse_eigen_relshps_list_t rfppp = pseEigenRelshpsListGet
+        (rcf.relshps_per_ppoint, v*precomp.ppoints_count + ppid);
       if( rfppp.costs_count <= 0 )
         continue; /* No relationships which use this ppoint */
 
-      struct pse_eval_relshps_t eval_relshps = PSE_EVAL_RELSHPS_NULL;
-      eval_relshps = PSE_EVAL_RELSHPS_NULL;
-      eval_relshps.count = rfppp.relshps.size();
-      eval_relshps.ids = rfppp.relshps.data(),
-      eval_relshps.data = rfppp.relshps_eval_data.data(),
-      eval_relshps.ctxts = rfppp.relshps_ctxt.empty()
-        ? nullptr
-        : rfppp.relshps_ctxt.data();
-      eval_relshps.configs = rfppp.relshps_config.empty()
-        ? nullptr
-        : rfppp.relshps_config.data();
-
-      ctxt->costs_tmp1.resize(rfppp.costs_count);
-      ctxt->costs_tmp2.resize(rfppp.costs_count);
+      struct pse_eval_relshps_t eval_relshps = rfppp.relshps;
+
+      struct pse_eval_coordinates_t eval_coords = PSE_EVAL_COORDINATES_NULL;
+      eval_coords.pspace_uid = func_pspace;
+      eval_coords.scalars_count = scratch.input.size();
+      eval_coords.coords = scratch.input.data();
+
+      scratch.costs_minus.resize(rfppp.costs_count);
+      scratch.costs_plus.resize(rfppp.costs_count);
 
       for(j = 0; j < ctxt->components_count; ++j) {
-        input_val_idx_in_x = i*ctxt->components_count+j;
-        input_val_idx_in_full = ppid*ctxt->components_count+j;
-        ref_value = x[input_val_idx_in_x];
-        h = eps * std::abs(x[j]);
+        const size_t input_val_idx_in_x = i*ctxt->components_count+j;
+        const size_t input_val_idx_in_full = ppid*ctxt->components_count+j;
+        const pse_real_t ref_value = x[input_val_idx_in_x];
+        const pse_real_t prev_value = scratch.input[input_val_idx_in_full];
+        pse_real_t h = eps * std::abs(ref_value);
         if (h == 0.) {
           h = eps;
         }
 
         /* Compute the cost at -delta */
-        (*input_converted)[input_val_idx_in_full] = ref_value - h;
-        PSE_CALL_OR_GOTO(res,exit, rcf.idata->params.compute
+        scratch.input[input_val_idx_in_full] = ref_value - h;
+        col_res = rcf.idata->params.compute
           (&ctxt->eval_ctxt, &eval_coords,
-           &eval_relshps, ctxt->costs_tmp1.data()));
+           &eval_relshps, scratch.costs_minus.data());
 
         /* Compute the cost at +delta */
-        (*input_converted)[input_val_idx_in_full] = ref_value + h;
-        PSE_CALL_OR_GOTO(res,exit, rcf.idata->params.compute
-          (&ctxt->eval_ctxt, &eval_coords,
-           &eval_relshps, ctxt->costs_tmp2.data()));
+        if( col_res == RES_OK ) {
+          scratch.input[input_val_idx_in_full] = ref_value + h;
+          col_res = rcf.idata->params.compute
+            (&ctxt->eval_ctxt, &eval_coords,
+             &eval_relshps, scratch.costs_plus.data());
+        }
 
         /* restore the value for this ppoint */
-        (*input_converted)[input_val_idx_in_full] = ref_value;
+        scratch.input[input_val_idx_in_full] = prev_value;
+        if( col_res != RES_OK )
+          break;
 
         /* Compute the difference to get the gradients */
-        ctxt->costs_tmp2 -= ctxt->costs_tmp1;
-        ctxt->costs_tmp2 /= (2*h);
+        scratch.costs_plus -= scratch.costs_minus;
+        scratch.costs_plus /= (2*h);
 
         /* Now, copy meaningfull gradients in the jacobian */
-        relshp_costs_start_idx = 0;
-        JacobianType::ColXpr::SegmentReturnType jac_segment =
-          jac.col(input_val_idx_in_x)
-             .segment(costs_start_idx, rcf.costs_count_per_variation);
-        for(k = 0; k < rfppp.relshps_costs_chunks.size(); ++k) {
-          const struct pse_costs_mem_chunk_t& chunk = rfppp.relshps_costs_chunks[k];
-          jac_segment.segment(chunk.offset, chunk.count) =
-            ctxt->costs_tmp2.segment(relshp_costs_start_idx, chunk.count);
+        size_t relshp_costs_start_idx = 0;
+        for(k = 0; k < rfppp.chunks_count; ++k) {
+          const struct pse_costs_mem_chunk_t& chunk = rfppp.chunks[k];
+          pseEigenJacobianChunkSet
+            (pseEigenFiniteDiffsJacobianGet(jac, scratch),
+             input_val_idx_in_x, costs_start_idx + chunk.offset,
+             scratch.costs_plus.segment(relshp_costs_start_idx, chunk.count));
           relshp_costs_start_idx += chunk.count;
         }
       }
+      if( col_res != RES_OK ) {
+#ifdef _OPENMP
+        #pragma omp critical
+#endif
+        res = col_res;
+      }
     }
+
+    for(t = 0; t < threads_count; ++t)
+      pseEigenFiniteDiffsJacobianMerge(jac, ctxt->finite_diffs_scratch[t]);
+    if( res != RES_OK )
+      break;
+
     /* For each variation, we have a full costs set. */
     costs_start_idx += rcf.costs_count_per_variation;
   }
 
-exit:
   return res;
 }
 #endif
 
+PSE_FINLINE int
+PseEigenExplorationSparseFunctor::df
+  (const InputType& x,
+   JacobianType& jac) const
+{
+#ifdef PSE_EIGEN_REF
+  PseEigenExplorationFunctor::JacobianType dense_jac(jac.rows(), jac.cols());
+  const int nfev = pb->df(x, dense_jac);
+  jac = dense_jac.sparseView();
+#else
+  std::vector<Triplet>& triplets = pb->ctxt->jacobian_triplets;
+  triplets.clear();
+  const int nfev = pb->jacobian_compute(x, triplets);
+  jac.setFromTriplets(triplets.begin(), triplets.end());
+#endif
+  return nfev;
+}
+
+/******************************************************************************
+ *
+ * SPARSE LEVENBERG-MARQUARDT
+ *
+ ******************************************************************************/
+
+PSE_INLINE
+PseEigenSparseLevenbergMarquardt::PseEigenSparseLevenbergMarquardt
+  (FunctorType& functor)
+  : functor(functor),
+    fnorm(0), delta(0), par(0),
+    /* Default parameters of the Eigen LM */
+    factor(100),
+    ftol(std::sqrt(Eigen::NumTraits<Scalar>::epsilon())),
+    xtol(std::sqrt(Eigen::NumTraits<Scalar>::epsilon())),
+    gtol(0),
+    maxfev(400),
+    nfev_count(0),
+    iterations_count(0),
+    computation_info(Eigen::InvalidInput)
+{}
+
+PSE_INLINE bool
+PseEigenSparseLevenbergMarquardt::damped_solve
+  (const Scalar damping)
+{
+  damped = jtj + damping * scaling;
+  ldlt.factorize(damped);
+  if( ldlt.info() != Eigen::Success )
+    return false;
+  step = ldlt.solve(-gradient);
+  return ldlt.info() == Eigen::Success && step.allFinite();
+}
+
+PSE_INLINE bool
+PseEigenSparseLevenbergMarquardt::lmpar()
+{
+  const Scalar dwarf = (std::numeric_limits<Scalar>::min)();
+  const Scalar eps = Eigen::NumTraits<Scalar>::epsilon();
+  Scalar dxnorm, fp, parl = 0, paru, gnorm, parc, temp;
+
+  /* The Gauss-Newton step is taken if it is in the bound. With R the factor of
+   * the QR of J, the norms ||R^-t.w|| used by MINPACK are wt.(Jt.J)^-1.w. */
+  const bool nonsingular = damped_solve(0);
+  if( nonsingular ) {
+    wa = diag.cwiseProduct(step);
+    dxnorm = wa.stableNorm();
+    fp = dxnorm - delta;
+    if( fp <= Scalar(0.1) * delta ) {
+      par = 0;
+      return true;
+    }
+    wa = diag.cwiseProduct(wa) / dxnorm;
+    temp = wa.dot(ldlt.solve(wa));
+    parl = fp / delta / temp;
+  } else {
+    dxnorm = 0;
+    fp = -delta;
+  }
+
+  /* Bounds of the parameter */
+  gnorm = gradient.cwiseQuotient(diag).stableNorm();
+  paru = gnorm / delta;
+  if( paru == 0 )
+    paru = dwarf / (std::min)(delta, Scalar(0.1));
+
+  par = (std::max)(par, parl);
+  par = (std::min)(par, paru);
+  if( par == 0 )
+    par = dxnorm != 0 ? gnorm / dxnorm : Scalar(0);
+
+  for(int iter = 0; ; ++iter) {
+    if( par == 0 )
+      par = (std::max)(dwarf, Scalar(.001) * paru);
+    /* Unlike the QR of J, the factorization of a rank deficient Jt.J fails
+     * with a tiny damping: it is then increased until it succeeds. */
+    while( !damped_solve(par) ) {
+      if( par >= 1 / eps )
+        return false;
+      par = (std::max)(Scalar(10) * par, eps);
+    }
+
+    wa = diag.cwiseProduct(step);
+    dxnorm = wa.stableNorm();
+    temp = fp;
+    fp = dxnorm - delta;
+
+    /* The parameter is accepted once ||D.h|| is close to delta, or when it is
+     * too small to reach the bound. */
+    if( std::abs(fp) <= Scalar(0.1) * delta
+     || (parl == 0 && fp <= temp && temp < 0)
+     || iter == 10 )
+      break;
+
+    /* Newton correction */
+    wa = diag.cwiseProduct(wa) / dxnorm;
+    temp = wa.dot(ldlt.solve(wa));
+    parc = fp / delta / temp;
+
+    if( fp > 0 )
+      parl = (std::max)(parl, par);
+    if( fp < 0 )
+      paru = (std::min)(paru, par);
+    par = (std::max)(parl, par + parc);
+  }
+  return true;
+}
+
+PSE_INLINE PseEigenSparseLevenbergMarquardt::Status
+PseEigenSparseLevenbergMarquardt::minimizeInit
+  (FVectorType& x)
+{
+  const Eigen::Index n = x.size();
+  const Eigen::Index m = functor.values();
+
+  nfev_count = 0;
+  if( n <= 0 || m < n ) {
+    computation_info = Eigen::InvalidInput;
+    return Eigen::LevenbergMarquardtSpace::ImproperInputParameters;
+  }
+  fvec.resize(m);
+  fvec_next.resize(m);
+  fjac.resize(m, n);
+  diag.resize(n);
+
+  nfev_count = 1;
+  if( functor(x, fvec) < 0 )
+    return Eigen::LevenbergMarquardtSpace::UserAsked;
+  fnorm = fvec.stableNorm();
+
+  par = 0;
+  iterations_count = 1;
+  return Eigen::LevenbergMarquardtSpace::NotStarted;
+}
+
+PSE_INLINE PseEigenSparseLevenbergMarquardt::Status
+PseEigenSparseLevenbergMarquardt::minimizeOneStep
+  (FVectorType& x)
+{
+  const Scalar eps = Eigen::NumTraits<Scalar>::epsilon();
+  const Eigen::Index n = x.size();
+  Scalar ratio, temp = 0, xnorm = 0, gnorm = 0;
+  assert(n == diag.size());
+
+  const int df_ret = functor.df(x, fjac);
+  if( df_ret < 0 )
+    return Eigen::LevenbergMarquardtSpace::UserAsked;
+  nfev_count += df_ret; /* evaluations done by the finite differences */
+
+  jtj = fjac.transpose() * fjac;
+  gradient = fjac.transpose() * fvec;
+  col_norms.resize(n);
+  for(Eigen::Index j = 0; j < n; ++j)
+    col_norms[j] = fjac.col(j).norm();
+
+  /* On the first iteration, D is the norms of the columns of the Jacobian
+   * matrix and the step bound is relative to the scaled inputs. */
+  if( iterations_count == 1 ) {
+    for(Eigen::Index j = 0; j < n; ++j)
+      diag[j] = col_norms[j] == 0 ? Scalar(1) : col_norms[j];
+    xnorm = diag.cwiseProduct(x).stableNorm();
+    delta = factor * xnorm;
+    if( delta == 0 )
+      delta = factor;
+  }
+
+  /* Norm of the scaled gradient, i.e. the cosinus of the angle between the
+   * costs and the columns of the Jacobian matrix. */
+  if( fnorm != 0 ) {
+    for(Eigen::Index j = 0; j < n; ++j) {
+      if( col_norms[j] != 0 ) {
+        gnorm = (std::max)
+          (gnorm, std::abs(gradient[j]) / fnorm / col_norms[j]);
+      }
+    }
+  }
+  if( gnorm <= gtol ) {
+    computation_info = Eigen::Success;
+    return Eigen::LevenbergMarquardtSpace::CosinusTooSmall;
+  }
+
+  diag = diag.cwiseMax(col_norms);
+
+  /* The damping only changes the diagonal: the pattern of the damped matrix
+   * is the one of Jt.J with its whole diagonal. */
+  scaling.resize(n, n);
+  scaling.setIdentity();
+  scaling.diagonal() = diag.cwiseAbs2();
+  damped = jtj + scaling;
+  ldlt.analyzePattern(damped);
+
+  do {
+    if( !lmpar() ) {
+      computation_info = Eigen::NumericalIssue;
+      return Eigen::LevenbergMarquardtSpace::ImproperInputParameters;
+    }
+    x_next = x + step;
+    const Scalar pnorm = diag.cwiseProduct(step).stableNorm();
+
+    /* On the first iteration, adjust the initial step bound */
+    if( iterations_count == 1 )
+      delta = (std::min)(delta, pnorm);
+
+    if( functor(x_next, fvec_next) < 0 )
+      return Eigen::LevenbergMarquardtSpace::UserAsked;
+    ++nfev_count;
+    const Scalar fnorm1 = fvec_next.stableNorm();
+
+    /* Scaled actual and predicted reductions, and the scaled directional
+     * derivative. */
+    Scalar actred = -1;
+    if( Scalar(.1) * fnorm1 < fnorm )
+      actred = 1 - Eigen::numext::abs2(fnorm1 / fnorm);
+    const Scalar temp1 =
+      Eigen::numext::abs2((fjac * step).stableNorm() / fnorm);
+    const Scalar temp2 = Eigen::numext::abs2(std::sqrt(par) * pnorm / fnorm);
+    const Scalar prered = temp1 + temp2 / Scalar(.5);
+    const Scalar dirder = -(temp1 + temp2);
+    ratio = prered != 0 ? actred / prered : Scalar(0);
+
+    /* Update of the step bound */
+    if( ratio <= Scalar(.25) ) {
+      if( actred >= 0 )
+        temp = Scalar(.5);
+      if( actred < 0 )
+        temp = Scalar(.5) * dirder / (dirder + Scalar(.5) * actred);
+      if( Scalar(.1) * fnorm1 >= fnorm || temp < Scalar(.1) )
+        temp = Scalar(.1);
+      delta = temp * (std::min)(delta, pnorm / Scalar(.1));
+      par /= temp;
+    } else if( !(par != 0 && ratio < Scalar(.75)) ) {
+      delta = pnorm / Scalar(.5);
+      par = Scalar(.5) * par;
+    }
+
+    /* Successful iteration */
+    if( ratio >= Scalar(1.e-4) ) {
+      x = x_next;
+      fvec.swap(fvec_next);
+      xnorm = diag.cwiseProduct(x).stableNorm();
+      fnorm = fnorm1;
+      ++iterations_count;
+    }
+
+    /* Tests for convergence */
+    const bool reduction_small =
+      std::abs(actred) <= ftol && prered <= ftol && Scalar(.5) * ratio <= 1;
+    if( reduction_small && delta <= xtol * xnorm ) {
+      computation_info = Eigen::Success;
+      return Eigen::LevenbergMarquardtSpace::RelativeErrorAndReductionTooSmall;
+    }
+    if( reduction_small ) {
+      computation_info = Eigen::Success;
+      return Eigen::LevenbergMarquardtSpace::RelativeReductionTooSmall;
+    }
+    if( delta <= xtol * xnorm ) {
+      computation_info = Eigen::Success;
+      return Eigen::LevenbergMarquardtSpace::RelativeErrorTooSmall;
+    }
+
+    /* Tests for termination and stringent tolerances */
+    if( nfev_count >= maxfev ) {
+      computation_info = Eigen::NoConvergence;
+      return Eigen::LevenbergMarquardtSpace::TooManyFunctionEvaluation;
+    }
+    if( std::abs(actred) <= eps && prered <= eps && Scalar(.5) * ratio <= 1 ) {
+      computation_info = Eigen::Success;
+      return Eigen::LevenbergMarquardtSpace::FtolTooSmall;
+    }
+    if( delta <= eps * xnorm ) {
+      computation_info = Eigen::Success;
+      return Eigen::LevenbergMarquardtSpace::XtolTooSmall;
+    }
+    if( gnorm <= eps ) {
+      computation_info = Eigen::Success;
+      return Eigen::LevenbergMarquardtSpace::GtolTooSmall;
+    }
+  } while( ratio < Scalar(1.e-4) );
+
+  return Eigen::LevenbergMarquardtSpace::Running;
+}
+
+PSE_INLINE PseEigenSparseLevenbergMarquardt::Status
+PseEigenSparseLevenbergMarquardt::minimize
+  (FVectorType& x)
+{
+  Status status = minimizeInit(x);
+  if( status != Eigen::LevenbergMarquardtSpace::NotStarted )
+    return status;
+  do {
+    status = minimizeOneStep(x);
+  } while( status == Eigen::LevenbergMarquardtSpace::Running );
+  return status;
+}
+
 /******************************************************************************
  *
  * HELPER FUNCTIONS
@@ -751,9 +1723,207 @@ pseEigenExplorationSolverContextClean
 {
   sb_free(ctxt->optimizable_ppoints);
   ctxt->input.resize(0);
+  /* Release the memory, that the assignment below would keep */
+  std::vector<PseEigenExplorationSparseFunctor::Triplet>().swap
+    (ctxt->jacobian_triplets);
+  std::vector<size_t>().swap(ctxt->input_idx_per_ppoint);
+  std::vector<struct pse_eigen_finite_diffs_scratch_t>().swap
+    (ctxt->finite_diffs_scratch);
+  std::vector<struct pse_eigen_cps_converted_input_t>().swap
+    (ctxt->converted_inputs);
+  ctxt->costs_locked.resize(0);
+  ctxt->costs_subset.resize(0);
+  ctxt->gradients.resize(0);
   *ctxt = PSE_EIGEN_CPS_EXPLORATION_SOLVER_CONTEXT_NULL;
 }
 
+#ifndef PSE_EIGEN_REF
+/* Build the lists of the enabled relationships using each ppoint, for each
+ * variation of the functor. The lists are counted first, so that each
+ * relationship is only visited twice instead of once per ppoint. */
+static PSE_FINLINE enum pse_res_t
+pseEigenExplorationSolverRelationshipsPerPointPrecompute
+  (struct pse_allocator_t* allocator,
+   const size_t ppoints_count,
+   struct pse_eigen_relshp_cost_func_t& rcf)
+{
+  enum pse_res_t res = RES_OK;
+  const struct pse_relshp_cost_func_params_t* rcfp = &rcf.idata->params;
+  struct pse_eigen_relshps_lists_t& lists = rcf.relshps_per_ppoint;
+  size_t j, p, q, v;
+
+  pseEigenRelshpsListsRelease(allocator, lists);
+  PSE_CALL_OR_RETURN(res, pseEigenRelshpsListsCreate
+    (allocator, rcf.idata->variations_count * ppoints_count, lists));
+
+  for(v = 0; v < rcf.idata->variations_count; ++v) {
+    const struct pse_cpspace_instance_variated_cost_func_data_t* ivcfd =
+      &rcf.idata->variations[v];
+    for(j = 0; j < ivcfd->relshps_count; ++j) {
+      const struct pse_eval_relshp_data_t* data = ivcfd->relshps_data[j];
+      if( *ivcfd->relshps_states[j] == PSE_CPSPACE_RELSHP_STATE_DISABLED )
+        continue;
+      for(p = 0; p < data->ppoints_count; ++p) {
+        /* A ppoint used twice by a relationship only uses it once */
+        for(q = 0; q < p && data->ppoints[q] != data->ppoints[p]; ++q);
+        if( q < p )
+          continue;
+        assert(data->ppoints[p] < ppoints_count);
+        ++lists.relshps_counts[v*ppoints_count + data->ppoints[p]];
+      }
+    }
+  }
+  PSE_CALL_OR_RETURN(res, pseEigenRelshpsListsAllocate(allocator, lists));
+
+  for(v = 0; v < rcf.idata->variations_count; ++v) {
+    const struct pse_cpspace_instance_variated_cost_func_data_t* ivcfd =
+      &rcf.idata->variations[v];
+    size_t relshp_costs_start_idx = 0;
+    for(j = 0; j < ivcfd->relshps_count; ++j) {
+      const struct pse_eval_relshp_data_t* data = ivcfd->relshps_data[j];
+      const size_t costs_count = pseEigenRelationshipCostsCount(rcfp, data);
+      if( *ivcfd->relshps_states[j] == PSE_CPSPACE_RELSHP_STATE_DISABLED )
+        continue;
+      for(p = 0; p < data->ppoints_count; ++p) {
+        for(q = 0; q < p && data->ppoints[q] != data->ppoints[p]; ++q);
+        if( q < p )
+          continue;
+        pseEigenRelshpsListsAppend
+          (lists, v*ppoints_count + data->ppoints[p],
+           ivcfd, j, relshp_costs_start_idx, costs_count);
+      }
+      relshp_costs_start_idx += costs_count;
+    }
+    assert(relshp_costs_start_idx == rcf.costs_count_per_variation);
+  }
+  return RES_OK;
+}
+#endif
+
+/* Index of the list of the relationship 'j' of the variation 'v' in the split
+ * lists of its functor */
+static PSE_FINLINE size_t
+pseEigenRelshpSplitListIndex
+  (const struct pse_eigen_cps_exploration_solver_context_t* ctxt,
+   const struct pse_cpspace_instance_variated_cost_func_data_t* ivcfd,
+   const size_t j,
+   const size_t v)
+{
+  const struct pse_eval_relshp_data_t* data = ivcfd->relshps_data[j];
+  bool locked = true;
+  if( *ivcfd->relshps_states[j] == PSE_CPSPACE_RELSHP_STATE_DISABLED )
+    return 3*v + 2;
+  for(size_t p = 0; p < data->ppoints_count && locked; ++p) {
+    locked = (ctxt->input_idx_per_ppoint[data->ppoints[p]] == PSE_INDEX_INVALID);
+  }
+  return 3*v + (locked ? 1 : 0);
+}
+
+/* Split the relationships of each cost functor between the enabled ones with
+ * at least one optimizable ppoint, the enabled ones whose ppoints are all
+ * locked and the disabled ones. This is only done again when the optimizable
+ * ppoints or the state of the relationships change. */
+static PSE_INLINE enum pse_res_t
+pseEigenExplorationSolverRelationshipsSplit
+  (const struct pse_eigen_cps_exploration_t* exp,
+   const struct pse_eigen_cps_exploration_solver_context_t* ctxt)
+{
+  enum pse_res_t res = RES_OK;
+  struct pse_allocator_t* allocator = exp->dev->allocator;
+  struct pse_eigen_cps_precomputations_t& precomp = exp->problem->precomp;
+  const size_t optimizable_ppoints_count = sb_count(ctxt->optimizable_ppoints);
+  const size_t states_revision = exp->cpsi->relshps_states_revision;
+  const bool states_changed = !precomp.relshps_split
+    || precomp.relshps_split_states_revision != states_revision;
+  size_t costs_needed = 0;
+  size_t i, j, v;
+  if( !states_changed
+   && precomp.relshps_split_ppoints_count == optimizable_ppoints_count
+   && std::equal
+       (precomp.relshps_split_ppoints,
+        precomp.relshps_split_ppoints + optimizable_ppoints_count,
+        ctxt->optimizable_ppoints) )
+    return RES_OK;
+
+  precomp.relshps_split = false;
+  if( precomp.relshps_split_ppoints )
+    PSE_FREE(allocator, precomp.relshps_split_ppoints);
+  precomp.relshps_split_ppoints = nullptr;
+  precomp.relshps_split_ppoints_count = 0;
+
+  for(i = 0; i < precomp.relshp_cost_funcs_count; ++i) {
+    struct pse_eigen_relshp_cost_func_t& rcf = precomp.relshp_cost_funcs[i];
+    const struct pse_relshp_cost_func_params_t* rcfp = &rcf.idata->params;
+    const size_t variations_count = rcf.idata->variations_count;
+    struct pse_eigen_relshps_lists_t& lists = rcf.relshps_split;
+
+    pseEigenRelshpsListsRelease(allocator, lists);
+    PSE_CALL_OR_RETURN(res, pseEigenRelshpsListsCreate
+      (allocator, 3*variations_count, lists));
+
+    /* Count the relationships of each list, then fill them */
+    for(v = 0; v < variations_count; ++v) {
+      const struct pse_cpspace_instance_variated_cost_func_data_t* ivcfd =
+        &rcf.idata->variations[v];
+      for(j = 0; j < ivcfd->relshps_count; ++j) {
+        ++lists.relshps_counts[pseEigenRelshpSplitListIndex(ctxt, ivcfd, j, v)];
+      }
+    }
+    PSE_CALL_OR_RETURN(res, pseEigenRelshpsListsAllocate(allocator, lists));
+
+    /* The costs of the enabled relationships are contiguous in the costs of
+     * each variation, in the order of the relationships. */
+    for(v = 0; v < variations_count; ++v) {
+      const struct pse_cpspace_instance_variated_cost_func_data_t* ivcfd =
+        &rcf.idata->variations[v];
+      size_t relshp_costs_start_idx = 0;
+      size_t gradients_count = 0;
+      for(j = 0; j < ivcfd->relshps_count; ++j) {
+        const struct pse_eval_relshp_data_t* data = ivcfd->relshps_data[j];
+        const size_t list_idx = pseEigenRelshpSplitListIndex(ctxt, ivcfd, j, v);
+        const size_t costs_count = (list_idx == 3*v + 2)
+          ? 0 : pseEigenRelationshipCostsCount(rcfp, data);
+        pseEigenRelshpsListsAppend
+          (lists, list_idx, ivcfd, j, relshp_costs_start_idx, costs_count);
+        relshp_costs_start_idx += costs_count;
+        gradients_count += rcfp->cost_arity_mode == PSE_COST_ARITY_MODE_PER_POINT
+          ? costs_count
+          : costs_count * data->ppoints_count;
+      }
+      /* The main variation has the list of all the relationships, not
+       * filtered by applicability of the variations. */
+      if( v == 0 ) {
+        rcf.costs_count_per_variation = relshp_costs_start_idx;
+        rcf.gradients_count_per_component = gradients_count;
+      }
+      assert(relshp_costs_start_idx == rcf.costs_count_per_variation);
+    }
+    costs_needed += rcf.costs_count_per_variation * variations_count;
+
+#ifndef PSE_EIGEN_REF
+    if( states_changed ) {
+      PSE_CALL_OR_RETURN(res,
+        pseEigenExplorationSolverRelationshipsPerPointPrecompute
+          (allocator, precomp.ppoints_count, rcf));
+    }
+#endif
+  }
+  precomp.costs_needed = costs_needed;
+
+  precomp.relshps_split_ppoints = PSE_TYPED_ALLOC_ARRAY
+    (allocator, pse_ppoint_id_t, PSE_MAX(optimizable_ppoints_count, 1));
+  if( !precomp.relshps_split_ppoints )
+    return RES_MEM_ERR;
+  std::copy
+    (ctxt->optimizable_ppoints,
+     ctxt->optimizable_ppoints + optimizable_ppoints_count,
+     precomp.relshps_split_ppoints);
+  precomp.relshps_split_ppoints_count = optimizable_ppoints_count;
+  precomp.relshps_split_states_revision = states_revision;
+  precomp.relshps_split = true;
+  return RES_OK;
+}
+
 static PSE_INLINE enum pse_res_t
 pseEigenExplorationSolverContextSetup
   (const struct pse_eigen_cps_exploration_t* exp,
@@ -793,20 +1963,32 @@ pseEigenExplorationSolverContextSetup
   ctxt->input.resize(optimizable_ppoints_scalars_count);
   ctxt->input_full.resize(sb_count(exp->cpsi->ppoints) * coords_comps_count);
 
-  /* TODO: is it normal to use a MAX here? Is this a problem for the results if
+  PSE_CALL_OR_GOTO(res,error, pseEigenExplorationCopySamples
+    (smpls, ctxt->optimizable_ppoints, ctxt->input));
+  PSE_CALL_OR_GOTO(res,error, pseEigenExplorationCopySamples
+    (smpls, exp->cpsi->ppoints, ctxt->input_full));
+
+  /* Columns of the Jacobian matrix for each parametric point */
+  ctxt->input_idx_per_ppoint.assign
+    (sb_count(exp->cpsi->ppoints), PSE_INDEX_INVALID);
+  for(i = 0; i < optimizable_ppoints_count; ++i) {
+    const pse_ppoint_id_t ppid = ctxt->optimizable_ppoints[i];
+    assert(ppid < ctxt->input_idx_per_ppoint.size());
+    ctxt->input_idx_per_ppoint[ppid] = i * coords_comps_count;
+  }
+  PSE_CALL_OR_GOTO(res,error,
+    pseEigenExplorationSolverRelationshipsSplit(exp, ctxt));
+
+  /* The costs of the enabled relationships are known once they are split.
+   * TODO: is it normal to use a MAX here? Is this a problem for the results if
    * some costs are allocated but not used? */
   ctxt->costs_count = PSE_MAX
     (optimizable_ppoints_scalars_count,
      exp->problem->precomp.costs_needed);
   ctxt->costs_ref.resize(ctxt->costs_count);
-  ctxt->costs_tmp1.resize(ctxt->costs_count);
-  ctxt->costs_tmp2.resize(ctxt->costs_count);
+  ctxt->costs_locked.setZero(ctxt->costs_count);
   ctxt->need_costs_ref = true;
-
-  PSE_CALL_OR_GOTO(res,error, pseEigenExplorationCopySamples
-    (smpls, ctxt->optimizable_ppoints, ctxt->input));
-  PSE_CALL_OR_GOTO(res,error, pseEigenExplorationCopySamples
-    (smpls, exp->cpsi->ppoints, ctxt->input_full));
+  ctxt->need_costs_locked = true;
 
   ctxt->eval_ctxt.dev = exp->dev->clt_dev;
   ctxt->eval_ctxt.cps = exp->cpsi->cps;
@@ -854,8 +2036,19 @@ static PSE_FINLINE void
 pseEigenExplorationSolverPrecomputationClean
   (struct pse_eigen_cps_exploration_t* exp)
 {
-  exp->problem->precomp.relshps.clear();
-  exp->problem->precomp.relshp_cost_funcs.clear();
+  struct pse_allocator_t* allocator = exp->dev->allocator;
+  struct pse_eigen_cps_precomputations_t& precomp = exp->problem->precomp;
+
+  for(size_t i = 0; i < precomp.relshp_cost_funcs_count; ++i) {
+    struct pse_eigen_relshp_cost_func_t& rcf = precomp.relshp_cost_funcs[i];
+    pseEigenRelshpsListsRelease(allocator, rcf.relshps_per_ppoint);
+    pseEigenRelshpsListsRelease(allocator, rcf.relshps_split);
+  }
+  if( precomp.relshp_cost_funcs )
+    PSE_FREE(allocator, precomp.relshp_cost_funcs);
+  if( precomp.relshps_split_ppoints )
+    PSE_FREE(allocator, precomp.relshps_split_ppoints);
+  precomp = PSE_EIGEN_CPS_PRECOMPUTATIONS_EMPTY;
 
   for(size_t i = 0; i < 3; ++i) {
     pseEigenExplorationSolverContextClean(&exp->ctxts[i]);
@@ -864,157 +2057,44 @@ pseEigenExplorationSolverPrecomputationClean
   sb_free(exp->cpsi->ppoints);
 }
 
-#ifndef PSE_EIGEN_REF
-static PSE_FINLINE enum pse_res_t
-pseEigenExplorationSolverRelationshipPerPointAddAndPrecompute
-  (const struct pse_eigen_cps_precomputations_t& cpsp,
-   struct pse_eigen_relshp_cost_func_t& rcf,
-   const pse_ppoint_id_t ppid)
-{
-  for(size_t i = 0; i < rcf.idata->variations_count; ++i) {
-    struct pse_cpspace_instance_variated_cost_func_data_t* ivcfd =
-      &rcf.idata->variations[i];
-    const size_t relshps_count = ivcfd->relshps_count;
-    struct pse_eigen_relshps_for_ppoint_precomputations_t& rfppp =
-      rcf.relshps_per_ppoint[pse_variated_ppoint_id_t(ppid, ivcfd->uid)];
-
-    rfppp = PSE_EIGEN_RELSHPS_FOR_PPOINT_PRECOMPUTATIONS_EMPTY;
-    rfppp.variation = ivcfd->uid;
-    rfppp.relshps.reserve(relshps_count);
-    rfppp.relshps_ctxt.reserve(relshps_count);
-    rfppp.relshps_config.reserve(relshps_count);
-    rfppp.relshps_eval_data.reserve(relshps_count);
-    rfppp.relshps_costs_chunks.reserve(relshps_count/2);
-
-    // TODO: this loop cost a lot and may be precomputed in the PSE library!
-    rfppp.costs_count = 0;
-    struct pse_costs_mem_chunk_t chunk = PSE_COSTS_MEM_CHUNK_EMPTY;
-    size_t relshp_costs_start_idx = 0;
-    for(size_t j = 0; j < relshps_count; ++j) {
-      const pse_relshp_id_t rid = ivcfd->relshps_ids[j];
-      const struct pse_eigen_relshp_precomputations_t& rp = cpsp.relshps.at(rid);
-      const pse_eigen_ppoint_id_set_t& ppoints_involved =
-        rp.ppoints_involved_set;
-      if( ppoints_involved.count(ppid) > 0 ) {
-        rfppp.relshps.push_back(rid);
-        rfppp.relshps_ctxt.push_back(ivcfd->relshps_ctxts[j]);
-        rfppp.relshps_config.push_back(ivcfd->relshps_configs[j]);
-        rfppp.relshps_eval_data.push_back(ivcfd->relshps_data[j]);
-        if( chunk.offset == PSE_OFFSET_INVALID ) {
-          chunk.offset = relshp_costs_start_idx;
-        } else {
-          assert(chunk.offset + chunk.count == relshp_costs_start_idx);
-        }
-        chunk.count += rp.costs_count;
-        rfppp.costs_count += rp.costs_count;
-      } else if( chunk.count > 0 ) {
-        // This chunk is finished
-        rfppp.relshps_costs_chunks.push_back(chunk);
-        chunk = PSE_COSTS_MEM_CHUNK_EMPTY;
-      }
-      relshp_costs_start_idx += rp.costs_count;
-    }
-    if( chunk.count > 0 ) {
-      // Keep the last chunk
-      rfppp.relshps_costs_chunks.push_back(chunk);
-    }
-    assert(relshp_costs_start_idx == rcf.costs_count_per_variation);
-    assert(rfppp.costs_count <= rcf.costs_count_per_variation);
-  }
-  return RES_OK;
-}
-#endif
-
 static PSE_INLINE enum pse_res_t
 pseEigenExplorationSolverPrecompute
   (struct pse_eigen_cps_exploration_t* exp)
 {
   enum pse_res_t res = RES_OK;
+  struct pse_allocator_t* allocator = nullptr;
   PseEigenExplorationProblem* pb = nullptr;
   const struct pse_cpspace_instance_t* cpsi = nullptr;
   assert(exp);
 
+  allocator = exp->dev->allocator;
   pb = exp->problem;
   cpsi = exp->cpsi;
 
-  /* Prepare the relationships precomputations. */
-  for(size_t i = 0; i < cpsi->relshps_count; ++i) {
-    const struct pse_cpspace_instance_relshp_data_t* ird = &cpsi->relshps[i];
-    const pse_relshp_id_t rid = (pse_relshp_id_t)ird->key;
-
-    assert(pb->precomp.relshps.count(rid) == 0);
-    struct pse_eigen_relshp_precomputations_t& rpc = pb->precomp.relshps[rid];
-
-    rpc.idata = ird;
-    rpc.costs_count = 0;
-
-    /* We keep a set to quickly check if a ppoint is involved in a relatioship */
-    rpc.ppoints_involved_set.reserve(ird->eval_data.ppoints_count);
-    for(size_t j = 0; j < ird->eval_data.ppoints_count; ++j) {
-      rpc.ppoints_involved_set.insert(ird->eval_data.ppoints[j]);
-    }
-  }
-
-  /* Prepare the cost functors precomputations. */
+  pb->precomp = PSE_EIGEN_CPS_PRECOMPUTATIONS_EMPTY;
+  pb->precomp.ppoints_count = sb_count(cpsi->ppoints);
+  pb->precomp.relshp_cost_funcs = PSE_TYPED_ALLOC_ARRAY
+    (allocator, struct pse_eigen_relshp_cost_func_t,
+     PSE_MAX(cpsi->cfuncs_count, 1));
+  PSE_VERIFY_OR_ELSE(pb->precomp.relshp_cost_funcs,
+    res = RES_MEM_ERR; goto error);
   for(size_t i = 0; i < cpsi->cfuncs_count; ++i) {
-    const struct pse_cpspace_instance_cost_func_data_t* icfd = &cpsi->cfuncs[i];
-    const pse_relshp_cost_func_id_t rcfid = (pse_relshp_cost_func_id_t)icfd->key;
-
-    assert(pb->precomp.relshp_cost_funcs.count(rcfid) == 0);
-    struct pse_eigen_relshp_cost_func_t& rcfpc =
-      pb->precomp.relshp_cost_funcs[rcfid];
-
-    rcfpc.idata = icfd;
-    rcfpc.costs_count_per_variation = 0;
+    pb->precomp.relshp_cost_funcs[i] = PSE_EIGEN_RELSHP_COST_FUNC_NULL;
+    pb->precomp.relshp_cost_funcs[i].idata = &cpsi->cfuncs[i];
   }
+  pb->precomp.relshp_cost_funcs_count = cpsi->cfuncs_count;
 
-  /* Second pass to compute the final costs count */
-  /* TODO: this pass may be merged with the first one */
-  pb->precomp.costs_needed = 0;
-  for(auto& fpcp: pb->precomp.relshp_cost_funcs) {
-    struct pse_eigen_relshp_cost_func_t& rcf = fpcp.second;
+  /* The costs count of each cost functor only counts its enabled
+   * relationships: it is computed when the relationships are split. */
+  for(size_t i = 0; i < pb->precomp.relshp_cost_funcs_count; ++i) {
+    const struct pse_eigen_relshp_cost_func_t& rcf = pb->precomp.relshp_cost_funcs[i];
     const struct pse_relshp_cost_func_params_t* rcfp = &rcf.idata->params;
     assert(rcf.idata->variations_count > 0);
-    const struct pse_cpspace_instance_variated_cost_func_data_t* main_ivcfd =
-      &rcf.idata->variations[0];
-    assert(main_ivcfd->uid == PSE_CLT_PPOINT_VARIATION_UID_INVALID);
-    /* The main variated cost func will have the list of all relationships, not
-     * filtered by applicability of the variations. */
-
-    /* Compute the number of costs needed by this functor */
-    rcf.costs_count_per_variation = 0;
-    switch(rcfp->cost_arity_mode) {
-      case PSE_COST_ARITY_MODE_PER_RELATIONSHIP: {
-        rcf.costs_count_per_variation =
-          rcfp->costs_count * main_ivcfd->relshps_count;
-        /* Keep the costs count for each relationship */
-        for(size_t i = 0; i < main_ivcfd->relshps_count; ++i) {
-          const pse_relshp_id_t rid = main_ivcfd->relshps_ids[i];
-          pb->precomp.relshps[rid].costs_count = rcfp->costs_count;
-        }
-      } break;
-      case PSE_COST_ARITY_MODE_PER_POINT: {
-        for(size_t i = 0; i < main_ivcfd->relshps_count; ++i) {
-          const pse_relshp_id_t rid = main_ivcfd->relshps_ids[i];
-          struct pse_eigen_relshp_precomputations_t& rp = pb->precomp.relshps[rid];
-          /* Keep the costs count for each relationship */
-          rp.costs_count = rcfp->costs_count * rp.idata->eval_data.ppoints_count;
-          rcf.costs_count_per_variation += rp.costs_count;
-        }
-      } break;
-      default: assert(false); res = RES_INTERNAL; goto error;
-    }
-    pb->precomp.costs_needed +=
-      rcf.costs_count_per_variation * rcf.idata->variations_count;
-
-#ifndef PSE_EIGEN_REF
-    for(size_t i = 0; i < sb_count(cpsi->ppoints); ++i) {
-      const pse_ppoint_id_t ppid = cpsi->ppoints[i];
-      PSE_CALL_OR_GOTO(res,error,
-        pseEigenExplorationSolverRelationshipPerPointAddAndPrecompute
-          (pb->precomp, rcf, ppid));
-    }
-#endif
+    assert(rcf.idata->variations[0].uid == PSE_CLT_PPOINT_VARIATION_UID_INVALID);
+    PSE_VERIFY_OR_ELSE
+      (rcfp->cost_arity_mode == PSE_COST_ARITY_MODE_PER_RELATIONSHIP
+    || rcfp->cost_arity_mode == PSE_COST_ARITY_MODE_PER_POINT,
+       res = RES_INTERNAL; goto error);
   }
 
 exit:
@@ -1033,6 +2113,8 @@ pseEigenExplorationCountersPrepare
   (void)opts;
   extra->counter_costs_calls.last_call = 0;
   extra->counter_iterations.last_call = 0;
+  extra->finite_diffs_columns_count = 0;
+  extra->finite_diffs_threads_count = 0;
 }
 
 static PSE_FINLINE void
@@ -1052,7 +2134,7 @@ pseEigenExplorationResultLog
    const char* name,
    struct pse_eigen_cps_exploration_solver_context_t* ctxt)
 {
-  char buff[16] = {0};
+  char buff[32] = {0};
   PSE_LOG(logger, DEBUG, name);
   PSE_LOG(logger, DEBUG, " -> Eigen LM status: ");
   PSE_LOG(logger, DEBUG, pseEigenLMStatusToCString(ctxt->algo_status));
@@ -1065,23 +2147,78 @@ pseEigenExplorationResultLog
 
   PSE_LOG(logger, DEBUG, name);
   PSE_LOG(logger, DEBUG, " -> Number of costs calls (last call/total): ");
-  sprintf(buff, "%I64u", (uint64_t)ctxt->extra.counter_costs_calls.last_call);
+  snprintf(buff, sizeof(buff), "%llu", (unsigned long long)ctxt->extra.counter_costs_calls.last_call);
   PSE_LOG(logger, DEBUG, buff);
   PSE_LOG(logger, DEBUG, "/");
-  sprintf(buff, "%I64u", (uint64_t)ctxt->extra.counter_costs_calls.total);
+  snprintf(buff, sizeof(buff), "%llu", (unsigned long long)ctxt->extra.counter_costs_calls.total);
   PSE_LOG(logger, DEBUG, buff);
   PSE_LOG(logger, DEBUG, "\n");
 
   PSE_LOG(logger, DEBUG, name);
   PSE_LOG(logger, DEBUG, " -> Number of iterations (last call/total): ");
-  sprintf(buff, "%I64u", (uint64_t)ctxt->extra.counter_iterations.last_call);
+  snprintf(buff, sizeof(buff), "%llu", (unsigned long long)ctxt->extra.counter_iterations.last_call);
   PSE_LOG(logger, DEBUG, buff);
   PSE_LOG(logger, DEBUG, "/");
-  sprintf(buff, "%I64u", (uint64_t)ctxt->extra.counter_iterations.total);
+  snprintf(buff, sizeof(buff), "%llu", (unsigned long long)ctxt->extra.counter_iterations.total);
+  PSE_LOG(logger, DEBUG, buff);
+  PSE_LOG(logger, DEBUG, "\n");
+
+  PSE_LOG(logger, DEBUG, name);
+  PSE_LOG(logger, DEBUG, " -> Finite differences (columns/threads): ");
+  snprintf(buff, sizeof(buff), "%llu", (unsigned long long)ctxt->extra.finite_diffs_columns_count);
+  PSE_LOG(logger, DEBUG, buff);
+  PSE_LOG(logger, DEBUG, "/");
+  snprintf(buff, sizeof(buff), "%llu", (unsigned long long)ctxt->extra.finite_diffs_threads_count);
   PSE_LOG(logger, DEBUG, buff);
   PSE_LOG(logger, DEBUG, "\n");
 }
 
+/* The Levenberg-Marquardt calls done by the exploration, whichever the
+ * Jacobian matrix used by the solver. */
+enum pse_eigen_lm_call_t {
+  PSE_EIGEN_LM_MINIMIZE_INIT,
+  PSE_EIGEN_LM_MINIMIZE_ONE_STEP,
+  PSE_EIGEN_LM_MINIMIZE
+};
+
+template<typename Solver>
+static PSE_FINLINE void
+pseEigenExplorationLMRun
+  (Solver& lm,
+   const enum pse_eigen_lm_call_t call,
+   struct pse_eigen_cps_exploration_solver_context_t* ctxt,
+   size_t* nfev,
+   size_t* iterations)
+{
+  switch(call) {
+    case PSE_EIGEN_LM_MINIMIZE_INIT:
+      ctxt->algo_status = lm.minimizeInit(ctxt->input); break;
+    case PSE_EIGEN_LM_MINIMIZE_ONE_STEP:
+      ctxt->algo_status = lm.minimizeOneStep(ctxt->input); break;
+    case PSE_EIGEN_LM_MINIMIZE:
+      ctxt->algo_status = lm.minimize(ctxt->input); break;
+    default: assert(false); break;
+  }
+  ctxt->algo_info = lm.info();
+  *nfev = (size_t)lm.nfev();
+  *iterations = (size_t)lm.iterations();
+}
+
+static PSE_FINLINE void
+pseEigenExplorationLMCall
+  (struct pse_eigen_cps_exploration_t* exp,
+   const enum pse_eigen_lm_call_t call,
+   struct pse_eigen_cps_exploration_solver_context_t* ctxt,
+   size_t* nfev,
+   size_t* iterations)
+{
+  if( exp->sparse_lm ) {
+    pseEigenExplorationLMRun(*exp->sparse_lm, call, ctxt, nfev, iterations);
+  } else {
+    pseEigenExplorationLMRun(*exp->lm, call, ctxt, nfev, iterations);
+  }
+}
+
 /******************************************************************************
  *
  * PRIVATE API
@@ -1116,8 +2253,15 @@ pseEigenExplorationCreate
   *exp = PSE_EIGEN_CPS_EXPLORATION_NULL;
   exp->problem = new PseEigenExplorationProblem{};
   PSE_VERIFY_OR_ELSE(exp->problem != nullptr, res = RES_MEM_ERR; goto error);
-  exp->lm = new PseEigenExplorationSolver{*exp->problem};
-  PSE_VERIFY_OR_ELSE(exp->lm != nullptr, res = RES_MEM_ERR; goto error);
+  if( params->options.jacobian == PSE_CPSPACE_EXPLORATION_JACOBIAN_SPARSE ) {
+    exp->sparse_problem = new PseEigenExplorationSparseProblem{exp->problem};
+    PSE_VERIFY_OR_ELSE(exp->sparse_problem != nullptr, res = RES_MEM_ERR; goto error);
+    exp->sparse_lm = new PseEigenExplorationSparseSolver{*exp->sparse_problem};
+    PSE_VERIFY_OR_ELSE(exp->sparse_lm != nullptr, res = RES_MEM_ERR; goto error);
+  } else {
+    exp->lm = new PseEigenExplorationSolver{*exp->problem};
+    PSE_VERIFY_OR_ELSE(exp->lm != nullptr, res = RES_MEM_ERR; goto error);
+  }
 
   exp->dev = dev;
   exp->cpsi = cpsi;
@@ -1133,6 +2277,8 @@ exit:
   return res;
 error:
   if( exp ) {
+    delete exp->sparse_lm;
+    delete exp->sparse_problem;
     delete exp->lm;
     delete exp->problem;
     PSE_FREE(exp->dev->allocator, exp);
@@ -1147,6 +2293,8 @@ pseEigenExplorationDestroy
   assert(exp);
 
   pseEigenExplorationSolverPrecomputationClean(exp);
+  delete exp->sparse_lm;
+  delete exp->sparse_problem;
   delete exp->lm;
   delete exp->problem;
   PSE_FREE(exp->dev->allocator, exp);
@@ -1161,6 +2309,7 @@ pseEigenExplorationSolveBegin
 {
   enum pse_res_t res = RES_OK;
   struct pse_eigen_cps_exploration_solver_context_t* ctxt = nullptr;
+  size_t iterations = 0;
   assert(exp && smpls);
 
   // Fast check without locking everyone
@@ -1193,9 +2342,8 @@ pseEigenExplorationSolveBegin
 
   pseEigenExplorationCountersPrepare(&exp->params.options, &ctxt->extra);
   exp->problem->ctxt = ctxt;
-  ctxt->algo_status = exp->lm->minimizeInit(ctxt->input);
-  ctxt->algo_info = exp->lm->info();
-  ctxt->extra.counter_costs_calls.last_call = exp->lm->nfev();
+  pseEigenExplorationLMCall(exp, PSE_EIGEN_LM_MINIMIZE_INIT, ctxt,
+    &ctxt->extra.counter_costs_calls.last_call, &iterations);
   ctxt->extra.counter_iterations.last_call = 1;
   pseEigenExplorationCountersFinalize(&exp->params.options, &ctxt->extra);
 
@@ -1219,6 +2367,7 @@ pseEigenExplorationSolveStep
 {
   enum pse_res_t res = RES_OK;
   struct pse_eigen_cps_exploration_solver_context_t* ctxt = nullptr;
+  size_t iterations = 0;
   assert(exp);
   if( exp->curr_ctxt_idx == PSE_INDEX_INVALID )
     return RES_NOT_READY;
@@ -1227,10 +2376,9 @@ pseEigenExplorationSolveStep
 
   const size_t prev_iterations_count = ctxt->extra.counter_iterations.last_call;
   pseEigenExplorationCountersPrepare(&exp->params.options, &ctxt->extra);
-  ctxt->algo_status = exp->lm->minimizeOneStep(ctxt->input);
-  ctxt->algo_info = exp->lm->info();
-  ctxt->extra.counter_costs_calls.last_call = exp->lm->nfev();
-  ctxt->extra.counter_iterations.last_call = exp->lm->iterations() - prev_iterations_count;
+  pseEigenExplorationLMCall(exp, PSE_EIGEN_LM_MINIMIZE_ONE_STEP, ctxt,
+    &ctxt->extra.counter_costs_calls.last_call, &iterations);
+  ctxt->extra.counter_iterations.last_call = iterations - prev_iterations_count;
   pseEigenExplorationCountersFinalize(&exp->params.options, &ctxt->extra);
 
   pseEigenExplorationResultLog(exp->dev->logger, "Step", ctxt);
@@ -1278,6 +2426,7 @@ pseEigenExplorationSolve
 {
   enum pse_res_t res = RES_OK;
   struct pse_eigen_cps_exploration_solver_context_t* ctxt = nullptr;
+  size_t nfev = 0, iterations = 0;
   assert(exp && smpls);
 
   // Fast check without locking everyone
@@ -1313,21 +2462,25 @@ pseEigenExplorationSolve
     /* Tries until converged or max tries reached */
     size_t i;
     for(i = 0; i < exp->params.options.max_convergence_tries; ++i) {
-      ctxt->algo_status = exp->lm->minimize(ctxt->input);
-      ctxt->algo_info = exp->lm->info();
-      ctxt->extra.counter_costs_calls.last_call += exp->lm->nfev();
-      ctxt->extra.counter_iterations.last_call += exp->lm->iterations();
+      pseEigenExplorationLMCall(exp, PSE_EIGEN_LM_MINIMIZE, ctxt,
+        &nfev, &iterations);
+      ctxt->extra.counter_costs_calls.last_call += nfev;
+      ctxt->extra.counter_iterations.last_call += iterations;
       res = pseEigenExplorationSolverContextStatusCheck
         (ctxt, exp->problem->last_res);
       if( res != RES_NOT_CONVERGED )
         break; /* Converged or error -> stop */
+      /* No step was accepted, e.g. when the finite differences used all the
+       * costs calls of the try: the next one would start from the same
+       * inputs and do the same. */
+      if( iterations <= 1 )
+        break;
     }
   } else {
     /* Only one try */
-    ctxt->algo_status = exp->lm->minimize(ctxt->input);
-    ctxt->algo_info = exp->lm->info();
-    ctxt->extra.counter_costs_calls.last_call = exp->lm->nfev();
-    ctxt->extra.counter_iterations.last_call = exp->lm->iterations();
+    pseEigenExplorationLMCall(exp, PSE_EIGEN_LM_MINIMIZE, ctxt,
+      &ctxt->extra.counter_costs_calls.last_call,
+      &ctxt->extra.counter_iterations.last_call);
     res = pseEigenExplorationSolverContextStatusCheck
       (ctxt, exp->problem->last_res);
   }
@@ -1362,14 +2515,20 @@ pseEigenExplorationLastResultsRetreive
   accessors = pseEigenValuesAccessorsGet(where, PSE_POINT_ATTRIB_COORDINATES);
   PSE_VERIFY_OR_ELSE(accessors && accessors->set, return RES_BAD_ARG);
 
+  /* The results of a started step-by-step exploration are the ones of its
+   * last step, so that they can be applied without ending it. */
+  if( exp->curr_ctxt_idx != PSE_INDEX_INVALID && exp->problem->ctxt )
+    results_ctxt_idx = exp->curr_ctxt_idx;
+  else
+    results_ctxt_idx = exp->last_ctxt_idx;
+
   /* If there is no current context results, just leave without any
    * modification. */
-  if( exp->last_ctxt_idx == PSE_INDEX_INVALID )
+  if( results_ctxt_idx == PSE_INDEX_INVALID )
     return RES_OK;
 
   // TODO: this solution is not working: if the retreive takes years, the solver
   // could overwrite the context kept here!
-  results_ctxt_idx = exp->last_ctxt_idx;
   ctxt = &exp->ctxts[results_ctxt_idx];
 
   PSE_CALL_OR_RETURN(res, accessors->set
@@ -25,6 +25,8 @@
  * \todo Ensure everything is thread-safe and can be called concurrently without
  * any problems. Mainly check the values lock/unlock mechanism to allow fast and
  * possibly lock-free read-write access from user and driver at the same time.
+ * Note that with OpenMP, the drivers already call the \p compute callback of
+ * the cost functors concurrently (see ::pse_relshp_cost_func_params_t).
  */
 
 PSE_API_BEGIN
@@ -281,12 +283,32 @@ enum pse_cost_arity_mode_t {
   PSE_COST_ARITY_MODE_PER_POINT
 };
 
-/*! Parameters of a relationship cost functor. */
+/*! Parameters of a relationship cost functor.
+ *
+ * \param compute Callback computing the costs of the given relationships. When
+ *    the library is built with OpenMP (PSE_ENABLE_USE_OF_OPENMP), it is called
+ *    concurrently by several threads to compute the finite differences, each
+ *    one with its own coordinates and costs: it must be reentrant, and must
+ *    synchronize its accesses to any state shared between its calls, such as
+ *    the contexts of the relationships.
+ * \param compute_df Optional callback computing the analytic gradients of the
+ *    costs, called with the same arguments than \p compute. Its last argument
+ *    is filled relationship after relationship: for each cost of the
+ *    relationship (in the order of \p compute), the derivatives with respect
+ *    to each coordinate of each parametric point of the relationship (in the
+ *    order of ::pse_eval_relshp_data_t::ppoints). With
+ *    ::PSE_COST_ARITY_MODE_PER_POINT, the costs of a parametric point only
+ *    depend on this point: the costs of \p compute are given point after point
+ *    and, for each cost of each point, only the derivatives with respect to the
+ *    coordinates of this point are given. When NULL, or when the
+ *    functor is evaluated in another parameter space than the explored one or
+ *    with variations, the gradients are computed by finite differences.
+ */
 struct pse_relshp_cost_func_params_t {
   pse_clt_cost_func_uid_t uid;
   pse_clt_pspace_uid_t expected_pspace;
   pse_clt_relshp_cost_func_compute_cb compute;
-  pse_clt_relshp_cost_func_compute_cb compute_df; /* TODO */
+  pse_clt_relshp_cost_func_compute_cb compute_df;
   enum pse_cost_arity_mode_t cost_arity_mode;
   size_t costs_count;
 
@@ -362,21 +384,34 @@ enum pse_cpspace_relshps_group_state_t {
   PSE_CPSPACE_RELSHPS_GROUP_STATE_ENABLED_PARTIALLY
 };
 
+/*! Representation of the Jacobian matrix of the costs used by the solver.
+ * A sparse Jacobian only stores the derivatives of each cost with respect to
+ * the parametric points of its relationship: it is much faster when the
+ * relationships involve few parametric points each. */
+enum pse_cpspace_exploration_jacobian_t {
+  PSE_CPSPACE_EXPLORATION_JACOBIAN_DENSE,
+  PSE_CPSPACE_EXPLORATION_JACOBIAN_SPARSE
+};
+
 /*! Options to do extra computation during the exploration.
  *
  * \param until_convergence For monolithic solve, will iterate until
  *    success/error or \p max_convergence_tries is reached. Not taken into
  *    account for iterative solve as the user can do it him-self.
  * \param max_convergence_tries Number of tries to converge. After that, we stop
- *    with RES_NOT_CONVERGED result.
+ *    with RES_NOT_CONVERGED result. We also stop once a try did not move the
+ *    points, as the next one would do the same.
  * \param auto_df_epsilon When using the automatic differential computation, we
  *    will use this value as the epsilon to have delta coordinates before and
  *    after the current coordinates of each parametric point.
+ * \param jacobian Dense or sparse Jacobian matrix, see
+ *    ::pse_cpspace_exploration_jacobian_t.
  */
 struct pse_cpspace_exploration_options_t {
   bool until_convergence;
   size_t max_convergence_tries;
   pse_real_t auto_df_epsilon;
+  enum pse_cpspace_exploration_jacobian_t jacobian;
 };
 
 typedef enum pse_res_t
@@ -434,9 +469,19 @@ struct pse_counter_t {
   size_t total;
 };
 
+/*! Statistics of the exploration.
+ *
+ * \param finite_diffs_columns_count Number of columns of the Jacobian matrix
+ *    computed with finite differences during the last call, 0 if all the cost
+ *    functors provided their gradients.
+ * \param finite_diffs_threads_count Number of threads used to compute these
+ *    columns in parallel during the last call (1 without OpenMP).
+ */
 struct pse_cpspace_exploration_extra_results_t {
   struct pse_counter_t counter_iterations;
   struct pse_counter_t counter_costs_calls;
+  size_t finite_diffs_columns_count;
+  size_t finite_diffs_threads_count;
 };
 
 /******************************************************************************
@@ -494,7 +539,7 @@ struct pse_cpspace_exploration_extra_results_t {
 #define PSE_CPSPACE_RELSHP_CNSTRS_NONE_                                        \
   { 0, NULL, NULL }
 #define PSE_CPSPACE_EXPLORATION_OPTIONS_DEFAULT_                               \
-  { true, 3, PSE_REAL_SAFE_EPS }
+  { true, 3, PSE_REAL_SAFE_EPS, PSE_CPSPACE_EXPLORATION_JACOBIAN_DENSE }
 #define PSE_CPSPACE_EXPLORATION_PSPACE_PARAMS_NULL_                            \
   { PSE_CLT_PSPACE_UID_INVALID_, NULL, NULL }
 #define PSE_CPSPACE_EXPLORATION_VARIATIONS_PARAMS_NULL_                        \
@@ -506,7 +551,7 @@ struct pse_cpspace_exploration_extra_results_t {
 #define PSE_CPSPACE_EXPLORATION_SAMPLES_NULL_                                  \
   { NULL }
 #define PSE_CPSPACE_EXPLORATION_EXTRA_RESULTS_NULL_                            \
-  { PSE_COUNTER_ZERO_, PSE_COUNTER_ZERO_ }
+  { PSE_COUNTER_ZERO_, PSE_COUNTER_ZERO_, 0, 0 }
 
 static const struct pse_eval_ctxt_t PSE_EVAL_CTXT_NULL =
   PSE_EVAL_CTXT_NULL_;
@@ -670,6 +715,10 @@ pseConstrainedParameterSpaceParameterSpacesVariationsRemoveIfExist
  *
  ******************************************************************************/
 
+/*! Add some parametric points to the given constrained parametric space. The
+ * identifiers of removed parametric points are reused first, the smallest ones
+ * first: removing the last added points then adding points again gives the
+ * same identifiers back. */
 PSE_API enum pse_res_t
 pseConstrainedParameterSpaceParametricPointsAdd
   (struct pse_cpspace_t* cps,
@@ -826,6 +875,12 @@ pseConstrainedParameterSpaceRelationshipsParamsGet
    const pse_relshp_id_t* ids,
    struct pse_cpspace_relshp_params_t* params);
 
+/*! Enable or disable the given relationships. Disabled relationships have no
+ * cost. This does not change the structure of the CPS: the existing
+ * exploration contexts are kept, and take the new states into account at the
+ * beginning of their next solve. A solve in progress, iterative or not, keeps
+ * the states it began with.
+ */
 PSE_API enum pse_res_t
 pseConstrainedParameterSpaceRelationshipsStateSet
   (struct pse_cpspace_t* cps,
@@ -1065,7 +1120,8 @@ pseConstrainedParameterSpaceExplorationIterativeSolveEnd
   (struct pse_cpspace_exploration_ctxt_t* ctxt);
 
 /*! Retreive the last results of the exploration. Will automatically lock/unlock
- * \p where for writting.
+ * \p where for writting. During a step-by-step exploration, they are the
+ * results of its last step: they can be applied without ending it.
  *
  * \param[in] ctxt The exploration context from where to retreive the last
  *    results.
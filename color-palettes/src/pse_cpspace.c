@@ -6,6 +6,9 @@
 #include "stb_ds.h"
 #include "stretchy_buffer.h"
 
+#include <string.h>
+#include <stdlib.h>
+
 /******************************************************************************
  *
  * Helper functions
@@ -181,6 +184,14 @@ pseParametricPointsIdsValidate
   return RES_OK;
 }
 
+static int
+psePPointIdCompare(const void* a, const void* b)
+{
+  const pse_ppoint_id_t ida = *(const pse_ppoint_id_t*)a;
+  const pse_ppoint_id_t idb = *(const pse_ppoint_id_t*)b;
+  return (ida > idb) - (ida < idb);
+}
+
 static PSE_FINLINE void
 pseRelationshipClean
   (struct pse_allocator_t* alloc,
@@ -339,7 +350,7 @@ pseConstrainedParameterSpaceDestroy
 
   PSE_CALL(pseDeviceConstrainedParameterSpaceUnregister(cps->dev, cps));
   for(i = 0; i < sb_count(cps->relshps_used); ++i) {
-    pseRelationshipClean(cps->dev->allocator, &cps->relshps[i]);
+    pseRelationshipClean(cps->dev->allocator, &cps->relshps[cps->relshps_used[i]]);
   }
   for(i = 0; i < hmlenu(cps->relshps_groups); ++i) {
     sb_free(cps->relshps_groups[i].ids);
@@ -790,7 +801,11 @@ pseConstrainedParameterSpaceParametricPointsAdd
 
   /* TODO: allocate once cps->ppoints_used as we know the size we will add */
 
-  /* First, try to use freed parametric points */
+  /* First, try to use freed parametric points, the smallest ids first so that
+   * the ids stay dense when the last added points are removed and added again */
+  if( sb_count(cps->ppoints_free) > 1 )
+    qsort(cps->ppoints_free, sb_count(cps->ppoints_free),
+          sizeof(pse_ppoint_id_t), psePPointIdCompare);
   for(i = 0; i < sb_count(cps->ppoints_free) && i < count; ++i) {
     const pse_ppoint_id_t ppid = cps->ppoints_free[i];
     cps->ppoints[ppid] = params[i];
@@ -1056,7 +1071,10 @@ pseConstrainedParameterSpaceRelationshipsRemove
    const pse_relshp_id_t* ids)
 {
   enum pse_res_t res = RES_OK;
-  size_t i, j;
+  uint8_t* removed = NULL; /* stretchy buffer, per relationship id */
+  pse_clt_relshps_group_uid_t* groups = NULL; /* stretchy buffer */
+  struct pse_relshps_group_t* grp = NULL;
+  size_t i, j, k;
   if( !cps || (count && !ids) )
     return RES_BAD_ARG;
   if( !count )
@@ -1065,19 +1083,44 @@ pseConstrainedParameterSpaceRelationshipsRemove
   /* First, check that the ids are valid */
   PSE_TRY_CALL_OR_RETURN(res, pseRelationshipsIdsValidate(cps, count, ids));
 
-  /* TODO: do something smarter than this... */
+  /* Mark the removed relationships and keep their groups, so that the used
+   * relationships and the groups are compacted in a single pass each, whatever
+   * the number of removed relationships. */
+  sb_setn(removed, sb_count(cps->relshps));
+  memset(removed, 0, sb_count(removed) * sizeof(uint8_t));
   for(i = 0; i < count; ++i) {
     const pse_relshp_id_t rid = ids[i];
+    const pse_clt_relshps_group_uid_t group_uid = cps->relshps[rid].clt_group_uid;
+    removed[rid] = 1;
+    if( group_uid != PSE_CLT_RELSHPS_GROUP_UID_INVALID ) {
+      for(j = 0; j < sb_count(groups) && groups[j] != group_uid; ++j);
+      if( j == sb_count(groups) )
+        sb_push(groups, group_uid);
+    }
     pseRelationshipClean(cps->dev->allocator, &cps->relshps[rid]);
+    cps->relshps[rid] = PSE_CPSPACE_RELSHP_NULL;
     sb_push(cps->relshps_free, rid);
-    for(j = 0; j < sb_count(cps->relshps_used); ++j) {
-      if( cps->relshps_used[j] == rid ) {
-        sb_delat(cps->relshps_used, j);
-        break;
-      }
+  }
+
+  for(i = 0, j = 0; i < sb_count(cps->relshps_used); ++i) {
+    if( !removed[cps->relshps_used[i]] )
+      cps->relshps_used[j++] = cps->relshps_used[i];
+  }
+  sb_setn(cps->relshps_used, j);
+
+  for(k = 0; k < sb_count(groups); ++k) {
+    if( hmgeti(cps->relshps_groups, groups[k]) < 0 )
+      continue;
+    grp = &hmgets(cps->relshps_groups, groups[k]);
+    for(i = 0, j = 0; i < sb_count(grp->ids); ++i) {
+      if( !removed[grp->ids[i]] )
+        grp->ids[j++] = grp->ids[i];
     }
+    sb_setn(grp->ids, j);
   }
 
+  sb_free(removed);
+  sb_free(groups);
   return res;
 }
 
@@ -1124,11 +1167,19 @@ pseConstrainedParameterSpaceRelationshipsClear
     return RES_BAD_ARG;
 
   for(i = 0; i < sb_count(cps->relshps_used); ++i) {
-    pseRelationshipClean(cps->dev->allocator, &cps->relshps[i]);
-    sb_push(cps->relshps_free, cps->relshps_used[i]);
+    const pse_relshp_id_t rid = cps->relshps_used[i];
+    pseRelationshipClean(cps->dev->allocator, &cps->relshps[rid]);
+    cps->relshps[rid] = PSE_CPSPACE_RELSHP_NULL;
+    sb_push(cps->relshps_free, rid);
   }
   sb_setn(cps->relshps_used, 0);
 
+  /* The groups are emptied too, their ids are free now */
+  for(i = 0; i < hmlenu(cps->relshps_groups); ++i) {
+    sb_free(cps->relshps_groups[i].ids);
+  }
+  hmfree(cps->relshps_groups);
+
   return RES_OK;
 }
 
@@ -1183,6 +1234,8 @@ pseConstrainedParameterSpaceRelationshipsStateSet
   for(i = 0; i < count; ++i) {
     cps->relshps[ids[i]].state = states[i];
   }
+  pseConstrainedParameterSpaceExplorationContextsRelationshipsStateUpdate
+    (cps, count, ids);
 
   return res;
 }
@@ -1207,6 +1260,8 @@ pseConstrainedParameterSpaceRelationshipsSameStateSet
   for(i = 0; i < count; ++i) {
     cps->relshps[ids[i]].state = state;
   }
+  pseConstrainedParameterSpaceExplorationContextsRelationshipsStateUpdate
+    (cps, count, ids);
 
   return res;
 }
@@ -1231,6 +1286,8 @@ pseConstrainedParameterSpaceRelationshipsStateSetByGroup
   for(i = 0; i < count; ++i) {
     cps->relshps[grp->ids[i]].state = state;
   }
+  pseConstrainedParameterSpaceExplorationContextsRelationshipsStateUpdate
+    (cps, count, grp->ids);
 
   return res;
 }
@@ -120,6 +120,7 @@ pseConstrainedParameterSpaceInstanceClean
 
       sb_free(ivcfd->relshps_ids);
       sb_free(ivcfd->relshps_data);
+      sb_free(ivcfd->relshps_states);
       sb_free(ivcfd->relshps_ctxts);
       sb_free(ivcfd->relshps_configs);
     }
@@ -198,13 +199,12 @@ pseConstrainedParameterSpaceInstanciate
     const struct pse_cpspace_relshp_params_t* rp = &r->params;
     struct pse_cpspace_instance_relshp_data_t new_rd;
 
-    /* Remove disabled relationships */
-    if( r->state == PSE_CPSPACE_RELSHP_STATE_DISABLED )
-      continue;
-
+    /* Disabled relationships are kept, as they can be enabled while the
+     * instance is used: the drivers skip them. */
     ++inst->relshps_count;
     new_rd = PSE_CPSPACE_INSTANCE_RELSHP_DATA_NULL;
     new_rd.key = rid;
+    new_rd.state = r->state;
 
     /* Precompute the list of the ppoint ids involved in this relationship */
     assert(hmgeti(inst->relshps,rid) < 0);
@@ -220,19 +220,17 @@ pseConstrainedParameterSpaceInstanciate
       } break;
       case PSE_RELSHP_KIND_EXCLUSIVE: {
         /* Hard case where we have to deduce the involved ppoint by getting
-         * all of them expect the ones listed in the relationship */
+         * all the used ones expect the ones listed in the relationship (the
+         * removed ppoints are not involved) */
         /* TODO: optimize for specific case where there is no excluded ppoint */
-        const size_t ppoints_count = sb_count(cps->ppoints);
-        const size_t involved_ppoints_count = ppoints_count - rp->ppoints_count;
+        const size_t ppoints_count = sb_count(cps->ppoints_used);
         bool found = false;
-        assert(ppoints_count >= rp->ppoints_count);
 
-        new_rd.eval_data.ppoints_count = involved_ppoints_count;
-        sb_setn(new_rd.eval_data.ppoints, new_rd.eval_data.ppoints_count);
+        sb_setn(new_rd.eval_data.ppoints, ppoints_count);
         ipp = 0;
-        for(j = 0; j < ppoints_count && ipp < involved_ppoints_count; ++j) {
+        for(j = 0; j < ppoints_count; ++j) {
           /* Check if we have to skip this ppoint */
-          const pse_ppoint_id_t ppid = (pse_ppoint_id_t)j;
+          const pse_ppoint_id_t ppid = cps->ppoints_used[j];
           found = false;
           for(k = 0; k < rp->ppoints_count; ++k) {
             if( rp->ppoints_id[k] == ppid ) {
@@ -246,8 +244,8 @@ pseConstrainedParameterSpaceInstanciate
             new_rd.eval_data.ppoints[ipp++] = ppid;
           }
         }
-        assert(j == ppoints_count);
-        assert(ipp == involved_ppoints_count);
+        sb_setn(new_rd.eval_data.ppoints, ipp);
+        new_rd.eval_data.ppoints_count = ipp;
       } break;
       default: break;
     }
@@ -267,10 +265,6 @@ pseConstrainedParameterSpaceInstanciate
     const struct pse_cpspace_relshp_params_t* rp = &r->params;
     struct pse_cpspace_instance_relshp_data_t* ird = NULL;
 
-    /* Do not treat disabled relationships */
-    if( r->state == PSE_CPSPACE_RELSHP_STATE_DISABLED )
-      continue;
-
     ird = &hmgets(inst->relshps, rid);
     for(j = 0; j < rp->cnstrs.funcs_count; ++j) {
       const pse_relshp_cost_func_id_t rcfid = rp->cnstrs.funcs[j];
@@ -345,6 +339,7 @@ pseConstrainedParameterSpaceInstanciate
 
         sb_push(ivcfd->relshps_ids, ird->key);
         sb_push(ivcfd->relshps_data, &ird->eval_data);
+        sb_push(ivcfd->relshps_states, &ird->state);
         sb_push(ivcfd->relshps_ctxts, NULL); /* created later */
         sb_push(ivcfd->relshps_configs, rcfc);
       }
@@ -422,6 +417,28 @@ pseConstrainedParameterSpaceExplorationContextDestroy
   PSE_FREE(alloc, ctxt);
 }
 
+void
+pseConstrainedParameterSpaceExplorationContextsRelationshipsStateUpdate
+  (struct pse_cpspace_t* cps,
+   const size_t count,
+   const pse_relshp_id_t* ids)
+{
+  size_t i, j;
+  assert(cps && (!count || ids));
+
+  /* Only the relationships that were in the CPS when the context was created
+   * are in its instance. */
+  for(i = 0; i < hmlenu(cps->exp_ctxts); ++i) {
+    struct pse_cpspace_instance_t* inst = &cps->exp_ctxts[i].key->icps;
+    for(j = 0; j < count; ++j) {
+      const ptrdiff_t idx = hmgeti(inst->relshps, ids[j]);
+      if( idx >= 0 )
+        inst->relshps[idx].state = cps->relshps[ids[j]].state;
+    }
+    ++inst->relshps_states_revision;
+  }
+}
+
 /******************************************************************************
  *
  * PUBLIC API - Constrained Parameter Space Exploration
@@ -46,4 +46,12 @@ LOCAL_SYMBOL void
 pseConstrainedParameterSpaceExplorationContextDestroy
   (struct pse_cpspace_exploration_ctxt_t* ctxt);
 
+/* Propagate the state of the given relationships to the instances of the
+ * exploration contexts of the CPS. */
+LOCAL_SYMBOL void
+pseConstrainedParameterSpaceExplorationContextsRelationshipsStateUpdate
+  (struct pse_cpspace_t* cps,
+   const size_t count,
+   const pse_relshp_id_t* ids);
+
 #endif /* PSE_CPSPACE_EXPLORATION_P_H */
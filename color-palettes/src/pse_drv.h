@@ -32,6 +32,8 @@ struct pse_cpspace_instance_variated_cost_func_data_t {
   size_t relshps_count;
   pse_relshp_id_t* relshps_ids;
   const struct pse_eval_relshp_data_t** relshps_data;
+  /* State of the relationships, updated when it changes in the CPS */
+  const enum pse_cpspace_relshp_state_t** relshps_states;
   pse_clt_cost_func_ctxt_t* relshps_ctxts;
   pse_clt_cost_func_ctxt_config_t* relshps_configs;
 };
@@ -46,6 +48,7 @@ struct pse_cpspace_instance_cost_func_data_t {
 struct pse_cpspace_instance_relshp_data_t {
   pse_relshp_id_t key;
   struct pse_eval_relshp_data_t eval_data;
+  enum pse_cpspace_relshp_state_t state;
 };
 
 struct pse_cpspace_instance_t {
@@ -60,6 +63,9 @@ struct pse_cpspace_instance_t {
 
   size_t relshps_count;
   struct pse_cpspace_instance_relshp_data_t* relshps;
+  /* Incremented each time the state of some relationships changes. The disabled
+   * relationships are kept in the instance, the drivers have to skip them. */
+  size_t relshps_states_revision;
 
   struct pse_cpspace_t* cps;  /*!< related CPS */
 };
@@ -154,14 +160,15 @@ typedef enum pse_res_t
 #define PSE_CPSPACE_INSTANCE_PSPACE_DATA_NULL_                                 \
   { PSE_CLT_PSPACE_UID_INVALID_, { 0, 0 } }
 #define PSE_CPSPACE_INSTANCE_VARIATED_COST_FUNC_DATA_NULL_                     \
-  { PSE_CLT_PPOINT_VARIATION_UID_INVALID_, 0, NULL, NULL, NULL, NULL }
+  { PSE_CLT_PPOINT_VARIATION_UID_INVALID_, 0, NULL, NULL, NULL, NULL, NULL }
 #define PSE_CPSPACE_INSTANCE_COST_FUNC_DATA_NULL_                              \
   { PSE_RELSHP_COST_FUNC_ID_INVALID_, PSE_RELSHP_COST_FUNC_PARAMS_NULL_,       \
     0, NULL }
 #define PSE_CPSPACE_INSTANCE_RELSHP_DATA_NULL_                                 \
-  { PSE_RELSHP_ID_INVALID_, PSE_EVAL_RELSHP_DATA_NULL_ }
+  { PSE_RELSHP_ID_INVALID_, PSE_EVAL_RELSHP_DATA_NULL_,                       \
+    PSE_CPSPACE_RELSHP_STATE_ENABLED }
 #define PSE_CPSPACE_INSTANCE_NULL_                                             \
-  { 0, NULL, 0, NULL, 0, NULL, 0, NULL, NULL }
+  { 0, NULL, 0, NULL, 0, NULL, 0, NULL, 0, NULL }
 #define PSE_DRV_NULL_                                                          \
   { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,                      \
     PSE_DRV_HANDLE_INVALID_, PSE_LIB_HANDLE_INVALID_ }
@@ -610,6 +610,16 @@ int main(int argc, char** argv) {
   CHECK(pseConstrainedParameterSpaceParametricPointsAdd
     (cps, 3, ppparams, ppids), RES_OK);
 
+  /* The last points removed then added again get their ids back */
+  CHECK(pseConstrainedParameterSpaceParametricPointsRemove
+    (cps, 1, &ppids[2]), RES_OK);
+  CHECK(pseConstrainedParameterSpaceParametricPointsRemove
+    (cps, 1, &ppids[1]), RES_OK);
+  CHECK(pseConstrainedParameterSpaceParametricPointsAdd
+    (cps, 2, ppparams, &ppids[1]), RES_OK);
+  CHECK(ppids[0] < ppids[1], true);
+  CHECK(ppids[1] < ppids[2], true);
+
   /****************************************************************************
    * Test API - Constrained Parameter Space Cost Functors
    ****************************************************************************/
@@ -804,6 +814,19 @@ int main(int argc, char** argv) {
     (cps, rguid), RES_OK);
   CHECK(pseConstrainedParameterSpaceRelationshipsCountGet(cps), 0);
 
+  /* Grouped relationships removed by id leave their group ********************/
+  CHECK(pseConstrainedParameterSpaceRelationshipsAdd
+    (cps, rguid, 9, rparams, rids), RES_OK);
+  CHECK(pseConstrainedParameterSpaceRelationshipsRemove
+    (cps, 3, &rids[3]), RES_OK);
+  CHECK(pseConstrainedParameterSpaceRelationshipsCountGet(cps), 6);
+  CHECK(pseConstrainedParameterSpaceRelationshipsAdd
+    (cps, irguid, 3, &rparams[3], &rids[3]), RES_OK);
+  CHECK(pseConstrainedParameterSpaceRelationshipsCountGet(cps), 9);
+  CHECK(pseConstrainedParameterSpaceRelationshipsRemoveByGroup
+    (cps, rguid), RES_OK);
+  CHECK(pseConstrainedParameterSpaceRelationshipsCountGet(cps), 3);
+
   /* With destroyed functors **************************************************/
   CHECK(pseConstrainedParameterSpaceRelationshipsClear(cps), RES_OK);
   CHECK(pseConstrainedParameterSpaceRelationshipCostFunctorsUnregister
@@ -2,6 +2,7 @@
 
 #include <pse.h>
 
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -335,6 +336,510 @@ printColors
   }
 }
 
+/* Analytic gradients: points of a 2D parameter space pulled toward targets
+ * and pushed apart along X. The same exploration is done with and without the
+ * compute_df functions, that must give the same results. */
+#define POINTS2D_PSPACE 0x2000
+#define POINTS2D_COUNT  4
+
+enum points2d_cost_function_uid {
+  TEST_CF_TARGET = 0x10,
+  TEST_CF_SPACING
+};
+
+/* Lock status of the points, and number of times the costs of each
+ * relationship are computed: the targets first, then the spacings. */
+static uint8_t points2d_locks[POINTS2D_COUNT];
+static size_t points2d_costs_computations[POINTS2D_COUNT*2-1];
+/* Explore again with the same context, after having disabled the spacings,
+ * then after having enabled them again. */
+static bool points2d_spacings_toggled;
+/* The targets are the costs, per point, of a single relationship of all the
+ * points, instead of the costs of one relationship per point. */
+static bool points2d_targets_per_point;
+
+/* With OpenMP, the costs are computed concurrently by the finite differences */
+static void
+countCostsComputation(const size_t idx)
+{
+#ifdef _OPENMP
+  #pragma omp atomic
+#endif
+  ++points2d_costs_computations[idx];
+}
+
+static enum pse_res_t
+computeTargetCb
+  (const struct pse_eval_ctxt_t* eval_ctxt,
+   const struct pse_eval_coordinates_t* eval_coords,
+   struct pse_eval_relshps_t* eval_relshps,
+   pse_real_t* costs)
+{
+  size_t i, p, c = 0;
+  pse_ppoint_id_t ppid;
+  (void)eval_ctxt;
+  for(i = 0; i < eval_relshps->count; ++i) {
+    const struct pse_eval_relshp_data_t* data = eval_relshps->data[i];
+    for(p = 0; p < data->ppoints_count; ++p, c += 2) {
+      ppid = data->ppoints[p];
+      countCostsComputation(ppid);
+      costs[c+0] = eval_coords->coords[ppid*2+0] - (pse_real_t)ppid;
+      costs[c+1] = eval_coords->coords[ppid*2+1] + (pse_real_t)ppid;
+    }
+  }
+  return RES_OK;
+}
+
+static enum pse_res_t
+computeTargetDfCb
+  (const struct pse_eval_ctxt_t* eval_ctxt,
+   const struct pse_eval_coordinates_t* eval_coords,
+   struct pse_eval_relshps_t* eval_relshps,
+   pse_real_t* grads)
+{
+  size_t i, p, g = 0;
+  (void)eval_ctxt, (void)eval_coords;
+  /* 2 costs of each point, derived with respect to its 2 coordinates only:
+   * per point, or per relationship of 1 point */
+  for(i = 0; i < eval_relshps->count; ++i) {
+    for(p = 0; p < eval_relshps->data[i]->ppoints_count; ++p, g += 4) {
+      grads[g+0] = 1; grads[g+1] = 0;
+      grads[g+2] = 0; grads[g+3] = 1;
+    }
+  }
+  return RES_OK;
+}
+
+static enum pse_res_t
+computeSpacingCb
+  (const struct pse_eval_ctxt_t* eval_ctxt,
+   const struct pse_eval_coordinates_t* eval_coords,
+   struct pse_eval_relshps_t* eval_relshps,
+   pse_real_t* costs)
+{
+  size_t i;
+  pse_ppoint_id_t ppid1, ppid2;
+  (void)eval_ctxt;
+  for(i = 0; i < eval_relshps->count; ++i) {
+    assert(eval_relshps->data[i]->ppoints_count == 2);
+    ppid1 = eval_relshps->data[i]->ppoints[0];
+    ppid2 = eval_relshps->data[i]->ppoints[1];
+    countCostsComputation(POINTS2D_COUNT + ppid1);
+    costs[i] =
+      eval_coords->coords[ppid2*2+0] - eval_coords->coords[ppid1*2+0] - 2;
+  }
+  return RES_OK;
+}
+
+static enum pse_res_t
+computeSpacingDfCb
+  (const struct pse_eval_ctxt_t* eval_ctxt,
+   const struct pse_eval_coordinates_t* eval_coords,
+   struct pse_eval_relshps_t* eval_relshps,
+   pse_real_t* grads)
+{
+  size_t i;
+  (void)eval_ctxt, (void)eval_coords;
+  /* 1 cost of 2 points of 2 coordinates */
+  for(i = 0; i < eval_relshps->count; ++i) {
+    grads[i*4+0] = -1; grads[i*4+1] = 0;
+    grads[i*4+2] =  1; grads[i*4+3] = 0;
+  }
+  return RES_OK;
+}
+
+static enum pse_res_t
+getPoints2DAttribs
+  (void* ctxt,
+   const enum pse_point_attrib_t attrib,
+   const enum pse_type_t as_type,
+   const size_t count,
+   const pse_ppoint_id_t* values_idx,
+   void* attrib_values)
+{
+  const pse_real_t* points = (const pse_real_t*)ctxt;
+  size_t i;
+  (void)as_type;
+  switch(attrib) {
+    case PSE_POINT_ATTRIB_COORDINATES: {
+      pse_real_t* out = (pse_real_t*)attrib_values;
+      for(i = 0; i < count; ++i) {
+        out[i*2+0] = points[values_idx[i]*2+0];
+        out[i*2+1] = points[values_idx[i]*2+1];
+      }
+    } break;
+    case PSE_POINT_ATTRIB_LOCK_STATUS: {
+      uint8_t* out = (uint8_t*)attrib_values;
+      for(i = 0; i < count; ++i) {
+        out[i] = points2d_locks[values_idx[i]];
+      }
+    } break;
+    default: assert(false);
+  }
+  return RES_OK;
+}
+
+static enum pse_res_t
+setPoints2DAttribs
+  (void* ctxt,
+   const enum pse_point_attrib_t attrib,
+   const enum pse_type_t as_type,
+   const size_t count,
+   const pse_ppoint_id_t* values_idx,
+   const void* attrib_values)
+{
+  pse_real_t* points = (pse_real_t*)ctxt;
+  const pse_real_t* in = (const pse_real_t*)attrib_values;
+  size_t i;
+  (void)as_type, (void)attrib;
+  assert(attrib == PSE_POINT_ATTRIB_COORDINATES);
+  for(i = 0; i < count; ++i) {
+    points[values_idx[i]*2+0] = in[i*2+0];
+    points[values_idx[i]*2+1] = in[i*2+1];
+  }
+  return RES_OK;
+}
+
+static void
+explorePoints2D
+  (const bool analytic_df,
+   const enum pse_cpspace_exploration_jacobian_t jacobian,
+   const bool iterative,
+   pse_real_t points[POINTS2D_COUNT*2])
+{
+  struct pse_device_params_t devp = PSE_DEVICE_PARAMS_NULL;
+  pse_clt_pspace_uid_t psp_uid = POINTS2D_PSPACE;
+  struct pse_pspace_params_t psp = PSE_PSPACE_PARAMS_NULL;
+  struct pse_cpspace_params_t cpsp = PSE_CPSPACE_PARAMS_NULL;
+  struct pse_cpspace_values_data_t data = PSE_CPSPACE_VALUES_DATA_NULL;
+  struct pse_cpspace_exploration_ctxt_params_t ctxtp = PSE_CPSPACE_EXPLORATION_CTXT_PARAMS_NULL;
+  struct pse_cpspace_exploration_extra_results_t results = PSE_CPSPACE_EXPLORATION_EXTRA_RESULTS_NULL;
+  struct pse_cpspace_exploration_samples_t smpls = PSE_CPSPACE_EXPLORATION_SAMPLES_NULL;
+  struct pse_relshp_cost_func_params_t ccfps[2] = {
+    PSE_RELSHP_COST_FUNC_PARAMS_NULL_,
+    PSE_RELSHP_COST_FUNC_PARAMS_NULL_
+  };
+  pse_relshp_cost_func_id_t ccfids[2] = {
+    PSE_RELSHP_COST_FUNC_ID_INVALID_,
+    PSE_RELSHP_COST_FUNC_ID_INVALID_
+  };
+  struct pse_ppoint_params_t ppps[POINTS2D_COUNT];
+  pse_ppoint_id_t ppids[POINTS2D_COUNT];
+  struct pse_cpspace_relshp_params_t rps[POINTS2D_COUNT*2-1];
+  struct pse_pspace_point_attrib_component_t coords_components[] = {
+    {PSE_TYPE_REAL},
+    {PSE_TYPE_REAL}
+  };
+  struct pse_pspace_point_attrib_component_t lock_components[] = {
+    {PSE_TYPE_BOOL_8}
+  };
+
+  struct pse_device_t* dev = NULL;
+  struct pse_cpspace_t* cps = NULL;
+  struct pse_cpspace_values_t* vals = NULL;
+  struct pse_cpspace_exploration_ctxt_t* ctxt = NULL;
+  pse_relshp_id_t rids[POINTS2D_COUNT*2-1];
+  pse_real_t stepped[POINTS2D_COUNT*2];
+  enum pse_res_t res = RES_OK;
+  const size_t targets_count = points2d_targets_per_point ? 1 : POINTS2D_COUNT;
+  size_t i, steps = 0, unlocked_count = 0;
+
+  for(i = 0; i < POINTS2D_COUNT; ++i) {
+    if( !points2d_locks[i] ) ++unlocked_count;
+  }
+  for(i = 0; i < POINTS2D_COUNT*2-1; ++i) {
+    points2d_costs_computations[i] = 0;
+  }
+
+  devp.backend_drv_filepath = PSE_LIB_NAME("pse-drv-eigen");
+  CHECK(pseDeviceCreate(&devp, &dev), RES_OK);
+
+  psp.ppoint_params.attribs[PSE_POINT_ATTRIB_COORDINATES].components_count = 2;
+  psp.ppoint_params.attribs[PSE_POINT_ATTRIB_COORDINATES].components = coords_components;
+  psp.ppoint_params.attribs[PSE_POINT_ATTRIB_LOCK_STATUS].components_count = 1;
+  psp.ppoint_params.attribs[PSE_POINT_ATTRIB_LOCK_STATUS].components = lock_components;
+  CHECK(pseConstrainedParameterSpaceCreate(dev, &cpsp, &cps), RES_OK);
+  CHECK(pseConstrainedParameterSpaceParameterSpacesDeclare
+    (cps, 1, &psp_uid, &psp), RES_OK);
+
+  ccfps[0].uid = TEST_CF_TARGET;
+  ccfps[0].expected_pspace = POINTS2D_PSPACE;
+  ccfps[0].compute = computeTargetCb;
+  ccfps[0].compute_df = analytic_df ? computeTargetDfCb : NULL;
+  ccfps[0].cost_arity_mode = points2d_targets_per_point
+    ? PSE_COST_ARITY_MODE_PER_POINT
+    : PSE_COST_ARITY_MODE_PER_RELATIONSHIP;
+  ccfps[0].costs_count = 2;
+  ccfps[1].uid = TEST_CF_SPACING;
+  ccfps[1].expected_pspace = POINTS2D_PSPACE;
+  ccfps[1].compute = computeSpacingCb;
+  ccfps[1].compute_df = analytic_df ? computeSpacingDfCb : NULL;
+  ccfps[1].cost_arity_mode = PSE_COST_ARITY_MODE_PER_RELATIONSHIP;
+  ccfps[1].costs_count = 1;
+  CHECK(pseConstrainedParameterSpaceRelationshipCostFunctorsRegister
+    (cps, 2, ccfps, ccfids), RES_OK);
+
+  for(i = 0; i < POINTS2D_COUNT; ++i) {
+    ppps[i] = PSE_PPOINT_PARAMS_NULL;
+    ppids[i] = PSE_PPOINT_ID_INVALID;
+  }
+  CHECK(pseConstrainedParameterSpaceParametricPointsAdd
+    (cps, POINTS2D_COUNT, ppps, ppids), RES_OK);
+
+  for(i = 0; i < targets_count + POINTS2D_COUNT-1; ++i) {
+    rps[i] = PSE_CPSPACE_RELSHP_PARAMS_NULL;
+    rps[i].kind = PSE_RELSHP_KIND_INCLUSIVE;
+    rps[i].cnstrs.funcs_count = 1;
+    if( i < targets_count ) {
+      rps[i].ppoints_count = points2d_targets_per_point ? POINTS2D_COUNT : 1;
+      rps[i].ppoints_id = &ppids[i];
+      rps[i].cnstrs.funcs = &ccfids[0];
+    } else {
+      rps[i].ppoints_count = 2;
+      rps[i].ppoints_id = &ppids[i-targets_count];
+      rps[i].cnstrs.funcs = &ccfids[1];
+    }
+  }
+  CHECK(pseConstrainedParameterSpaceRelationshipsAdd
+    (cps, PSE_CLT_RELSHPS_GROUP_UID_INVALID, targets_count + POINTS2D_COUNT-1,
+     rps, rids), RES_OK);
+
+  data.pspace = POINTS2D_PSPACE;
+  data.storage = PSE_CPSPACE_VALUES_STORAGE_ACCESSORS_GLOBAL;
+  data.as.global.accessors.ctxt = points;
+  data.as.global.accessors.get = getPoints2DAttribs;
+  data.as.global.accessors.set = setPoints2DAttribs;
+  CHECK(pseConstrainedParameterSpaceValuesCreate(cps, &data, &vals), RES_OK);
+
+  ctxtp.pspace.explore_in = POINTS2D_PSPACE;
+  ctxtp.options.jacobian = jacobian;
+  CHECK(pseConstrainedParameterSpaceExplorationContextCreate
+    (cps, &ctxtp, &ctxt), RES_OK);
+
+  smpls.values = vals;
+  if( !iterative ) {
+    CHECK(pseConstrainedParameterSpaceExplorationSolve(ctxt, &smpls), RES_OK);
+  } else {
+    /* The results of each step are retreived without ending the exploration,
+     * the last ones being the results of the exploration */
+    res = pseConstrainedParameterSpaceExplorationIterativeSolveBegin
+      (ctxt, &smpls);
+    CHECK(res, RES_NOT_CONVERGED);
+    while( res == RES_NOT_CONVERGED ) {
+      res = pseConstrainedParameterSpaceExplorationIterativeSolveStep(ctxt);
+      CHECK(res == RES_OK || res == RES_NOT_CONVERGED, true);
+      CHECK(pseConstrainedParameterSpaceExplorationLastResultsRetreive
+        (ctxt, vals, NULL), RES_OK);
+      if( steps++ == 0 ) {
+        CHECK(points[POINTS2D_COUNT*2-1] != 0.5, true);
+      }
+    }
+    for(i = 0; i < POINTS2D_COUNT*2; ++i) stepped[i] = points[i];
+    CHECK(pseConstrainedParameterSpaceExplorationIterativeSolveEnd(ctxt),
+      RES_OK);
+  }
+  CHECK(pseConstrainedParameterSpaceExplorationLastResultsRetreive
+    (ctxt, vals, &results), RES_OK);
+  if( iterative ) {
+    for(i = 0; i < POINTS2D_COUNT*2; ++i) {
+      CHECK(points[i], stepped[i]);
+    }
+  }
+
+  /* One column per coordinate of each point, shared by at most one thread per
+   * point */
+  if( iterative ) {
+    /* Counters of the last step only */
+  } else if( analytic_df ) {
+    CHECK(results.finite_diffs_columns_count, 0);
+    CHECK(results.finite_diffs_threads_count, 0);
+  } else {
+    CHECK(results.finite_diffs_columns_count, unlocked_count*2);
+    CHECK(results.finite_diffs_threads_count >= 1, true);
+    CHECK(results.finite_diffs_threads_count <= unlocked_count, true);
+  }
+
+  if( points2d_spacings_toggled ) {
+    /* Without the spacings, the targets are reached along X too, and the costs
+     * of the spacings are not computed. */
+    CHECK(pseConstrainedParameterSpaceRelationshipsSameStateSet
+      (cps, POINTS2D_COUNT-1, rids + targets_count,
+       PSE_CPSPACE_RELSHP_STATE_DISABLED), RES_OK);
+    for(i = POINTS2D_COUNT; i < POINTS2D_COUNT*2-1; ++i) {
+      points2d_costs_computations[i] = 0;
+    }
+    CHECK(pseConstrainedParameterSpaceExplorationSolve(ctxt, &smpls), RES_OK);
+    CHECK(pseConstrainedParameterSpaceExplorationLastResultsRetreive
+      (ctxt, vals, NULL), RES_OK);
+    for(i = POINTS2D_COUNT; i < POINTS2D_COUNT*2-1; ++i) {
+      CHECK(points2d_costs_computations[i], 0);
+    }
+    for(i = 0; i < POINTS2D_COUNT; ++i) {
+      CHECK(fabs(points[i*2+0] - (pse_real_t)i) < 1.e-4, true);
+      CHECK(fabs(points[i*2+1] + (pse_real_t)i) < 1.e-4, true);
+    }
+
+    CHECK(pseConstrainedParameterSpaceRelationshipsSameStateSet
+      (cps, POINTS2D_COUNT-1, rids + targets_count,
+       PSE_CPSPACE_RELSHP_STATE_ENABLED), RES_OK);
+    CHECK(pseConstrainedParameterSpaceExplorationSolve(ctxt, &smpls), RES_OK);
+    CHECK(pseConstrainedParameterSpaceExplorationLastResultsRetreive
+      (ctxt, vals, NULL), RES_OK);
+  }
+
+  CHECK(pseConstrainedParameterSpaceExplorationContextRefSub(ctxt), RES_OK);
+  CHECK(pseConstrainedParameterSpaceValuesRefSub(vals), RES_OK);
+  CHECK(pseConstrainedParameterSpaceRefSub(cps), RES_OK);
+  CHECK(pseDeviceDestroy(dev), RES_OK);
+}
+
+static void
+testAnalyticGradients(void)
+{
+  pse_real_t ref[POINTS2D_COUNT*2];
+  pse_real_t points[POINTS2D_COUNT*2];
+  size_t i, j;
+
+  for(i = 0; i < POINTS2D_COUNT*2; ++i) ref[i] = 0.5;
+  explorePoints2D(false, PSE_CPSPACE_EXPLORATION_JACOBIAN_DENSE, false, ref);
+  /* Targets along Y are reached, the spacing along X is a compromise */
+  for(i = 0; i < POINTS2D_COUNT; ++i) {
+    CHECK(fabs(ref[i*2+1] + (pse_real_t)i) < 1.e-4, true);
+  }
+  CHECK(ref[2] - ref[0] > 1.0 && ref[2] - ref[0] < 2.0, true);
+
+  for(j = 0; j < 2; ++j) {
+    for(i = 0; i < POINTS2D_COUNT*2; ++i) points[i] = 0.5;
+    explorePoints2D(true, j == 0
+      ? PSE_CPSPACE_EXPLORATION_JACOBIAN_DENSE
+      : PSE_CPSPACE_EXPLORATION_JACOBIAN_SPARSE, false, points);
+    for(i = 0; i < POINTS2D_COUNT*2; ++i) {
+      CHECK(fabs(points[i] - ref[i]) < 1.e-4, true);
+    }
+  }
+
+  /* Step by step, the exploration reaches the same results */
+  for(j = 0; j < 2; ++j) {
+    for(i = 0; i < POINTS2D_COUNT*2; ++i) points[i] = 0.5;
+    explorePoints2D(j != 0, PSE_CPSPACE_EXPLORATION_JACOBIAN_DENSE, true,
+      points);
+    for(i = 0; i < POINTS2D_COUNT*2; ++i) {
+      CHECK(fabs(points[i] - ref[i]) < 1.e-4, true);
+    }
+  }
+}
+
+/* The steps of the finite differences are relative to the value of their own
+ * coordinate: the points far from the first one still have gradients, that a
+ * step relative to the coordinates of the first point would lose. */
+static void
+testFiniteDiffsSteps(void)
+{
+  pse_real_t ref[POINTS2D_COUNT*2];
+  pse_real_t points[POINTS2D_COUNT*2];
+  size_t i;
+
+  for(i = 0; i < POINTS2D_COUNT*2; ++i) ref[i] = 0.5;
+  explorePoints2D(false, PSE_CPSPACE_EXPLORATION_JACOBIAN_DENSE, false, ref);
+
+  for(i = 0; i < POINTS2D_COUNT*2; ++i) points[i] = i < 2 ? 0.5 : 1.e10;
+  explorePoints2D(false, PSE_CPSPACE_EXPLORATION_JACOBIAN_DENSE, false, points);
+  for(i = 0; i < POINTS2D_COUNT*2; ++i) {
+    CHECK(fabs(points[i] - ref[i]) < 1.e-4, true);
+  }
+}
+
+/* Per point, the gradients of the costs of each point are only given with
+ * respect to its own coordinates, the locked point having none in the Jacobian
+ * matrix. They must give the same results than the finite differences. */
+static void
+testPerPointGradients(void)
+{
+  pse_real_t ref[POINTS2D_COUNT*2];
+  pse_real_t points[POINTS2D_COUNT*2];
+  size_t i, j;
+
+  points2d_targets_per_point = true;
+  points2d_locks[0] = 1;
+  for(i = 0; i < POINTS2D_COUNT*2; ++i) ref[i] = 0.5;
+  explorePoints2D(false, PSE_CPSPACE_EXPLORATION_JACOBIAN_DENSE, false, ref);
+  CHECK(ref[0], 0.5);
+  CHECK(ref[1], 0.5);
+  for(i = 1; i < POINTS2D_COUNT; ++i) {
+    CHECK(fabs(ref[i*2+1] + (pse_real_t)i) < 1.e-4, true);
+  }
+
+  for(j = 0; j < 2; ++j) {
+    for(i = 0; i < POINTS2D_COUNT*2; ++i) points[i] = 0.5;
+    explorePoints2D(true, j == 0
+      ? PSE_CPSPACE_EXPLORATION_JACOBIAN_DENSE
+      : PSE_CPSPACE_EXPLORATION_JACOBIAN_SPARSE, false, points);
+    for(i = 0; i < POINTS2D_COUNT*2; ++i) {
+      CHECK(fabs(points[i] - ref[i]) < 1.e-4, true);
+    }
+  }
+  points2d_locks[0] = 0;
+  points2d_targets_per_point = false;
+}
+
+/* The costs of the relationships whose points are all locked do not change
+ * during a solve: they are only computed once. */
+static void
+testLockedRelationships(void)
+{
+  pse_real_t points[POINTS2D_COUNT*2];
+  size_t i, j;
+
+  points2d_locks[0] = points2d_locks[1] = 1;
+  for(j = 0; j < 3; ++j) {
+    for(i = 0; i < POINTS2D_COUNT*2; ++i) points[i] = 0.5;
+    explorePoints2D(j != 0, j == 2
+      ? PSE_CPSPACE_EXPLORATION_JACOBIAN_SPARSE
+      : PSE_CPSPACE_EXPLORATION_JACOBIAN_DENSE, false, points);
+
+    /* Targets of the locked points and their spacing */
+    CHECK(points2d_costs_computations[0], 1);
+    CHECK(points2d_costs_computations[1], 1);
+    CHECK(points2d_costs_computations[POINTS2D_COUNT], 1);
+    /* The other relationships are computed at each iteration */
+    CHECK(points2d_costs_computations[2] > 1, true);
+    CHECK(points2d_costs_computations[POINTS2D_COUNT+1] > 1, true);
+
+    for(i = 0; i < 2*2; ++i) {
+      CHECK(points[i], 0.5);
+    }
+    for(i = 2; i < POINTS2D_COUNT; ++i) {
+      CHECK(fabs(points[i*2+1] + (pse_real_t)i) < 1.e-4, true);
+    }
+  }
+  points2d_locks[0] = points2d_locks[1] = 0;
+}
+
+/* The state of the relationships can change without re-creating the
+ * exploration context: it is taken into account by the next solve. */
+static void
+testRelationshipsStates(void)
+{
+  pse_real_t ref[POINTS2D_COUNT*2];
+  pse_real_t points[POINTS2D_COUNT*2];
+  size_t i, j;
+
+  for(i = 0; i < POINTS2D_COUNT*2; ++i) ref[i] = 0.5;
+  explorePoints2D(false, PSE_CPSPACE_EXPLORATION_JACOBIAN_DENSE, false, ref);
+
+  points2d_spacings_toggled = true;
+  for(j = 0; j < 3; ++j) {
+    for(i = 0; i < POINTS2D_COUNT*2; ++i) points[i] = 0.5;
+    explorePoints2D(j != 0, j == 2
+      ? PSE_CPSPACE_EXPLORATION_JACOBIAN_SPARSE
+      : PSE_CPSPACE_EXPLORATION_JACOBIAN_DENSE, false, points);
+    for(i = 0; i < POINTS2D_COUNT*2; ++i) {
+      CHECK(fabs(points[i] - ref[i]) < 1.e-4, true);
+    }
+  }
+  points2d_spacings_toggled = false;
+}
+
 int main()
 {
   struct pse_device_params_t devp = PSE_DEVICE_PARAMS_NULL;
@@ -527,5 +1032,11 @@ int main()
   CHECK(pseConstrainedParameterSpaceValuesRefSub(valssmpls), RES_OK);
   CHECK(pseConstrainedParameterSpaceRefSub(cps), RES_OK);
   CHECK(pseDeviceDestroy(dev), RES_OK);
+
+  testAnalyticGradients();
+  testFiniteDiffsSteps();
+  testPerPointGradients();
+  testLockedRelationships();
+  testRelationshipsStates();
   return 0;
 }
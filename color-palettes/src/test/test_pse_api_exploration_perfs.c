@@ -0,0 +1,453 @@
+#include "test_utils.h"
+
+#include <pse.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#ifdef _OPENMP
+  #include <omp.h>
+#endif
+
+/* Benchmark of the exploration on a grid of 2D points: each point is pulled
+ * to its place in the grid and keeps its distance to the points around it.
+ * The creation of the exploration context, where the driver makes its
+ * precomputations, is timed on a large grid. The solves with both Jacobian
+ * matrices are timed on a smaller one, as the QR factorizations of the dense
+ * Jacobian quickly dominate, then the sparse ones are also timed on a large
+ * grid.
+ *
+ * Usage: test_api_exploration_perfs [creation grid width] [solve grid width]
+ *          [repetitions] [sparse solve grid width] */
+#define GRID_PSPACE     0x3000
+#define GRID_NEIGHBOURS 2       /* in each direction */
+#define GRID_DISTANCE   1.5
+
+enum grid_cost_function_uid {
+  GRID_CF_HOME = 0x10,
+  GRID_CF_DISTANCE
+};
+
+static size_t grid_width = 0;
+
+static pse_real_t
+gridHome(const pse_ppoint_id_t ppid, const size_t comp)
+{
+  return (pse_real_t)(comp == 0 ? ppid % grid_width : ppid / grid_width)
+    * (pse_real_t)GRID_DISTANCE;
+}
+
+static enum pse_res_t
+computeHomeCb
+  (const struct pse_eval_ctxt_t* eval_ctxt,
+   const struct pse_eval_coordinates_t* eval_coords,
+   struct pse_eval_relshps_t* eval_relshps,
+   pse_real_t* costs)
+{
+  size_t i;
+  pse_ppoint_id_t ppid;
+  (void)eval_ctxt;
+  for(i = 0; i < eval_relshps->count; ++i) {
+    ppid = eval_relshps->data[i]->ppoints[0];
+    costs[i*2+0] = eval_coords->coords[ppid*2+0] - gridHome(ppid, 0);
+    costs[i*2+1] = eval_coords->coords[ppid*2+1] - gridHome(ppid, 1);
+  }
+  return RES_OK;
+}
+
+static enum pse_res_t
+computeHomeDfCb
+  (const struct pse_eval_ctxt_t* eval_ctxt,
+   const struct pse_eval_coordinates_t* eval_coords,
+   struct pse_eval_relshps_t* eval_relshps,
+   pse_real_t* grads)
+{
+  size_t i;
+  (void)eval_ctxt, (void)eval_coords;
+  /* 2 costs of 1 point of 2 coordinates */
+  for(i = 0; i < eval_relshps->count; ++i) {
+    grads[i*4+0] = 1; grads[i*4+1] = 0;
+    grads[i*4+2] = 0; grads[i*4+3] = 1;
+  }
+  return RES_OK;
+}
+
+static pse_real_t
+gridDistance
+  (const struct pse_eval_coordinates_t* eval_coords,
+   const struct pse_eval_relshp_data_t* data,
+   pse_real_t d[2])
+{
+  const pse_ppoint_id_t ppid1 = data->ppoints[0];
+  const pse_ppoint_id_t ppid2 = data->ppoints[1];
+  d[0] = eval_coords->coords[ppid2*2+0] - eval_coords->coords[ppid1*2+0];
+  d[1] = eval_coords->coords[ppid2*2+1] - eval_coords->coords[ppid1*2+1];
+  return (pse_real_t)sqrt(d[0]*d[0] + d[1]*d[1]);
+}
+
+static enum pse_res_t
+computeDistanceCb
+  (const struct pse_eval_ctxt_t* eval_ctxt,
+   const struct pse_eval_coordinates_t* eval_coords,
+   struct pse_eval_relshps_t* eval_relshps,
+   pse_real_t* costs)
+{
+  size_t i;
+  pse_real_t d[2], home[2];
+  (void)eval_ctxt;
+  for(i = 0; i < eval_relshps->count; ++i) {
+    const struct pse_eval_relshp_data_t* data = eval_relshps->data[i];
+    home[0] = gridHome(data->ppoints[1], 0) - gridHome(data->ppoints[0], 0);
+    home[1] = gridHome(data->ppoints[1], 1) - gridHome(data->ppoints[0], 1);
+    costs[i] = gridDistance(eval_coords, data, d)
+      - (pse_real_t)sqrt(home[0]*home[0] + home[1]*home[1]);
+  }
+  return RES_OK;
+}
+
+static enum pse_res_t
+computeDistanceDfCb
+  (const struct pse_eval_ctxt_t* eval_ctxt,
+   const struct pse_eval_coordinates_t* eval_coords,
+   struct pse_eval_relshps_t* eval_relshps,
+   pse_real_t* grads)
+{
+  size_t i;
+  pse_real_t d[2], dist;
+  (void)eval_ctxt;
+  /* 1 cost of 2 points of 2 coordinates */
+  for(i = 0; i < eval_relshps->count; ++i) {
+    dist = gridDistance(eval_coords, eval_relshps->data[i], d);
+    if( dist > 0 ) {
+      d[0] /= dist;
+      d[1] /= dist;
+    }
+    grads[i*4+0] = -d[0]; grads[i*4+1] = -d[1];
+    grads[i*4+2] =  d[0]; grads[i*4+3] =  d[1];
+  }
+  return RES_OK;
+}
+
+static enum pse_res_t
+getGridAttribs
+  (void* ctxt,
+   const enum pse_point_attrib_t attrib,
+   const enum pse_type_t as_type,
+   const size_t count,
+   const pse_ppoint_id_t* values_idx,
+   void* attrib_values)
+{
+  const pse_real_t* points = (const pse_real_t*)ctxt;
+  size_t i;
+  (void)as_type;
+  switch(attrib) {
+    case PSE_POINT_ATTRIB_COORDINATES: {
+      pse_real_t* out = (pse_real_t*)attrib_values;
+      for(i = 0; i < count; ++i) {
+        out[i*2+0] = points[values_idx[i]*2+0];
+        out[i*2+1] = points[values_idx[i]*2+1];
+      }
+    } break;
+    case PSE_POINT_ATTRIB_LOCK_STATUS: {
+      uint8_t* out = (uint8_t*)attrib_values;
+      for(i = 0; i < count; ++i) {
+        out[i] = 0;
+      }
+    } break;
+    default: assert(false);
+  }
+  return RES_OK;
+}
+
+static enum pse_res_t
+setGridAttribs
+  (void* ctxt,
+   const enum pse_point_attrib_t attrib,
+   const enum pse_type_t as_type,
+   const size_t count,
+   const pse_ppoint_id_t* values_idx,
+   const void* attrib_values)
+{
+  pse_real_t* points = (pse_real_t*)ctxt;
+  const pse_real_t* in = (const pse_real_t*)attrib_values;
+  size_t i;
+  (void)as_type, (void)attrib;
+  assert(attrib == PSE_POINT_ATTRIB_COORDINATES);
+  for(i = 0; i < count; ++i) {
+    points[values_idx[i]*2+0] = in[i*2+0];
+    points[values_idx[i]*2+1] = in[i*2+1];
+  }
+  return RES_OK;
+}
+
+/* Wall clock time in milliseconds: the CPU time of clock() would add up the
+ * time of all the threads computing the finite differences */
+static double
+wallClockMs(void)
+{
+#if defined(_OPENMP)
+  return omp_get_wtime() * 1000.0;
+#elif defined(PSE_OS_WINDOWS)
+  /* clock() gives the wall clock time on Windows */
+  return (double)clock() * 1000.0 / (double)CLOCKS_PER_SEC;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1.0e6;
+#endif
+}
+
+static double
+elapsedMs(const double start)
+{
+  return wallClockMs() - start;
+}
+
+/* Points shaken around their place in the grid */
+static void
+gridPointsReset(pse_real_t* points, const size_t count)
+{
+  size_t i;
+  srand(123456);
+  for(i = 0; i < count; ++i) {
+    points[i*2+0] = gridHome(i, 0)
+      + (pse_real_t)(rand() % 1000 - 500) / (pse_real_t)1000;
+    points[i*2+1] = gridHome(i, 1)
+      + (pse_real_t)(rand() % 1000 - 500) / (pse_real_t)1000;
+  }
+}
+
+static void
+benchGrid
+  (const bool analytic_df,
+   const enum pse_cpspace_exploration_jacobian_t jacobian,
+   const bool solve,
+   const size_t repetitions)
+{
+  struct pse_device_params_t devp = PSE_DEVICE_PARAMS_NULL;
+  pse_clt_pspace_uid_t psp_uid = GRID_PSPACE;
+  struct pse_pspace_params_t psp = PSE_PSPACE_PARAMS_NULL;
+  struct pse_cpspace_params_t cpsp = PSE_CPSPACE_PARAMS_NULL;
+  struct pse_cpspace_values_data_t data = PSE_CPSPACE_VALUES_DATA_NULL;
+  struct pse_cpspace_exploration_ctxt_params_t ctxtp = PSE_CPSPACE_EXPLORATION_CTXT_PARAMS_NULL;
+  struct pse_cpspace_exploration_extra_results_t results = PSE_CPSPACE_EXPLORATION_EXTRA_RESULTS_NULL;
+  struct pse_cpspace_exploration_samples_t smpls = PSE_CPSPACE_EXPLORATION_SAMPLES_NULL;
+  struct pse_relshp_cost_func_params_t ccfps[2] = {
+    PSE_RELSHP_COST_FUNC_PARAMS_NULL_,
+    PSE_RELSHP_COST_FUNC_PARAMS_NULL_
+  };
+  pse_relshp_cost_func_id_t ccfids[2] = {
+    PSE_RELSHP_COST_FUNC_ID_INVALID_,
+    PSE_RELSHP_COST_FUNC_ID_INVALID_
+  };
+  struct pse_pspace_point_attrib_component_t coords_components[] = {
+    {PSE_TYPE_REAL},
+    {PSE_TYPE_REAL}
+  };
+  struct pse_pspace_point_attrib_component_t lock_components[] = {
+    {PSE_TYPE_BOOL_8}
+  };
+  const size_t points_count = grid_width * grid_width;
+  struct pse_ppoint_params_t* ppps = NULL;
+  pse_ppoint_id_t* ppids = NULL;
+  pse_ppoint_id_t* pairs = NULL;
+  struct pse_cpspace_relshp_params_t* rps = NULL;
+  pse_relshp_id_t* rids = NULL;
+  pse_real_t* points = NULL;
+  size_t relshps_count = 0;
+
+  struct pse_device_t* dev = NULL;
+  struct pse_cpspace_t* cps = NULL;
+  struct pse_cpspace_values_t* vals = NULL;
+  struct pse_cpspace_exploration_ctxt_t* ctxt = NULL;
+  size_t i, x, y, r;
+  int dx, dy;
+  double start;
+  double create_ms = 0, solve_ms = 0;
+  double error, max_error = 0;
+  bool converged = true;
+  enum pse_res_t res = RES_OK;
+
+  devp.backend_drv_filepath = PSE_LIB_NAME("pse-drv-eigen");
+  CHECK(pseDeviceCreate(&devp, &dev), RES_OK);
+
+  psp.ppoint_params.attribs[PSE_POINT_ATTRIB_COORDINATES].components_count = 2;
+  psp.ppoint_params.attribs[PSE_POINT_ATTRIB_COORDINATES].components = coords_components;
+  psp.ppoint_params.attribs[PSE_POINT_ATTRIB_LOCK_STATUS].components_count = 1;
+  psp.ppoint_params.attribs[PSE_POINT_ATTRIB_LOCK_STATUS].components = lock_components;
+  CHECK(pseConstrainedParameterSpaceCreate(dev, &cpsp, &cps), RES_OK);
+  CHECK(pseConstrainedParameterSpaceParameterSpacesDeclare
+    (cps, 1, &psp_uid, &psp), RES_OK);
+
+  ccfps[0].uid = GRID_CF_HOME;
+  ccfps[0].expected_pspace = GRID_PSPACE;
+  ccfps[0].compute = computeHomeCb;
+  ccfps[0].compute_df = analytic_df ? computeHomeDfCb : NULL;
+  ccfps[0].cost_arity_mode = PSE_COST_ARITY_MODE_PER_RELATIONSHIP;
+  ccfps[0].costs_count = 2;
+  ccfps[1].uid = GRID_CF_DISTANCE;
+  ccfps[1].expected_pspace = GRID_PSPACE;
+  ccfps[1].compute = computeDistanceCb;
+  ccfps[1].compute_df = analytic_df ? computeDistanceDfCb : NULL;
+  ccfps[1].cost_arity_mode = PSE_COST_ARITY_MODE_PER_RELATIONSHIP;
+  ccfps[1].costs_count = 1;
+  CHECK(pseConstrainedParameterSpaceRelationshipCostFunctorsRegister
+    (cps, 2, ccfps, ccfids), RES_OK);
+
+  ppps = (struct pse_ppoint_params_t*)malloc(points_count * sizeof(*ppps));
+  ppids = (pse_ppoint_id_t*)malloc(points_count * sizeof(*ppids));
+  NCHECK(ppps, NULL);
+  NCHECK(ppids, NULL);
+  for(i = 0; i < points_count; ++i) {
+    ppps[i] = PSE_PPOINT_PARAMS_NULL;
+    ppids[i] = PSE_PPOINT_ID_INVALID;
+  }
+  CHECK(pseConstrainedParameterSpaceParametricPointsAdd
+    (cps, points_count, ppps, ppids), RES_OK);
+
+  /* One home relationship per point, and one distance relationship with each
+   * following point around it. */
+  r = (2*GRID_NEIGHBOURS+1)*(2*GRID_NEIGHBOURS+1);
+  rps = (struct pse_cpspace_relshp_params_t*)
+    malloc(points_count * r * sizeof(*rps));
+  rids = (pse_relshp_id_t*)malloc(points_count * r * sizeof(*rids));
+  pairs = (pse_ppoint_id_t*)malloc(points_count * r * 2 * sizeof(*pairs));
+  NCHECK(rps, NULL);
+  NCHECK(rids, NULL);
+  NCHECK(pairs, NULL);
+  for(i = 0; i < points_count; ++i) {
+    rps[relshps_count] = PSE_CPSPACE_RELSHP_PARAMS_NULL;
+    rps[relshps_count].kind = PSE_RELSHP_KIND_INCLUSIVE;
+    rps[relshps_count].ppoints_count = 1;
+    rps[relshps_count].ppoints_id = &ppids[i];
+    rps[relshps_count].cnstrs.funcs_count = 1;
+    rps[relshps_count].cnstrs.funcs = &ccfids[0];
+    ++relshps_count;
+  }
+  for(y = 0; y < grid_width; ++y) {
+    for(x = 0; x < grid_width; ++x) {
+      for(dy = 0; dy <= GRID_NEIGHBOURS; ++dy) {
+        for(dx = -GRID_NEIGHBOURS; dx <= GRID_NEIGHBOURS; ++dx) {
+          const int nx = (int)x + dx;
+          const int ny = (int)y + dy;
+          if( (dy == 0 && dx <= 0)
+           || nx < 0 || nx >= (int)grid_width || ny >= (int)grid_width )
+            continue;
+          pairs[relshps_count*2+0] = ppids[y*grid_width+x];
+          pairs[relshps_count*2+1] = ppids[(size_t)ny*grid_width+(size_t)nx];
+          rps[relshps_count] = PSE_CPSPACE_RELSHP_PARAMS_NULL;
+          rps[relshps_count].kind = PSE_RELSHP_KIND_INCLUSIVE;
+          rps[relshps_count].ppoints_count = 2;
+          rps[relshps_count].ppoints_id = &pairs[relshps_count*2];
+          rps[relshps_count].cnstrs.funcs_count = 1;
+          rps[relshps_count].cnstrs.funcs = &ccfids[1];
+          ++relshps_count;
+        }
+      }
+    }
+  }
+  CHECK(pseConstrainedParameterSpaceRelationshipsAdd
+    (cps, PSE_CLT_RELSHPS_GROUP_UID_INVALID, relshps_count, rps, rids),
+    RES_OK);
+
+  points = (pse_real_t*)malloc(points_count * 2 * sizeof(*points));
+  NCHECK(points, NULL);
+  data.pspace = GRID_PSPACE;
+  data.storage = PSE_CPSPACE_VALUES_STORAGE_ACCESSORS_GLOBAL;
+  data.as.global.accessors.ctxt = points;
+  data.as.global.accessors.get = getGridAttribs;
+  data.as.global.accessors.set = setGridAttribs;
+  CHECK(pseConstrainedParameterSpaceValuesCreate(cps, &data, &vals), RES_OK);
+
+  ctxtp.pspace.explore_in = GRID_PSPACE;
+  ctxtp.options.jacobian = jacobian;
+  smpls.values = vals;
+  for(r = 0; r < repetitions; ++r) {
+    start = wallClockMs();
+    CHECK(pseConstrainedParameterSpaceExplorationContextCreate
+      (cps, &ctxtp, &ctxt), RES_OK);
+    create_ms += elapsedMs(start);
+
+    if( solve ) {
+      gridPointsReset(points, points_count);
+      start = wallClockMs();
+      res = pseConstrainedParameterSpaceExplorationSolve(ctxt, &smpls);
+      solve_ms += elapsedMs(start);
+      /* With finite differences, the maximum count of costs calls of the LM
+       * may be reached after the points are in place, checked below */
+      CHECK(res == RES_OK || (!analytic_df && res == RES_NOT_CONVERGED), true);
+      converged = converged && res == RES_OK;
+      CHECK(pseConstrainedParameterSpaceExplorationLastResultsRetreive
+        (ctxt, vals, &results), RES_OK);
+    }
+    CHECK(pseConstrainedParameterSpaceExplorationContextRefSub(ctxt), RES_OK);
+  }
+
+  printf("%s %s, %lu points, %lu relationships:\n",
+    analytic_df ? "analytic" : "finite differences",
+    jacobian == PSE_CPSPACE_EXPLORATION_JACOBIAN_SPARSE ? "sparse" : "dense",
+    (unsigned long)points_count, (unsigned long)relshps_count);
+  if( solve ) {
+    /* Every point goes back to its place in the grid */
+    for(i = 0; i < points_count; ++i) {
+      error = PSE_MAX(fabs(points[i*2+0] - gridHome(i, 0)),
+                      fabs(points[i*2+1] - gridHome(i, 1)));
+      CHECK(error < 1.e-3, true);
+      max_error = PSE_MAX(max_error, error);
+    }
+    /* The finite differences count in the maximum count of costs calls of
+     * each LM try: on large grids, a try stops after its first Jacobian
+     * matrix, and the solve after its last try, before its convergence. The
+     * analytic gradients run until the convergence, with as many steps but
+     * more of them: compare the errors along with the times. */
+    printf("  context creation %.2f ms, solve %.2f ms"
+           " (%lu iterations, %lu costs calls, %s, max error %.1e)\n",
+      create_ms / (double)repetitions, solve_ms / (double)repetitions,
+      (unsigned long)results.counter_iterations.last_call,
+      (unsigned long)results.counter_costs_calls.last_call,
+      converged ? "converged" : "not converged",
+      max_error);
+  } else {
+    printf("  context creation %.2f ms\n", create_ms / (double)repetitions);
+  }
+
+  CHECK(pseConstrainedParameterSpaceValuesRefSub(vals), RES_OK);
+  CHECK(pseConstrainedParameterSpaceRefSub(cps), RES_OK);
+  CHECK(pseDeviceDestroy(dev), RES_OK);
+  free(points);
+  free(pairs);
+  free(rids);
+  free(rps);
+  free(ppids);
+  free(ppps);
+}
+
+int main(int argc, char** argv)
+{
+  size_t creation_grid_width = 40;
+  size_t solve_grid_width = 12;
+  size_t repetitions = 5;
+  size_t sparse_solve_grid_width = 32;
+  if( argc > 1 ) creation_grid_width = (size_t)atol(argv[1]);
+  if( argc > 2 ) solve_grid_width = (size_t)atol(argv[2]);
+  if( argc > 3 ) repetitions = (size_t)atol(argv[3]);
+  if( argc > 4 ) sparse_solve_grid_width = (size_t)atol(argv[4]);
+  CHECK(creation_grid_width > 0 && solve_grid_width > 0, true);
+  CHECK(sparse_solve_grid_width > 0, true);
+  CHECK(repetitions > 0, true);
+
+  grid_width = creation_grid_width;
+  benchGrid(true, PSE_CPSPACE_EXPLORATION_JACOBIAN_SPARSE, false, repetitions);
+
+  grid_width = solve_grid_width;
+  benchGrid(true, PSE_CPSPACE_EXPLORATION_JACOBIAN_SPARSE, true, repetitions);
+  benchGrid(false, PSE_CPSPACE_EXPLORATION_JACOBIAN_SPARSE, true, repetitions);
+  benchGrid(true, PSE_CPSPACE_EXPLORATION_JACOBIAN_DENSE, true, repetitions);
+  benchGrid(false, PSE_CPSPACE_EXPLORATION_JACOBIAN_DENSE, true, repetitions);
+
+  grid_width = sparse_solve_grid_width;
+  benchGrid(true, PSE_CPSPACE_EXPLORATION_JACOBIAN_SPARSE, true, repetitions);
+  benchGrid(false, PSE_CPSPACE_EXPLORATION_JACOBIAN_SPARSE, true, repetitions);
+  return 0;
+}
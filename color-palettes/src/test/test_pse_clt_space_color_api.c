@@ -4,6 +4,7 @@
 #include <clt/space/color/pse_color.h>
 #include <clt/space/color/pse_color_vision_deficiencies.h>
 
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -260,6 +261,63 @@ int main(int argc, char* argv[])
   PSE_CALL(pseColorPaletteExplorationResultsRetreive
     (exc, &opts_colors, &results));
 
+  /* The same exploration, using the sparse Jacobian matrix, must give the same
+   * colors. */
+  {
+    struct pse_color_palette_exploration_ctxt_params_t sparse_excp = excp;
+    struct pse_cpspace_exploration_ctxt_t* sparse_exc = NULL;
+    struct pse_cpspace_exploration_extra_results_t sparse_results =
+      PSE_CPSPACE_EXPLORATION_EXTRA_RESULTS_NULL;
+    struct pse_colors_t sparse_opts_colors = PSE_COLORS_INVALID;
+    struct pse_colors_t dense_clrs = PSE_COLORS_INVALID;
+    struct pse_colors_t sparse_clrs = PSE_COLORS_INVALID;
+    size_t i;
+    pse_real_t diff, max_diff = 0;
+
+    sparse_excp.options.jacobian = PSE_CPSPACE_EXPLORATION_JACOBIAN_SPARSE;
+    PSE_CALL(pseColorsAllocate
+      (alloc, PSE_COLOR_FORMAT_RGBui8, colors_count, &sparse_opts_colors));
+    PSE_CALL(pseColorPaletteExplorationContextCreate
+      (cp, &sparse_excp, &sparse_exc));
+    PSE_CALL(pseColorPaletteExplorationContextInitFromValues
+      (sparse_exc, &refs_colors));
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    PSE_CALL(pseColorPaletteExplorationSolve
+      (sparse_exc, &smpls_colors, 1, locked));
+    clock_gettime(CLOCK_REALTIME, &te);
+#ifdef PRINT_PERFS
+    fprintf(stdout, "Elapsed time (sparse): %.3f ms\n", clock_elps_ms(&ts, &te));
+#endif
+
+    PSE_CALL(pseColorsConvert(&smpls_colors, &sparse_opts_colors));
+    PSE_CALL(pseColorPaletteExplorationResultsRetreive
+      (sparse_exc, &sparse_opts_colors, &sparse_results));
+    /* The results are retreived in the exploration format: compare them in
+     * RGB */
+    PSE_CALL(pseColorsAllocate
+      (alloc, PSE_COLOR_FORMAT_RGBr, colors_count, &dense_clrs));
+    PSE_CALL(pseColorsAllocate
+      (alloc, PSE_COLOR_FORMAT_RGBr, colors_count, &sparse_clrs));
+    PSE_CALL(pseColorsConvert(&opts_colors, &dense_clrs));
+    PSE_CALL(pseColorsConvert(&sparse_opts_colors, &sparse_clrs));
+    for(i = 0; i < colors_count; ++i) {
+      const struct pse_color_RGBr_t* a = &dense_clrs.as.RGB.as.RGBr[i];
+      const struct pse_color_RGBr_t* b = &sparse_clrs.as.RGB.as.RGBr[i];
+      diff = PSE_MAX(fabs(a->R - b->R), PSE_MAX(fabs(a->G - b->G), fabs(a->B - b->B)));
+      max_diff = PSE_MAX(max_diff, diff);
+    }
+    if( max_diff > 1.0 / 255.0 ) {
+      fprintf(stderr, "Sparse and dense explorations differ by %f\n", max_diff);
+      return 1;
+    }
+
+    PSE_CALL(pseColorsFree(alloc, &dense_clrs));
+    PSE_CALL(pseColorsFree(alloc, &sparse_clrs));
+    PSE_CALL(pseConstrainedParameterSpaceExplorationContextRefSub(sparse_exc));
+    PSE_CALL(pseColorsFree(alloc, &sparse_opts_colors));
+  }
+
 #ifdef PRINT_FINAL_PPOINTS
   fprintf(stdout, "Final colors =====================\n");
   printColors(&opts_colors);
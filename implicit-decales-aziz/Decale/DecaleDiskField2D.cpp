@@ -4,6 +4,7 @@
 
 #include "DecaleDiskField2D.h"
 #include <math.h>
+#include "DecaleRowKernels.h"
 
 
 DecaleDiskField2D::DecaleDiskField2D(double posx, double posy, double radius,unsigned int id, int z_index, unsigned int n)
@@ -18,3 +19,24 @@ double DecaleDiskField2D::variableRadius (double x, double y) {
 
     return Vector2D(radius*scalex*cos(t), radius*scaley*sin(t)).norm();
 }
+
+void DecaleDiskField2D::evalRow (double x, double y0, unsigned int count, double *out) {
+
+    /***********************************
+    // The normalized squared distance of the disk (ellipse when scaled) is
+    // (u.p/(radius*scalex))^2 + (v.p/(radius*scaley))^2 : no atan nor sqrt is needed per sample.
+    ***********************************/
+    const double px = x-posx;
+    const double ua = u.x/(radius*scalex)*px, ub = u.y/(radius*scalex);
+    const double va = v.x/(radius*scaley)*px, vb = v.y/(radius*scaley);
+
+    evalRowKernel([&](auto y) {
+        typedef decltype(y) T;
+        T py = rowSub(y, rowBroadcast<T>(posy));
+        T a = rowAdd(rowBroadcast<T>(ua), rowMul(rowBroadcast<T>(ub), py));
+        T b = rowAdd(rowBroadcast<T>(va), rowMul(rowBroadcast<T>(vb), py));
+        return rowAdd(rowMul(a, a), rowMul(b, b));
+    }, y0, count, out);
+
+    fallOffSquaredRow(out, count, n);
+}
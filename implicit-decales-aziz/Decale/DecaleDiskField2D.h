@@ -14,6 +14,8 @@ public:
     DecaleDiskField2D (double posx, double posy, double radius, unsigned int id, int z_index, unsigned int n=2);
 
     double variableRadius (double x, double y);
+
+    void evalRow (double x, double y0, unsigned int count, double *out);
 };
 
 #endif
@@ -4,6 +4,7 @@
 
 #include "DecaleRoundCornerSquareField2D.h"
 #include <math.h>
+#include "DecaleRowKernels.h"
 #include <iostream>
 
 
@@ -54,3 +55,41 @@ void DecaleRoundCornerSquareField2D::scale(const double scalex, const double sca
 
     c = oi.x*oi.x/(rx*rx) + oi.y*oi.y/(ry*ry) -1.;
 }
+
+void DecaleRoundCornerSquareField2D::evalRow (double x, double y0, unsigned int count, double *out) {
+
+    /***********************************
+    // Same distance as variableRadius, with both sides and the rounded corner evaluated for every sample
+    // and the corner selected with a mask. In the corner, the ray-ellipse intersection is rewritten
+    // with q = (|u.p|,|v.p|) so that d = |p|/r = 2a/(-b+sqrt(b*b-4ac)) with
+    // a = qx^2/rx^2 + qy^2/ry^2 and b = -2(oi.x qx/rx^2 + oi.y qy/ry^2).
+    ***********************************/
+    const double px = x-posx;
+    const double atani = fabs(tani);
+    const double irx2 = 1./(rx*rx), iry2 = 1./(ry*ry);
+    const double isx = 1./(radius*scalex), isy = 1./(radius*scaley);
+
+    evalRowKernel([&](auto y) {
+        typedef decltype(y) T;
+        T py = rowSub(y, rowBroadcast<T>(posy));
+        T qx = rowAbs(rowAdd(rowBroadcast<T>(u.x*px), rowMul(rowBroadcast<T>(u.y), py)));
+        T qy = rowAbs(rowAdd(rowBroadcast<T>(v.x*px), rowMul(rowBroadcast<T>(v.y), py)));
+
+        auto corner = rowAnd(
+                rowGreater(rowMul(qy, rowBroadcast<T>(scalex)), rowMul(qx, rowBroadcast<T>(atani*scaley))),
+                rowGreater(rowMul(qx, rowBroadcast<T>(scaley)), rowMul(qy, rowBroadcast<T>(atani*scalex))));
+
+        T a = rowAdd(rowMul(rowMul(qx, qx), rowBroadcast<T>(irx2)), rowMul(rowMul(qy, qy), rowBroadcast<T>(iry2)));
+        T b = rowMul(rowBroadcast<T>(-2.),
+                     rowAdd(rowMul(qx, rowBroadcast<T>(oi.x*irx2)), rowMul(qy, rowBroadcast<T>(oi.y*iry2))));
+        T delta = rowSub(rowMul(b, b), rowMul(rowBroadcast<T>(4.*c), a));
+        T dCorner = rowDiv(rowMul(rowBroadcast<T>(2.), a), rowSub(rowSqrt(delta), b));
+
+        T dSide = rowMax(rowMul(qx, rowBroadcast<T>(isx)), rowMul(qy, rowBroadcast<T>(isy)));
+
+        T d = rowSelect(corner, dCorner, dSide);
+        return rowMul(d, d);
+    }, y0, count, out);
+
+    fallOffSquaredRow(out, count, n);
+}
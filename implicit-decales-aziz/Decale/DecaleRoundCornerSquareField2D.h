@@ -24,6 +24,8 @@ public:
 
     double variableRadius (double x, double y);
 
+    void evalRow (double x, double y0, unsigned int count, double *out);
+
     /**
      * Virtual in DecaleScalarFields2D.h
      * Scale the Decale along axis by factors scalex and scaley.
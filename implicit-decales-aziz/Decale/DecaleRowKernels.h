@@ -0,0 +1,147 @@
+//
+// Row evaluation kernels shared by the Decale shapes.
+//
+// A Decale buffer row is a line of constant x (buffers are indexed i*iheight+j), so its samples are
+// contiguous in memory. The kernels below evaluate a whole row with packs of doubles:
+// 4 lanes with AVX, 2 lanes with SSE2, and a scalar path for the remaining samples (or when no SIMD
+// instruction set is enabled at compile time).
+//
+// The shape kernels are written once as generic functors taking the local y coordinate of the samples
+// either as a double or as a RowPack, using the row* overloads below.
+//
+
+#ifndef TEST_DECALEROWKERNELS_H
+#define TEST_DECALEROWKERNELS_H
+
+#include <math.h>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define DECALE_ROW_LANES 4
+typedef __m256d RowPack;
+typedef __m256d RowMask;
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DECALE_ROW_LANES 2
+typedef __m128d RowPack;
+typedef __m128d RowMask;
+#else
+#define DECALE_ROW_LANES 1
+#endif
+
+
+/***********************************
+// Scalar path
+***********************************/
+
+template <typename T> inline T rowBroadcast (double a);
+template <> inline double rowBroadcast<double> (double a) { return a; }
+
+inline double rowAdd (double a, double b) { return a + b; }
+inline double rowSub (double a, double b) { return a - b; }
+inline double rowMul (double a, double b) { return a * b; }
+inline double rowDiv (double a, double b) { return a / b; }
+inline double rowSqrt (double a) { return sqrt(a); }
+inline double rowAbs (double a) { return fabs(a); }
+inline double rowMax (double a, double b) { return a > b ? a : b; }
+inline bool rowLess (double a, double b) { return a < b; }
+inline bool rowGreater (double a, double b) { return a > b; }
+inline bool rowAnd (bool a, bool b) { return a && b; }
+inline double rowSelect (bool mask, double a, double b) { return mask ? a : b; }
+
+
+/***********************************
+// SIMD path
+***********************************/
+
+#if DECALE_ROW_LANES == 4
+
+inline RowPack rowAdd (RowPack a, RowPack b) { return _mm256_add_pd(a, b); }
+inline RowPack rowSub (RowPack a, RowPack b) { return _mm256_sub_pd(a, b); }
+inline RowPack rowMul (RowPack a, RowPack b) { return _mm256_mul_pd(a, b); }
+inline RowPack rowDiv (RowPack a, RowPack b) { return _mm256_div_pd(a, b); }
+inline RowPack rowSqrt (RowPack a) { return _mm256_sqrt_pd(a); }
+inline RowPack rowAbs (RowPack a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.), a); }
+inline RowPack rowMax (RowPack a, RowPack b) { return _mm256_max_pd(a, b); }
+inline RowMask rowLess (RowPack a, RowPack b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+inline RowMask rowGreater (RowPack a, RowPack b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+inline RowMask rowAnd (RowMask a, RowMask b) { return _mm256_and_pd(a, b); }
+inline RowPack rowSelect (RowMask mask, RowPack a, RowPack b) { return _mm256_blendv_pd(b, a, mask); }
+
+template <> inline RowPack rowBroadcast<RowPack> (double a) { return _mm256_set1_pd(a); }
+inline RowPack rowRamp (double start) { return _mm256_setr_pd(start, start + 1., start + 2., start + 3.); }
+inline void rowStore (double *out, RowPack a) { _mm256_storeu_pd(out, a); }
+inline RowPack rowLoad (const double *in) { return _mm256_loadu_pd(in); }
+
+#elif DECALE_ROW_LANES == 2
+
+inline RowPack rowAdd (RowPack a, RowPack b) { return _mm_add_pd(a, b); }
+inline RowPack rowSub (RowPack a, RowPack b) { return _mm_sub_pd(a, b); }
+inline RowPack rowMul (RowPack a, RowPack b) { return _mm_mul_pd(a, b); }
+inline RowPack rowDiv (RowPack a, RowPack b) { return _mm_div_pd(a, b); }
+inline RowPack rowSqrt (RowPack a) { return _mm_sqrt_pd(a); }
+inline RowPack rowAbs (RowPack a) { return _mm_andnot_pd(_mm_set1_pd(-0.), a); }
+inline RowPack rowMax (RowPack a, RowPack b) { return _mm_max_pd(a, b); }
+inline RowMask rowLess (RowPack a, RowPack b) { return _mm_cmplt_pd(a, b); }
+inline RowMask rowGreater (RowPack a, RowPack b) { return _mm_cmpgt_pd(a, b); }
+inline RowMask rowAnd (RowMask a, RowMask b) { return _mm_and_pd(a, b); }
+inline RowPack rowSelect (RowMask mask, RowPack a, RowPack b) { return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b)); }
+
+template <> inline RowPack rowBroadcast<RowPack> (double a) { return _mm_set1_pd(a); }
+inline RowPack rowRamp (double start) { return _mm_setr_pd(start, start + 1.); }
+inline void rowStore (double *out, RowPack a) { _mm_storeu_pd(out, a); }
+inline RowPack rowLoad (const double *in) { return _mm_loadu_pd(in); }
+
+#endif
+
+
+/**
+ * Evaluates a kernel on count consecutive samples of a row starting at the local ordinate y0 (step of one pixel)
+ * and stores the results in out.
+ * @param kernel: generic functor returning, for a pack of local ordinates, the pack of values to store.
+ */
+template <typename Kernel>
+inline void evalRowKernel (const Kernel &kernel, double y0, unsigned int count, double *out) {
+
+    unsigned int j=0;
+#if DECALE_ROW_LANES > 1
+    for (; j+DECALE_ROW_LANES<=count; j+=DECALE_ROW_LANES)
+        rowStore(out+j, kernel(rowRamp(y0+double(j))));
+#endif
+    for (; j<count; j++)
+        out[j] = kernel(y0+double(j));
+}
+
+/**
+ * Replaces in place each squared normalized distance d2 of a row by the falloff value (1-d2)^n (0 when d2 >= 1).
+ */
+inline void fallOffSquaredRow (double *values, unsigned int count, unsigned int n) {
+
+    unsigned int j=0;
+#if DECALE_ROW_LANES > 1
+    const RowPack one = rowBroadcast<RowPack>(1.);
+    const RowPack zero = rowBroadcast<RowPack>(0.);
+    for (; j+DECALE_ROW_LANES<=count; j+=DECALE_ROW_LANES) {
+        RowPack d2 = rowLoad(values+j);
+        RowPack base = rowSub(one, d2);
+        RowPack f = one;
+        for (unsigned int e=n; e>0; e>>=1) {
+            if (e & 1u) f = rowMul(f, base);
+            base = rowMul(base, base);
+        }
+        rowStore(values+j, rowSelect(rowLess(d2, one), f, zero));
+    }
+#endif
+    for (; j<count; j++) {
+        double d2 = values[j];
+        double base = 1.-d2;
+        double f = 1.;
+        for (unsigned int e=n; e>0; e>>=1) {
+            if (e & 1u) f *= base;
+            base *= base;
+        }
+        values[j] = (d2 < 1.) ? f : 0.;
+    }
+}
+
+#endif //TEST_DECALEROWKERNELS_H
@@ -8,7 +8,8 @@
 
 
 
-DecaleScalarField2D::DecaleScalarField2D() : widthBoundaryUV (0.05) {}
+DecaleScalarField2D::DecaleScalarField2D() : discreteUVField (NULL), fieldStorage (FIELD_STORAGE_DOUBLE),
+    uvStorage (UV_STORAGE_DOUBLE), bufferPool (NULL), widthBoundaryUV (0.05), restPoseIndex (-1) {}
 
 
 
@@ -33,8 +34,7 @@ DecaleScalarField2D::DecaleScalarField2D(double posx, double posy, double size,u
     iwidth=(unsigned int)dwidth;
     iheight=(unsigned int) dheight;
 
-    cornerx=(int)(posx-radius);
-    cornery=(int)(posy-radius);
+    updateCorner();
 
     widthBoundaryUV=0.05;
 
@@ -43,6 +43,27 @@ DecaleScalarField2D::DecaleScalarField2D(double posx, double posy, double size,u
 
     hasRotated = false;
     needUpdateBuffersSize = false;
+
+    restPoseIndex = -1;
+
+    fieldStorage = FIELD_STORAGE_DOUBLE;
+    uvStorage = UV_STORAGE_DOUBLE;
+
+    bufferPool = NULL;
+    discreteUVField = NULL;
+}
+
+DecaleScalarField2D::~DecaleScalarField2D() {
+
+    /***********************************
+    // The rest-pose fields are owned by their cache, the other field buffers by the vector of field buffers
+    ***********************************/
+    for (std::map<std::pair<int,int>, FieldBuffer *>::iterator it = restPoseFields.begin(); it != restPoseFields.end(); ++it)
+        delete it->second;
+    for (int i=0; i<(int)discreteFields.size(); i++)
+        if (i != restPoseIndex) delete discreteFields[i];
+
+    delete discreteUVField;
 }
 
 double DecaleScalarField2D::dist (double x, double y) {
@@ -61,82 +82,160 @@ double DecaleScalarField2D::eval(const double x, const double y) {
     return fallOff (d);
 }
 
+void DecaleScalarField2D::evalRow(double x, double y0, unsigned int count, double *out) {
+
+    for (unsigned int j=0; j<count; j++)
+        out[j]=eval(x, y0+double(j));
+}
+
+void DecaleScalarField2D::evalDiscreteField(FieldBuffer *field, std::pair<int,int> phase) {
+
+    /***********************************
+    // Samples are taken at the pixels covered by the Decale buffer (corner + i), with the sub-pixel
+    // phase of the corner quantized: the sampling only depends on the phase, not on the position.
+    ***********************************/
+    Vector2D origin = sampleOrigin(phase);
+
+    std::vector<double> row (iheight);
+
+    for (int i=0; i<iwidth; i++) {
+        evalRow(double(i)+origin.x, origin.y, iheight, row.data());
+        field->setRow(i*iheight, iheight, row.data());
+    }
+}
+
+std::pair<int,int> DecaleScalarField2D::quantizedCorner() {
+
+    return std::make_pair((int)floor((posx - dwidth/2.)*nbSubPixelPhases + 0.5),
+                          (int)floor((posy - dheight/2.)*nbSubPixelPhases + 0.5));
+}
+
+void DecaleScalarField2D::updateCorner() {
+
+    /***********************************
+    // The integer corner is the quantized corner rounded down: a corner at less than half a phase before the next
+    // pixel has the phase 0 of this pixel, so that the phases are in [0, nbSubPixelPhases)
+    ***********************************/
+    std::pair<int,int> corner = quantizedCorner();
+
+    cornerx = (int)floor(double(corner.first)/nbSubPixelPhases);
+    cornery = (int)floor(double(corner.second)/nbSubPixelPhases);
+}
+
+std::pair<int,int> DecaleScalarField2D::subPixelPhase() {
+
+    std::pair<int,int> corner = quantizedCorner();
+
+    return std::make_pair(corner.first - cornerx*nbSubPixelPhases, corner.second - cornery*nbSubPixelPhases);
+}
+
+Vector2D DecaleScalarField2D::sampleOrigin(std::pair<int,int> phase) {
+
+    return Vector2D(posx - dwidth/2. - double(phase.first)/nbSubPixelPhases,
+                    posy - dheight/2. - double(phase.second)/nbSubPixelPhases);
+}
+
 void DecaleScalarField2D::computeDiscreteField() {
 
-    discreteField = new double [iwidth*iheight];
+    discreteField = new FieldBuffer (iwidth*iheight, fieldStorage, bufferPool);
 
-    for (int i=0; i<iwidth; i++)
-        for (int j=0; j<iheight;j++)
-            discreteField[i*iheight+j]=eval(double(i)+posx-dwidth/2., double(j)+posy-dheight/2.);
+    /***********************************
+    // The first computed buffer is the rest-pose field: it is owned by the cache of rest-pose fields
+    ***********************************/
+    if (restPoseIndex < 0) {
+        restPoseIndex = discreteFields.size();
+        restPosePhase = subPixelPhase();
+        restPoseFields[restPosePhase] = discreteField;
+    }
+    evalDiscreteField(discreteField, subPixelPhase());
 
     discreteFields.push_back(discreteField);
 }
 
 void DecaleScalarField2D::updateDiscreteField(unsigned int indexField) {
 
-    for (int i=0; i<iwidth; i++)
-        for (int j=0; j<iheight;j++)
-            discreteFields[indexField][i*iheight+j]=eval(double(i)+posx-dwidth/2., double(j)+posy-dheight/2.);
+    std::pair<int,int> phase = subPixelPhase();
+
+    if ((int)indexField == restPoseIndex) {
+        restPosePhase = phase;
+        FieldBuffer *&field = restPoseFields[restPosePhase];
+        if (field == NULL) field = new FieldBuffer (iwidth*iheight, fieldStorage, bufferPool);
+        discreteFields[indexField] = field;
+    }
+    evalDiscreteField(discreteFields[indexField], phase);
+}
+
+bool DecaleScalarField2D::selectRestPoseField() {
+
+    if (restPoseIndex < 0) return true;
+
+    std::pair<int,int> phase = subPixelPhase();
+    if (phase == restPosePhase) return true;
+
+    std::map<std::pair<int,int>, FieldBuffer *>::iterator it = restPoseFields.find(phase);
+    if (it == restPoseFields.end()) return false;
+
+    restPosePhase = phase;
+    discreteFields[restPoseIndex] = it->second;
+    return true;
+}
+
+void DecaleScalarField2D::updateRestPoseField() {
+
+    if (!selectRestPoseField()) updateDiscreteField(restPoseIndex);
 }
 
 void DecaleScalarField2D::computeDiscreteUVField (unsigned int indexField){
 
-    discreteUVField = new Vector2D [iwidth*iheight];
-    double x,y,valu,valv, valField;
-    Vector2D p,s;
+    delete discreteUVField;
+    discreteUVField = new UVBuffer (iwidth*iheight, uvStorage, bufferPool);
+    updateDiscreteUVField(indexField);
+}
+void DecaleScalarField2D::updateDiscreteUVField(unsigned int indexField) {
+
+    Vector2D uv;
 
     for (int i=0; i<iwidth; i++)
         for (int j=0; j<iheight;j++) {
-            valField = getDiscreteFieldValue(i,j,indexField);
-            if (valField >= iso) {
-                x = double(i)+posx-dwidth/2.;
-                y = double(j)+posy-dheight/2.;
-                p.x = x-posx;
-                p.y = y-posy;
-                p.normalize();
-                s = p * invFallOff(valField);
-                s = s * variableRadius(x,y);
-
-                valu = ((s * u) / (variableRadius(posx+u.x,posy+u.y) * invAtIso) + 1.) / 2.;
-                valv = ((s * v) / (variableRadius(posx+v.x,posy+v.y) * invAtIso) + 1.) / 2.;
-
-                discreteUVField[i*iheight+j] = Vector2D(valu,valv);
-            }
-            else
-                discreteUVField[i*iheight+j] = Vector2D(-1.,-1.);
+            uv = evalUV(i, j, getDiscreteFieldValue(i,j,indexField));
+            discreteUVField->set(i*iheight+j, uv.x, uv.y);
         }
 }
-void DecaleScalarField2D::updateDiscreteUVField(unsigned int indexField) {
 
-    double x,y,valu,valv, valField;
+Vector2D DecaleScalarField2D::evalUV(unsigned int i, unsigned int j, double valField) {
+
+    double x,y,valu,valv;
     Vector2D p,s;
 
-    for (int i=0; i<iwidth; i++)
-        for (int j=0; j<iheight;j++) {
-            valField = getDiscreteFieldValue(i,j,indexField);
-            if (valField >= iso) {
-                x = double(i)+posx-dwidth/2.;
-                y = double(j)+posy-dheight/2.;
-                p.x = x-posx;
-                p.y = y-posy;
-                p.normalize();
-                s = p * invFallOff(valField);
-                s = s * variableRadius(x,y);
-
-                valu = ((s * u) / (variableRadius(posx+u.x,posy+u.y) * invAtIso) + 1.) / 2.;
-                valv = ((s * v) / (variableRadius(posx+v.x,posy+v.y) * invAtIso) + 1.) / 2.;
-
-                discreteUVField[i*iheight+j] = Vector2D(valu,valv);
-            }
-            else
-                discreteUVField[i*iheight+j] = Vector2D(-1.,-1.);
-        }
+    if (valField < iso) return Vector2D(-1., -1.);
+
+    /***********************************
+    // The pixel is at the same place as the sample of its field value
+    ***********************************/
+    Vector2D origin = sampleOrigin(subPixelPhase());
+    x = double(i)+origin.x;
+    y = double(j)+origin.y;
+    p.x = x-posx;
+    p.y = y-posy;
+    p.normalize();
+    s = p * invFallOff(valField);
+    s = s * variableRadius(x,y);
+
+    valu = ((s * u) / (variableRadius(posx+u.x,posy+u.y) * invAtIso) + 1.) / 2.;
+    valv = ((s * v) / (variableRadius(posx+v.x,posy+v.y) * invAtIso) + 1.) / 2.;
+
+    return Vector2D(valu, valv);
 }
 
 
 Vector2D DecaleScalarField2D::getUV(unsigned int i, unsigned int j){
 
-    return discreteUVField[i*iheight+j];
+    return discreteUVField->get(i*iheight+j);
+}
+
+void DecaleScalarField2D::setUV(unsigned int i, unsigned int j, const Vector2D &uv){
+
+    discreteUVField->set(i*iheight+j, uv.x, uv.y);
 }
 
 
@@ -154,13 +253,15 @@ double DecaleScalarField2D::getPosy() {
 void DecaleScalarField2D::setPosx(double newx) {
 
     posx = newx;
-    cornerx=(int)(posx-dwidth/2.);
+    updateCorner();
+    selectRestPoseField();
 }
 
 void DecaleScalarField2D::setPosy(double newy) {
 
     posy = newy;
-    cornery=(int)(posy-dheight/2.);
+    updateCorner();
+    selectRestPoseField();
 }
 
 unsigned int DecaleScalarField2D::getId() {
@@ -203,7 +304,7 @@ double DecaleScalarField2D::getDHeight() {
 }
 
 
-double *DecaleScalarField2D::getDiscreteField (unsigned int indexField){
+FieldBuffer *DecaleScalarField2D::getDiscreteField (unsigned int indexField){
 
     return discreteFields[indexField];
 }
@@ -211,10 +312,10 @@ double *DecaleScalarField2D::getDiscreteField (unsigned int indexField){
 
 double DecaleScalarField2D::getDiscreteFieldValue (unsigned int i, unsigned int j, unsigned int indexField){
 
-    return discreteFields[indexField][i*iheight+j];
+    return discreteFields[indexField]->get(i*iheight+j);
 }
 
-void DecaleScalarField2D::addDiscreteField (double *discreteField){
+void DecaleScalarField2D::addDiscreteField (FieldBuffer *discreteField){
 
     discreteFields.push_back(discreteField);
 }
@@ -246,6 +347,32 @@ void DecaleScalarField2D::setScaley(double value)
 void DecaleScalarField2D::setZIndex(int value){
     z_index = value;
 }
+
+void DecaleScalarField2D::setStorage(FieldStorage fieldStorage, UVStorage uvStorage) {
+
+    this->fieldStorage = fieldStorage;
+    this->uvStorage = uvStorage;
+}
+
+FieldStorage DecaleScalarField2D::getFieldStorage() {
+
+    return fieldStorage;
+}
+
+UVStorage DecaleScalarField2D::getUVStorage() {
+
+    return uvStorage;
+}
+
+void DecaleScalarField2D::setBufferPool(BufferPool *pool) {
+
+    bufferPool = pool;
+}
+
+BufferPool *DecaleScalarField2D::getBufferPool() {
+
+    return bufferPool;
+}
 double DecaleScalarField2D::getWidthBoundary (){
 
     return widthBoundaryUV;
@@ -253,6 +380,8 @@ double DecaleScalarField2D::getWidthBoundary (){
 
 void DecaleScalarField2D::rotate(const double theta) {
 
+    if (theta == 0.) return;
+
     this->u.set (cos(theta)*u.x - sin(theta)*u.y, sin(theta)*u.x + cos(theta)*u.y);
     this->v.set (cos(theta)*v.x - sin(theta)*v.y, sin(theta)*v.x + cos(theta)*v.y);
 
@@ -264,8 +393,7 @@ void DecaleScalarField2D::rotate(const double theta) {
     iwidth=(unsigned int)dwidth;
     iheight=(unsigned int) dheight;
 
-    cornerx=(int)(posx - dwidth/2.);
-    cornery=(int)(posy - dheight/2.);
+    updateCorner();
 
     /***********************************
     // The field and UV buffer size need to be updates and buffers need to be re-computed
@@ -276,6 +404,8 @@ void DecaleScalarField2D::rotate(const double theta) {
 
 void DecaleScalarField2D::scale(const double scalex, const double scaley) {
 
+    if ((scalex == 1.) && (scaley == 1.)) return;
+
     /***********************************
     // Scale accumulation. Provides the scales from the rest pose.
     ***********************************/
@@ -301,8 +431,7 @@ void DecaleScalarField2D::scale(const double scalex, const double scaley) {
     iwidth=(unsigned int)dwidth;
     iheight=(unsigned int)dheight;
 
-    cornerx=(int)(posx - dwidth/2.);
-    cornery=(int)(posy - dheight/2.);
+    updateCorner();
 
     /***********************************
     // The field and UV buffer size need to be updates and buffers need to be re-computed
@@ -311,12 +440,30 @@ void DecaleScalarField2D::scale(const double scalex, const double scaley) {
 }
 void DecaleScalarField2D::updateBuffersSize() {
 
+    /***********************************
+    // Buffers are resized in place: their memory is kept when they shrink
+    // and is exchanged in the buffer pool when they grow
+    ***********************************/
     for (int i=0; i<discreteFields.size();i++){
-        delete(discreteFields[i]);
-        discreteFields[i] = new double [iwidth*iheight];
+        if (i == restPoseIndex) continue;
+        discreteFields[i]->resize(iwidth*iheight);
     }
-    delete(discreteUVField);
-    discreteUVField = new Vector2D [iwidth*iheight];
+
+    /***********************************
+    // The shape has changed: the cached rest-pose fields are flushed, except the current one that is resized
+    ***********************************/
+    if (restPoseIndex >= 0) {
+        FieldBuffer *current = discreteFields[restPoseIndex];
+        for (std::map<std::pair<int,int>, FieldBuffer *>::iterator it = restPoseFields.begin(); it != restPoseFields.end(); ++it)
+            if (it->second != current) delete it->second;
+        restPoseFields.clear();
+
+        current->resize(iwidth*iheight);
+        restPosePhase = subPixelPhase();
+        restPoseFields[restPosePhase] = current;
+    }
+
+    discreteUVField->resize(iwidth*iheight);
 
     needUpdateBuffersSize = false;
 }
@@ -8,10 +8,12 @@
 #include "../Field2D/Field2D.h"
 #include <vector>
 #include <map>
+#include <utility>
 #include "../Tools/Vector2D.h"
+#include "../Tools/FieldBuffer.h"
 
 
-typedef std::vector<double *> VectorOfDiscreteFields;
+typedef std::vector<FieldBuffer *> VectorOfDiscreteFields;
 
 class DecaleScalarField2D : public Field2D {
 
@@ -19,6 +21,10 @@ public:
 
     DecaleScalarField2D();
     DecaleScalarField2D(double posx, double posy, double size, unsigned int id, int z_index, unsigned int n);
+    /**
+     * Release the field buffers (including the cached rest-pose fields) and the UV buffer.
+     */
+    ~DecaleScalarField2D();
 
     double eval (const double x, const double y);
 
@@ -28,6 +34,17 @@ public:
 
     virtual double variableRadius (double x, double y)=0;
 
+    /**
+     * Evaluates the field on a row of count samples of constant abscissa x, starting at the ordinate y0
+     * with a step of one pixel. A row is contiguous in the Decale buffers (index i*iheight+j).
+     * The default implementation calls eval per sample; the Decale shapes override it with a vectorized kernel.
+     * @param x : abscissa of the row
+     * @param y0 : ordinate of the first sample
+     * @param count : number of samples
+     * @param out : the count field values
+     */
+    virtual void evalRow (double x, double y0, unsigned int count, double *out);
+
     /**
      * Rotates the Decale by an angle theta (in Radians) from its current rotation.
      * The Decale width, height and corner are adjusted.
@@ -52,6 +69,13 @@ public:
      * @param indexField: index of the buffer to recompute in the vector of field buffers.
      */
     void updateDiscreteField (unsigned int indexField);
+    /**
+     * Makes the rest-pose field buffer (the first computed field buffer, before any deformation) match the current
+     * sub-pixel phase of the Decale position. The buffer is taken from the cache of rest-pose fields, and is evaluated
+     * and cached if this phase has not been evaluated yet for the current shape, scale and rotation.
+     * Has to be called after a translation (setPosx, setPosy) before the field buffers are used.
+     */
+    void updateRestPoseField ();
 
     /**
      * Create and compute the (u,v) parameterization (in [0,1]*[0,1], or -1 = no image) in a buffer of Vector2D
@@ -67,6 +91,11 @@ public:
      */
 
     void updateDiscreteUVField (unsigned int indexField);
+    /**
+     * (u,v) parameterization of the pixel (i,j) of the Decale buffers where the field value is valField
+     * (-1 = no image when the value is below the iso-value). The UV buffers are computed with it.
+     */
+    Vector2D evalUV (unsigned int i, unsigned int j, double valField);
     /**
      * Change the size of all the Decale buffers (field buffers and UV Buffer) according to the width and height Decale attributes.
      * They all have to be recomputed (can be done with the updates of discrete fields = buffers).
@@ -80,14 +109,34 @@ public:
 
 
     Vector2D getUV(unsigned int i, unsigned int j);
+    void setUV(unsigned int i, unsigned int j, const Vector2D &uv);
 
-    double *getDiscreteField (unsigned int indexField);
+    FieldBuffer *getDiscreteField (unsigned int indexField);
     double getDiscreteFieldValue (unsigned int i, unsigned int j, unsigned int indexField);
-    void addDiscreteField (double *discreteField);
+    void addDiscreteField (FieldBuffer *discreteField);
+
+    /**
+     * Set the storage of the field buffers (double, float or 16-bit fixed point) and of the UV buffer (double or half).
+     * Buffers created afterwards use this storage: it has to be set before computing the Decale buffers.
+     */
+    void setStorage (FieldStorage fieldStorage, UVStorage uvStorage);
+    FieldStorage getFieldStorage ();
+    UVStorage getUVStorage ();
+
+    /**
+     * Set the pool from which the memory of the field buffers and UV buffer is taken (the heap if NULL).
+     * It has to be set before computing the Decale buffers, and the pool has to outlive the Decale buffers.
+     */
+    void setBufferPool (BufferPool *pool);
+    BufferPool *getBufferPool ();
 
 
     double getPosx ();
     double getPosy ();
+    /**
+     * Translate the Decale. Only the corner is moved: the field does not depend on the position, and the rest-pose
+     * field buffer is re-selected from the cache of rest-pose fields when its sub-pixel phase is already cached.
+     */
     void setPosx(double newx);
     void setPosy(double newy);
 
@@ -119,11 +168,15 @@ protected:
     int id;
     int z_index;
 
-    double *discreteField;
+    FieldBuffer *discreteField;
     double *discreteDistanceField;
-    Vector2D *discreteUVField;
+    UVBuffer *discreteUVField;
     VectorOfDiscreteFields discreteFields;
 
+    FieldStorage fieldStorage;
+    UVStorage uvStorage;
+    BufferPool *bufferPool;
+
     double posx;
     double posy;
 
@@ -153,6 +206,48 @@ protected:
     bool hasRotated;
     bool needUpdateBuffersSize;
 
+    /**
+     * Number of quantized sub-pixel phases per axis of the rest-pose field buffers (1/4 pixel).
+     */
+    static const int nbSubPixelPhases = 4;
+
+    /**
+     * Rest-pose field buffers, indexed by the quantized sub-pixel phase of the Decale corner.
+     * They only depend on the shape, scale and rotation of the Decale: the cache owns the buffers and is flushed
+     * when the buffers are resized (after a scale or a rotation).
+     * The buffer of the phase restPosePhase is the one stored in the vector of field buffers at index restPoseIndex.
+     */
+    std::map<std::pair<int,int>, FieldBuffer *> restPoseFields;
+    std::pair<int,int> restPosePhase;
+    int restPoseIndex;
+
+    /**
+     * Corner of the Decale buffers, rounded to the nearest 1/nbSubPixelPhases pixel (in 1/nbSubPixelPhases pixel).
+     */
+    std::pair<int,int> quantizedCorner ();
+    /**
+     * Update the integer corner of the Decale buffers from the position and the size of the Decale.
+     */
+    void updateCorner ();
+    /**
+     * Quantized sub-pixel phase (in 1/nbSubPixelPhases pixel, in [0, nbSubPixelPhases)) of the Decale position
+     * relative to its integer corner.
+     */
+    std::pair<int,int> subPixelPhase ();
+    /**
+     * Position sampled by the pixel (0,0) of the Decale buffers, whose corner has the given sub-pixel phase.
+     */
+    Vector2D sampleOrigin (std::pair<int,int> phase);
+    /**
+     * Select the cached rest-pose field buffer of the current sub-pixel phase.
+     * @return false if this phase is not cached yet (the rest-pose field buffer is left unchanged)
+     */
+    bool selectRestPoseField ();
+    /**
+     * Evaluate the field in a buffer, sampled at the pixels of a Decale whose corner has the given sub-pixel phase.
+     */
+    void evalDiscreteField (FieldBuffer *field, std::pair<int,int> phase);
+
 };
 
 
@@ -4,6 +4,7 @@
 
 #include "DecaleSquareField2D.h"
 #include <math.h>
+#include "DecaleRowKernels.h"
 
 
 DecaleSquareField2D::DecaleSquareField2D(double posx, double posy, double radius,unsigned int id, int z_index, unsigned int n)
@@ -13,10 +14,36 @@ DecaleSquareField2D::DecaleSquareField2D(double posx, double posy, double radius
 
 double DecaleSquareField2D::variableRadius (double x, double y) {
 
+    /***********************************
+    // Same normalized distance as evalRow: the radius is the distance to the center divided by
+    // max(|u.p|/(radius*scalex), |v.p|/(radius*scaley)).
+    ***********************************/
     Vector2D p(x-posx,y-posy);
-    double up = u*p*scaley;
-    double vp = v*p*scalex;
+    double du = fabs(u*p)/(radius*scalex);
+    double dv = fabs(v*p)/(radius*scaley);
 
-    if (fabs(up) >= fabs(vp)) return radius*scalex*p.norm()/fabs(p*u);
-    return radius*scaley*p.norm()/fabs(p*v);
+    if (du >= dv) return p.norm()/du;
+    return p.norm()/dv;
+}
+
+void DecaleSquareField2D::evalRow (double x, double y0, unsigned int count, double *out) {
+
+    /***********************************
+    // The normalized distance of the square (rectangle when scaled) is
+    // max(|u.p|/(radius*scalex), |v.p|/(radius*scaley)).
+    ***********************************/
+    const double px = x-posx;
+    const double ua = u.x/(radius*scalex)*px, ub = u.y/(radius*scalex);
+    const double va = v.x/(radius*scaley)*px, vb = v.y/(radius*scaley);
+
+    evalRowKernel([&](auto y) {
+        typedef decltype(y) T;
+        T py = rowSub(y, rowBroadcast<T>(posy));
+        T a = rowAdd(rowBroadcast<T>(ua), rowMul(rowBroadcast<T>(ub), py));
+        T b = rowAdd(rowBroadcast<T>(va), rowMul(rowBroadcast<T>(vb), py));
+        T d = rowMax(rowAbs(a), rowAbs(b));
+        return rowMul(d, d);
+    }, y0, count, out);
+
+    fallOffSquaredRow(out, count, n);
 }
@@ -15,6 +15,8 @@ public:
     DecaleSquareField2D (double posx, double posy, double radius, unsigned int id, int z_index, unsigned int n=2);
 
     double variableRadius (double x, double y);
+
+    void evalRow (double x, double y0, unsigned int count, double *out);
 };
 
 
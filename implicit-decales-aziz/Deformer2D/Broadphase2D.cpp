@@ -0,0 +1,69 @@
+//
+// Broadphase of the n-ary Deformers: finds which Decale buffers overlap.
+//
+
+#include "Broadphase2D.h"
+#include <algorithm>
+
+
+namespace {
+
+struct Box {
+    unsigned int index;
+    double minx, maxx;
+    double miny, maxy;
+
+    bool operator < (const Box &b) const { return minx < b.minx; }
+};
+
+}
+
+
+void Broadphase2D::overlappingFields (const VectorOfDecaleFields &fields, std::vector<VectorOfIndexes> &neighbours) {
+
+    /***********************************
+    // Buffer bounding boxes. A buffer sample of a Decale is read from (int)(x-posx+dwidth/2.) in [0, iwidth):
+    // the box is widened by one pixel on the lower side to be conservative with this truncation.
+    ***********************************/
+    std::vector<Box> boxes (fields.size());
+    for (unsigned int i=0; i<fields.size(); i++) {
+        DecaleScalarField2D *f = fields[i];
+        boxes[i].index = i;
+        boxes[i].minx = f->getPosx() - f->getDWidth()/2. - 1.;
+        boxes[i].maxx = f->getPosx() - f->getDWidth()/2. + double(f->getIWidth());
+        boxes[i].miny = f->getPosy() - f->getDHeight()/2. - 1.;
+        boxes[i].maxy = f->getPosy() - f->getDHeight()/2. + double(f->getIHeight());
+    }
+    std::sort(boxes.begin(), boxes.end());
+
+    neighbours.resize(fields.size());
+    for (unsigned int i=0; i<fields.size(); i++) {
+        neighbours[i].clear();
+        neighbours[i].push_back(i);
+    }
+
+    /***********************************
+    // Sweep along x: active holds the boxes whose x interval contains the current minx
+    ***********************************/
+    std::vector<unsigned int> active;
+    for (unsigned int b=0; b<boxes.size(); b++) {
+        const Box &box = boxes[b];
+
+        unsigned int kept = 0;
+        for (unsigned int a=0; a<active.size(); a++) {
+            const Box &other = boxes[active[a]];
+            if (other.maxx < box.minx) continue;
+            active[kept++] = active[a];
+
+            if ((other.miny <= box.maxy) && (box.miny <= other.maxy)) {
+                neighbours[box.index].push_back(other.index);
+                neighbours[other.index].push_back(box.index);
+            }
+        }
+        active.resize(kept);
+        active.push_back(b);
+    }
+
+    for (unsigned int i=0; i<neighbours.size(); i++)
+        std::sort(neighbours[i].begin(), neighbours[i].end());
+}
@@ -0,0 +1,30 @@
+//
+// Broadphase of the n-ary Deformers: finds which Decale buffers overlap.
+//
+// The bounding box of a Decale is the area covered by its field buffers. The boxes are sorted along x and swept
+// (sweep and prune): only the boxes still open along x are tested for an overlap along y.
+//
+
+#ifndef TEST_BROADPHASE2D_H
+#define TEST_BROADPHASE2D_H
+
+#include "../Decale/DecaleScalarField2D.h"
+
+typedef std::vector<unsigned int> VectorOfIndexes;
+
+
+class Broadphase2D {
+
+public:
+
+    /**
+     * For each field (by index in fields), computes the sorted indexes of the fields whose bounding box overlaps its own.
+     * The list of a field includes the field itself: a field overlapping no other field has a list of size 1.
+     * @param fields: the Decales
+     * @param neighbours: the list of overlapping fields per field
+     */
+    static void overlappingFields (const VectorOfDecaleFields &fields, std::vector<VectorOfIndexes> &neighbours);
+};
+
+
+#endif //TEST_BROADPHASE2D_H
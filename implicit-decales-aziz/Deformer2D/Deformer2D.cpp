@@ -4,12 +4,16 @@
 
 #include "Deformer2D.h"
 #include <iostream>
+#include <algorithm>
 
 
 
-Deformer2D::Deformer2D () {}
+Deformer2D::Deformer2D () : threadPool (NULL) {}
 
-Deformer2D::Deformer2D(DecaleScalarField2D *f1, unsigned int index1, DecaleScalarField2D *f2, unsigned int index2)  {
+Deformer2D::~Deformer2D () {}
+
+Deformer2D::Deformer2D(DecaleScalarField2D *f1, unsigned int index1, DecaleScalarField2D *f2, unsigned int index2)
+        : threadPool (NULL) {
 
     fields.push_back (f1);
     fields.push_back (f2);
@@ -33,41 +37,126 @@ void Deformer2D::removeLastField(){
 
 void Deformer2D::applyToDiscreteFields() {
 
-    double *discreteField;
+    std::vector<FieldBuffer *> discreteFields (fields.size());
 
-        for (int i=0; i<fields.size(); i++){
+    for (int i=0; i<fields.size(); i++)
+        discreteFields[i] = new FieldBuffer (fields[i]->getIWidth()*fields[i]->getIHeight(), fields[i]->getFieldStorage(),
+                                             fields[i]->getBufferPool());
 
-            innerIndex = i;
+    computeDiscreteFields(discreteFields);
 
-            discreteField = new double [fields[i]->getIWidth()*fields[i]->getIHeight()];
+    for (int i=0; i<fields.size(); i++)
+        fields[i]->addDiscreteField(discreteFields[i]);
+}
 
-            for (int j=0; j<fields[i]->getIWidth(); j++)
-                for (int k=0; k<fields[i]->getIHeight();k++) {
-                    discreteField[j * fields[i]->getIHeight() + k] = eval(
-                            double(j) + fields[i]->getPosx() - fields[i]->getDWidth() / 2.,
-                            double(k) + fields[i]->getPosy() - fields[i]->getDHeight() / 2.);
-                }
-            fields[i]->addDiscreteField(discreteField);
-        }
 
+void Deformer2D::applyToExistingDiscreteFields(unsigned int index) {
+
+    std::vector<FieldBuffer *> discreteFields (fields.size());
+
+    for (int i=0; i<fields.size(); i++)
+        discreteFields[i] = fields[i]->getDiscreteField(index);
+
+    computeDiscreteFields(discreteFields);
 }
 
+void Deformer2D::computeDiscreteFields (const std::vector<FieldBuffer *> &discreteFields) {
+
+    /***********************************
+    // Local Deformers: overlapping fields are found once per application
+    ***********************************/
+    prepare();
+
+    /***********************************
+    // Split the buffers into tiles of rows, the buffers of isolated fields being copied in a single task
+    ***********************************/
+    std::vector<Tile> tiles;
+    for (unsigned int i=0; i<fields.size(); i++) {
+        Tile tile;
+        tile.field = i;
+
+        if (isLocal() && (neighbours[i].size() == 1)) {
+            tile.row0 = 0;
+            tile.row1 = fields[i]->getIWidth();
+            tiles.push_back(tile);
+            continue;
+        }
+        for (unsigned int j=0; j<fields[i]->getIWidth(); j+=rowsPerTile) {
+            tile.row0 = j;
+            tile.row1 = std::min(j + rowsPerTile, fields[i]->getIWidth());
+            tiles.push_back(tile);
+        }
+    }
 
-void Deformer2D::applyToExistingDiscreteFields(unsigned int index) {
+    if (threadPool == NULL) {
+        for (unsigned int t=0; t<tiles.size(); t++) computeTile(tiles[t], discreteFields[tiles[t].field]);
+        return;
+    }
+    threadPool->parallelFor(tiles.size(), [this, &tiles, &discreteFields] (unsigned int t) {
+        computeTile(tiles[t], discreteFields[tiles[t].field]);
+    });
+}
 
-    double *discreteField;
+void Deformer2D::computeTile (const Tile &tile, FieldBuffer *discreteField) {
 
-    for (int i=0; i<fields.size(); i++){
-        innerIndex = i;
-        discreteField = fields[i]->getDiscreteField(index);
+    unsigned int i = tile.field;
 
-        for (int j=0; j<fields[i]->getIWidth(); j++)
-            for (int k=0; k<fields[i]->getIHeight();k++) {
-                discreteField[j * fields[i]->getIHeight() + k] = eval(
-                        double(j) + fields[i]->getPosx() - fields[i]->getDWidth() / 2.,
-                        double(k) + fields[i]->getPosy() - fields[i]->getDHeight() / 2.);
-            }
+    if (isLocal() && (neighbours[i].size() == 1)) {
+        discreteField->copy(*fields[i]->getDiscreteField(indexes[i]));
+        return;
     }
+
+    DeformerState state;
+    state.innerIndex = i;
+    state.fieldValues.reserve(fields.size());
+
+    for (unsigned int j=tile.row0; j<tile.row1; j++)
+        for (unsigned int k=0; k<fields[i]->getIHeight();k++) {
+            discreteField->set(j * fields[i]->getIHeight() + k, eval(
+                    double(j) + fields[i]->getPosx() - fields[i]->getDWidth() / 2.,
+                    double(k) + fields[i]->getPosy() - fields[i]->getDHeight() / 2., state));
+        }
+}
+
+void Deformer2D::prepare () {
+
+    if (isLocal()) Broadphase2D::overlappingFields(fields, neighbours);
+}
+
+double Deformer2D::evalPixel (unsigned int field, unsigned int i, unsigned int j, DeformerState &state) {
+
+    if (isLocal() && (neighbours[field].size() == 1)) return fields[field]->getDiscreteFieldValue(i, j, indexes[field]);
+
+    state.innerIndex = field;
+    return eval(double(i) + fields[field]->getPosx() - fields[field]->getDWidth() / 2.,
+                double(j) + fields[field]->getPosy() - fields[field]->getDHeight() / 2., state);
+}
+
+double Deformer2D::evalPixelPointwise (unsigned int field, unsigned int i, unsigned int j, double value, DeformerState &state) {
+
+    state.innerIndex = field;
+    return evalPointwise(double(i) + fields[field]->getPosx() - fields[field]->getDWidth() / 2.,
+                         double(j) + fields[field]->getPosy() - fields[field]->getDHeight() / 2., value, state);
+}
+
+bool Deformer2D::isPointwise () {
+
+    return false;
+}
+
+double Deformer2D::evalPointwise (double x, double y, double value, DeformerState &state) {
+
+    return eval(x, y, state);
+}
+
+void Deformer2D::setThreadPool (ThreadPool *pool) {
+
+    threadPool = pool;
+}
+
+bool Deformer2D::isLocal() {
+
+    return false;
 }
 
 double Deformer2D::evalInner(double x,double y){
@@ -75,6 +164,16 @@ double Deformer2D::evalInner(double x,double y){
     return 0.;
 }
 
+void Deformer2D::bakeEvalInner() {
 
+    std::function<double (double, double)> op = [this] (double x, double y) { return evalInner(x, y); };
+    innerTable.bake(op);
+}
 
+double Deformer2D::innerTableError (unsigned int samples) {
 
+    if (!innerTable.isBaked()) return 0.;
+
+    std::function<double (double, double)> op = [this] (double x, double y) { return evalInner(x, y); };
+    return innerTable.maxError(op, samples);
+}
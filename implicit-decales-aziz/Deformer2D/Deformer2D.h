@@ -6,8 +6,21 @@
 #define TEST_DEFORMER2D_H
 
 #include "../Decale/DecaleScalarField2D.h"
+#include "Broadphase2D.h"
+#include "../Tools/ThreadPool.h"
+#include "OperatorTable2D.h"
 
-typedef std::vector<unsigned int> VectorOfIndexes;
+/**
+ * State of an evaluation of a Deformer, owned by the caller of eval: the evaluations of a Deformer are re-entrant
+ * and the buffers of the Decales can be computed in parallel (one state per thread).
+ */
+struct DeformerState {
+
+    // Index of the deformed field (f1) in the vector of field functions
+    unsigned int innerIndex;
+    // Scratch values of the n-ary Deformers
+    std::vector<double> fieldValues;
+};
 
 /**
  * A Deformer 2D is a binary Deformer. It is however implemented to enable the definition of n-ary deformers at the condition that it can be implemented
@@ -23,6 +36,7 @@ public:
      * Creates an empty Deformer. Field functions have to be added (with @fn addField(f, index));
      */
     Deformer2D ();
+    virtual ~Deformer2D ();
 
     /**
          * Creates a Deformer deforming f1 with the interaction between two initial field functions f1 and f2.
@@ -38,9 +52,10 @@ public:
          * Virtual function defining the equation D(f1(P), fi(P)) of a specific Deformer
          * @param x: value of f1(P)
          * @param y: value of fi(P)
+         * @param state: the evaluation state, giving the index of the deformed field
          * @return: Dp = D(f1(P), fi(P))
          */
-    virtual double eval (double x, double y) = 0;
+    virtual double eval (double x, double y, DeformerState &state) = 0;
 
     /**
         * It remove a given field,
@@ -74,6 +89,58 @@ public:
          */
     void applyToExistingDiscreteFields(unsigned int index);
 
+    /**
+     * Prepares the evaluations of the Deformer for the current positions of the fields (the overlapping fields of a
+     * local Deformer). The application of the Deformer to the field buffers does it: it has to be called before
+     * evalPixel otherwise.
+     */
+    void prepare ();
+
+    /**
+     * Deformed value of the field of index field (in the vector of field functions) at the pixel (i,j) of its buffers,
+     * as stored in its field buffer by applyToExistingDiscreteFields.
+     */
+    double evalPixel (unsigned int field, unsigned int i, unsigned int j, DeformerState &state);
+
+    /**
+     * Tells if the Deformer is pointwise: the deformed value of a field at a point only depends on the value of this
+     * field at this point (in the buffer the Deformer is applied to) and on fields it does not deform (the Gamut).
+     * A pointwise Deformer can be evaluated on values that are not stored in a buffer (see evalPointwise).
+     */
+    virtual bool isPointwise ();
+
+    /**
+     * Deformed value of the field of index state.innerIndex at the point (x,y), where its value is value.
+     * Only meaningful for pointwise Deformers: the default evaluates eval (the value being read in the buffer).
+     */
+    virtual double evalPointwise (double x, double y, double value, DeformerState &state);
+
+    /**
+     * Deformed value of the field of index field at the pixel (i,j) of its buffers, where its value is value
+     * (evalPointwise at the pixel).
+     */
+    double evalPixelPointwise (unsigned int field, unsigned int i, unsigned int j, double value, DeformerState &state);
+
+    /**
+     * Tells if the Deformer is local: a field is only deformed by the fields whose buffers overlap its own
+     * and it is left unchanged when it overlaps no other field (n-ary max and contact Deformers).
+     * The field buffers of a local Deformer are only computed from the overlapping fields found by a broadphase
+     * (see neighbours), and the deformation is skipped (the field buffer is copied) for isolated fields.
+     */
+    virtual bool isLocal ();
+
+    /**
+     * Set the pool of threads on which the field buffers are computed (per Decale and per tile of rows).
+     * Without pool (NULL, the default), they are computed by the calling thread.
+     */
+    void setThreadPool (ThreadPool *pool);
+
+    /**
+     * Largest difference between the lookup table of evalInner and evalInner on a grid of samples x samples points
+     * (0 for the Deformers without table), for the accuracy tests of the tables.
+     */
+    double innerTableError (unsigned int samples = 1000);
+
 
 public:
 
@@ -83,9 +150,49 @@ public:
     VectorOfDecaleFields fields;
     VectorOfIndexes indexes;
 
-    int innerIndex;
+    /**
+     * Per field, the indexes of the fields overlapping it, itself included (only computed for local Deformers).
+     */
+    std::vector<VectorOfIndexes> neighbours;
+
+    ThreadPool *threadPool;
 
     virtual double evalInner(double x,double y);
+
+protected:
+
+    /**
+     * Lookup table of evalInner (see bakeEvalInner).
+     */
+    OperatorTable2D innerTable;
+
+    /**
+     * Samples evalInner(x, y) in innerTable, so that the binary Deformers evaluate their operator with a bilinear lookup.
+     * It has to be called by the constructors of the Deformers defining evalInner.
+     * The table is split at the iso-value 0.5 of evalInner (its accuracy is checked by the tests, see innerTableError).
+     */
+    void bakeEvalInner ();
+
+    /**
+     * Number of rows (constant x) of a field buffer computed by a task.
+     */
+    static const unsigned int rowsPerTile = 16;
+
+    /**
+     * Rows [row0, row1) of the buffer of a field. A whole buffer when it is only copied (isolated field of a local Deformer).
+     */
+    struct Tile {
+        unsigned int field;
+        unsigned int row0;
+        unsigned int row1;
+    };
+
+    /**
+     * Computes the deformed fields in the given buffers (one per field), in parallel on the pool of threads.
+     */
+    void computeDiscreteFields (const std::vector<FieldBuffer *> &discreteFields);
+
+    void computeTile (const Tile &tile, FieldBuffer *discreteField);
 };
 
 
@@ -7,18 +7,22 @@
 #include <iostream>
 
 
-Deformer2DBinaryHardContact::Deformer2DBinaryHardContact () : Deformer2D (), hardness(4) {}
+Deformer2DBinaryHardContact::Deformer2DBinaryHardContact () : Deformer2D (), hardness(4) {
+
+    bakeEvalInner();
+}
 
 Deformer2DBinaryHardContact::Deformer2DBinaryHardContact
         (DecaleScalarField2D *f1, unsigned int index1, DecaleScalarField2D *f2, unsigned int index2)
         : Deformer2D (f1, index1, f2, index2) {
 
     hardness = 4;
+    bakeEvalInner();
 }
 
 
 
-double Deformer2DBinaryHardContact::eval (double x, double y){
+double Deformer2DBinaryHardContact::eval (double x, double y, DeformerState &state){
 
     int ix0 = (int) (x - fields[0]->getPosx() + fields[0]->getDWidth() / 2.);
     int iy0 = (int) (y - fields[0]->getPosy() + fields[0]->getDHeight() / 2.);
@@ -33,6 +37,8 @@ double Deformer2DBinaryHardContact::eval (double x, double y){
     if ((ix1 >= 0) && (ix1 < fields[1]->getIWidth()) && (iy1 >= 0) && (iy1 < fields[1]->getIHeight()))
         f1 = fields[1]->getDiscreteFieldValue(ix1, iy1, indexes[1]);
 
+    if (fields[0]->getIso() == innerTable.getSplit()) return innerTable.eval(f0, f1);
+
     double t=pow(2.*f0,hardness);
 
     if ((f0<=fields[0]->getIso()) && (f1<=fields[0]->getIso())) return f1;
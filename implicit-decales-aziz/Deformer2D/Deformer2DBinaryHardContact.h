@@ -16,7 +16,7 @@ public:
 
     Deformer2DBinaryHardContact (DecaleScalarField2D *f1, unsigned int index1, DecaleScalarField2D *f2, unsigned int index2);
 
-    double eval (double x, double y);
+    double eval (double x, double y, DeformerState &state);
 
 protected:
 
@@ -10,7 +10,7 @@ Deformer2DBinaryHardContactMax::Deformer2DBinaryHardContactMax (DecaleScalarFiel
 
 
 
-double Deformer2DBinaryHardContactMax::eval (double x, double y){
+double Deformer2DBinaryHardContactMax::eval (double x, double y, DeformerState &state){
 
     int ix0 = (int) (x - fields[0]->getPosx() + fields[0]->getDWidth() / 2.);
     int iy0 = (int) (y - fields[0]->getPosy() + fields[0]->getDHeight() / 2.);
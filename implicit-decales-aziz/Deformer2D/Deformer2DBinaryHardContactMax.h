@@ -13,7 +13,7 @@ public:
 
     Deformer2DBinaryHardContactMax(DecaleScalarField2D *f1, unsigned int index1, DecaleScalarField2D *f2, unsigned int index2);
 
-    double eval(double x, double y);
+    double eval (double x, double y, DeformerState &state);
 
 };
 
@@ -13,18 +13,21 @@ Deformer2DBlendMax::Deformer2DBlendMax (DecaleScalarField2D *f1, unsigned int in
 
 
 
-double Deformer2DBlendMax::eval (double x, double y){
+double Deformer2DBlendMax::eval (double x, double y, DeformerState &state){
     double maxi=0.;
     double sum=0.;
     double value=0.;
     double valueCurrent=0.;
     double boundary = fields[0]->getIso() + fields[0]->getWidthBoundary();
 
-    for (int i=0; i<fields.size();i++){
+    const VectorOfIndexes &candidates = neighbours[state.innerIndex];
+
+    for (int c=0; c<candidates.size();c++){
+        int i = candidates[c];
         int ix = (int)(x-fields[i]->getPosx()+fields[i]->getDWidth()/2.);
         int iy = (int)(y-fields[i]->getPosy()+fields[i]->getDHeight()/2.);
 
-        if (i==innerIndex) valueCurrent = fields[innerIndex]->getDiscreteFieldValue(ix, iy, indexes[innerIndex]);
+        if (i==state.innerIndex) valueCurrent = fields[state.innerIndex]->getDiscreteFieldValue(ix, iy, indexes[state.innerIndex]);
 
         if ((ix >= 0) && (ix<fields[i]->getIWidth()) && (iy >= 0) && (iy<fields[i]->getIHeight())){
             value=fields[i]->getDiscreteFieldValue(ix, iy, indexes[i]);
@@ -56,3 +59,8 @@ double Deformer2DBlendMax::evalInner (double x, double y){
     if (value <= 0.) return 0.;
     return bound;
 }
+
+bool Deformer2DBlendMax::isLocal (){
+
+    return true;
+}
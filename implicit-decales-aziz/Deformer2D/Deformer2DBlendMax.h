@@ -16,7 +16,9 @@ public:
 
     Deformer2DBlendMax (DecaleScalarField2D *f1, unsigned int index1, DecaleScalarField2D *f2, unsigned int index2);
 
-    double eval (double x, double y);
+    double eval (double x, double y, DeformerState &state);
+
+    bool isLocal ();
 
 protected:
 
@@ -7,41 +7,62 @@
 #include <math.h>
 
 
+const double Deformer2DContact::hTableMaxT = 0.95;
+
+/***********************************
+// h(s,t) = 1 - w^(1/(1-t)) with w = (s+t-1)/(2t-1) in [0,1] (s+t >= 1 and s <= t)
+***********************************/
+static double hOfW (double w, double t){
+
+    if (t <= 0.5) return 1.;
+    return 1. - pow (w,1./(1.-t));
+}
+
+
 //Deformer2DMax::Deformer2DMax (VectorOfDecaleFields fs) : Deformer2D (fs) {}
 
-Deformer2DContact::Deformer2DContact () : Deformer2D () {}
+Deformer2DContact::Deformer2DContact () : Deformer2D () {
+
+    hTable.bake(hOfW);
+}
 
 Deformer2DContact::Deformer2DContact (DecaleScalarField2D *f1, unsigned int index1, DecaleScalarField2D *f2, unsigned int index2)
-        : Deformer2D (f1, index1, f2, index2) {}
+        : Deformer2D (f1, index1, f2, index2) {
 
+    hTable.bake(hOfW);
+}
 
 
-double Deformer2DContact::eval (double x, double y){
+
+double Deformer2DContact::eval (double x, double y, DeformerState &state){
 
     double maxi=0.;
     double value=0.;
     double valueCurrent=0.;
-    fieldValues.clear();
+    state.fieldValues.clear();
+
+    const VectorOfIndexes &candidates = neighbours[state.innerIndex];
 
-    for (int i=0; i<fields.size();i++){
+    for (int c=0; c<candidates.size();c++){
+        int i = candidates[c];
         int ix = (int)(x-fields[i]->getPosx()+fields[i]->getDWidth()/2.);
         int iy = (int)(y-fields[i]->getPosy()+fields[i]->getDHeight()/2.);
 
-        if (i==innerIndex) valueCurrent = fields[innerIndex]->getDiscreteFieldValue(ix, iy, indexes[innerIndex]);
+        if (i==state.innerIndex) valueCurrent = fields[state.innerIndex]->getDiscreteFieldValue(ix, iy, indexes[state.innerIndex]);
 
         if ((ix >= 0) && (ix<fields[i]->getIWidth()) && (iy >= 0) && (iy<fields[i]->getIHeight())){
             value=fields[i]->getDiscreteFieldValue(ix, iy, indexes[i]);
             if (value>maxi){
-                fieldValues.push_back(maxi);
+                state.fieldValues.push_back(maxi);
                 maxi=value;
             }
             else
-                fieldValues.push_back(value);
+                state.fieldValues.push_back(value);
         }
     }
     double prodFi=1.;
-    for (int i=0; i<fieldValues.size(); i++)
-        prodFi = prodFi*h(fieldValues[i],maxi);
+    for (int i=0; i<state.fieldValues.size(); i++)
+        prodFi = prodFi*h(state.fieldValues[i],maxi);
 
     if (maxi == valueCurrent) return 0.5 + (maxi-0.5)*prodFi;
     if ((valueCurrent <= 0.5)&&(maxi <= 0.5)) return valueCurrent;
@@ -61,6 +82,16 @@ double Deformer2DContact::evalInner (double x, double y){
 
 double Deformer2DContact::h (double s, double t){
 
-    if (s+t >= 1.) return 1. - pow ((s+t-1.)/(2.*t-1.),1./(1.-t));
-    return 1.;
-}
\ No newline at end of file
+    if (s+t < 1.) return 1.;
+
+    /***********************************
+    // The exponent 1/(1-t) makes h too steep to be tabulated when t gets close to 1
+    ***********************************/
+    if (t <= hTableMaxT) return hTable.eval((s+t-1.)/(2.*t-1.), t);
+    return 1. - pow ((s+t-1.)/(2.*t-1.),1./(1.-t));
+}
+
+bool Deformer2DContact::isLocal (){
+
+    return true;
+}
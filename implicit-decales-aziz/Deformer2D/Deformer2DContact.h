@@ -16,11 +16,17 @@ public:
 
     Deformer2DContact (DecaleScalarField2D *f1, unsigned int index1, DecaleScalarField2D *f2, unsigned int index2);
 
-    double eval (double x, double y);
+    double eval (double x, double y, DeformerState &state);
+
+    bool isLocal ();
 
 private:
 
-    std::vector<double>fieldValues;
+    /**
+     * Lookup table of 1 - w^(1/(1-t)) in (w, t), w = (s+t-1)/(2t-1), used by h for t <= hTableMaxT
+     */
+    OperatorTable2D hTable;
+    static const double hTableMaxT;
 
     double h (double s, double t);
 
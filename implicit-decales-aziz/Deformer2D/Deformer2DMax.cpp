@@ -13,16 +13,19 @@ Deformer2DMax::Deformer2DMax (DecaleScalarField2D *f1, unsigned int index1, Deca
 
 
 
-double Deformer2DMax::eval (double x, double y){
+double Deformer2DMax::eval (double x, double y, DeformerState &state){
     double maxi=0.;
     double value=0.;
     double valueCurrent=0.;
 
-    for (int i=0; i<fields.size();i++){
+    const VectorOfIndexes &candidates = neighbours[state.innerIndex];
+
+    for (int c=0; c<candidates.size();c++){
+        int i = candidates[c];
         int ix = (int)(x-fields[i]->getPosx()+fields[i]->getDWidth()/2.);
         int iy = (int)(y-fields[i]->getPosy()+fields[i]->getDHeight()/2.);
 
-        if (i==innerIndex) valueCurrent = fields[innerIndex]->getDiscreteFieldValue(ix, iy, indexes[innerIndex]);
+        if (i==state.innerIndex) valueCurrent = fields[state.innerIndex]->getDiscreteFieldValue(ix, iy, indexes[state.innerIndex]);
 
         if ((ix >= 0) && (ix<fields[i]->getIWidth()) && (iy >= 0) && (iy<fields[i]->getIHeight())){
             value=fields[i]->getDiscreteFieldValue(ix, iy, indexes[i]);
@@ -46,3 +49,8 @@ double Deformer2DMax::evalInner (double x, double y){
     if (value > 0.) return value;
     return 0.;
 }
+
+bool Deformer2DMax::isLocal (){
+
+    return true;
+}
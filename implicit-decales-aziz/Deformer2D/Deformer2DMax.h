@@ -15,7 +15,9 @@ public:
     //Deformer2DMax (VectorOfDecaleFields fs);
     Deformer2DMax (DecaleScalarField2D *f1, unsigned int index1, DecaleScalarField2D *f2, unsigned int index2);
 
-    double eval (double x, double y);
+    double eval (double x, double y, DeformerState &state);
+
+    bool isLocal ();
 
 protected:
 
@@ -0,0 +1,141 @@
+//
+// Fused drawing pipeline of the Decales: deformation, (u,v) parameterization and texture fetch per tile of pixels.
+//
+
+#include "DeformerPipeline2D.h"
+#include <algorithm>
+
+
+DeformerPipeline2D::DeformerPipeline2D () : threadPool (NULL), storeBuffers (false) {}
+
+void DeformerPipeline2D::setDecales (VectorOfDecaleFields decales) {
+
+    this->decales = decales;
+}
+
+void DeformerPipeline2D::setDeformers (VectorOfDeformers deformers) {
+
+    this->deformers = deformers;
+}
+
+void DeformerPipeline2D::setThreadPool (ThreadPool *pool) {
+
+    threadPool = pool;
+}
+
+void DeformerPipeline2D::setStoreBuffers (bool store) {
+
+    storeBuffers = store;
+}
+
+bool DeformerPipeline2D::isFusable () {
+
+    for (unsigned int d=0; d<deformers.size(); d++) {
+        if ((d > 0) && !deformers[d]->isPointwise()) return false;
+        for (unsigned int f=0; f<deformers[d]->indexes.size(); f++)
+            if (deformers[d]->indexes[f] != d) return false;
+    }
+
+    /***********************************
+    // The stored buffers have to exist (computed once with applyToDiscreteFields)
+    ***********************************/
+    if (storeBuffers)
+        for (unsigned int k=0; k<decales.size(); k++)
+            if (decales[k]->getNbDiscreteFields() <= deformers.size()) return false;
+
+    return true;
+}
+
+void DeformerPipeline2D::prepare () {
+
+    fieldIndexes.assign(deformers.size(), std::vector<int> (decales.size(), -1));
+
+    for (unsigned int d=0; d<deformers.size(); d++) {
+        deformers[d]->prepare();
+
+        for (unsigned int k=0; k<decales.size(); k++) {
+            VectorOfDecaleFields &fields = deformers[d]->fields;
+            VectorOfDecaleFields::iterator it = std::find(fields.begin(), fields.end(), decales[k]);
+            if (it != fields.end()) fieldIndexes[d][k] = it - fields.begin();
+        }
+    }
+}
+
+void DeformerPipeline2D::draw (ColorImage *image, const VectorOfColorImages &decaleImages, const QRect &clip) {
+
+    image->detach();
+
+    /***********************************
+    // Decales drawn one after the other (the last one is on top), their tiles in parallel
+    ***********************************/
+    for (unsigned int k=0; k<decales.size(); k++) {
+        int x0, x1, y0, y1;
+        if (!image->decaleRows(decales[k], clip, x0, x1, y0, y1)) continue;
+
+        std::vector<Tile> tiles;
+        for (int y=y0; y<y1; y+=tileSize)
+            for (int x=x0; x<x1; x+=tileSize) {
+                Tile tile;
+                tile.x0 = x;
+                tile.x1 = std::min(x + tileSize, x1);
+                tile.y0 = y;
+                tile.y1 = std::min(y + tileSize, y1);
+                tiles.push_back(tile);
+            }
+
+        if (threadPool == NULL) {
+            for (unsigned int t=0; t<tiles.size(); t++) drawTile(k, tiles[t], image, decaleImages[k]);
+            continue;
+        }
+        threadPool->parallelFor(tiles.size(), [this, k, &tiles, image, &decaleImages] (unsigned int t) {
+            drawTile(k, tiles[t], image, decaleImages[k]);
+        });
+    }
+}
+
+void DeformerPipeline2D::drawTile (unsigned int k, const Tile &tile, ColorImage *image, ColorImage *decaleImage) {
+
+    DecaleScalarField2D *decale = decales[k];
+    int cornerx = (int)decale->getCornerX();
+    int cornery = (int)decale->getCornerY();
+    int iwidth = (int)decale->getIWidth();
+    int iheight = (int)decale->getIHeight();
+
+    DeformerState state;
+
+    /***********************************
+    // (u,v) of the pixels of the tile, with the next column and row for the footprints of the texture fetch.
+    // Along the columns of the tile, which are contiguous in the Decale buffers.
+    ***********************************/
+    int stride = tile.x1 - tile.x0 + 1;
+    std::vector<Vector2D> uvs (stride * (tile.y1 - tile.y0 + 1));
+
+    for (int x=tile.x0; x<=tile.x1; x++)
+        for (int y=tile.y0; y<=tile.y1; y++) {
+            Vector2D &uv = uvs[(y - tile.y0) * stride + (x - tile.x0)];
+            int i = x - cornerx;
+            int j = y - cornery;
+            if ((i >= iwidth) || (j >= iheight)) {
+                uv = Vector2D(-1., -1.);
+                continue;
+            }
+            bool stored = storeBuffers && (x < tile.x1) && (y < tile.y1);
+
+            /***********************************
+            // Chain of Deformers, from the rest-pose field
+            ***********************************/
+            double value = decale->getDiscreteFieldValue(i, j, 0);
+            for (unsigned int d=0; d<deformers.size(); d++) {
+                int f = fieldIndexes[d][k];
+                if (f >= 0)
+                    value = (d == 0) ? deformers[d]->evalPixel(f, i, j, state)
+                                     : deformers[d]->evalPixelPointwise(f, i, j, value, state);
+                if (stored) decale->getDiscreteField(d + 1)->set(i * iheight + j, value);
+            }
+
+            uv = decale->evalUV(i, j, value);
+            if (stored) decale->setUV(i, j, uv);
+        }
+
+    image->addColorImageWithUV(decaleImage, tile.x0, tile.x1, tile.y0, tile.y1, uvs.data(), stride);
+}
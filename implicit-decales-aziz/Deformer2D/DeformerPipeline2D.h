@@ -0,0 +1,89 @@
+//
+// Fused drawing pipeline of the Decales: deformation, (u,v) parameterization and texture fetch per tile of pixels.
+//
+// Applied one after the other, the Deformers each write a whole field buffer per Decale, the UV buffer is written from the
+// last one and read back to draw the Decale images. The pipeline instead evaluates, per pixel of a tile, the chain of
+// Deformers (the first one from the rest-pose field buffers, the following ones being pointwise), the (u,v) of the
+// deformed value and the texel, while the tile is in cache. The deformed field buffers and the UV buffers are only
+// written if they are asked for (setStoreBuffers).
+//
+
+#ifndef TEST_DEFORMERPIPELINE2D_H
+#define TEST_DEFORMERPIPELINE2D_H
+
+#include "Deformer2D.h"
+#include "../Tools/ColorImage.h"
+#include "../Tools/ThreadPool.h"
+#include <QRect>
+
+
+class DeformerPipeline2D {
+
+public:
+
+    DeformerPipeline2D ();
+
+    void setDecales (VectorOfDecaleFields decales);
+    void setDeformers (VectorOfDeformers deformers);
+
+    /**
+     * Set the pool of threads on which the tiles are computed (NULL, the default, for the calling thread)
+     */
+    void setThreadPool (ThreadPool *pool);
+
+    /**
+     * Also store the deformed fields and the (u,v) of the drawn pixels in the Decale buffers (false by default).
+     * The Deformer d stores in the field buffers of index d+1, as applyToExistingDiscreteFields(d+1).
+     */
+    void setStoreBuffers (bool store);
+
+    /**
+     * Tells if the Deformers can be fused: the first one is applied to the rest-pose field buffers (index 0), and
+     * each following Deformer d is pointwise and applied to the result of the previous one (index d).
+     * Otherwise the Deformers have to be applied to the field buffers.
+     */
+    bool isFusable ();
+
+    /**
+     * Prepares the Deformers for the current positions of the Decales.
+     * Has to be called once the rest-pose field buffers are updated, before drawing.
+     */
+    void prepare ();
+
+    /**
+     * Draw the Decale images (decaleImages[i] for the Decale i, in the order of the Decales) in the rectangle clip of image
+     */
+    void draw (ColorImage *image, const VectorOfColorImages &decaleImages, const QRect &clip);
+
+private:
+
+    /**
+     * Size (in pixels) of the side of the tiles
+     */
+    static const int tileSize = 32;
+
+    /**
+     * Pixels [x0,x1)x[y0,y1) of the image drawn by a Decale
+     */
+    struct Tile {
+        int x0;
+        int x1;
+        int y0;
+        int y1;
+    };
+
+    void drawTile (unsigned int decale, const Tile &tile, ColorImage *image, ColorImage *decaleImage);
+
+    VectorOfDecaleFields decales;
+    VectorOfDeformers deformers;
+    ThreadPool *threadPool;
+    bool storeBuffers;
+
+    /**
+     * Per Deformer and per Decale, the index of the Decale in the fields of the Deformer (-1 if it does not deform it)
+     */
+    std::vector<std::vector<int>> fieldIndexes;
+};
+
+
+#endif //TEST_DEFORMERPIPELINE2D_H
@@ -0,0 +1,58 @@
+//
+// Lookup table of a composition operator g(x, y) of two field values x, y in [0,1].
+//
+
+#include "OperatorTable2D.h"
+#include <math.h>
+
+
+OperatorTable2D::OperatorTable2D () : cells (0), stride (0), split (0.5) {
+
+    origin[0] = origin[1] = 0.;
+    invCell[0] = invCell[1] = 0.;
+}
+
+void OperatorTable2D::bake (const std::function<double (double, double)> &op, unsigned int resolution, double split) {
+
+    this->split = split;
+    cells = (resolution < 4) ? 2 : resolution / 2;
+    stride = cells + 1;
+
+    origin[0] = 0.;
+    origin[1] = split;
+    invCell[0] = double(cells) / split;
+    invCell[1] = double(cells) / (1. - split);
+
+    /***********************************
+    // The samples on the split lines are taken slightly inside their quadrant (one-sided limits)
+    ***********************************/
+    const double inside = 1e-9;
+
+    samples.resize(4 * stride * stride);
+    for (unsigned int qy=0; qy<2; qy++)
+        for (unsigned int qx=0; qx<2; qx++)
+            for (unsigned int j=0; j<stride; j++)
+                for (unsigned int i=0; i<stride; i++) {
+                    double x = origin[qx] + double(i) / invCell[qx];
+                    double y = origin[qy] + double(j) / invCell[qy];
+                    if ((qx == 0) && (i == cells)) x -= inside;
+                    if ((qx == 1) && (i == 0)) x += inside;
+                    if ((qy == 0) && (j == cells)) y -= inside;
+                    if ((qy == 1) && (j == 0)) y += inside;
+
+                    samples[(qy * 2 + qx) * stride * stride + j * stride + i] = float(op(x, y));
+                }
+}
+
+double OperatorTable2D::maxError (const std::function<double (double, double)> &op, unsigned int samples) const {
+
+    double error = 0.;
+    for (unsigned int j=0; j<samples; j++)
+        for (unsigned int i=0; i<samples; i++) {
+            double x = (double(i) + 0.5) / double(samples);
+            double y = (double(j) + 0.5) / double(samples);
+            double e = fabs(eval(x, y) - op(x, y));
+            if (e > error) error = e;
+        }
+    return error;
+}
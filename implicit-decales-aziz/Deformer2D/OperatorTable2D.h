@@ -0,0 +1,92 @@
+//
+// Lookup table of a composition operator g(x, y) of two field values x, y in [0,1].
+//
+// The operator is sampled once and then evaluated by a bilinear interpolation of the samples.
+// The composition operators have branches on the iso-value (x <= iso, y <= iso), on which they are discontinuous:
+// the table is made of four quadrant tables split at the iso-value, each one sampled on its closed quadrant
+// with the one-sided limits of the operator, so that no interpolation is done across the discontinuities.
+//
+
+#ifndef TEST_OPERATORTABLE2D_H
+#define TEST_OPERATORTABLE2D_H
+
+#include <vector>
+#include <functional>
+
+
+class OperatorTable2D {
+
+public:
+
+    /**
+     * Creates an empty table (to be baked before any evaluation).
+     */
+    OperatorTable2D ();
+
+    /**
+     * Samples an operator.
+     * @param op: the operator g(x, y), x and y in [0,1]
+     * @param resolution: number of cells per axis (half of them in each quadrant)
+     * @param split: the value of x and y on which the operator branches (the iso-value)
+     */
+    void bake (const std::function<double (double, double)> &op, unsigned int resolution = 256, double split = 0.5);
+
+    /**
+     * @return true if the table has been baked
+     */
+    bool isBaked () const { return !samples.empty(); }
+
+    double getSplit () const { return split; }
+
+    /**
+     * Bilinear interpolation of the samples, x and y being clamped to [0,1] (NaN to 0).
+     * The quadrants are chosen as x <= split and y <= split for the lower ones.
+     */
+    inline double eval (double x, double y) const {
+
+        if (!(x > 0.)) x = 0.;
+        if (x > 1.) x = 1.;
+        if (!(y > 0.)) y = 0.;
+        if (y > 1.) y = 1.;
+
+        unsigned int qx = (x > split) ? 1 : 0;
+        unsigned int qy = (y > split) ? 1 : 0;
+
+        double u = (x - origin[qx]) * invCell[qx];
+        double v = (y - origin[qy]) * invCell[qy];
+        unsigned int i = (unsigned int) u;
+        unsigned int j = (unsigned int) v;
+        if (i >= cells) i = cells - 1;
+        if (j >= cells) j = cells - 1;
+        u -= double(i);
+        v -= double(j);
+
+        const float *s = &samples[(qy * 2 + qx) * stride * stride + j * stride + i];
+        double s0 = s[0] + u * (s[1] - s[0]);
+        double s1 = s[stride] + u * (s[stride + 1] - s[stride]);
+        return s0 + v * (s1 - s0);
+    }
+
+    /**
+     * Largest difference between the table and the operator on a regular grid of samples x samples points
+     * (cell centers of a grid not aligned with the table), for the tolerance checks.
+     */
+    double maxError (const std::function<double (double, double)> &op, unsigned int samples = 1000) const;
+
+private:
+
+    // Number of cells per axis of a quadrant, and of samples per row of a quadrant (cells + 1)
+    unsigned int cells;
+    unsigned int stride;
+
+    double split;
+    // Per half axis (lower, upper): value of the first sample and inverse of the cell size
+    double origin[2];
+    double invCell[2];
+
+    // The four quadrants (lower-lower, upper-lower, lower-upper, upper-upper in x then y), row major in y
+    std::vector<float> samples;
+};
+
+
+#endif //TEST_OPERATORTABLE2D_H
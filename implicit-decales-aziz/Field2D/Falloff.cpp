@@ -0,0 +1,47 @@
+//
+// Compile-time specialized falloff functions of Field2D.
+//
+
+#include "Falloff.h"
+#include <math.h>
+
+
+InvFalloffTable::InvFalloffTable (unsigned int n) {
+
+    for (unsigned int k=0; k<=size; k++)
+        values[k] = 1.-pow(double(k)/double(size),1./(double(n)));
+}
+
+
+double FalloffGeneric::eval (double normalizedField, unsigned int n) {
+
+    if (normalizedField>=1.) return 0.;
+    if (normalizedField<=0.) return 1.;
+
+    double base = 1.-normalizedField*normalizedField;
+    double f = 1.;
+    for (unsigned int e=n; e>0; e>>=1) {
+        if (e & 1u) f *= base;
+        base *= base;
+    }
+    return f;
+}
+
+double FalloffGeneric::inverse (double valFallOff, unsigned int n) {
+
+    return sqrt(1.-pow(valFallOff,1./(double(n))));
+}
+
+
+void selectFalloff (unsigned int n, FalloffFunction &fallOff, FalloffFunction &invFallOff) {
+
+    switch (n) {
+        case 1: fallOff = Falloff<1>::eval; invFallOff = Falloff<1>::inverse; break;
+        case 2: fallOff = Falloff<2>::eval; invFallOff = Falloff<2>::inverse; break;
+        case 3: fallOff = Falloff<3>::eval; invFallOff = Falloff<3>::inverse; break;
+        case 4: fallOff = Falloff<4>::eval; invFallOff = Falloff<4>::inverse; break;
+        case 6: fallOff = Falloff<6>::eval; invFallOff = Falloff<6>::inverse; break;
+        case 8: fallOff = Falloff<8>::eval; invFallOff = Falloff<8>::inverse; break;
+        default: fallOff = FalloffGeneric::eval; invFallOff = FalloffGeneric::inverse; break;
+    }
+}
@@ -0,0 +1,104 @@
+//
+// Compile-time specialized falloff functions of Field2D.
+//
+// f(d) = ( 1 - d^2 )^n for a normalized distance d in [0,1] (1 for d <= 0, 0 for d >= 1)
+// inverse: d(f) = sqrt( 1 - f^(1/n) )
+//
+// Falloff<N> computes f with an exponentiation by squaring unrolled at compile time, and its inverse from a table
+// of d^2 = 1 - f^(1/n) precomputed once per N (linear interpolation between the samples, then one sqrt).
+// d^2 is tabulated rather than d since it stays smooth near f = 1 (the primitive center).
+// FalloffGeneric is the fallback for any n (exponentiation by squaring in a loop and pow for the inverse).
+// Field2D selects its functions once at construction with selectFalloff (see below).
+//
+
+#ifndef TEST_FALLOFF_H
+#define TEST_FALLOFF_H
+
+#include <math.h>
+
+
+/**
+ * base^N by squaring, unrolled at compile time.
+ */
+template <unsigned int N>
+struct FalloffPower {
+    static constexpr double eval (double base) {
+        return ((N & 1u) ? base : 1.) * FalloffPower<N/2>::eval(base*base);
+    }
+};
+
+template <>
+struct FalloffPower<0> {
+    static constexpr double eval (double) { return 1.; }
+};
+
+
+/**
+ * Table of the squared inverse falloff function sampled over [0,1].
+ */
+class InvFalloffTable {
+
+public:
+
+    explicit InvFalloffTable (unsigned int n);
+
+    /**
+     * @param valFallOff: a falloff value (clamped to [0,1])
+     * @return the normalized distance d such that f(d) = valFallOff
+     */
+    double eval (double valFallOff) const {
+
+        if (valFallOff <= 0.) return 1.;
+        if (valFallOff >= 1.) return 0.;
+        double t = valFallOff * double(size);
+        unsigned int k = (unsigned int) t;
+        t -= double(k);
+        return sqrt(values[k] + t * (values[k+1] - values[k]));
+    }
+
+private:
+
+    static const unsigned int size = 1024;
+    double values[size+1];
+};
+
+
+typedef double (*FalloffFunction) (double value, unsigned int n);
+
+/**
+ * Falloff of constant power N. The parameter n of the functions is ignored (it equals N).
+ */
+template <unsigned int N>
+struct Falloff {
+
+    static double eval (double normalizedField, unsigned int) {
+
+        if (normalizedField>=1.) return 0.;
+        if (normalizedField>0.) return FalloffPower<N>::eval(1.-normalizedField*normalizedField);
+        return 1.;
+    }
+
+    static double inverse (double valFallOff, unsigned int) {
+
+        static const InvFalloffTable table (N);
+        return table.eval(valFallOff);
+    }
+};
+
+/**
+ * Falloff of any power n
+ */
+struct FalloffGeneric {
+
+    static double eval (double normalizedField, unsigned int n);
+
+    static double inverse (double valFallOff, unsigned int n);
+};
+
+/**
+ * Select the falloff function and its inverse for the power n: a specialized Falloff<N> when available,
+ * FalloffGeneric otherwise.
+ */
+void selectFalloff (unsigned int n, FalloffFunction &fallOff, FalloffFunction &invFallOff);
+
+#endif //TEST_FALLOFF_H
@@ -7,6 +7,7 @@
 
 Field2D::Field2D (): size (1.), n(2), iso(0.5) {
 
+    selectFalloff(n, fallOffFunction, invFallOffFunction);
     invAtIso = invFallOff(iso);
     radius = size / invAtIso;
 }
@@ -14,10 +15,13 @@ Field2D::Field2D (): size (1.), n(2), iso(0.5) {
 Field2D::Field2D (double size, unsigned int n)
         : size(size), n(n), iso(0.5) {
 
+    selectFalloff(n, fallOffFunction, invFallOffFunction);
     invAtIso = invFallOff(iso);
     radius = size / invAtIso;
 }
 
+Field2D::~Field2D () {}
+
 
 double Field2D::normalizeField (double distanceFieldValue){
 
@@ -26,14 +30,12 @@ double Field2D::normalizeField (double distanceFieldValue){
 
 double Field2D::fallOff (double normalizedField){
 
-    if (normalizedField>=1.) return 0.;
-    if (normalizedField>0.) return pow(1-normalizedField*normalizedField,n);
-    return 1.;
+    return fallOffFunction(normalizedField, n);
 }
 
 double Field2D::invFallOff (double valFallOff){
 
-    return sqrt(1.-pow(valFallOff,1./(double(n))));
+    return invFallOffFunction(valFallOff, n);
 }
 
 void Field2D::setSize(double value)
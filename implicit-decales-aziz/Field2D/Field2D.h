@@ -10,12 +10,14 @@
 // The evaluation of f is done in two steps:
 // Step 1: Normalize the distance field: computes nf = d/radius
 // Step 2: Apply the falloff function to the normalized field: computes f = (1-nf)^n
+// The falloff function and its inverse are selected once at construction from n (see Falloff.h).
 
 
 #ifndef TEST_FIELD2D_H
 #define TEST_FIELD2D_H
 
 #include <vector>
+#include "Falloff.h"
 
 
 class Field2D {
@@ -27,6 +29,7 @@ public:
     // size is the size of the primitive (see below)
     // n controls the slope of the falloff function (see below)
     Field2D (double size, unsigned int n);
+    virtual ~Field2D ();
 
     // Field evaluation at any position (x,y) => to be defined by type of Field Function
     // example of a bounded circle of center (0,0) and radius r => size = r and the eval function is written as:
@@ -81,6 +84,10 @@ protected:
     // Parameter controlling the slope of the falloff function.
     // The larger n, the steeper the slope of f.
     unsigned int n;
+
+    // Falloff function and its inverse specialized for n
+    FalloffFunction fallOffFunction;
+    FalloffFunction invFallOffFunction;
 };
 
 typedef std::vector <Field2D *> VectorOfFields;
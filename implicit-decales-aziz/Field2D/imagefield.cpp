@@ -1,8 +1,58 @@
 #include "imagefield.h"
 #include <iostream>
+#include <math.h>
+#include <algorithm>
 
-ImageField::ImageField(const QString &filename)
-{ 
+// Squared distance of the pixels without site
+static const double farAway = 1e20;
+
+// Number of columns (or rows) transformed by a task
+static const unsigned int linesPerTask = 16;
+
+/***********************************
+// 1D squared distance transform of f (n samples): d[q] = min_p (q-p)^2 + f[p]
+// Lower envelope of the parabolas rooted at the sites (f < farAway), Felzenszwalb and Huttenlocher.
+// v (n) and z (n+1) are scratch arrays.
+***********************************/
+static void distanceTransform1D (const double *f, int n, double *d, int *v, double *z)
+{
+    int k = -1;
+    for (int q = 0; q < n; q++) {
+        if (f[q] >= farAway) continue;
+        if (k < 0) {
+            k = 0;
+            v[0] = q;
+            z[0] = -farAway;
+            z[1] = farAway;
+            continue;
+        }
+        double s = ((f[q] + double(q)*q) - (f[v[k]] + double(v[k])*v[k])) / (2.*(q - v[k]));
+        while (s <= z[k]) {
+            k--;
+            s = ((f[q] + double(q)*q) - (f[v[k]] + double(v[k])*v[k])) / (2.*(q - v[k]));
+        }
+        k++;
+        v[k] = q;
+        z[k] = s;
+        z[k+1] = farAway;
+    }
+
+    if (k < 0) {
+        for (int q = 0; q < n; q++) d[q] = farAway;
+        return;
+    }
+
+    k = 0;
+    for (int q = 0; q < n; q++) {
+        while (z[k+1] < q) k++;
+        d[q] = double(q - v[k])*(q - v[k]) + f[v[k]];
+    }
+}
+
+ImageField::ImageField(const QString &filename, ThreadPool *pool, const QString &cacheFile)
+    : distances(NULL), width(0), height(0), maskKey(0), threadPool(pool), d(0), dn(0)
+{
+    cache.setFileName(cacheFile.toStdString());
     img_src.load(filename);
     calculateDistnaceField();
 }
@@ -11,101 +61,120 @@ double ImageField::eval(double x, double y)
 {
     //return signed distance to the gamut: distance field
     //std::cout<<"x: "<<x<<std::endl;
-    return m[x][y];
+    return distances[size_t(x)*height + size_t(y)];
 }
 
-bool ImageField::isInsideTheImage(int i,int j, int w, int h){
-    return i>=0 and i<w &&  j>=0 and j<h;
+uint64_t ImageField::getMaskKey()
+{
+    return maskKey;
 }
 
-void ImageField::calculateDistnaceField()
+void ImageField::squaredDistanceTransform(std::vector<double> &grid)
 {
-    m.resize(size_t(img_src.width()), std::vector<int>(size_t(img_src.height())));
-
-    for(size_t i = 0; i <m.size(); i++){
-        for(size_t j = 0; j<m[0].size(); j++){
-            QColor col = img_src.pixelColor(static_cast<int>(i),static_cast<int>(j));
-            //set initial values when loading a binary image
-            if(col == QColor(Qt::black)){
-               m[i][j] = 0;//black - window area - inside gamut
-            }else{
-               m[i][j] = -1;//white - not projected area - outside of gamut
-            }
+    unsigned int nbColumnTasks = (width + linesPerTask - 1) / linesPerTask;
+    unsigned int nbRowTasks = (height + linesPerTask - 1) / linesPerTask;
+
+    /***********************************
+    // Along the columns (contiguous), then along the rows (stride height), each task with its own scratch arrays
+    ***********************************/
+    auto columns = [this, &grid] (unsigned int t) {
+        int n = height;
+        std::vector<double> f(n), z(n+1);
+        std::vector<int> v(n);
+        for (int i = t*linesPerTask; i < std::min(int((t+1)*linesPerTask), width); i++) {
+            std::copy(grid.begin() + size_t(i)*height, grid.begin() + size_t(i+1)*height, f.begin());
+            distanceTransform1D(f.data(), n, &grid[size_t(i)*height], v.data(), z.data());
+        }
+    };
+    auto rows = [this, &grid] (unsigned int t) {
+        int n = width;
+        std::vector<double> f(n), dist(n), z(n+1);
+        std::vector<int> v(n);
+        for (int j = t*linesPerTask; j < std::min(int((t+1)*linesPerTask), height); j++) {
+            for (int i = 0; i < n; i++) f[i] = grid[size_t(i)*height + j];
+            distanceTransform1D(f.data(), n, dist.data(), v.data(), z.data());
+            for (int i = 0; i < n; i++) grid[size_t(i)*height + j] = dist[i];
         }
+    };
+
+    if (threadPool == NULL) {
+        for (unsigned int t = 0; t < nbColumnTasks; t++) columns(t);
+        for (unsigned int t = 0; t < nbRowTasks; t++) rows(t);
+        return;
     }
+    threadPool->parallelFor(nbColumnTasks, columns);
+    threadPool->parallelFor(nbRowTasks, rows);
+}
 
+void ImageField::calculateDistnaceField()
+{
+    width = img_src.width();
+    height = img_src.height();
 
-    //--------------------------------------------------positive side
-    d = 1;//iso value - level
-
-    //Manipulate with an image(black - projection)
-    //adding pixels that are inside the shape(with value 0) to a stack "coord"
-    for(size_t i = 0; i <m.size(); i++){
-        for(size_t j = 0; j<m[0].size(); j++){
-            if(m[i][j] == 0){
-                pixel_coord.push({int(i),int(j)});
-            }
-        }
+    /***********************************
+    // Read the mask by scanlines: black - window area - inside gamut, other - not projected area - outside of gamut
+    ***********************************/
+    QImage mask = img_src.convertToFormat(QImage::Format_ARGB32);
+    std::vector<unsigned char> inside(size_t(width)*height);
+    maskKey = FieldCache::hash(&width, sizeof(width));
+    maskKey = FieldCache::hash(&height, sizeof(height), maskKey);
+    for (int j = 0; j < height; j++) {
+        const QRgb *line = reinterpret_cast<const QRgb *>(mask.constScanLine(j));
+        maskKey = FieldCache::hash(line, size_t(width)*sizeof(QRgb), maskKey);
+        for (int i = 0; i < width; i++)
+            inside[size_t(i)*height + j] = (line[i] == 0xff000000u) ? 1 : 0;
     }
-    //saving initial number of pixels with value of '0'
-    size_t currentLevelSize = pixel_coord.size();
-
-    while(pixel_coord.size() != 0){
-        auto &currentCoord = pixel_coord.front();
-        for(int i = currentCoord.x() - 1; i <= currentCoord.x() + 1; i++){
-            for(int j = currentCoord.y() - 1; j<= currentCoord.y() + 1 ; j++){
-                if(isInsideTheImage(int(i),int(j), m.size(), m[0].size()) and m[i][j]==-1){
-                      m[i][j] = d;
-                      pixel_coord.push({int(i), int(j)}); //pushing new level of neighbours
-                }
-            }
-        }
-        //remove 1st coord with value of 0
-        pixel_coord.pop();
-        currentLevelSize--;
-
-        //next level:
-        if(currentLevelSize == 0){
-            currentLevelSize = pixel_coord.size();
-            d++;
-        }
+
+    /***********************************
+    // Distance field of the same mask computed by a previous run
+    // The cached buffer is d, dn (as floats) then the distances, so that the mapped distances are not read before
+    // being used
+    ***********************************/
+    size_t bytes = (2 + size_t(width)*height)*sizeof(float);
+    const float *mapped = (const float *) cache.map(maskKey, bytes);
+    if (mapped != NULL) {
+        d = int(mapped[0]);
+        dn = int(mapped[1]);
+        distances = mapped + 2;
+        return;
     }
 
+    computeDistances(inside);
+    distances = distanceGrid.data() + 2;
+    cache.store(maskKey, distanceGrid.data(), bytes);
+}
+
+void ImageField::computeDistances(const std::vector<unsigned char> &inside)
+{
+    distanceGrid.assign(2 + size_t(width)*height, 0.f);
+    float *distance = distanceGrid.data() + 2;
+
+    std::vector<double> grid(size_t(width)*height);
+
+    //--------------------------------------------------positive side
+    //distance of the outside pixels to the nearest inside pixel
+    for (size_t k = 0; k < grid.size(); k++) grid[k] = inside[k] ? 0. : farAway;
+    squaredDistanceTransform(grid);
+    for (size_t k = 0; k < grid.size(); k++)
+        if (!inside[k]) distance[k] = float(sqrt(grid[k]));
+
     //----------------------------------------negative side
+    //distance of the inside pixels to the nearest outside pixel
+    for (size_t k = 0; k < grid.size(); k++) grid[k] = inside[k] ? farAway : 0.;
+    squaredDistanceTransform(grid);
+    for (size_t k = 0; k < grid.size(); k++)
+        if (inside[k]) distance[k] = -float(sqrt(grid[k]));
 
-    //adding negative values - making unsigned distance field
-    //adding pixels with value '1' to a stack "coord"
-    for(size_t i = 0; i <m.size(); i++){
-        for(size_t j = 0; j<m[0].size(); j++){
-            if(m[i][j] == 1){
-                pixel_coord.push({int(i), int(j)});
-            }
-        }
+    d = 0;
+    dn = 0;
+    for (size_t k = 0; k < grid.size(); k++) {
+        d = std::max(d, int(ceil(distance[k])));
+        dn = std::min(dn, int(floor(distance[k])));
     }
 
-    //saving initial number of pixels with value of '0'
-    currentLevelSize = pixel_coord.size();
-    //distance to negative side - negative iso value
-    dn = -1;
-
-    while(pixel_coord.size() != 0){
-        auto &currentCoord = pixel_coord.front();
-        for(int i = currentCoord.x() - 1; i <= currentCoord.x() + 1; i++){
-            for(int j = currentCoord.y() - 1; j<= currentCoord.y() + 1; j++){
-                if(isInsideTheImage(int(i),int(j), m.size(), m[0].size()) and m[i][j]==0){
-                      m[i][j] = dn;
-                      pixel_coord.push({int(i),int(j)}); //pushing new level of neighbours
-                }
-            }
-        }
-        //remove 1st coord with value of 1
-        pixel_coord.pop();
-        currentLevelSize--;
-
-        //next level:
-        if(currentLevelSize == 0){
-            currentLevelSize = pixel_coord.size();
-            dn--;
-        }
-    }
+    /***********************************
+    // d and dn are stored in front of the distances (as in the cache file), converted to floats (they are exact)
+    ***********************************/
+    distanceGrid[0] = float(d);
+    distanceGrid[1] = float(dn);
 }
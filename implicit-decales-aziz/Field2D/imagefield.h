@@ -2,26 +2,51 @@
 #define IMAGEFIELD_H
 
 #include "Field2D.h"
+#include "../Tools/ThreadPool.h"
+#include "../Tools/FieldCache.h"
 #include <QString>
 #include <QImage>
-#include <queue>
+#include <vector>
 
 class ImageField : public Field2D
 {
 public:
-    ImageField(const QString &path);
+    // The image is a binary mask: black pixels are inside (the projected window), the others are outside.
+    // The distance field is computed on the threads of pool when it is given.
+    // With a cache file, the distance field is mapped from the file when it was computed from the same mask,
+    // otherwise it is computed and stored in the file.
+    ImageField(const QString &path, ThreadPool *pool = NULL, const QString &cacheFile = QString());
     double eval (double x, double y) override;
 
+    // Hash of the mask (size and pixels), identifying the distance field
+    uint64_t getMaskKey();
+
 protected:
+    // Exact Euclidean signed distance (in pixels) from the pixel centers to the mask boundary:
+    // positive outside (distance to the nearest inside pixel), negative inside (minus the distance to the nearest outside pixel).
+    // Computed by two separable squared distance transforms (Felzenszwalb and Huttenlocher), along the columns then the rows.
     void calculateDistnaceField();
-    bool isInsideTheImage(int i,int j, int w, int h);
 
-    std::vector< std::vector<int> > m;
+    // Computes distanceGrid (d, dn then the distances) from the inside flags of the pixels (indexed i*height+j)
+    void computeDistances(const std::vector<unsigned char> &inside);
+
+    // Squared distances from the sites (f = 0) of the columns then of the rows of grid (f = infinity elsewhere)
+    void squaredDistanceTransform(std::vector<double> &grid);
+
+    // Distance field, indexed i*height+j (the pixels of a column are contiguous):
+    // in distanceGrid (after d and dn) when it is computed, or in the mapped cache file
+    const float *distances;
+    std::vector<float> distanceGrid;
+    int width;
+    int height;
+
+    FieldCache cache;
+    uint64_t maskKey;
+
     QImage img_src;
+    ThreadPool *threadPool;
     int d; //positive max val of field
     int dn;//negative max val of field
-
-    std::queue<QPoint> pixel_coord;
 };
 
 #endif // IMAGEFIELD_H
@@ -7,10 +7,11 @@
 #include <iostream>
 #include <QMouseEvent>
 #include <QTimer>
+#include <QPainter>
 #include <math.h>
 
 
-QWidgetMyDecale::QWidgetMyDecale (int width, int height, Color bgColor) : QWidgetMyWidget() {
+QWidgetMyDecale::QWidgetMyDecale (int width, int height, Color bgColor) : QWidgetMyWidget(), asyncSolver (&mysolver), damage (width, height) {
 
     /***********************************
     // Create the color image with a background color
@@ -20,6 +21,11 @@ QWidgetMyDecale::QWidgetMyDecale (int width, int height, Color bgColor) : QWidge
     this->bgColor.setColor(bgColor);
     colorImage->setColor (bgColor);
 
+    /***********************************
+    // The Widget draws the color image itself (only the damaged part of it at each frame)
+    ***********************************/
+    setFixedSize(width, height);
+    setAttribute(Qt::WA_OpaquePaintEvent);
 
 }
 std::vector<bool> QWidgetMyDecale::lockedDecals;
@@ -207,7 +213,6 @@ bool QWidgetMyDecale::event(QEvent *event){
     }
     case QEvent::MouseButtonRelease:{
         setLockedDecalsToFalse();
-        innerRemoveColorDecale();
         needUpdate = true;
     }
 
@@ -285,9 +290,6 @@ bool QWidgetMyDecale::event(QEvent *event){
                 auto refvalx = i.value().pos.x();
                 auto refvaly = i.value().pos.y();
 
-                innerRemoveColorDecale();
-
-
 
 
                 int pid1 = -1, pid2 = -1;
@@ -410,7 +412,6 @@ void QWidgetMyDecale::mouseMoveEvent(QMouseEvent *event) {
     if(indexSelectedDecale>=0){
         std::cout<<"move id: "<<indexSelectedDecale<<std::endl;
 
-        innerRemoveColorDecale();
         decales[indexSelectedDecale]->setPosx(refposx+event->pos().x()-refx);
         decales[indexSelectedDecale]->setPosy(refposy+event->pos().y()-refy);
 
@@ -456,6 +457,14 @@ void QWidgetMyDecale::mouseDoubleClickEvent(QMouseEvent *event){ //Zoom on the d
 }
 
 
+void QWidgetMyDecale::paintEvent(QPaintEvent *event) {
+
+    QPainter painter (this);
+    for (const QRect &rect : event->region())
+        painter.drawImage(rect, colorImage->getQImage(), rect);
+}
+
+
 void QWidgetMyDecale::repaint() {
 
     innerPaintColorDecaleMouseUpdate();
@@ -469,6 +478,8 @@ void QWidgetMyDecale::update() {
 
 void QWidgetMyDecale::prepareSolver(GamutField2D *gamut)
 {
+    //the solver is only used by its thread once started
+    asyncSolver.stop();
     isSolverPrepared = true;
     //solver
     std::cout<<"---1 - Creating mysolver"<<std::endl;
@@ -478,18 +489,45 @@ void QWidgetMyDecale::prepareSolver(GamutField2D *gamut)
     mysolver.setGamut(gamut);
     std::cout<<"---3 - Calling solver update"<<std::endl;
     mysolver.init();
-    std::cout<<"---4 - Calling solver solve"<<std::endl;
-    mysolver.solve();
+    std::cout<<"---4 - Starting solver thread"<<std::endl;
+    asyncSolver.start();
+    //the first solve is done by the solver thread, from the input submitted at the next frame
+    needUpdate = true;
+
+}
+bool QWidgetMyDecale::internal_preupdate_submit()
+{
+    mysolver.readLayout(solverInput);
+    for(size_t i = 0; i < mysolver.decales.size(); i++){
+        int id = mysolver.decales[i]->getId();
+        solverInput.locked[i] = (id >= 0 && size_t(id) < lockedDecals.size() && lockedDecals[id]) ? 1 : 0;
+    }
+    solverInput.sequence = solverSequence + 1;
 
+    if(!asyncSolver.submit(solverInput)) return false;
+    solverSequence++;
+    return true;
 }
-void QWidgetMyDecale::internal_preupdate_solve()
+
+bool QWidgetMyDecale::internal_preupdate_retrieve()
 {
-    mysolver.solve();
+    if(!asyncSolver.retrieve(solverResult)) return false;
+
+    //the Decales held by the user follow the user, not the (older) solved positions
+    for(size_t i = 0; i < solverResult.posx.size() && i < mysolver.decales.size(); i++){
+        DecaleScalarField2D *decale = mysolver.decales[i];
+        int id = decale->getId();
+        if(id >= 0 && size_t(id) < lockedDecals.size() && lockedDecals[id]) continue;
+        decale->setPosx(solverResult.posx[i]);
+        decale->setPosy(solverResult.posy[i]);
+    }
+    return true;
 }
 
 void QWidgetMyDecale::setDecales (VectorOfDecaleFields decales) {
 
     this->decales = decales;
+    pipeline.setDecales(decales);
     //setting clicked decals for solver getter
     lockedDecals.resize(decales.size());
     setLockedDecalsToFalse();
@@ -506,11 +544,12 @@ void  QWidgetMyDecale::setDeformers (VectorOfDeformers deformers) {
 
     this->deformers = deformers;
     this->deformerType =  0;
+    pipeline.setDeformers(deformers);
 }
 
-void QWidgetMyDecale::setLabel (QLabel *label){
+void QWidgetMyDecale::setThreadPool (ThreadPool *pool) {
 
-    this->label = label;
+    pipeline.setThreadPool(pool);
 }
 
 void QWidgetMyDecale::setDecaleImages(VectorOfColorImages decaleImages) {
@@ -528,55 +567,135 @@ void QWidgetMyDecale::innerPaintColorDecaleMouseUpdate() {
 
 
     /***********************************
-    // Re-Compute the existing deformed Decale buffer fields with the current decale positions
+    // Select the rest-pose Decale buffer fields matching the current decale positions (evaluated only once per sub-pixel phase)
     ***********************************/
-    for (int i=0;i<deformers.size();i++)
-        deformers[i]->applyToExistingDiscreteFields(i+1);
+    for (int i=0;i<decales.size();i++)
+        decales[i]->updateRestPoseField();
 
     /***********************************
-    // Compute the corresponding UV buffers per Decale
+    // Fused Deformers: the deformed fields and the UVs are computed per tile when drawing
     ***********************************/
-    for (int i=0;i<decales.size();i++)
-        decales[i]->updateDiscreteUVField(decales[i]->getNbDiscreteFields()-1);
-        //decales[i]->computeDiscreteUVField(decales[i]->getNbDiscreteFields()-1);
-
+    bool fused = pipeline.isFusable();
+
+    if (fused) {
+        pipeline.prepare();
+    } else {
+        /***********************************
+        // Re-Compute the existing deformed Decale buffer fields with the current decale positions
+        ***********************************/
+        for (int i=0;i<deformers.size();i++)
+            deformers[i]->applyToExistingDiscreteFields(i+1);
+
+        /***********************************
+        // Compute the corresponding UV buffers per Decale
+        ***********************************/
+        for (int i=0;i<decales.size();i++)
+            decales[i]->updateDiscreteUVField(decales[i]->getNbDiscreteFields()-1);
+            //decales[i]->computeDiscreteUVField(decales[i]->getNbDiscreteFields()-1);
+    }
 
     /***********************************
-    // update the image with the decale images
+    // Clear the damaged part of the image, then draw the decale images in it
     ***********************************/
-    for (int i=0; i<decaleImages.size();i++) {
-        colorImage->addColorImageWithDecaleUV(decales[i], decaleImages[i]);
+    damageChangedDecales();
+    if (damage.isEmpty()) return;
+
+    const std::vector<QRect> &rects = damage.getRects();
+    for (unsigned int r=0; r<rects.size(); r++) {
+        colorImage->clearColorImage(rects[r]);
 
+        if (fused) {
+            pipeline.draw(colorImage, decaleImages, rects[r]);
+            continue;
+        }
+        for (int i=0; i<decaleImages.size();i++)
+            colorImage->addColorImageWithDecaleUV(decales[i], decaleImages[i], rects[r]);
     }
+
     /***********************************
-    // update the Widget image
+    // Present the damaged part of the Widget image (drawn by paintEvent)
     ***********************************/
-    label->setPixmap(colorImage->getQPixmap());
+    QWidget::update(damage.getRegion());
+    damage.clear();
 
     //std::cout<<"repaint "<<decales.size()<<std::endl;
 }
 
-void QWidgetMyDecale::innerRemoveColorDecale()
-{
-    for (int i=0; i<decaleImages.size();i++)
-        colorImage->clearDecaleColorImage(decales[i], decaleImages[i], gamut,gamutColor, bgColor);
+void QWidgetMyDecale::damageChangedDecales() {
+
+    std::map<int, DecaleFrame> frames;
+    std::vector<bool> changed (decales.size(), false);
+    DamageRegion moved (colorImage->getWidth(), colorImage->getHeight());
+
+    /***********************************
+    // Decales moved or scaled (or new): their previous and current footprints are damaged
+    ***********************************/
+    for (int i=0; i<decales.size(); i++) {
+        DecaleFrame frame;
+        frame.rect = QRect((int)decales[i]->getCornerX(), (int)decales[i]->getCornerY(),
+                           (int)decales[i]->getIWidth(), (int)decales[i]->getIHeight());
+        frame.posx = decales[i]->getPosx();
+        frame.posy = decales[i]->getPosy();
+        frame.scalex = decales[i]->getScalex();
+        frame.scaley = decales[i]->getScaley();
+
+        auto previous = decaleFrames.find(decales[i]->getId());
+        if (previous == decaleFrames.end()) {
+            changed[i] = true;
+        } else {
+            const DecaleFrame &p = previous->second;
+            changed[i] = (p.rect != frame.rect) || (p.posx != frame.posx) || (p.posy != frame.posy)
+                         || (p.scalex != frame.scalex) || (p.scaley != frame.scaley);
+            if (changed[i]) moved.add(p.rect);
+            decaleFrames.erase(previous);
+        }
+        if (changed[i]) moved.add(frame.rect);
+
+        frames[decales[i]->getId()] = frame;
+    }
+
+    /***********************************
+    // Removed Decales: the frames left
+    ***********************************/
+    for (auto &removed : decaleFrames)
+        moved.add(removed.second.rect);
+
+    /***********************************
+    // The Decales overlapping a damaged footprint are deformed by the changed Decales, and in turn change the
+    // deformation of the Decales overlapping them (A deforms B deforms C): damaged up to the closure of the overlaps
+    ***********************************/
+    const std::vector<QRect> &rects = moved.getRects();
+    std::vector<QRect> deformed (rects.begin(), rects.end());
+    for (unsigned int r=0; r<rects.size(); r++)
+        damage.add(rects[r]);
+    while (!deformed.empty()) {
+        QRect rect = deformed.back();
+        deformed.pop_back();
+
+        for (int i=0; i<decales.size(); i++) {
+            const QRect &footprint = frames[decales[i]->getId()].rect;
+            if (changed[i] || !rect.intersects(footprint)) continue;
+            changed[i] = true;
+            damage.add(footprint);
+            deformed.push_back(footprint);
+        }
+    }
+
+    decaleFrames.swap(frames);
 }
 
 void QWidgetMyDecale::innerRemoveLastDecale(){
        // colorImage->clearDecaleColorImage2(decales.back(), decaleImages.back(), gamut,gamutColor, bgColor);
 }
 
-void QWidgetMyDecale::innerRemoveDecale(DecaleScalarField2D *decale){
-        colorImage->clearDecaleColorImage(decale, gamut,gamutColor, bgColor);
-}
-
 void QWidgetMyDecale::setGamutColor(Color gamutColor) {
 
     this->gamutColor.setColor(gamutColor);
     /***********************************
-    // Color the Gamut area with the color gamutColor
+    // Color the Gamut area with the color gamutColor, in the background layer restored under the Decales
     ***********************************/
-    colorImage->setColorGamut (gamut,gamutColor);
+    colorImage->setBackground (gamut,gamutColor,bgColor);
+    damage.addAll();
 }
 
 void QWidgetMyDecale::removeDecale(int decaleId){
@@ -609,11 +728,20 @@ void QWidgetMyDecale::removeDecale(int decaleId){
                 break;
         }
 
-        innerRemoveDecale(decales[decaleIndex]);
-
+        // The footprint of the removed Decale is damaged at the next frame
 
         decales.erase(decales.begin()+decaleIndex);
         decaleImages.erase(decaleImages.begin()+decaleImagesIndex);
+        pipeline.setDecales(decales);
+
+        // Only the relationships of the removed Decale are removed from the solver (no rebuild of the space)
+        if(isSolverPrepared){
+            bool running = asyncSolver.isRunning();
+            asyncSolver.stop();
+            mysolver.removeDecale(removedDecale);
+            if(running) asyncSolver.start();
+            needUpdate = true;
+        }
 
         //remove(decales.begin(), decales.end(), removedDecale);
         //remove(decaleImages.begin(), decaleImages.end(), removedDecaleImage);
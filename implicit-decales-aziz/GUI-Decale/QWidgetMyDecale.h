@@ -6,12 +6,16 @@
 #define TEST_QWIDGETMYDECALE_H
 
 #include "QWidgetMyWidget.h"
+#include "../Solver/asyncsolver.h"
 #include "../Decale/DecaleScalarField2D.h"
 #include "../Deformer2D/Deformer2D.h"
+#include "../Deformer2D/DeformerPipeline2D.h"
 #include "../Tools/ColorImage.h"
-#include <QLabel>
+#include "../Tools/DamageRegion.h"
 #include <QEvent>
 #include <QTouchEvent>
+#include <QPaintEvent>
+#include <map>
 
 
 class QWidgetMyDecale : public QWidgetMyWidget {
@@ -20,16 +24,23 @@ public:
 
     QWidgetMyDecale(int width, int height, Color bgColor);
     MyDecalSolver mysolver;
+    /**
+     * Thread solving the layout with mysolver, started by prepareSolver
+     */
+    AsyncSolver asyncSolver;
 
     void setDecales (VectorOfDecaleFields decales);
     void setGamut (GamutField2D *gamut);
     void setGamutColor (Color gamutColor);
     void setDeformers (VectorOfDeformers deformers);
     void setDecaleImages(VectorOfColorImages decaleImages);
-    void setLabel (QLabel *label);
+    /**
+     * Set the pool of threads on which the Decales are deformed and drawn per tile (NULL for the GUI thread)
+     */
+    void setThreadPool (ThreadPool *pool);
 
     /**
-     * Call the private innerPaintColorDecaleMouseUpdate() function for deforming and redrawing Decales in the Widget Pixmap.
+     * Call the private innerPaintColorDecaleMouseUpdate() function for deforming and redrawing Decales in the Widget image.
      */
     void update();
 
@@ -40,7 +51,14 @@ public:
 protected:
 
 
-    void internal_preupdate_solve() override;
+    bool internal_preupdate_submit() override;
+    bool internal_preupdate_retrieve() override;
+
+    // Sequence number of the last input submitted to the solver thread
+    unsigned long solverSequence = 0;
+    // Input and result exchanged with the solver thread (kept to reuse their memory)
+    DecaleLayout solverInput;
+    DecaleLayout solverResult;
 
     /**
      * Select the Decale closer to the mouse pointer.
@@ -49,13 +67,17 @@ protected:
     void mouseDoubleClickEvent(QMouseEvent *event);
     /**
      * Translate the Decale closer to the mouse pointer.
-     * The moved Decale is cleared in the image
-     * The position of the Decale is updated
+     * The position of the Decale is updated (its footprint is damaged at the next frame)
      */
     void mouseMoveEvent(QMouseEvent *event);
 
     bool event(QEvent *event);//for touch
 
+    /**
+     * Draw the damaged part of the Widget image
+     */
+    void paintEvent(QPaintEvent *event) override;
+
     void repaint();
 
     VectorOfDecaleFields decales;
@@ -66,7 +88,26 @@ protected:
     Color gamutColor;
     Color bgColor;
 
-    QLabel *label;
+    /**
+     * Fused deformation, (u,v) parameterization and drawing of the Decales, per tile of the damaged part of the image
+     */
+    DeformerPipeline2D pipeline;
+
+    /***********************************
+    // Part of the Widget image to clear, redraw and present at the next frame
+    ***********************************/
+    DamageRegion damage;
+
+    /**
+     * Footprint and placement of a Decale at the last drawn frame
+     */
+    struct DecaleFrame {
+        QRect rect;
+        double posx, posy;
+        double scalex, scaley;
+    };
+    // Per Decale id
+    std::map<int, DecaleFrame> decaleFrames;
 
     double refx;
     double refy;
@@ -106,13 +147,17 @@ private:
     /**
      * Compute the deformed Decale buffers.
      * Compute the corresponding UV Decale buffers
-     * Draw the Decale images in the Widget image
-     * Update the Widget Pixmap
+     * Clear and draw the Decale images in the damaged part of the Widget image
+     * (the deformed fields and the UVs are only computed there, per tile, when the Deformers can be fused)
+     * Present the damaged part of the Widget image
      */
     void innerPaintColorDecaleMouseUpdate() override;
-    void innerRemoveColorDecale();
+    /**
+     * Damage the footprints (previous and current) of the Decales moved, scaled or removed since the last frame,
+     * and the footprints of the Decales overlapping them (their deformation changes), transitively
+     */
+    void damageChangedDecales();
     void innerRemoveLastDecale();
-    void innerRemoveDecale(DecaleScalarField2D *decale);
     //void innerPaintDecaleMouseUpdate() override;
 
     int getClosestDecalID(QPointF pos);
@@ -21,11 +21,14 @@ QWidgetMyWidget::QWidgetMyWidget () : timerSet(0), QWidget () {
 
 void QWidgetMyWidget::timerHandler()
 {
-    if(isSolverPrepared and needUpdate){
+    if(isSolverPrepared){
         //std::cout<<"timer"<<std::endl;
-        internal_preupdate_solve();
-        innerPaintColorDecaleMouseUpdate();
-        needUpdate = false;
+        //the moves of the user are handed to the solver thread, and its newest positions are drawn as they come
+        //(partial results of an unfinished solve too): the frame never waits for the solver
+        bool redraw = needUpdate;
+        if(needUpdate) needUpdate = !internal_preupdate_submit();
+        if(internal_preupdate_retrieve()) redraw = true;
+        if(redraw) innerPaintColorDecaleMouseUpdate();
     }
 }
 void QWidgetMyWidget::mousePressEvent(QMouseEvent *event) {
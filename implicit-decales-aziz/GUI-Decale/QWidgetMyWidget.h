@@ -18,7 +18,16 @@ public:
 
 
 protected:
-    virtual void internal_preupdate_solve() = 0;
+    /**
+     * Hand the current state of the Decales to the solver thread (never waits for it).
+     * @return false if the solver could not take it, it is then submitted again at the next frame
+     */
+    virtual bool internal_preupdate_submit() = 0;
+    /**
+     * Apply the newest positions solved by the solver thread (never waits for it).
+     * @return true if positions were applied since the last frame
+     */
+    virtual bool internal_preupdate_retrieve() = 0;
     virtual void innerPaintColorDecaleMouseUpdate() = 0;
 
     void mousePressEvent(QMouseEvent *event);
@@ -28,7 +37,7 @@ protected:
     bool isSolverPrepared = false;
 
     void timerHandler();
-    bool needUpdate;
+    bool needUpdate = false;
 
     QTimer *timer;
 };
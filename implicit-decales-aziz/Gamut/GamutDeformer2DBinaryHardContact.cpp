@@ -7,7 +7,10 @@
 #include <iostream>
 
 
-GamutDeformer2DBinaryHardContact::GamutDeformer2DBinaryHardContact () : hardness (4), Deformer2D () {}
+GamutDeformer2DBinaryHardContact::GamutDeformer2DBinaryHardContact () : hardness (4), Deformer2D () {
+
+    bakeEvalInner();
+}
 
 GamutDeformer2DBinaryHardContact::GamutDeformer2DBinaryHardContact (GamutField2D *g, DecaleScalarField2D *f, unsigned int index)
         : Deformer2D () {
@@ -18,34 +21,50 @@ GamutDeformer2DBinaryHardContact::GamutDeformer2DBinaryHardContact (GamutField2D
     gamut = g;
 
     hardness = 4;
+    bakeEvalInner();
+}
+
+double GamutDeformer2DBinaryHardContact::eval (double x, double y, DeformerState &state){
+
+    int ix1 = (int) (x - fields[state.innerIndex]->getPosx() + fields[state.innerIndex]->getDWidth() / 2.);
+    int iy1 = (int) (y - fields[state.innerIndex]->getPosy() + fields[state.innerIndex]->getDHeight() / 2.);
+
+    double f1=0.;
+
+    if ((ix1 >= 0) && (ix1 < fields[state.innerIndex]->getIWidth()) && (iy1 >= 0) && (iy1 < fields[state.innerIndex]->getIHeight()))
+        f1 = fields[state.innerIndex]->getDiscreteFieldValue(ix1, iy1, indexes[state.innerIndex]);
+
+    return evalPointwise(x, y, f1, state);
 }
 
-double GamutDeformer2DBinaryHardContact::eval (double x, double y){
+bool GamutDeformer2DBinaryHardContact::isPointwise (){
+
+    return true;
+}
+
+double GamutDeformer2DBinaryHardContact::evalPointwise (double x, double y, double f1, DeformerState &state){
 
     int ix0 = (int) (x - gamut->getCornerX());
     int iy0 = (int) (y - gamut->getCornerY());
-    int ix1 = (int) (x - fields[innerIndex]->getPosx() + fields[innerIndex]->getDWidth() / 2.);
-    int iy1 = (int) (y - fields[innerIndex]->getPosy() + fields[innerIndex]->getDHeight() / 2.);
 
     double f0=0.;
-    double f1=0.;
 
     if ((ix0 >= 0) && (ix0 < gamut->getIWidth()) && (iy0 >= 0) && (iy0 < gamut->getIHeight()))
         f0 = gamut->getDiscreteFieldValue(ix0, iy0);
-    if ((ix1 >= 0) && (ix1 < fields[innerIndex]->getIWidth()) && (iy1 >= 0) && (iy1 < fields[innerIndex]->getIHeight()))
-        f1 = fields[innerIndex]->getDiscreteFieldValue(ix1, iy1, indexes[innerIndex]);
+
+    if (fields[state.innerIndex]->getIso() == innerTable.getSplit()) return innerTable.eval(f0, f1);
 
     double t=pow(2*f0,hardness);
 
     /* Composition operator */
-    /*if ((f0<=fields[innerIndex]->getIso()) && (f1<=fields[innerIndex]->getIso())) return f1;
-    if (f0>fields[innerIndex]->getIso()) return f0;
+    /*if ((f0<=fields[state.innerIndex]->getIso()) && (f1<=fields[state.innerIndex]->getIso())) return f1;
+    if (f0>fields[state.innerIndex]->getIso()) return f0;
     return (1.-t)*f1+t/2.;*/
 
     /* Decale deformer */
-    if ((f0<=fields[innerIndex]->getIso()) && (f1<fields[innerIndex]->getIso())) return f1;
-    if ((f0>=fields[innerIndex]->getIso()) && (f1>=fields[innerIndex]->getIso())) return 1.-f0;
-    if ((f0>fields[innerIndex]->getIso()) && (f1<fields[innerIndex]->getIso()))
+    if ((f0<=fields[state.innerIndex]->getIso()) && (f1<fields[state.innerIndex]->getIso())) return f1;
+    if ((f0>=fields[state.innerIndex]->getIso()) && (f1>=fields[state.innerIndex]->getIso())) return 1.-f0;
+    if ((f0>fields[state.innerIndex]->getIso()) && (f1<fields[state.innerIndex]->getIso()))
         return std::max(0.,0.5-sqrt((0.5-f0)*(0.5-f0)+(0.5-f1)*(0.5-f1)));
     return (1.-t)*f1+t/2.;
     //return f1;
@@ -6,7 +6,10 @@
 #include <math.h>
 
 
-GamutDeformer2DBinaryHardContactMax::GamutDeformer2DBinaryHardContactMax () : Deformer2D () {}
+GamutDeformer2DBinaryHardContactMax::GamutDeformer2DBinaryHardContactMax () : Deformer2D () {
+
+    bakeEvalInner();
+}
 
 GamutDeformer2DBinaryHardContactMax::GamutDeformer2DBinaryHardContactMax (GamutField2D *g, DecaleScalarField2D *f, unsigned int index)
         : Deformer2D () {
@@ -15,27 +18,43 @@ GamutDeformer2DBinaryHardContactMax::GamutDeformer2DBinaryHardContactMax (GamutF
     indexes.push_back(index);
 
     gamut = g;
+    bakeEvalInner();
+}
+
+double GamutDeformer2DBinaryHardContactMax::eval (double x, double y, DeformerState &state){
+
+    int ix1 = (int) (x - fields[state.innerIndex]->getPosx() + fields[state.innerIndex]->getDWidth() / 2.);
+    int iy1 = (int) (y - fields[state.innerIndex]->getPosy() + fields[state.innerIndex]->getDHeight() / 2.);
+
+    double f1=0.;
+
+    if ((ix1 >= 0) && (ix1 < fields[state.innerIndex]->getIWidth()) && (iy1 >= 0) && (iy1 < fields[state.innerIndex]->getIHeight()))
+        f1 = fields[state.innerIndex]->getDiscreteFieldValue(ix1, iy1, indexes[state.innerIndex]);
+
+    return evalPointwise(x, y, f1, state);
 }
 
-double GamutDeformer2DBinaryHardContactMax::eval (double x, double y){
+bool GamutDeformer2DBinaryHardContactMax::isPointwise (){
+
+    return true;
+}
+
+double GamutDeformer2DBinaryHardContactMax::evalPointwise (double x, double y, double f1, DeformerState &state){
 
     int ix0 = (int) (x - gamut->getCornerX());
     int iy0 = (int) (y - gamut->getCornerY());
-    int ix1 = (int) (x - fields[innerIndex]->getPosx() + fields[innerIndex]->getDWidth() / 2.);
-    int iy1 = (int) (y - fields[innerIndex]->getPosy() + fields[innerIndex]->getDHeight() / 2.);
 
     double f0=0.;
-    double f1=0.;
 
     if ((ix0 >= 0) && (ix0 < gamut->getIWidth()) && (iy0 >= 0) && (iy0 < gamut->getIHeight()))
         f0 = gamut->getDiscreteFieldValue(ix0, iy0);
-    if ((ix1 >= 0) && (ix1 < fields[innerIndex]->getIWidth()) && (iy1 >= 0) && (iy1 < fields[innerIndex]->getIHeight()))
-        f1 = fields[innerIndex]->getDiscreteFieldValue(ix1, iy1, indexes[innerIndex]);
+
+    if (fields[state.innerIndex]->getIso() == innerTable.getSplit()) return innerTable.eval(f0, f1);
 
     /* Decale deformer */
-    if ((f0<=fields[innerIndex]->getIso()) && (f1<fields[innerIndex]->getIso())) return f1;
-    if ((f0>=fields[innerIndex]->getIso()) && (f1>=fields[innerIndex]->getIso())) return 1.-f0;
-    if ((f0>fields[innerIndex]->getIso()) && (f1<fields[innerIndex]->getIso()))
+    if ((f0<=fields[state.innerIndex]->getIso()) && (f1<fields[state.innerIndex]->getIso())) return f1;
+    if ((f0>=fields[state.innerIndex]->getIso()) && (f1>=fields[state.innerIndex]->getIso())) return 1.-f0;
+    if ((f0>fields[state.innerIndex]->getIso()) && (f1<fields[state.innerIndex]->getIso()))
         return std::max(0.,0.5-sqrt((0.5-f0)*(0.5-f0)+(0.5-f1)*(0.5-f1)));
     return f1;
 }
@@ -48,6 +67,6 @@ double GamutDeformer2DBinaryHardContactMax::evalInner (double x, double y) {
     if ((x>=0.5) && (y>=0.5)) return 1.-x;
     if ((x>0.5) && (y<0.5))
         return std::max(0.,0.5-sqrt((0.5-x)*(0.5-x)+(0.5-y)*(0.5-y)));
-    return x;
+    return y;
 
 }
@@ -16,7 +16,13 @@ public:
 
     GamutDeformer2DBinaryHardContactMax (GamutField2D *g, DecaleScalarField2D *f, unsigned int index);
 
-    double eval (double x, double y);
+    double eval (double x, double y, DeformerState &state);
+
+    /**
+     * The deformed Decale only depends on its own value and on the Gamut
+     */
+    bool isPointwise ();
+    double evalPointwise (double x, double y, double value, DeformerState &state);
 
     //void applyToDiscreteFields ();
 
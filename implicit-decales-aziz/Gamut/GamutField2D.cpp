@@ -4,14 +4,21 @@
 
 #include "GamutField2D.h"
 
-GamutField2D::GamutField2D () : field(), Field2D() {}
+GamutField2D::GamutField2D () : Field2D(), field(), discreteField(NULL), fieldStorage(FIELD_STORAGE_DOUBLE), bufferPool(NULL),
+                                 distanceFieldKey(0) {}
 
 GamutField2D::GamutField2D (Field2D *f, int cornerx, int cornery, unsigned int width, unsigned int height, double size, unsigned int n)
-        : cornerx(cornerx), cornery(cornery), iwidth(width), iheight(height), Field2D(size, n) {
+        : Field2D(size, n), cornerx(cornerx), cornery(cornery), iwidth(width), iheight(height),
+          discreteField(NULL), fieldStorage(FIELD_STORAGE_DOUBLE), bufferPool(NULL), distanceFieldKey(0) {
 
     field = f;
 }
 
+GamutField2D::~GamutField2D () {
+
+    delete discreteField;
+}
+
 
 double GamutField2D::eval (const double x, const double y) {
 
@@ -20,17 +27,69 @@ double GamutField2D::eval (const double x, const double y) {
 
 void GamutField2D::computeDiscreteField () {
 
-    discreteField = new double [iwidth*iheight];
+    /***********************************
+    // The cached buffer is identified by all the inputs of the field values
+    ***********************************/
+    size_t bytes = size_t(iwidth)*iheight*FieldBuffer::bytesPerValue(fieldStorage);
+    uint64_t key = FieldCache::hash(&distanceFieldKey, sizeof(distanceFieldKey));
+    key = FieldCache::hash(&size, sizeof(size), key);
+    key = FieldCache::hash(&n, sizeof(n), key);
+    key = FieldCache::hash(&iso, sizeof(iso), key);
+    key = FieldCache::hash(&cornerx, sizeof(cornerx), key);
+    key = FieldCache::hash(&cornery, sizeof(cornery), key);
+    key = FieldCache::hash(&iwidth, sizeof(iwidth), key);
+    key = FieldCache::hash(&iheight, sizeof(iheight), key);
+    key = FieldCache::hash(&fieldStorage, sizeof(fieldStorage), key);
+
+    void *values = cache.map(key, bytes);
+    if (values != NULL) {
+        discreteField = new FieldBuffer (iwidth*iheight, fieldStorage, values);
+        return;
+    }
+
+    discreteField = new FieldBuffer (iwidth*iheight, fieldStorage, bufferPool);
 
     for (int i=0; i<iwidth; i++)
         for (int j=0; j<iheight;j++)
-            discreteField[i*iheight+j]=eval(double(i+cornerx), double(j+cornery));
+            discreteField->set(i*iheight+j, eval(double(i+cornerx), double(j+cornery)));
+
+    cache.store(key, discreteField->getData(), bytes);
 }
 
 
 double GamutField2D::getDiscreteFieldValue (unsigned int i, unsigned int j){
 
-    return discreteField[i*iheight+j];
+    return discreteField->get(i*iheight+j);
+}
+
+double GamutField2D::getPixelValue (int x, int y){
+
+    int i = x - cornerx;
+    int j = y - cornery;
+    if ((discreteField != NULL) && (i >= 0) && (i < (int)iwidth) && (j >= 0) && (j < (int)iheight))
+        return discreteField->get(i*iheight+j);
+    return eval(double(x), double(y));
+}
+
+void GamutField2D::setStorage (FieldStorage fieldStorage){
+
+    this->fieldStorage = fieldStorage;
+}
+
+FieldStorage GamutField2D::getFieldStorage (){
+
+    return fieldStorage;
+}
+
+void GamutField2D::setBufferPool (BufferPool *pool){
+
+    bufferPool = pool;
+}
+
+void GamutField2D::setCache (const std::string &fileName, uint64_t distanceFieldKey){
+
+    cache.setFileName(fileName);
+    this->distanceFieldKey = distanceFieldKey;
 }
 
 
@@ -6,6 +6,8 @@
 #define TEST_GAMUTFIELD2D_H
 
 #include "../Field2D/Field2D.h"
+#include "../Tools/FieldBuffer.h"
+#include "../Tools/FieldCache.h"
 
 class GamutField2D : public Field2D {
 
@@ -13,13 +15,44 @@ public:
 
     GamutField2D ();
     GamutField2D (Field2D *f, int cornerx, int cornery, unsigned int width, unsigned int height, double size, unsigned int n);
+    /**
+     * Release the field buffer (the distance field is not owned by the Gamut).
+     */
+    ~GamutField2D ();
 
     double eval (const double x, const double y);
 
     void computeDiscreteField ();
 
+    /**
+     * Set the storage of the field buffer (double, float or 16-bit fixed point).
+     * It has to be set before computing the field buffer.
+     */
+    void setStorage (FieldStorage fieldStorage);
+    FieldStorage getFieldStorage ();
+
+    /**
+     * Set the pool from which the memory of the field buffer is taken (the heap if NULL).
+     * It has to be set before computing the field buffer.
+     */
+    void setBufferPool (BufferPool *pool);
+
+    /**
+     * Set the file in which the field buffer is cached. The buffer is mapped from the file when it was computed
+     * from the same distance field with the same falloff, window and storage, otherwise it is computed and stored in the file.
+     * It has to be set before computing the field buffer.
+     * @param fileName: the cache file (no cache if empty)
+     * @param distanceFieldKey: hash of the distance field (e.g. ImageField::getMaskKey())
+     */
+    void setCache (const std::string &fileName, uint64_t distanceFieldKey);
+
     double getDiscreteFieldValue (unsigned int i, unsigned int j);
 
+    /**
+     * Field value at the pixel (x,y): read in the field buffer when it is computed and covers the pixel, evaluated otherwise.
+     */
+    double getPixelValue (int x, int y);
+
     unsigned int getCornerX ();
     unsigned int getCornerY ();
 
@@ -39,7 +72,12 @@ protected:
     unsigned int iwidth;
     unsigned int iheight;
 
-    double *discreteField;
+    FieldBuffer *discreteField;
+    FieldStorage fieldStorage;
+    BufferPool *bufferPool;
+
+    FieldCache cache;
+    uint64_t distanceFieldKey;
 };
 
 
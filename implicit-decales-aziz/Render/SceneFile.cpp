@@ -0,0 +1,191 @@
+//
+// Description of a scene read from a scene file.
+//
+
+#include "SceneFile.h"
+#include <fstream>
+#include <sstream>
+#include <stdlib.h>
+#include <math.h>
+
+
+static const char *deformerNames[] = {"contact", "blend-contact", "max", "blend-max",
+                                      "gamut-hard-contact", "gamut-hard-contact-max"};
+
+/***********************************
+// Number read from a token (false if the token is not entirely a number)
+***********************************/
+static bool readNumber (const std::string &token, double &value) {
+
+    if (token.empty()) return false;
+    char *end;
+    value = strtod(token.c_str(), &end);
+    return *end == '\0';
+}
+
+/***********************************
+// Path relative to the directory of the scene file (absolute paths are kept)
+***********************************/
+static std::string scenePath (const std::string &directory, const std::string &path) {
+
+    if (directory.empty() || path.empty() || (path[0] == '/') || ((path.size() > 1) && (path[1] == ':'))) return path;
+    return directory + "/" + path;
+}
+
+bool readSceneFile (const std::string &fileName, SceneDescription &scene, std::string &error) {
+
+    std::ifstream file (fileName.c_str());
+    if (!file) {
+        error = fileName + ": cannot be opened";
+        return false;
+    }
+
+    size_t slash = fileName.find_last_of("/\\");
+    std::string directory = (slash == std::string::npos) ? std::string() : fileName.substr(0, slash);
+
+    scene.width = 0;
+    scene.height = 0;
+    scene.backgroundColor = "#D3D3D3";
+    scene.gamutColor = "#000000";
+    scene.gamutMask.clear();
+    scene.gamutFallOff = 80.;
+    scene.n = 2;
+    scene.fieldStorage = "double";
+    scene.uvStorage = "double";
+    scene.decales.clear();
+    scene.deformers.clear();
+    scene.output.clear();
+
+    std::string line;
+    for (int lineNumber = 1; std::getline(file, line); lineNumber++) {
+
+        size_t first = line.find_first_not_of(" \t\r");
+        if ((first == std::string::npos) || (line[first] == '#')) continue;
+
+        std::istringstream stream (line);
+        std::vector<std::string> tokens;
+        std::string token;
+        while (stream >> token) tokens.push_back(token);
+
+        std::ostringstream where;
+        where << fileName << ":" << lineNumber << ": ";
+        const std::string &statement = tokens[0];
+        double a, b, c;
+
+        if (statement == "canvas") {
+            if ((tokens.size() != 3) || !readNumber(tokens[1], a) || !readNumber(tokens[2], b) || (a < 1.) || (b < 1.)) {
+                error = where.str() + "expected: canvas <width> <height>";
+                return false;
+            }
+            scene.width = (unsigned int)a;
+            scene.height = (unsigned int)b;
+        }
+        else if (statement == "background") {
+            if (tokens.size() != 2) {
+                error = where.str() + "expected: background <color>";
+                return false;
+            }
+            scene.backgroundColor = tokens[1];
+        }
+        else if (statement == "gamut-color") {
+            if (tokens.size() != 2) {
+                error = where.str() + "expected: gamut-color <color>";
+                return false;
+            }
+            scene.gamutColor = tokens[1];
+        }
+        else if (statement == "gamut") {
+            if ((tokens.size() != 3) || !readNumber(tokens[2], a) || (a <= 0.)) {
+                error = where.str() + "expected: gamut <mask> <falloff size>";
+                return false;
+            }
+            scene.gamutMask = scenePath(directory, tokens[1]);
+            scene.gamutFallOff = a;
+        }
+        else if (statement == "falloff") {
+            if ((tokens.size() != 2) || !readNumber(tokens[1], a) || (a < 2.)) {
+                error = where.str() + "expected: falloff <n >= 2>";
+                return false;
+            }
+            scene.n = (unsigned int)a;
+        }
+        else if (statement == "storage") {
+            if ((tokens.size() != 3) ||
+                ((tokens[1] != "double") && (tokens[1] != "float") && (tokens[1] != "fixed16")) ||
+                ((tokens[2] != "double") && (tokens[2] != "half"))) {
+                error = where.str() + "expected: storage <double|float|fixed16> <double|half>";
+                return false;
+            }
+            scene.fieldStorage = tokens[1];
+            scene.uvStorage = tokens[2];
+        }
+        else if (statement == "decale") {
+            DecaleDescription decale;
+            if ((tokens.size() < 6) || !readNumber(tokens[2], a) || !readNumber(tokens[3], b) || !readNumber(tokens[4], c) ||
+                ((tokens[1] != "disk") && (tokens[1] != "square") && (tokens[1] != "roundsquare"))) {
+                error = where.str() + "expected: decale <disk|square|roundsquare> <x> <y> <size> <image> [rotation=<radians>] [scale=<sx>,<sy>] [corner=<radians>]";
+                return false;
+            }
+            decale.shape = tokens[1];
+            decale.posx = a;
+            decale.posy = b;
+            decale.size = c;
+            decale.image = scenePath(directory, tokens[5]);
+            decale.rotation = 0.;
+            decale.cornerAngle = M_PI/6.;
+            decale.scalex = 1.;
+            decale.scaley = 1.;
+
+            for (unsigned int t=6; t<tokens.size(); t++) {
+                size_t comma = tokens[t].find(',');
+                if ((tokens[t].compare(0, 9, "rotation=") == 0) && readNumber(tokens[t].substr(9), a))
+                    decale.rotation = a;
+                else if ((tokens[t].compare(0, 7, "corner=") == 0) && (decale.shape == "roundsquare") &&
+                         readNumber(tokens[t].substr(7), a))
+                    decale.cornerAngle = a;
+                else if ((tokens[t].compare(0, 6, "scale=") == 0) && (comma != std::string::npos) &&
+                         readNumber(tokens[t].substr(6, comma - 6), a) && readNumber(tokens[t].substr(comma + 1), b) &&
+                         (a > 0.) && (b > 0.)) {
+                    decale.scalex = a;
+                    decale.scaley = b;
+                }
+                else {
+                    error = where.str() + "unknown Decale option " + tokens[t];
+                    return false;
+                }
+            }
+            scene.decales.push_back(decale);
+        }
+        else if (statement == "deformer") {
+            bool known = false;
+            for (unsigned int d=0; d<sizeof(deformerNames)/sizeof(deformerNames[0]); d++)
+                if ((tokens.size() == 2) && (tokens[1] == deformerNames[d])) known = true;
+            if (!known) {
+                error = where.str() + "expected: deformer <contact|blend-contact|max|blend-max|gamut-hard-contact|gamut-hard-contact-max>";
+                return false;
+            }
+            if ((tokens[1].compare(0, 5, "gamut") == 0) && scene.gamutMask.empty()) {
+                error = where.str() + "the Deformer " + tokens[1] + " needs a Gamut (gamut statement before it)";
+                return false;
+            }
+            scene.deformers.push_back(tokens[1]);
+        }
+        else if (statement == "output") {
+            if (tokens.size() != 2) {
+                error = where.str() + "expected: output <image>";
+                return false;
+            }
+            scene.output = scenePath(directory, tokens[1]);
+        }
+        else {
+            error = where.str() + "unknown statement " + statement;
+            return false;
+        }
+    }
+
+    if ((scene.width == 0) || (scene.height == 0)) {
+        error = fileName + ": no canvas statement";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,78 @@
+//
+// Description of a scene (canvas, Gamut mask, Decales with their shapes and images, chain of Deformers) read from a
+// scene file, so that scenes can be rendered without the hard-coded setup of the application.
+//
+// The scene file is a text file, one statement per line (the paths are relative to the directory of the scene file,
+// the lines starting with '#' are comments):
+//
+//     canvas 1024 740
+//     background #D3D3D3
+//     gamut Images/gamut_images/test4 80
+//     gamut-color #000000
+//     falloff 2
+//     storage float half
+//     decale square 700 270 100 Images/i-mail.png rotation=0.39 scale=1,1.2
+//     decale roundsquare 290 650 44 Images/i-map.png corner=0.52
+//     decale disk 410 140 34 Images/round-google.png
+//     deformer contact
+//     deformer gamut-hard-contact-max
+//     output preview.png
+//
+// The Deformers are applied in order, each one to all the Decales (the Deformer d to their field buffers of index d).
+// Deformers: contact, blend-contact, max, blend-max (between the Decales), gamut-hard-contact and gamut-hard-contact-max
+// (between the Decales and the Gamut, which needs a gamut statement).
+// The storage statement selects lossy storages of the field buffers (float or fixed16) and of the UV buffers (half)
+// to reduce the memory bandwidth; the buffers are stored in double by default.
+//
+
+#ifndef TEST_SCENEFILE_H
+#define TEST_SCENEFILE_H
+
+#include <string>
+#include <vector>
+
+
+struct DecaleDescription {
+    // disk, square or roundsquare
+    std::string shape;
+    double posx;
+    double posy;
+    double size;
+    // Path of the image of the Decale
+    std::string image;
+    // Rotation in radians
+    double rotation;
+    // Angle (in radians, from the x axis) from which the rounded corners start (roundsquare)
+    double cornerAngle;
+    double scalex;
+    double scaley;
+};
+
+struct SceneDescription {
+    unsigned int width;
+    unsigned int height;
+    // Colors as accepted by QColor (#RRGGBB or SVG names)
+    std::string backgroundColor;
+    std::string gamutColor;
+    // Path of the binary mask of the Gamut (no Gamut if empty) and radius of its falloff function
+    std::string gamutMask;
+    double gamutFallOff;
+    // Slope of the fallOff functions (Gamut and Decales)
+    unsigned int n;
+    // Storage of the field buffers (double, float or fixed16) and of the UV buffers (double or half)
+    std::string fieldStorage;
+    std::string uvStorage;
+    std::vector<DecaleDescription> decales;
+    std::vector<std::string> deformers;
+    // Path of the rendered image (empty for the default one, see SceneRenderer)
+    std::string output;
+};
+
+/**
+ * Read the scene file fileName in scene.
+ * @return false (and the reason, with its line, in error) if the file cannot be read or is not a valid scene
+ */
+bool readSceneFile (const std::string &fileName, SceneDescription &scene, std::string &error);
+
+
+#endif //TEST_SCENEFILE_H
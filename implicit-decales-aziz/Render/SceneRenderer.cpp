@@ -0,0 +1,218 @@
+//
+// Headless rendering of a scene description.
+//
+
+#include "SceneRenderer.h"
+#include "../Decale/DecaleDiskField2D.h"
+#include "../Decale/DecaleSquareField2D.h"
+#include "../Decale/DecaleRoundCornerSquareField2D.h"
+#include "../Deformer2D/Deformer2DContact.h"
+#include "../Deformer2D/Deformer2DBlendContact.h"
+#include "../Deformer2D/Deformer2DMax.h"
+#include "../Deformer2D/Deformer2DBlendMax.h"
+#include "../Deformer2D/DeformerPipeline2D.h"
+#include "../Gamut/GamutDeformer2DBinaryHardContact.h"
+#include "../Gamut/GamutDeformer2DBinaryHardContactMax.h"
+#include "../Field2D/imagefield.h"
+#include <QImageReader>
+#include <QColor>
+
+
+/***********************************
+// Color of the scene file (#RRGGBB or SVG name)
+***********************************/
+static bool readColor (const std::string &name, Color &color, std::string &error) {
+
+    QColor qc (QString::fromStdString(name));
+    if (!qc.isValid()) {
+        error = "invalid color " + name;
+        return false;
+    }
+    color = Color(qc);
+    return true;
+}
+
+/***********************************
+// Storages of the scene file (validated by readSceneFile)
+***********************************/
+static FieldStorage fieldStorage (const std::string &name) {
+
+    if (name == "float") return FIELD_STORAGE_FLOAT;
+    if (name == "fixed16") return FIELD_STORAGE_FIXED16;
+    return FIELD_STORAGE_DOUBLE;
+}
+
+static UVStorage uvStorage (const std::string &name) {
+
+    return (name == "half") ? UV_STORAGE_HALF : UV_STORAGE_DOUBLE;
+}
+
+
+SceneRenderer::SceneRenderer () : gamutDistanceField(NULL), gamut(NULL), image(NULL), textureAtlas(NULL) {}
+
+SceneRenderer::~SceneRenderer () {
+
+    clear();
+}
+
+void SceneRenderer::clear () {
+
+    /***********************************
+    // The buffers go back to the pool of the renderer, which is trimmed between the scenes
+    ***********************************/
+    for (unsigned int i=0; i<deformers.size(); i++) delete deformers[i];
+    for (unsigned int i=0; i<decales.size(); i++) delete decales[i];
+    for (unsigned int i=0; i<decaleImages.size(); i++) delete decaleImages[i];
+    deformers.clear();
+    decales.clear();
+    decaleImages.clear();
+
+    delete gamut;
+    delete gamutDistanceField;
+    delete image;
+    delete textureAtlas;
+    gamut = NULL;
+    gamutDistanceField = NULL;
+    image = NULL;
+    textureAtlas = NULL;
+
+    bufferPool.trim();
+}
+
+bool SceneRenderer::buildGamut (const SceneDescription &scene, std::string &error) {
+
+    if (scene.gamutMask.empty()) return true;
+
+    QString mask = QString::fromStdString(scene.gamutMask);
+    if (!QImageReader(mask).canRead()) {
+        error = scene.gamutMask + ": cannot read the Gamut mask";
+        return false;
+    }
+
+    /***********************************
+    // The distance field of the mask and the Gamut field buffer are cached next to the mask (shared by the scenes)
+    ***********************************/
+    ImageField *distanceField = new ImageField(mask, NULL, mask + ".sdf.cache");
+    gamutDistanceField = distanceField;
+
+    gamut = new GamutField2D(distanceField, 0, 0, scene.width, scene.height, scene.gamutFallOff, scene.n);
+    gamut->setStorage(fieldStorage(scene.fieldStorage));
+    gamut->setBufferPool(&bufferPool);
+    gamut->setCache((mask + ".gamut.cache").toStdString(), distanceField->getMaskKey());
+    gamut->computeDiscreteField();
+
+    return true;
+}
+
+bool SceneRenderer::buildDecales (const SceneDescription &scene, std::string &error) {
+
+    for (unsigned int k=0; k<scene.decales.size(); k++) {
+        const DecaleDescription &description = scene.decales[k];
+
+        ColorImage *decaleImage = new ColorImage(QString::fromStdString(description.image), k);
+        decaleImages.push_back(decaleImage);
+        if (decaleImage->getQImage().isNull()) {
+            error = description.image + ": cannot read the Decale image";
+            return false;
+        }
+        decaleImage->setTextureAtlas(textureAtlas);
+
+        DecaleScalarField2D *decale;
+        if (description.shape == "disk")
+            decale = new DecaleDiskField2D(description.posx, description.posy, description.size, k, 0, scene.n);
+        else if (description.shape == "square")
+            decale = new DecaleSquareField2D(description.posx, description.posy, description.size, k, 0, scene.n);
+        else
+            decale = new DecaleRoundCornerSquareField2D(description.posx, description.posy, description.size,
+                                                        description.cornerAngle, k, 0, scene.n);
+        decales.push_back(decale);
+
+        if (description.rotation != 0.) decale->rotate(description.rotation);
+        if ((description.scalex != 1.) || (description.scaley != 1.)) decale->scale(description.scalex, description.scaley);
+
+        decale->setStorage(fieldStorage(scene.fieldStorage), uvStorage(scene.uvStorage));
+        decale->setBufferPool(&bufferPool);
+        decale->computeDiscreteField();
+    }
+    return true;
+}
+
+void SceneRenderer::buildDeformers (const SceneDescription &scene) {
+
+    if (decales.empty()) return;
+
+    /***********************************
+    // The Deformer d deforms all the Decales, from their field buffers of index d
+    ***********************************/
+    for (unsigned int d=0; d<scene.deformers.size(); d++) {
+        const std::string &name = scene.deformers[d];
+        Deformer2D *deformer;
+        unsigned int first = 0;
+
+        if (name == "contact") deformer = new Deformer2DContact();
+        else if (name == "blend-contact") deformer = new Deformer2DBlendContact();
+        else if (name == "max") deformer = new Deformer2DMax();
+        else if (name == "blend-max") deformer = new Deformer2DBlendMax();
+        else {
+            if (name == "gamut-hard-contact") deformer = new GamutDeformer2DBinaryHardContact(gamut, decales[0], d);
+            else deformer = new GamutDeformer2DBinaryHardContactMax(gamut, decales[0], d);
+            first = 1;
+        }
+
+        for (unsigned int k=first; k<decales.size(); k++) deformer->addField(decales[k], d);
+        deformers.push_back(deformer);
+    }
+}
+
+bool SceneRenderer::render (const SceneDescription &scene, std::string &error) {
+
+    clear();
+
+    Color backgroundColor, gamutColor;
+    if (!readColor(scene.backgroundColor, backgroundColor, error) || !readColor(scene.gamutColor, gamutColor, error))
+        return false;
+
+    textureAtlas = new TextureAtlas();
+    if (!buildGamut(scene, error) || !buildDecales(scene, error)) return false;
+    buildDeformers(scene);
+
+    image = new ColorImage(scene.width, scene.height);
+    if (gamut != NULL) image->setBackground(gamut, gamutColor, backgroundColor);
+    else image->setColor(backgroundColor);
+
+    /***********************************
+    // Fused Deformers: the deformed fields and the UVs are computed per tile when drawing (no intermediate buffer).
+    // Otherwise, the Deformers are applied to the field buffers, then the UV buffers are computed from the last ones.
+    ***********************************/
+    DeformerPipeline2D pipeline;
+    pipeline.setDecales(decales);
+    pipeline.setDeformers(deformers);
+
+    QRect canvas (0, 0, scene.width, scene.height);
+    if (pipeline.isFusable()) {
+        pipeline.prepare();
+        pipeline.draw(image, decaleImages, canvas);
+        return true;
+    }
+
+    for (unsigned int d=0; d<deformers.size(); d++) deformers[d]->applyToDiscreteFields();
+    for (unsigned int k=0; k<decales.size(); k++) {
+        decales[k]->computeDiscreteUVField(decales[k]->getNbDiscreteFields() - 1);
+        image->addColorImageWithDecaleUV(decales[k], decaleImages[k], canvas);
+    }
+    return true;
+}
+
+bool SceneRenderer::save (const std::string &fileName, std::string &error) {
+
+    if ((image == NULL) || !image->getQImage().save(QString::fromStdString(fileName))) {
+        error = fileName + ": cannot write the image";
+        return false;
+    }
+    return true;
+}
+
+ColorImage *SceneRenderer::getImage () {
+
+    return image;
+}
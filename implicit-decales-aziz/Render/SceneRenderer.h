@@ -0,0 +1,68 @@
+//
+// Headless rendering of a scene description: builds the Gamut, the Decales, their images and the Deformers of the
+// scene, and draws them in an image (no widget, no display).
+//
+// A renderer owns everything it builds (including its buffer pool and texture atlas) and draws on the calling thread,
+// so that several scenes can be rendered in parallel, one renderer per thread.
+//
+
+#ifndef TEST_SCENERENDERER_H
+#define TEST_SCENERENDERER_H
+
+#include "SceneFile.h"
+#include "../Tools/ColorImage.h"
+#include "../Tools/BufferPool.h"
+#include "../Tools/TextureAtlas.h"
+#include "../Decale/DecaleScalarField2D.h"
+#include "../Deformer2D/Deformer2D.h"
+#include "../Gamut/GamutField2D.h"
+#include <string>
+
+
+class SceneRenderer {
+
+public:
+
+    SceneRenderer ();
+    /**
+     * Release the fields, the Deformers and the images of the scene
+     */
+    ~SceneRenderer ();
+
+    /**
+     * Build the scene (replaces the previous one) and draw it in the image of the renderer.
+     * @return false (and the reason in error) if an image or the Gamut mask cannot be read, or a color is not valid
+     */
+    bool render (const SceneDescription &scene, std::string &error);
+
+    /**
+     * Save the rendered image (the format is deduced from the file extension, PNG for .png).
+     * @return false (and the reason in error) if the file cannot be written
+     */
+    bool save (const std::string &fileName, std::string &error);
+
+    ColorImage *getImage ();
+
+private:
+
+    SceneRenderer (const SceneRenderer &);
+    SceneRenderer &operator = (const SceneRenderer &);
+
+    bool buildGamut (const SceneDescription &scene, std::string &error);
+    bool buildDecales (const SceneDescription &scene, std::string &error);
+    void buildDeformers (const SceneDescription &scene);
+    void clear ();
+
+    VectorOfDecaleFields decales;
+    VectorOfColorImages decaleImages;
+    VectorOfDeformers deformers;
+    Field2D *gamutDistanceField;
+    GamutField2D *gamut;
+    ColorImage *image;
+
+    BufferPool bufferPool;
+    TextureAtlas *textureAtlas;
+};
+
+
+#endif //TEST_SCENERENDERER_H
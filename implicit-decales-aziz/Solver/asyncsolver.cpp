@@ -0,0 +1,92 @@
+//
+// Solver of the Decale layout running on its own thread.
+//
+
+#include "asyncsolver.h"
+#include <chrono>
+
+const int AsyncSolver::idleWait;
+
+AsyncSolver::AsyncSolver (MyDecalSolver *solver) : solver(solver), inputs(8), running(false) {}
+
+AsyncSolver::~AsyncSolver () {
+
+    stop();
+}
+
+void AsyncSolver::start () {
+
+    if (running) return;
+    running = true;
+    thread = std::thread(&AsyncSolver::work, this);
+}
+
+void AsyncSolver::stop () {
+
+    if (!running) return;
+    {
+        std::lock_guard<std::mutex> lock (sleepMutex);
+        running = false;
+    }
+    wakeUp.notify_one();
+    thread.join();
+
+    // Inputs and results of the previous Decales are dropped (stop precedes the changes of the Decales)
+    DecaleLayout dropped;
+    while (inputs.pop(dropped)) {}
+    results.update();
+}
+
+bool AsyncSolver::isRunning () const {
+
+    return running;
+}
+
+bool AsyncSolver::submit (const DecaleLayout &input) {
+
+    if (!inputs.push(input)) return false;
+    wakeUp.notify_one();
+    return true;
+}
+
+bool AsyncSolver::retrieve (DecaleLayout &result) {
+
+    if (!results.update()) return false;
+    result = results.front();
+    return true;
+}
+
+void AsyncSolver::work () {
+
+    DecaleLayout input;
+    bool solving = false;
+
+    while (running) {
+
+        /***********************************
+        // Only the newest input is solved: the ones pushed while the solver was busy are skipped
+        ***********************************/
+        bool received = false;
+        while (inputs.pop(input)) received = true;
+        if (received) {
+            solver->setLayout(input);
+            solving = true;
+        }
+
+        if (!solving) {
+            std::unique_lock<std::mutex> lock (sleepMutex);
+            if (running && inputs.isEmpty()) wakeUp.wait_for(lock, std::chrono::milliseconds(idleWait));
+            continue;
+        }
+
+        /***********************************
+        // One budget of iterations, then the positions are published (partial results of an unfinished solve too)
+        ***********************************/
+        solving = !solver->solve();
+
+        DecaleLayout &result = results.back();
+        result = solver->getLayout();
+        result.finished = !solving;
+        results.publish();
+    }
+}
@@ -0,0 +1,75 @@
+//
+// Solver of the Decale layout running on its own thread.
+//
+// The GUI thread pushes inputs (DecaleLayout snapshots of the Decales) in a lock-free queue, and takes the newest
+// solved positions from a lock-free triple buffer: it never waits for the solver. The solver thread only solves from
+// the newest input (the older ones are dropped), within the budget of MyDecalSolver::solve, and publishes the
+// positions after each call so that an unfinished solve is drawn progressively.
+//
+
+#ifndef TEST_ASYNCSOLVER_H
+#define TEST_ASYNCSOLVER_H
+
+#include "mydecalsolver.h"
+#include "../Tools/SPSCQueue.h"
+#include "../Tools/TripleBuffer.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+
+class AsyncSolver {
+
+public:
+
+    explicit AsyncSolver (MyDecalSolver *solver);
+    /**
+     * Stops and joins the solver thread
+     */
+    ~AsyncSolver ();
+
+    /**
+     * Starts the solver thread. The solver has to be initialized, and is only used by this thread until stop().
+     */
+    void start ();
+    /**
+     * Stops and joins the solver thread (the unfinished solve is abandoned)
+     */
+    void stop ();
+    bool isRunning () const;
+
+    /**
+     * Hand a new input to the solver thread (GUI thread only, never waits).
+     * @return false if the queue of inputs is full: the input has to be submitted again later
+     */
+    bool submit (const DecaleLayout &input);
+    /**
+     * Take the newest positions published by the solver thread in result (GUI thread only, never waits).
+     * @return false if nothing was published since the last call (result is unchanged)
+     */
+    bool retrieve (DecaleLayout &result);
+
+private:
+
+    AsyncSolver (const AsyncSolver &);
+    AsyncSolver &operator = (const AsyncSolver &);
+
+    void work ();
+
+    MyDecalSolver *solver;
+
+    SPSCQueue<DecaleLayout> inputs;
+    TripleBuffer<DecaleLayout> results;
+
+    std::thread thread;
+    std::atomic<bool> running;
+
+    // The idle solver thread sleeps until an input is submitted (or for idleWait milliseconds, since submit does not lock)
+    std::mutex sleepMutex;
+    std::condition_variable wakeUp;
+    static const int idleWait = 5;
+};
+
+
+#endif //TEST_ASYNCSOLVER_H
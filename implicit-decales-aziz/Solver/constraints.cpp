@@ -1,5 +1,6 @@
 #include "constraints.h"
 #include <iostream>
+#include <algorithm>
 #include <map>
 
 int costFactor = 1;
@@ -59,12 +60,10 @@ pse_res_t Constraints::gamut_constratint(const pse_eval_ctxt_t *, const pse_eval
         };
 
         if(isInsideTheImage(m,n,int(width),int(height))) {
-            std::map<pse_ppoint_id_t, DecaleScalarField2D*>::iterator it;
-            it = MyDecalSolver::mydecalsmap.find(ppidx);
             signedDistance = std::max(
                         0.0,
                         getGamutValue(m, n, x, y ) +
-                        MyDecalSolver::mydecalsmap.at(it->first)->getSize() // radius
+                        MyDecalSolver::getDecaleSize(ppidx) // radius
                                       );
             costs[i] = ( signedDistance > 0. ) ? computeCost( signedDistance ) : 0.0;
 
@@ -134,13 +133,8 @@ pse_res_t Constraints::min_dist_constratint(const pse_eval_ctxt_t *eval_ctxt,
 
         double dist = std::max(std::abs(x2-x1), std::abs(y2-y1));
 
-        std::map<pse_ppoint_id_t, DecaleScalarField2D*>::iterator it1;
-        std::map<pse_ppoint_id_t, DecaleScalarField2D*>::iterator it2;
-        it1 = MyDecalSolver::mydecalsmap.find(ppidx1);
-        it2 = MyDecalSolver::mydecalsmap.find(ppidx2);
-
-        double r1 = MyDecalSolver::mydecalsmap.at(it1->first)->getSize();
-        double r2 = MyDecalSolver::mydecalsmap.at(it2->first)->getSize();
+        double r1 = MyDecalSolver::getDecaleSize(ppidx1);
+        double r2 = MyDecalSolver::getDecaleSize(ppidx2);
 
         costs[i] = costFactor * std::min(0.0, dist-r1-r2);
 
@@ -177,24 +171,11 @@ pse_res_t Constraints::max_dist_constratint(const pse_eval_ctxt_t *eval_ctxt,
 
         //double dist = std::max(std::abs(x2-x1), std::abs(y2-y1));//L1 dist
 
-        std::map<pse_ppoint_id_t, DecaleScalarField2D*>::iterator it1;
-        std::map<pse_ppoint_id_t, DecaleScalarField2D*>::iterator it2;
-        it1 = MyDecalSolver::mydecalsmap.find(ppidx1);
-        it2 = MyDecalSolver::mydecalsmap.find(ppidx2);
-
-        int id1 = it1->first;
-        int id2 = it2->first;
-
         double maxDist = 150; //if <150 collision doesn't work
         double f =  std::max(0.0, dist - maxDist);
 
-        //2 decals relation
-
-        //C
-        if( id1 == 0 and id2 == 2)
-            costs[i] = f;
-        else
-            costs[i] = 0;
+        //2 decals relation: the pair of max_dist_decales
+        costs[i] = f;
 
         costs[i] *= costFactor;
     }
@@ -202,6 +183,154 @@ pse_res_t Constraints::max_dist_constratint(const pse_eval_ctxt_t *eval_ctxt,
     return RES_OK;
 }
 
+pse_res_t Constraints::gamut_constratint_df(const pse_eval_ctxt_t *, const pse_eval_coordinates_t *eval_coords, pse_eval_relshps_t *eval_relshps, pse_real_t *grads)
+{
+    assert(eval_relshps->count == 1);
+    const struct pse_eval_relshp_data_t* data = eval_relshps->data[0];
+    const size_t count = data->ppoints_count;
+
+    auto gamut = MyDecalSolver::mygamut;
+
+    size_t height = gamut->getIHeight();
+    size_t width  = gamut->getIWidth();
+
+    // The cost of a point only depends on this point: only its derivatives are given (per point)
+    std::fill(grads, grads + count*2, 0.);
+
+    for(size_t i = 0; i < count; ++i) {
+        pse_real_t *grad = grads + i*2;
+
+        const pse_ppoint_id_t ppidx = data->ppoints[i];
+        const pse_real_t x = eval_coords->coords[i*2+0];
+        const pse_real_t y = eval_coords->coords[i*2+1];
+
+        int m = int(floor(x-2.5) + 1);
+        int n = int(floor(y-2.5) + 1);
+
+        if(isInsideTheImage(m,n,int(width),int(height))) {
+            // bilinear interpolation of gamut_constratint, constant on the borders of the distance field
+            if (m == 0 or n == 0) continue;
+
+            const double f00 = gamut->getDistanceField()->eval(m-1,n-1);
+            const double f01 = gamut->getDistanceField()->eval(m-1,n);
+            const double f10 = gamut->getDistanceField()->eval(m,n-1);
+            const double f11 = gamut->getDistanceField()->eval(m,n);
+            const double value = ( (m-x)    *( ((n-y)     * f00) + ((y-(n-1)) * f01) )) +
+                                 ( (x-(m-1))*( ((n-y)     * f10) + ((y-(n-1)) * f11) ));
+            if (value + MyDecalSolver::getDecaleSize(ppidx) <= 0.) continue;
+
+            grad[0] = costFactor * ( -((n-y) * f00 + (y-(n-1)) * f01) + ((n-y) * f10 + (y-(n-1)) * f11) );
+            grad[1] = costFactor * ( (m-x) * (f01 - f00) + (x-(m-1)) * (f11 - f10) );
+
+        }else{
+            // only the distance to the boundary depends on the position
+            auto corner = [grad](double dx, double dy) {
+                double dist = std::sqrt(dx*dx + dy*dy);
+                if (dist > 0.) {
+                    grad[0] = costFactor * dx / dist;
+                    grad[1] = costFactor * dy / dist;
+                }
+            };
+            if(y < 0 and x > 0 and x <= width){//top
+                grad[1] = costFactor;
+            }else if(y >=height and x > 0 and x <= width){//bottom
+                grad[1] = costFactor;
+            }else if(x < 0 and y > 0 and y <= height){//left
+                grad[0] = costFactor;
+            }else if(x >=width and y > 0 and y <= height){//right
+                grad[0] = costFactor;
+            }else if(x < 0 and y < 0){//top left
+                corner(x-0, y-0);
+            }else if(x >=width and y < 0){//top right
+                corner(x-width, y-0);
+            }else if(x < 0 and y >= height){//bottom left
+                corner(x-0, y-height);
+            }else if(x >=width and y >= height){//bottom right
+                corner(x-width, y-height);
+            }
+        }
+    }
+    return RES_OK;
+}
+
+pse_res_t Constraints::min_dist_constratint_df(const pse_eval_ctxt_t *eval_ctxt,
+                                               const pse_eval_coordinates_t *eval_coords,
+                                               pse_eval_relshps_t *eval_relshps,
+                                               pse_real_t *grads)
+{
+    size_t i;
+    (void)eval_ctxt;
+
+    for(i = 0; i < eval_relshps->count; ++i) {
+        const struct pse_eval_relshp_data_t* data = eval_relshps->data[i];
+        assert(data->ppoints_count == 2);
+
+        const pse_ppoint_id_t ppidx1 = data->ppoints[0];
+        const pse_ppoint_id_t ppidx2 = data->ppoints[1];
+
+        const pse_real_t dx = eval_coords->coords[ppidx2*2+0] - eval_coords->coords[ppidx1*2+0];
+        const pse_real_t dy = eval_coords->coords[ppidx2*2+1] - eval_coords->coords[ppidx1*2+1];
+
+        double dist = std::max(std::abs(dx), std::abs(dy));
+
+        double r1 = MyDecalSolver::getDecaleSize(ppidx1);
+        double r2 = MyDecalSolver::getDecaleSize(ppidx2);
+
+        // x1, y1, x2, y2: only the largest of the coordinates differences counts while overlapping
+        pse_real_t *grad = grads + i*4;
+        std::fill(grad, grad + 4, 0.);
+        if (dist-r1-r2 >= 0.) continue;
+
+        const int axis = (std::abs(dx) >= std::abs(dy)) ? 0 : 1;
+        const double sign = ((axis == 0 ? dx : dy) >= 0.) ? 1. : -1.;
+        grad[axis]   = -costFactor * sign;
+        grad[2+axis] =  costFactor * sign;
+    }
+
+    return RES_OK;
+}
+
+pse_res_t Constraints::max_dist_constratint_df(const pse_eval_ctxt_t *eval_ctxt,
+                                               const pse_eval_coordinates_t *eval_coords,
+                                               pse_eval_relshps_t *eval_relshps,
+                                               pse_real_t *grads)
+{
+    size_t i;
+    (void)eval_ctxt;
+
+    for(i = 0; i < eval_relshps->count; ++i) {
+        const struct pse_eval_relshp_data_t* data = eval_relshps->data[i];
+        assert(data->ppoints_count == 2);
+
+        const pse_ppoint_id_t ppidx1 = data->ppoints[0];
+        const pse_ppoint_id_t ppidx2 = data->ppoints[1];
+
+        const pse_real_t dx = eval_coords->coords[ppidx2*2+0] - eval_coords->coords[ppidx1*2+0];
+        const pse_real_t dy = eval_coords->coords[ppidx2*2+1] - eval_coords->coords[ppidx1*2+1];
+
+        double dist = std::sqrt(dx*dx + dy*dy);
+
+        double maxDist = 150;
+
+        // x1, y1, x2, y2: the L2 distance only counts beyond maxDist
+        pse_real_t *grad = grads + i*4;
+        std::fill(grad, grad + 4, 0.);
+        if (dist <= maxDist) continue;
+
+        grad[0] = -costFactor * dx / dist;
+        grad[1] = -costFactor * dy / dist;
+        grad[2] =  costFactor * dx / dist;
+        grad[3] =  costFactor * dy / dist;
+    }
+
+    return RES_OK;
+}
+
+std::array<unsigned int, 2> Constraints::max_dist_decales()
+{
+    return {{0, 2}};
+}
+
 static enum pse_res_t alignement(
         const struct pse_eval_ctxt_t* eval_ctxt,
                      const struct pse_eval_coordinates_t* eval_coords,
@@ -30,6 +30,30 @@ public:
              const struct pse_eval_coordinates_t* eval_coords,
              struct pse_eval_relshps_t* eval_relshps,
              pse_real_t* costs);
+    /**
+     * Analytic gradients of the costs above (compute_df of the cost functors): for each cost, the derivatives with
+     * respect to x and y of each point of its relationship, or of its point only for the costs per point of the gamut
+     */
+    static enum pse_res_t gamut_constratint_df
+            (const struct pse_eval_ctxt_t* eval_ctxt,
+             const struct pse_eval_coordinates_t* eval_coords,
+             struct pse_eval_relshps_t* eval_relshps,
+             pse_real_t* grads);
+    static enum pse_res_t min_dist_constratint_df
+            (const struct pse_eval_ctxt_t* eval_ctxt,
+             const struct pse_eval_coordinates_t* eval_coords,
+             struct pse_eval_relshps_t* eval_relshps,
+             pse_real_t* grads);
+    static enum pse_res_t max_dist_constratint_df
+            (const struct pse_eval_ctxt_t* eval_ctxt,
+             const struct pse_eval_coordinates_t* eval_coords,
+             struct pse_eval_relshps_t* eval_relshps,
+             pse_real_t* grads);
+    /**
+     * Ids (getId) of the two Decales kept at most 150 apart by max_dist_constratint: only their pair has a max_dist
+     * relationship
+     */
+    static std::array<unsigned int, 2> max_dist_decales();
     static enum pse_res_t alignement(
             const struct pse_eval_ctxt_t* eval_ctxt,
                          const struct pse_eval_coordinates_t* eval_coords,
@@ -2,15 +2,17 @@
 #include <vector>
 #include <map>
 #include <iostream>
+#include <chrono>
+#include <algorithm>
 
 GenericSolver::GenericSolver()
 {
     std::cout<<"generic solver: constructor"<<std::endl;
     /* Create the device that will load the driver */
 #ifdef __gnu_linux__
-    devp.backend_drv_filepath = PSE_LIB_NAME("pse-drv-eigen-ref");
+    devp.backend_drv_filepath = PSE_LIB_NAME("pse-drv-eigen");
 #else
-    devp.backend_drv_filepath = PSE_LIB_NAME("libpse-drv-eigen-ref");
+    devp.backend_drv_filepath = PSE_LIB_NAME("libpse-drv-eigen");
 #endif
     //devp.logger = &PSE_LOGGER_STDOUT;
     PSE_CALL(pseDeviceCreate(&devp, &dev));
@@ -26,6 +28,7 @@ void GenericSolver::init()
 
    //destroy curent state of cps
    if(ctxt!=nullptr){
+       endSolve();
        PSE_CALL(pseConstrainedParameterSpaceExplorationContextRefSub(ctxt));
    }
    if( cps != nullptr ) {
@@ -55,56 +58,294 @@ void GenericSolver::init()
    coords_data.as.global.accessors.ctxt = this;//send current state to the context
    PSE_CALL(pseConstrainedParameterSpaceValuesCreate(cps, &coords_data, &coords));
 
+   /* To call on the CPS when its structure change */
+   ecp.pspace.explore_in = r2_uid;
+   ecp.options.auto_df_epsilon = //0.00000001
+                                   0.00001
+                                 ;
+   ecp.options.max_convergence_tries = //1000000
+                                         100000
+                                       ;
+   ecp.options.until_convergence = true;
+   // Each cost only depends on one or two Decales: the Jacobian is mostly zeros
+   ecp.options.jacobian = PSE_CPSPACE_EXPLORATION_JACOBIAN_SPARSE;
+
+   internal_preupdate_globalrelationships();
+
+   //the points are added to the empty space as they are added later (no exploration context yet)
    internal_preupdate_assignnpoints();//size_t nPoints = decalDataArray.size();
-   size_t nRelshsps = (nPoints*nPoints-nPoints) / 2;// according to adjacenecy matrix
+   size_t count = nPoints;
+   nPoints = 0;
+   ctxt = nullptr;
+   explorationOutdated = true;
+   ppids.clear();
+   pointRelshps.clear();
+   relshpPoints.clear();
+   pairRelshps.clear();
+   activePairs.clear();
+   addPoints(count);
+   std::cout<<"nRelshsps:::  "<<relshpPoints.size()<<std::endl;
+}
 
-   //starting over the state of the cps
-   std::vector<pse_ppoint_params_t> ppp(nPoints, PSE_PPOINT_PARAMS_NULL);
-   std::vector<pse_ppoint_id_t> ppids(nPoints, PSE_PPOINT_ID_INVALID_);
+void GenericSolver::addPoints(size_t count)
+{
+   if(count == 0) return;
 
-   std::vector< std::array<pse_ppoint_id_t, 2> > pppairs(nRelshsps);
+   std::vector<pse_ppoint_params_t> ppp(count, PSE_PPOINT_PARAMS_NULL);
+   std::vector<pse_ppoint_id_t> newppids(count, PSE_PPOINT_ID_INVALID_);
+   PSE_CALL(pseConstrainedParameterSpaceParametricPointsAdd(cps,count,ppp.data(),newppids.data()));
+
+   size_t first = nPoints;
+   nPoints += count;
+   ppids.insert(ppids.end(), newppids.begin(), newppids.end());
+   //the driver indexes the points by id
+   assert(ppids[nPoints-1] == nPoints-1);
 
-   PSE_CALL(pseConstrainedParameterSpaceParametricPointsAdd(cps,nPoints,ppp.data(),ppids.data()));
    //mapping
-   internal_preupdate_mapping(ppids);
-
-   //1 to 1 relation
-   //c - to change number of pairs 0 and 1
-   //iterate over hald of adjacency matrix - undirected graph
-   //making the pairs
-   size_t c = 0;
-
-   for(size_t i = 0; i <nPoints-1; i++){
-       for(size_t j = i+1; j <nPoints; j++){
-           pppairs[c][0] = ppids[i];
-           pppairs[c][1] = ppids[j];
-           c++;
+   internal_preupdate_mapping(first, count);
+   //the pairs of the new points with their neighbours are made by the next selection of the pairs
+   explorationOutdated = true;
+   solveSteps = 0;
+}
+
+void GenericSolver::removePoint(size_t index)
+{
+   assert(index < nPoints);
+   size_t last = nPoints - 1;
+   pse_ppoint_id_t removed = ppids[index];
+   pse_ppoint_id_t lastppid = ppids[last];
+
+   /***********************************
+   // The relationships of the removed point and of the last one go, the last point is removed from the space,
+   // and the pairs of the last point (with its neighbours only) are made again under the id of the removed one
+   ***********************************/
+   std::vector< std::array<pse_ppoint_id_t, 2> > pppairs;
+   if(index != last){
+       std::map<pse_ppoint_id_t, std::vector<pse_relshp_id_t> >::const_iterator it = pointRelshps.find(lastppid);
+       if(it != pointRelshps.end()){
+           std::set<pse_ppoint_id_t> others;
+           for(pse_relshp_id_t rid : it->second){
+               const std::array<pse_ppoint_id_t, 2> &pair = relshpPoints.at(rid);
+               others.insert(pair[0] == lastppid ? pair[1] : pair[0]);
+           }
+           others.erase(removed);
+           for(pse_ppoint_id_t other : others) pppairs.push_back(pairKey({{removed, other}}));
        }
+   }
+   removeRelationshipsOf(removed);
+   if(index != last) removeRelationshipsOf(lastppid);
+   PSE_CALL(pseConstrainedParameterSpaceParametricPointsRemove(cps, 1, &lastppid));
+   ppids.pop_back();
+   nPoints--;
 
+   internal_preupdate_mapping(index, index != last ? 1 : 0);
+   addPairRelationships(pppairs);
+   explorationOutdated = true;
+   solveSteps = 0;
+}
+
+void GenericSolver::addPairRelationships(const std::vector< std::array<pse_ppoint_id_t, 2> > &pppairs)
+{
+   if(pppairs.empty()) return;
+
+   std::vector<pse_relshp_id_t> rids;
+   std::vector<size_t> ridPairs;
+   internal_preupdate_constraintrelationships(pppairs, rids, ridPairs);
+   for(size_t k = 0; k < rids.size(); k++){
+       const std::array<pse_ppoint_id_t, 2> &pair = pppairs[ridPairs[k]];
+       relshpPoints[rids[k]] = pair;
+       pointRelshps[pair[0]].push_back(rids[k]);
+       pointRelshps[pair[1]].push_back(rids[k]);
+       pairRelshps[pairKey(pair)].push_back(rids[k]);
    }
-   //making the relationships between points
-   internal_preupdate_constraintrelationships(nRelshsps, pppairs);
-   std::cout<<"nRelshsps:::  "<<nRelshsps<<std::endl;
+   //the relationships are enabled when added, until the next selection of the active pairs
+   for(const std::array<pse_ppoint_id_t, 2> &pair : pppairs) activePairs.insert(pairKey(pair));
+}
 
+void GenericSolver::removeRelationshipsOf(pse_ppoint_id_t ppid)
+{
+   std::map<pse_ppoint_id_t, std::vector<pse_relshp_id_t> >::iterator it = pointRelshps.find(ppid);
+   if(it == pointRelshps.end()) return;
 
-   /* To call on the CPS when its structure change */
-   ecp.pspace.explore_in = r2_uid;
-   ecp.options.auto_df_epsilon = //0.00000001
-                                   0.00001
-                                 ;
-   ecp.options.max_convergence_tries = //1000000
-                                         100000
-                                       ;
-   ecp.options.until_convergence = true;
+   std::vector<pse_relshp_id_t> rids;
+   rids.swap(it->second);
+   pointRelshps.erase(it);
+
+   //the relationships are forgotten by the other point of their pair
+   for(pse_relshp_id_t rid : rids){
+       const std::array<pse_ppoint_id_t, 2> pair = relshpPoints.at(rid);
+       std::vector<pse_relshp_id_t> &other = pointRelshps[pair[0] == ppid ? pair[1] : pair[0]];
+       other.erase(std::find(other.begin(), other.end(), rid));
+       relshpPoints.erase(rid);
+       pairRelshps.erase(pairKey(pair));
+       activePairs.erase(pairKey(pair));
+   }
+   if(!rids.empty()) PSE_CALL(pseConstrainedParameterSpaceRelationshipsRemove(cps, rids.size(), rids.data()));
+}
+
+bool GenericSolver::setPairs(const std::vector< std::array<pse_ppoint_id_t, 2> > &pairs)
+{
+   std::set< std::array<pse_ppoint_id_t, 2> > kept;
+   for(const std::array<pse_ppoint_id_t, 2> &pair : pairs) kept.insert(pairKey(pair));
+
+   /***********************************
+   // Only the relationships of the pairs entering or leaving the set are made or removed
+   ***********************************/
+   std::vector< std::array<pse_ppoint_id_t, 2> > added;
+   for(const std::array<pse_ppoint_id_t, 2> &pair : kept){
+       if(pairRelshps.count(pair) == 0) added.push_back(pair);
+   }
+   std::vector<pse_relshp_id_t> removed;
+   for(const std::pair<const std::array<pse_ppoint_id_t, 2>, std::vector<pse_relshp_id_t> > &entry : pairRelshps){
+       if(kept.count(entry.first) == 0) removed.insert(removed.end(), entry.second.begin(), entry.second.end());
+   }
+   if(added.empty() && removed.empty()) return false;
+
+   for(pse_relshp_id_t rid : removed){
+       const std::array<pse_ppoint_id_t, 2> pair = relshpPoints.at(rid);
+       for(pse_ppoint_id_t ppid : pair){
+           std::vector<pse_relshp_id_t> &rids = pointRelshps[ppid];
+           rids.erase(std::find(rids.begin(), rids.end(), rid));
+       }
+       relshpPoints.erase(rid);
+       pairRelshps.erase(pairKey(pair));
+       activePairs.erase(pairKey(pair));
+   }
+   if(!removed.empty()) PSE_CALL(pseConstrainedParameterSpaceRelationshipsRemove(cps, removed.size(), removed.data()));
+   addPairRelationships(added);
+   explorationOutdated = true;
+   return true;
+}
+
+bool GenericSolver::setActivePairs(const std::vector< std::array<pse_ppoint_id_t, 2> > &pairs)
+{
+   std::set< std::array<pse_ppoint_id_t, 2> > active;
+   for(const std::array<pse_ppoint_id_t, 2> &pair : pairs){
+       if(pairRelshps.count(pairKey(pair))) active.insert(pairKey(pair));
+   }
+
+   /***********************************
+   // Only the relationships of the pairs entering or leaving the active set change state. The exploration context
+   // takes the new states at the beginning of the next solve: it is not created again.
+   ***********************************/
+   std::vector<pse_relshp_id_t> enabled, disabled;
+   for(const std::array<pse_ppoint_id_t, 2> &pair : active){
+       if(activePairs.count(pair) == 0){
+           const std::vector<pse_relshp_id_t> &rids = pairRelshps.at(pair);
+           enabled.insert(enabled.end(), rids.begin(), rids.end());
+       }
+   }
+   for(const std::array<pse_ppoint_id_t, 2> &pair : activePairs){
+       if(active.count(pair) == 0){
+           const std::vector<pse_relshp_id_t> &rids = pairRelshps.at(pair);
+           disabled.insert(disabled.end(), rids.begin(), rids.end());
+       }
+   }
+   if(enabled.empty() && disabled.empty()) return false;
+
+   if(!enabled.empty()) PSE_CALL(pseConstrainedParameterSpaceRelationshipsSameStateSet(cps, enabled.size(), enabled.data(), PSE_CPSPACE_RELSHP_STATE_ENABLED));
+   if(!disabled.empty()) PSE_CALL(pseConstrainedParameterSpaceRelationshipsSameStateSet(cps, disabled.size(), disabled.data(), PSE_CPSPACE_RELSHP_STATE_DISABLED));
+   activePairs.swap(active);
+   solveOutdated = true;
+   return true;
+}
+
+std::array<pse_ppoint_id_t, 2> GenericSolver::pairKey(const std::array<pse_ppoint_id_t, 2> &pair)
+{
+   return {{std::min(pair[0], pair[1]), std::max(pair[0], pair[1])}};
+}
+
+void GenericSolver::updateExploration()
+{
+   if(ctxt != nullptr){
+       endSolve();
+       PSE_CALL(pseConstrainedParameterSpaceExplorationContextRefSub(ctxt));
+   }
    PSE_CALL(pseConstrainedParameterSpaceExplorationContextCreate(cps, &ecp, &ctxt));
+   explorationOutdated = false;
+}
+
+void GenericSolver::endSolve()
+{
+   if(!solving) return;
+   PSE_CALL(pseConstrainedParameterSpaceExplorationIterativeSolveEnd(ctxt));
+   solving = false;
 }
 
-void GenericSolver::solve()
+bool GenericSolver::solve()
 {
     //std::cout<<"solve"<<std::endl;
+    /***********************************
+    // The whole call counts against the budget, including the selection of the active pairs and the new exploration
+    // context after changes of the structure
+    ***********************************/
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::milli> budget (solveBudget);
+
+    internal_presolve_activepairs();
+    if (explorationOutdated || solveOutdated) endSolve();
+    if (explorationOutdated) updateExploration();
     smpls.values = coords;
-    PSE_CALL(pseConstrainedParameterSpaceExplorationSolve(ctxt, &smpls));
+
+    if (solveBudget <= 0.) {
+        endSolve();
+        //solved again while the solved positions bring new pairs of points into interaction
+        const int maxRefreshes = 8;
+        int refreshes = 0;
+        do {
+            if (explorationOutdated) updateExploration();
+            //not converged at the end of the tries: the positions are still the best ones found
+            enum pse_res_t res = pseConstrainedParameterSpaceExplorationSolve(ctxt, &smpls);
+            if ((res != RES_OK) && (res != RES_NOT_CONVERGED)) {
+                std::cout<<"solver: solve failed ("<<res<<")"<<std::endl;
+                break;
+            }
+            PSE_CALL(pseConstrainedParameterSpaceExplorationLastResultsRetreive(ctxt, coords, NULL));
+        } while (internal_presolve_activepairs() && ++refreshes < maxRefreshes);
+        solveOutdated = false;
+        return true;
+    }
+
+    /***********************************
+    // Iterations until convergence or the end of the budget. The iterative exploration is kept from one call to the
+    // next while its inputs and the structure of the space do not change, its partial results being applied after
+    // each call; it is begun again from the current positions otherwise (e.g. to follow the moved Decales).
+    ***********************************/
+    enum pse_res_t res = RES_NOT_CONVERGED;
+    if (!solving) {
+        res = pseConstrainedParameterSpaceExplorationIterativeSolveBegin(ctxt, &smpls);
+        solveOutdated = false;
+        if (res == RES_NOT_FOUND) {
+            solveSteps = 0;
+            return true;
+        }
+        if ((res != RES_OK) && (res != RES_NOT_CONVERGED)) {
+            std::cout<<"solver: begin failed ("<<res<<")"<<std::endl;
+            solveSteps = 0;
+            return true;
+        }
+        solving = true;
+    }
+
+    while ((res == RES_NOT_CONVERGED) && (solveSteps < ecp.options.max_convergence_tries)) {
+        res = pseConstrainedParameterSpaceExplorationIterativeSolveStep(ctxt);
+        solveSteps++;
+        if (std::chrono::steady_clock::now() - start >= budget) break;
+    }
+
     PSE_CALL(pseConstrainedParameterSpaceExplorationLastResultsRetreive(ctxt, coords, NULL));
+
+    bool finished = (res != RES_NOT_CONVERGED) || (solveSteps >= ecp.options.max_convergence_tries);
+    if (finished) endSolve();
+    //the points may have moved into new interactions: the solve goes on with them (still bounded by solveSteps)
+    if (finished && (solveSteps < ecp.options.max_convergence_tries) && internal_presolve_activepairs()) finished = false;
+    if (finished) solveSteps = 0;
+    return finished;
+}
+
+void GenericSolver::setSolveBudget(double milliseconds)
+{
+    solveBudget = milliseconds;
 }
 
 
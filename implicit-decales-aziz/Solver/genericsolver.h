@@ -2,10 +2,12 @@
 #define GENERICSOLVER_H
 #include <pse.h>
 #include <vector>
+#include <array>
 #include "../Decale/DecaleScalarField2D.h"
 #include "../Deformer2D/Deformer2D.h"
 #include <QString>
 #include <map>
+#include <set>
 
 
 class GenericSolver
@@ -14,16 +16,92 @@ public:
     GenericSolver();
 
     //functions
+    /**
+     * Build the constrained parameter space, with one parametric point per element (see internal_preupdate_assignnpoints)
+     */
     void init();
-    void solve();
+
+    /**
+     * Add count parametric points, without rebuilding the space. The new points get the indexes nPoints to
+     * nPoints+count-1; their relationships with their neighbours are made by the next selection of the pairs
+     * (see internal_presolve_activepairs).
+     */
+    void addPoints(size_t count);
+    /**
+     * Remove the parametric point of index and its relationships, without rebuilding the space.
+     * The last point takes its place (its index and its id), so that the ids stay 0 to nPoints-1 as the driver expects:
+     * the caller moves its last element to index the same way. Only the relationships of the two points change.
+     */
+    void removePoint(size_t index);
+
+    /**
+     * Solve the layout within the time budget (see setSolveBudget), and write the resulting positions through the
+     * accessors of the parametric points. An unfinished solve is resumed by the next call: its iterative exploration
+     * goes on if nothing changed since (see solveOutdated), else it is begun again from the written positions.
+     * @return true if the solve is finished (converged, failed, or nothing to optimize), false if it has to be resumed
+     */
+    bool solve();
+
+    /**
+     * Wall-clock time (in milliseconds) given to each call of solve, from its start (the selection of the active pairs
+     * and the new exploration contexts count). With 0, solve iterates until convergence.
+     * A call iterates at least once, so that an unfinished solve always progresses.
+     */
+    void setSolveBudget(double milliseconds);
 
 
 protected:
     virtual void internal_preupdate_assignconstraints() = 0;
-    virtual void internal_preupdate_constraintrelationships(size_t nRelshsps, std::vector< std::array<pse_ppoint_id_t, 2> > pppairs) = 0;
+    /**
+     * Add the relationships involving all the points (once, at init)
+     */
+    virtual void internal_preupdate_globalrelationships() = 0;
+    /**
+     * Add the relationships of the pairs of points, append their ids to rids and the index of their pair in pppairs to
+     * ridPairs (a pair may have several relationships)
+     */
+    virtual void internal_preupdate_constraintrelationships(const std::vector< std::array<pse_ppoint_id_t, 2> > &pppairs,
+                                                            std::vector<pse_relshp_id_t> &rids,
+                                                            std::vector<size_t> &ridPairs) = 0;
     virtual void internal_preupdate_assignnpoints() = 0;
-    virtual void internal_preupdate_mapping(std::vector<pse_ppoint_id_t> ppids) = 0;
+    /**
+     * Map the ids of the count points from index first to their elements, and forget the ids past the last point
+     */
+    virtual void internal_preupdate_mapping(size_t first, size_t count) = 0;
     virtual void internal_preupdate_setHandlers() = 0;
+    /**
+     * Make the relationships of the pairs of points that may have a cost soon (see setPairs), and enable the ones that
+     * can have a cost at the current positions (see setActivePairs).
+     * Called before each solve, and after a finished one to check that the points did not move into new interactions.
+     * @return true if the pairs or the enabled relationships changed
+     */
+    virtual bool internal_presolve_activepairs() = 0;
+
+    void addPairRelationships(const std::vector< std::array<pse_ppoint_id_t, 2> > &pppairs);
+    void removeRelationshipsOf(pse_ppoint_id_t ppid);
+    /**
+     * Make the relationships of the given pairs of points that do not have them yet, and remove the ones of the other
+     * pairs: only the pairs entering or leaving the set change.
+     * @return true if the pairs changed
+     */
+    bool setPairs(const std::vector< std::array<pse_ppoint_id_t, 2> > &pairs);
+    /**
+     * Enable the relationships of the given pairs of points, and disable the ones of the other pairs (the pairs without
+     * relationships are ignored). The disabled relationships stay in the space and in the exploration context, without
+     * cost nor Jacobian entry: only the solve is begun again (see solveOutdated).
+     * @return true if the enabled relationships changed
+     */
+    bool setActivePairs(const std::vector< std::array<pse_ppoint_id_t, 2> > &pairs);
+    static std::array<pse_ppoint_id_t, 2> pairKey(const std::array<pse_ppoint_id_t, 2> &pair);
+    /**
+     * New exploration context on the current structure of the space (the contexts work on a copy of it).
+     * Done by the next solve after changes of the structure, so that successive changes only pay it once.
+     */
+    void updateExploration();
+    /**
+     * End the iterative exploration begun by solve, if any (its partial results were already applied)
+     */
+    void endSolve();
 
 
 
@@ -55,11 +133,28 @@ protected:
 
     //update
     struct pse_cpspace_exploration_ctxt_params_t ecp = PSE_CPSPACE_EXPLORATION_CTXT_PARAMS_NULL;
-    size_t nPoints;
+    size_t nPoints = 0;
+    // Id of the parametric point of each index
     std::vector<pse_ppoint_id_t> ppids;
+    // Pair relationships of each parametric point, and the points of each pair relationship
+    std::map<pse_ppoint_id_t, std::vector<pse_relshp_id_t> > pointRelshps;
+    std::map<pse_relshp_id_t, std::array<pse_ppoint_id_t, 2> > relshpPoints;
+    // Relationships of each pair of points (smallest id first), and the pairs whose relationships are enabled
+    std::map<std::array<pse_ppoint_id_t, 2>, std::vector<pse_relshp_id_t> > pairRelshps;
+    std::set<std::array<pse_ppoint_id_t, 2> > activePairs;
 
     //solve
     struct pse_cpspace_exploration_samples_t smpls = PSE_CPSPACE_EXPLORATION_SAMPLES_NULL;
+    double solveBudget = 8.;
+    // Iterations of the unfinished solve over the previous calls (bounded by max_convergence_tries)
+    size_t solveSteps = 0;
+    // The structure of the space changed since the exploration context was created
+    bool explorationOutdated = true;
+    // An iterative exploration is begun, and kept by the next calls of solve
+    bool solving = false;
+    // The inputs of the solve (positions, sizes, lock states, enabled relationships) changed since it was begun:
+    // its iterative exploration is begun again
+    bool solveOutdated = true;
 
 
 
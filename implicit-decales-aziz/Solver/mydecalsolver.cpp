@@ -1,17 +1,26 @@
 #include "mydecalsolver.h"
 #include <iostream>
+#include <algorithm>
+#include <cmath>
 #include "constraints.h"
-#include "../GUI-Decale/QWidgetMyDecale.h"
 
 
 MyDecalSolver::MyDecalSolver() :  GenericSolver(){
     std::cout<<"mysolver: constructor"<<std::endl;
 }
-std::map<pse_ppoint_id_t, DecaleScalarField2D*> MyDecalSolver::mydecalsmap;
+std::map<pse_ppoint_id_t, size_t> MyDecalSolver::mydecalsmap;
+DecaleLayout MyDecalSolver::mylayout;
 GamutField2D* MyDecalSolver::mygamut;
 
 void MyDecalSolver::setDecales(const VectorOfDecaleFields &decales){
     this->decales = decales;
+    readLayout(mylayout);
+    for(size_t k = 0; k < 2; k++){
+        maxDistIndexes[k] = size_t(-1);
+        for(size_t i = 0; i < decales.size(); i++){
+            if(decales[i]->getId() == Constraints::max_dist_decales()[k]) maxDistIndexes[k] = i;
+        }
+    }
     std::cout<<"mysolver: setting decals test "<<decales[0]->getCornerX()<<std::endl;
 }
 
@@ -20,6 +29,96 @@ void MyDecalSolver::setGamut(GamutField2D *gamut)
     this->mygamut = gamut;
 }
 
+void MyDecalSolver::addDecale(DecaleScalarField2D *decale)
+{
+    decales.push_back(decale);
+    mylayout.posx.push_back(decale->getPosx());
+    mylayout.posy.push_back(decale->getPosy());
+    mylayout.size.push_back(decale->getSize());
+    mylayout.locked.push_back(0);
+    //its pairs are made by the next selection
+    pairsLayout.posx.push_back(decale->getPosx());
+    pairsLayout.posy.push_back(decale->getPosy());
+    pairsLayout.size.push_back(decale->getSize());
+    pairsOutdated = true;
+    for(size_t k = 0; k < 2; k++){
+        if(decale->getId() == Constraints::max_dist_decales()[k]) maxDistIndexes[k] = decales.size() - 1;
+    }
+    addPoints(1);
+}
+
+void MyDecalSolver::removeDecale(DecaleScalarField2D *decale)
+{
+    size_t index = std::find(decales.begin(), decales.end(), decale) - decales.begin();
+    if(index == decales.size()) return;
+
+    //the last Decale takes the index of the removed one, as its parametric point does
+    size_t last = decales.size() - 1;
+    decales[index] = decales[last];
+    mylayout.posx[index] = mylayout.posx[last];
+    mylayout.posy[index] = mylayout.posy[last];
+    mylayout.size[index] = mylayout.size[last];
+    mylayout.locked[index] = mylayout.locked[last];
+    pairsLayout.posx[index] = pairsLayout.posx[last];
+    pairsLayout.posy[index] = pairsLayout.posy[last];
+    pairsLayout.size[index] = pairsLayout.size[last];
+    decales.pop_back();
+    mylayout.posx.pop_back();
+    mylayout.posy.pop_back();
+    mylayout.size.pop_back();
+    mylayout.locked.pop_back();
+    pairsLayout.posx.pop_back();
+    pairsLayout.posy.pop_back();
+    pairsLayout.size.pop_back();
+    //the max_dist Decales follow their index
+    for(size_t k = 0; k < 2; k++){
+        if(maxDistIndexes[k] == index) maxDistIndexes[k] = size_t(-1);
+        else if(maxDistIndexes[k] == last) maxDistIndexes[k] = index;
+    }
+    removePoint(index);
+}
+
+void MyDecalSolver::readLayout(DecaleLayout &layout) const
+{
+    layout.posx.resize(decales.size());
+    layout.posy.resize(decales.size());
+    layout.size.resize(decales.size());
+    layout.locked.assign(decales.size(), 0);
+    for(size_t i = 0; i < decales.size(); i++){
+        layout.posx[i] = decales[i]->getPosx();
+        layout.posy[i] = decales[i]->getPosy();
+        layout.size[i] = decales[i]->getSize();
+    }
+    layout.finished = false;
+}
+
+void MyDecalSolver::setLayout(const DecaleLayout &layout)
+{
+    assert(layout.posx.size() == mylayout.posx.size());
+    //a Decale released since the last input is taken where the user left it
+    for(size_t i = 0; i < layout.posx.size(); i++){
+        if(layout.locked[i] || mylayout.locked[i]){
+            mylayout.posx[i] = layout.posx[i];
+            mylayout.posy[i] = layout.posy[i];
+        }
+    }
+    mylayout.size = layout.size;
+    mylayout.locked = layout.locked;
+    mylayout.sequence = layout.sequence;
+    mylayout.finished = false;
+    solveOutdated = true;
+}
+
+const DecaleLayout &MyDecalSolver::getLayout() const
+{
+    return mylayout;
+}
+
+double MyDecalSolver::getDecaleSize(pse_ppoint_id_t ppid)
+{
+    return mylayout.size[mydecalsmap.at(ppid)];
+}
+
 void MyDecalSolver::internal_preupdate_assignconstraints()
 {
 
@@ -27,6 +126,7 @@ void MyDecalSolver::internal_preupdate_assignconstraints()
     fp.push_back( PSE_RELSHP_COST_FUNC_PARAMS_NULL);
     fids.push_back(PSE_RELSHP_COST_FUNC_ID_INVALID_);
     fp.back().compute = Constraints::gamut_constratint;
+    fp.back().compute_df = Constraints::gamut_constratint_df;
     fp.back().cost_arity_mode = PSE_COST_ARITY_MODE_PER_POINT;
     fp.back().costs_count = 1;
     fp.back().expected_pspace = r2_uid;
@@ -36,6 +136,7 @@ void MyDecalSolver::internal_preupdate_assignconstraints()
     fp.push_back(PSE_RELSHP_COST_FUNC_PARAMS_NULL);
     fids.push_back(PSE_RELSHP_COST_FUNC_ID_INVALID_);
     fp.back().compute = Constraints::min_dist_constratint;
+    fp.back().compute_df = Constraints::min_dist_constratint_df;
     fp.back().cost_arity_mode = PSE_COST_ARITY_MODE_PER_RELATIONSHIP;
     fp.back().costs_count = 1;
     fp.back().expected_pspace = r2_uid;
@@ -45,13 +146,14 @@ void MyDecalSolver::internal_preupdate_assignconstraints()
     fp.push_back( PSE_RELSHP_COST_FUNC_PARAMS_NULL);
     fids.push_back(PSE_RELSHP_COST_FUNC_ID_INVALID_);
     fp.back().compute = Constraints::max_dist_constratint;
+    fp.back().compute_df = Constraints::max_dist_constratint_df;
     fp.back().cost_arity_mode = PSE_COST_ARITY_MODE_PER_RELATIONSHIP;
     fp.back().costs_count = 1;
     fp.back().expected_pspace = r2_uid;
 
 }
 
-void MyDecalSolver::internal_preupdate_constraintrelationships(size_t nRelshsps, std::vector< std::array<pse_ppoint_id_t, 2> > pppairs)
+void MyDecalSolver::internal_preupdate_globalrelationships()
 {
 
     //gamut constr
@@ -64,32 +166,48 @@ void MyDecalSolver::internal_preupdate_constraintrelationships(size_t nRelshsps,
     grp.cnstrs.funcs = &fids[gamut_cosntr_ID];
     grp.cnstrs.ctxts_config = gamut_config; // gives access to the current state
     PSE_CALL(pseConstrainedParameterSpaceRelationshipsAdd(cps,gamut_cosntr_ID,1,&grp,&grid));
+}
+
+void MyDecalSolver::internal_preupdate_constraintrelationships(const std::vector< std::array<pse_ppoint_id_t, 2> > &pppairs,
+                                                               std::vector<pse_relshp_id_t> &rids,
+                                                               std::vector<size_t> &ridPairs)
+{
+    size_t nRelshsps = pppairs.size();
 
     //min dist constr
     std::vector<pse_cpspace_relshp_params_t> rp(nRelshsps, PSE_CPSPACE_RELSHP_PARAMS_NULL_);
-    std::vector<pse_relshp_id_t> rids(nRelshsps, PSE_RELSHP_ID_INVALID_) ;
+    std::vector<pse_relshp_id_t> r0ids(nRelshsps, PSE_RELSHP_ID_INVALID_) ;
     for(size_t i = 0; i < nRelshsps; i++) {
       rp[i].ppoints_count = 2;
-      rp[i].ppoints_id = pppairs[i].data();
+      rp[i].ppoints_id = const_cast<pse_ppoint_id_t*>(pppairs[i].data());//copied by the space
       rp[i].kind = PSE_RELSHP_KIND_INCLUSIVE;
       rp[i].cnstrs.funcs_count = 1;
       rp[i].cnstrs.ctxts_config = gamut_config;// name is the same, but it is the state
       rp[i].cnstrs.funcs = &fids[min_dist_cosntr_ID];
     }
-    PSE_CALL(pseConstrainedParameterSpaceRelationshipsAdd(cps, min_dist_cosntr_ID,nRelshsps,rp.data(),rids.data()));
+    PSE_CALL(pseConstrainedParameterSpaceRelationshipsAdd(cps, min_dist_cosntr_ID,nRelshsps,rp.data(),r0ids.data()));
+    for(size_t i = 0; i < nRelshsps; i++) {
+      rids.push_back(r0ids[i]);
+      ridPairs.push_back(i);
+    }
 
-    //max dist constr
-    std::vector<pse_cpspace_relshp_params_t> rp1(nRelshsps, PSE_CPSPACE_RELSHP_PARAMS_NULL_) ;
-    std::vector<pse_relshp_id_t> r1ids(nRelshsps, PSE_RELSHP_ID_INVALID_) ;
+    //max dist constr: only the pair of the max_dist Decales
     for(size_t i = 0; i < nRelshsps; i++) {
-      rp1[i].ppoints_count = 2;
-      rp1[i].ppoints_id = pppairs[i].data();
-      rp1[i].kind = PSE_RELSHP_KIND_INCLUSIVE;
-      rp1[i].cnstrs.funcs_count = 1;
-      rp1[i].cnstrs.ctxts_config = gamut_config;// name is the same, but it is the state
-      rp1[i].cnstrs.funcs = &fids[max_dist_cosntr_ID];
+      std::array<size_t, 2> indexes = {{mydecalsmap.at(pppairs[i][0]), mydecalsmap.at(pppairs[i][1])}};
+      if(std::minmax(indexes[0], indexes[1]) != std::minmax(maxDistIndexes[0], maxDistIndexes[1])) continue;
+
+      pse_cpspace_relshp_params_t rp1 = PSE_CPSPACE_RELSHP_PARAMS_NULL_;
+      pse_relshp_id_t r1id = PSE_RELSHP_ID_INVALID_;
+      rp1.ppoints_count = 2;
+      rp1.ppoints_id = const_cast<pse_ppoint_id_t*>(pppairs[i].data());
+      rp1.kind = PSE_RELSHP_KIND_INCLUSIVE;
+      rp1.cnstrs.funcs_count = 1;
+      rp1.cnstrs.ctxts_config = gamut_config;// name is the same, but it is the state
+      rp1.cnstrs.funcs = &fids[max_dist_cosntr_ID];
+      PSE_CALL(pseConstrainedParameterSpaceRelationshipsAdd(cps,max_dist_cosntr_ID,1,&rp1,&r1id));
+      rids.push_back(r1id);
+      ridPairs.push_back(i);
     }
-    PSE_CALL(pseConstrainedParameterSpaceRelationshipsAdd(cps,max_dist_cosntr_ID,nRelshsps,rp1.data(),r1ids.data()));
 
 }
 
@@ -97,15 +215,77 @@ void MyDecalSolver::internal_preupdate_constraintrelationships(size_t nRelshsps,
 void MyDecalSolver::internal_preupdate_assignnpoints(){
     std::cout<<"internal_preupdate points"<<std::endl;
     nPoints = decales.size();
+    //the pairs are made by the first selection
+    pairsLayout.posx = mylayout.posx;
+    pairsLayout.posy = mylayout.posy;
+    pairsLayout.size = mylayout.size;
+    pairsOutdated = true;
 }
 
-void MyDecalSolver::internal_preupdate_mapping(std::vector<pse_ppoint_id_t> ppids){
-    mydecalsmap.clear();
-    for(size_t i = 0; i< nPoints; i++){
-        mydecalsmap.insert({ppids[i],decales[i]});
+void MyDecalSolver::internal_preupdate_mapping(size_t first, size_t count){
+    //the ids are the indexes (see GenericSolver::addPoints): the ones past the last point are removed
+    mydecalsmap.erase(mydecalsmap.lower_bound(pse_ppoint_id_t(nPoints)), mydecalsmap.end());
+    for(size_t i = first; i < first + count; i++){
+        mydecalsmap[ppids[i]] = i;
     }
 }
 
+bool MyDecalSolver::internal_presolve_activepairs()
+{
+    /***********************************
+    // The pairs with relationships are only searched again when a Decale moved or grew by more than half the skin
+    // since: no pair farther than the margin plus the skin then could have come closer than the margin.
+    ***********************************/
+    for(size_t i = 0; i < nPoints && !pairsOutdated; i++){
+        double drift = std::max(std::abs(mylayout.posx[i]-pairsLayout.posx[i]), std::abs(mylayout.posy[i]-pairsLayout.posy[i]))
+                     + std::max(0., mylayout.size[i]-pairsLayout.size[i]);
+        pairsOutdated = (drift > 0.5*proximitySkin);
+    }
+
+    bool changed = false;
+    if(pairsOutdated){
+        /***********************************
+        // min_dist costs nothing to Decales whose boxes do not overlap: only the pairs close to it have relationships.
+        // The cells are larger than any interaction distance, so that the close pairs are in the same or adjacent cells.
+        ***********************************/
+        double maxSize = 0.;
+        for(double size : mylayout.size) maxSize = std::max(maxSize, size);
+        proximity.build(mylayout.posx, mylayout.posy, 2.*maxSize + proximityMargin + proximitySkin);
+        candidatePairs.clear();
+        proximity.candidatePairs(candidatePairs);
+
+        nearPairs.clear();
+        for(const std::array<size_t, 2> &pair : candidatePairs){
+            size_t i = pair[0], j = pair[1];
+            double dist = std::max(std::abs(mylayout.posx[i]-mylayout.posx[j]), std::abs(mylayout.posy[i]-mylayout.posy[j]));
+            if(dist < mylayout.size[i] + mylayout.size[j] + proximityMargin + proximitySkin) nearPairs.push_back({{ppids[i], ppids[j]}});
+        }
+        //max_dist is solved wherever its Decales are
+        if(maxDistIndexes[0] < nPoints && maxDistIndexes[1] < nPoints && maxDistIndexes[0] != maxDistIndexes[1]){
+            nearPairs.push_back({{ppids[maxDistIndexes[0]], ppids[maxDistIndexes[1]]}});
+        }
+
+        changed = setPairs(nearPairs);
+        pairsLayout.posx = mylayout.posx;
+        pairsLayout.posy = mylayout.posy;
+        pairsLayout.size = mylayout.size;
+        pairsOutdated = false;
+    }
+
+    /***********************************
+    // Only the pairs closer than the margin are enabled, among the ones with relationships
+    ***********************************/
+    nearPairs.clear();
+    for(const std::pair<const std::array<pse_ppoint_id_t, 2>, std::vector<pse_relshp_id_t> > &entry : pairRelshps){
+        size_t i = mydecalsmap.at(entry.first[0]), j = mydecalsmap.at(entry.first[1]);
+        double dist = std::max(std::abs(mylayout.posx[i]-mylayout.posx[j]), std::abs(mylayout.posy[i]-mylayout.posy[j]));
+        bool far = std::minmax(i, j) == std::minmax(maxDistIndexes[0], maxDistIndexes[1]);
+        if(far || dist < mylayout.size[i] + mylayout.size[j] + proximityMargin) nearPairs.push_back(entry.first);
+    }
+
+    return setActivePairs(nearPairs) || changed;
+}
+
 void MyDecalSolver::internal_preupdate_setHandlers(){
     coords_data.as.global.accessors.get = getAttribs;
     coords_data.as.global.accessors.set = setAttribs;
@@ -128,8 +308,8 @@ pse_res_t MyDecalSolver::getAttribs(void *ctxt,
         for(i = 0; i < count; ++i) {
             const pse_ppoint_id_t ppid = values_idx[i];
 
-            out[i*2+0] = pse_real_t(mydecalsmap[ppid]->getPosx());
-            out[i*2+1] = pse_real_t(mydecalsmap[ppid]->getPosy());
+            out[i*2+0] = pse_real_t(mylayout.posx[mydecalsmap[ppid]]);
+            out[i*2+1] = pse_real_t(mylayout.posy[mydecalsmap[ppid]]);
         }
     } break;
     case PSE_POINT_ATTRIB_LOCK_STATUS: {
@@ -138,14 +318,8 @@ pse_res_t MyDecalSolver::getAttribs(void *ctxt,
         assert(as_type == PSE_TYPE_BOOL_8);
         for(i = 0; i < count; ++i) {
             const pse_ppoint_id_t ppid = values_idx[i];
-            (void)ppid;
-            //reverse mapping
-            std::map<pse_ppoint_id_t, DecaleScalarField2D*>::iterator it;
-            it = mydecalsmap.find(ppid);
-
-            if(QWidgetMyDecale::lockedDecals.at(it->first)== true){//active when pressed by user
-                out[i] = 1 ;
-            }else out[i] = 0;
+
+            out[i] = mylayout.locked[mydecalsmap[ppid]];//active when pressed by user
         }
       } break;
     default: assert(false);
@@ -170,8 +344,8 @@ pse_res_t MyDecalSolver::setAttribs(void *ctxt,
             for(i = 0; i < count; ++i) {
                 const pse_ppoint_id_t ppid = values_idx[i];
 
-                mydecalsmap[ppid]->setPosx(in[i*2+0]);//qreal
-                mydecalsmap[ppid]->setPosy(in[i*2+1]);
+                mylayout.posx[mydecalsmap[ppid]] = in[i*2+0];
+                mylayout.posy[mydecalsmap[ppid]] = in[i*2+1];
             }
         } break;
         default: assert(false);
@@ -5,7 +5,27 @@
 #include "../Decale/DecaleScalarField2D.h"
 #include "../Deformer2D/Deformer2D.h"
 #include "../Gamut/GamutField2D.h"
+#include "../Tools/SpatialHash.h"
 #include <map>
+#include <vector>
+#include <stdint.h>
+
+/**
+ * State of the Decales handed to the solver (input), or positions resulting from a solve (result).
+ * The vectors are indexed as the Decales given to MyDecalSolver::setDecales.
+ */
+struct DecaleLayout {
+    // Sequence number of the input (a result carries the one of the last input it was solved from)
+    unsigned long sequence = 0;
+    std::vector<double> posx;
+    std::vector<double> posy;
+    // Half extent of the Decales (getSize)
+    std::vector<double> size;
+    // 1 for the Decales held by the user: the solver does not move them
+    std::vector<uint8_t> locked;
+    // Result: the solve of the input is finished (no newer positions until the next input)
+    bool finished = false;
+};
 
 class MyDecalSolver : public GenericSolver
 {
@@ -13,12 +33,39 @@ public:
     MyDecalSolver();
     void setDecales (const VectorOfDecaleFields &decales);
     void setGamut(GamutField2D *gamut);
+    /**
+     * Add a Decale to the initialized solver: only its relationships with the other Decales are made
+     */
+    void addDecale (DecaleScalarField2D *decale);
+    /**
+     * Remove a Decale from the initialized solver: only its relationships are removed.
+     * The last Decale takes its index (in decales and in the layouts).
+     */
+    void removeDecale (DecaleScalarField2D *decale);
+
+    /**
+     * Read the current positions, sizes and lock states of the Decales in layout (on the thread owning the Decales)
+     */
+    void readLayout (DecaleLayout &layout) const;
+    /**
+     * Input of the next solves: the sizes, the lock states and the positions of the locked (or just released) Decales.
+     * The free Decales keep the positions of the solver (the ones of its results, applied by the GUI).
+     */
+    void setLayout (const DecaleLayout &layout);
+    /**
+     * Positions of the last solve (or of the input when nothing was solved since)
+     */
+    const DecaleLayout &getLayout () const;
 
     void internal_preupdate_assignconstraints() override;
-    void internal_preupdate_constraintrelationships(size_t nRelshsps, std::vector< std::array<pse_ppoint_id_t, 2> > pppairs) override;
+    void internal_preupdate_globalrelationships() override;
+    void internal_preupdate_constraintrelationships(const std::vector< std::array<pse_ppoint_id_t, 2> > &pppairs,
+                                                    std::vector<pse_relshp_id_t> &rids,
+                                                    std::vector<size_t> &ridPairs) override;
     void internal_preupdate_assignnpoints() override;
-    void internal_preupdate_mapping(std::vector<pse_ppoint_id_t> ppids) override;
+    void internal_preupdate_mapping(size_t first, size_t count) override;
     void internal_preupdate_setHandlers() override;
+    bool internal_presolve_activepairs() override;
 
 
     static enum pse_res_t getAttribs(void* ctxt,
@@ -35,8 +82,13 @@ public:
                               const void* attrib_values);
 
 
+    static double getDecaleSize (pse_ppoint_id_t ppid);
+
     VectorOfDecaleFields decales;
-    static std::map<pse_ppoint_id_t, DecaleScalarField2D*> mydecalsmap;
+    // Index of the Decale of a parametric point, in decales and in mylayout
+    static std::map<pse_ppoint_id_t, size_t> mydecalsmap;
+    // The solver only reads and writes this layout (never the Decales, which belong to the GUI thread)
+    static DecaleLayout mylayout;
 
     static GamutField2D *mygamut;
 
@@ -46,6 +98,19 @@ protected:
     int gamut_cosntr_ID = -1;
     int min_dist_cosntr_ID = -1;
     int max_dist_cosntr_ID = -1;
+    // Index of each Decale of Constraints::max_dist_decales in decales (size_t(-1) while it is not in the solver)
+    std::array<size_t, 2> maxDistIndexes = {{size_t(-1), size_t(-1)}};
+
+    // The min_dist relationships of two Decales are enabled when their boxes are closer than this margin. They are made
+    // when the boxes are closer than the margin plus the skin, and made again once a Decale moved or grew by more than
+    // half the skin since (pairsLayout): the pairs to enable are then always among the made ones.
+    double proximityMargin = 16.;
+    double proximitySkin = 8.;
+    SpatialHash proximity;
+    DecaleLayout pairsLayout;
+    bool pairsOutdated = true;
+    std::vector< std::array<size_t, 2> > candidatePairs;
+    std::vector< std::array<pse_ppoint_id_t, 2> > nearPairs;
 
 
 };
@@ -4,3 +4,18 @@ Scene::Scene()
 {
 
 }
+
+BufferPool *Scene::getBufferPool()
+{
+    return &bufferPool;
+}
+
+ThreadPool *Scene::getThreadPool()
+{
+    return &threadPool;
+}
+
+TextureAtlas *Scene::getTextureAtlas()
+{
+    return &textureAtlas;
+}
@@ -1,11 +1,36 @@
 #ifndef SCENE_H
 #define SCENE_H
 
+#include "../Tools/BufferPool.h"
+#include "../Tools/ThreadPool.h"
+#include "../Tools/TextureAtlas.h"
+
 
 class Scene
 {
 public:
     Scene();
+
+    /**
+     * Pool of the field and UV buffers of the Decales and of the Gamut of the scene.
+     * Its statistics tell how often the buffers hit the heap.
+     */
+    BufferPool *getBufferPool();
+
+    /**
+     * Pool of threads on which the Deformers compute the field buffers of the Decales.
+     */
+    ThreadPool *getThreadPool();
+
+    /**
+     * Atlas of the Decale images (with their mip chains), sampled when drawing the Decales.
+     */
+    TextureAtlas *getTextureAtlas();
+
+protected:
+    BufferPool bufferPool;
+    ThreadPool threadPool;
+    TextureAtlas textureAtlas;
 };
 
 #endif // SCENE_H
@@ -0,0 +1,25 @@
+//
+// Macros shared by the tests: a failed check prints its location and exits with 1.
+//
+
+#ifndef TEST_TESTUTILS_H
+#define TEST_TESTUTILS_H
+
+#include <iostream>
+#include <stdlib.h>
+#include <math.h>
+
+#define CHECK(a)                                                                        \
+    if (!(a)) {                                                                         \
+        std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #a << std::endl; \
+        exit(1);                                                                        \
+    }
+
+#define CHECK_NEAR(a,b,eps)                                                             \
+    if (!(fabs((a)-(b)) <= (eps))) {                                                    \
+        std::cerr << __FILE__ << ":" << __LINE__ << ": " << (a) << " != " << (b)        \
+                  << " (eps " << (eps) << ")" << std::endl;                             \
+        exit(1);                                                                        \
+    }
+
+#endif //TEST_TESTUTILS_H
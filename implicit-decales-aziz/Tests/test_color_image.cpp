@@ -0,0 +1,76 @@
+//
+// The Decale images are composited over the image (premultiplied src-over): their opaque texels replace the image,
+// their translucent texels are blended with it, their transparent texels leave it unchanged.
+//
+
+#include <stdint.h>
+#include <vector>
+#include "../Tools/ColorImage.h"
+#include "../Tools/TextureAtlas.h"
+#include "../Tools/Vector2D.h"
+#include "TestUtils.h"
+
+
+/***********************************
+// Channel c (0 blue, 1 green, 2 red, 3 alpha) of a premultiplied ARGB32 pixel
+***********************************/
+static int channel (uint32_t pixel, int c) {
+
+    return (int)((pixel >> (8 * c)) & 0xff);
+}
+
+static void checkPixel (uint32_t pixel, uint32_t expected) {
+
+    for (int c=0; c<4; c++)
+        CHECK_NEAR(channel(pixel, c), channel(expected, c), 1);
+}
+
+int main () {
+
+    /***********************************
+    // Texture of 20 texels (a mixed pack of 8 texels, an opaque pack of 8 texels, then 4 texels for the scalar tail):
+    // opaque red, green at 50% (premultiplied), transparent, opaque blue
+    ***********************************/
+    const int width = 20;
+    const uint32_t texels[4] = { 0xffff0000u, 0x80008000u, 0x00000000u, 0xff0000ffu };
+    const uint32_t expected[4] = { 0xffff0000u, 0xff7fff7fu, 0xffffffffu, 0xff0000ffu };
+
+    QImage texture (width, 1, QImage::Format_ARGB32_Premultiplied);
+    uint32_t *row = reinterpret_cast<uint32_t *>(texture.scanLine(0));
+    for (int x=0; x<width; x++)
+        row[x] = ((x >= 8) && (x < 16)) ? texels[(x % 2) * 3] : texels[x % 4];
+    ColorImage decale (texture, 0);
+
+    /***********************************
+    // UVs at the texel centers (with the next column and scanline)
+    ***********************************/
+    int stride = width + 1;
+    std::vector<Vector2D> uvs (stride * 2);
+    for (int y=0; y<2; y++)
+        for (int x=0; x<=width; x++)
+            uvs[y * stride + x] = Vector2D((x + 0.5) / width, 0.5);
+
+    ColorImage image (width, 1);
+    image.setColor(Color(1., 1., 1.));
+    image.addColorImageWithUV(&decale, 0, width, 0, 1, uvs.data(), stride);
+
+    const uint32_t *pixels = reinterpret_cast<const uint32_t *>(image.getQImage().constScanLine(0));
+    for (int x=0; x<width; x++)
+        checkPixel(pixels[x], ((x >= 8) && (x < 16)) ? expected[(x % 2) * 3] : expected[x % 4]);
+
+    /***********************************
+    // Same image with the texture atlas (the footprints of one texel sample the texel centers of the first level)
+    ***********************************/
+    TextureAtlas atlas;
+    decale.setTextureAtlas(&atlas);
+
+    ColorImage atlasImage (width, 1);
+    atlasImage.setColor(Color(1., 1., 1.));
+    atlasImage.addColorImageWithUV(&decale, 0, width, 0, 1, uvs.data(), stride);
+
+    const uint32_t *atlasPixels = reinterpret_cast<const uint32_t *>(atlasImage.getQImage().constScanLine(0));
+    for (int x=0; x<width; x++)
+        checkPixel(atlasPixels[x], pixels[x]);
+
+    return 0;
+}
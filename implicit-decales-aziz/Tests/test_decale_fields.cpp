@@ -0,0 +1,115 @@
+//
+// The vectorized row evaluation of the Decale shapes has to match their per-pixel evaluation,
+// including for rotated Decales with a non-uniform scale.
+// The (u,v) of the pixels are computed where their field values are sampled, whatever the sub-pixel phase.
+//
+
+#include <algorithm>
+#include <vector>
+#include "../Decale/DecaleDiskField2D.h"
+#include "../Decale/DecaleSquareField2D.h"
+#include "../Decale/DecaleRoundCornerSquareField2D.h"
+#include "TestUtils.h"
+
+
+static void checkRows (DecaleScalarField2D &decale) {
+
+    const unsigned int count = 61;
+    std::vector<double> row (count);
+
+    for (double x = decale.getPosx()-40.; x <= decale.getPosx()+40.; x += 1.25) {
+        const double y0 = decale.getPosy()-30.5;
+        decale.evalRow(x, y0, count, row.data());
+        for (unsigned int j=0; j<count; j++)
+            CHECK_NEAR(row[j], decale.eval(x, y0+double(j)), 1e-9);
+    }
+}
+
+static void checkShape (DecaleScalarField2D &decale) {
+
+    checkRows(decale);
+
+    decale.scale(1.8, 0.6);
+    checkRows(decale);
+
+    decale.rotate(0.4);
+    checkRows(decale);
+
+    decale.scale(0.5, 1.5);
+    checkRows(decale);
+}
+
+static void checkSampling (DecaleScalarField2D &decale, double fraction) {
+
+    /***********************************
+    // The fraction is the one of the corner of the Decale
+    ***********************************/
+    decale.setPosx(50. + fraction + decale.getDWidth()/2.);
+    decale.setPosy(40. + fraction + decale.getDHeight()/2.);
+    decale.computeDiscreteField();
+    decale.computeDiscreteUVField(0);
+
+    /***********************************
+    // The corner is rounded to the nearest quarter of pixel, then down to the pixel
+    ***********************************/
+    const double cornerx = decale.getPosx() - decale.getDWidth()/2.;
+    const double cornery = decale.getPosy() - decale.getDHeight()/2.;
+    CHECK((int)decale.getCornerX() == (int)floor(cornerx + 0.125));
+    CHECK((int)decale.getCornerY() == (int)floor(cornery + 0.125));
+
+    /***********************************
+    // Origin of the samples: the corner shifted by a quantized sub-pixel phase
+    ***********************************/
+    const unsigned int ci = decale.getIWidth()/2, cj = decale.getIHeight()/2;
+    double x0 = 0., y0 = 0.;
+    bool found = false;
+    for (int px=0; px<=4 && !found; px++)
+        for (int py=0; py<=4 && !found; py++) {
+            x0 = cornerx - double(px)/4.;
+            y0 = cornery - double(py)/4.;
+            found = (fabs(decale.getDiscreteFieldValue(ci, cj, 0) - decale.eval(x0 + ci, y0 + cj)) < 1e-12)
+                 && (fabs(decale.getDiscreteFieldValue(ci-3, cj+2, 0) - decale.eval(x0 + ci-3, y0 + cj+2)) < 1e-12);
+        }
+    CHECK(found);
+
+    /***********************************
+    // Along the row and the column of the center, the (u,v) of a pixel are on the side of the center where its
+    // field value is sampled
+    ***********************************/
+    for (unsigned int i=0; i<decale.getIWidth(); i++) {
+        Vector2D uv = decale.getUV(i, cj);
+        double x = x0 + double(i) - decale.getPosx();
+        if ((uv.x < 0.) || (fabs(x) < 1e-9)) continue;
+        CHECK((uv.x > 0.5) == (x > 0.));
+    }
+    for (unsigned int j=0; j<decale.getIHeight(); j++) {
+        Vector2D uv = decale.getUV(ci, j);
+        double y = y0 + double(j) - decale.getPosy();
+        if ((uv.y < 0.) || (fabs(y) < 1e-9)) continue;
+        CHECK((uv.y > 0.5) == (y > 0.));
+    }
+}
+
+
+int main () {
+
+    DecaleDiskField2D disk (100., 80., 25., 0, 0);
+    checkShape(disk);
+
+    DecaleSquareField2D square (100.3, 80.7, 25., 1, 0);
+    checkShape(square);
+
+    DecaleRoundCornerSquareField2D roundCornerSquare (100., 80., 25., M_PI/8., 2, 0);
+    checkShape(roundCornerSquare);
+
+    /***********************************
+    // Sub-pixel phases 0 to 3, and a corner close to the next pixel, sampled at its phase 0
+    ***********************************/
+    const double fractions[] = {0., 0.3, 0.55, 0.7, 0.9, 0.95};
+    for (double fraction : fractions) {
+        DecaleDiskField2D sampled (100., 80., 25., 3, 0);
+        checkSampling(sampled, fraction);
+    }
+
+    return 0;
+}
@@ -0,0 +1,51 @@
+//
+// The binary Deformers evaluate their composition operator through a lookup table (OperatorTable2D):
+// the tables have to stay close to the analytic operators, including around their discontinuities at the iso-value.
+//
+
+#include <math.h>
+#include "../Deformer2D/OperatorTable2D.h"
+#include "../Deformer2D/Deformer2DBinaryHardContact.h"
+#include "../Deformer2D/Deformer2DContact.h"
+#include "../Gamut/GamutDeformer2DBinaryHardContact.h"
+#include "../Gamut/GamutDeformer2DBinaryHardContactMax.h"
+#include "TestUtils.h"
+
+
+int main () {
+
+    /***********************************
+    // A smooth operator is interpolated within the bilinear error, a discontinuous one (at the split) exactly
+    // on both sides of its discontinuity
+    ***********************************/
+    OperatorTable2D table;
+    CHECK(!table.isBaked());
+
+    std::function<double (double, double)> smooth = [] (double x, double y) { return x*y; };
+    table.bake(smooth);
+    CHECK(table.isBaked());
+    CHECK(table.maxError(smooth) < 1e-5);
+    CHECK_NEAR(table.eval(-1., 2.), smooth(0., 1.), 1e-6);
+
+    std::function<double (double, double)> step = [] (double x, double y) { return (x <= 0.5) ? y : 1.; };
+    table.bake(step);
+    CHECK(table.maxError(step) < 1e-6);
+
+    /***********************************
+    // Tables of the binary Deformers
+    ***********************************/
+    Deformer2DBinaryHardContact hardContact;
+    CHECK(hardContact.innerTableError() < 2e-3);
+
+    GamutDeformer2DBinaryHardContact gamutHardContact;
+    CHECK(gamutHardContact.innerTableError() < 2e-3);
+
+    GamutDeformer2DBinaryHardContactMax gamutHardContactMax;
+    CHECK(gamutHardContactMax.innerTableError() < 2e-3);
+
+    // No table for the n-ary Deformers
+    Deformer2DContact contact;
+    CHECK(contact.innerTableError() == 0.);
+
+    return 0;
+}
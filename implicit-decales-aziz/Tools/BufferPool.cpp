@@ -0,0 +1,142 @@
+//
+// Pool of memory blocks for the field buffers and UV buffers of the Decales and of the Gamut.
+//
+
+#include "BufferPool.h"
+#include <new>
+
+
+BufferPool::BufferPool () {
+
+    statistics.acquires = 0;
+    statistics.releases = 0;
+    statistics.reuses = 0;
+    statistics.heapAllocations = 0;
+    statistics.bytesInUse = 0;
+    statistics.bytesCached = 0;
+    statistics.peakBytes = 0;
+}
+
+BufferPool::~BufferPool () {
+
+    trim();
+}
+
+size_t BufferPool::sizeClass (size_t bytes) {
+
+    if (bytes <= 64) return 64;
+
+    /***********************************
+    // Smallest m * 2^k >= bytes with m in {4,5,6,7}
+    ***********************************/
+    size_t k = 0;
+    while ((bytes - 1) >> (k + 3)) k++;
+    size_t m = ((bytes - 1) >> k) + 1;
+
+    return m << k;
+}
+
+void *BufferPool::acquire (size_t bytes) {
+
+    size_t capacity = sizeClass(bytes);
+    std::lock_guard<std::mutex> lock (mutex);
+
+    statistics.acquires++;
+    statistics.bytesInUse += capacity;
+
+    std::map<size_t, std::vector<void *> >::iterator it = freeBlocks.find(capacity);
+    if ((it != freeBlocks.end()) && !it->second.empty()) {
+        void *block = it->second.back();
+        it->second.pop_back();
+        statistics.reuses++;
+        statistics.bytesCached -= capacity;
+        return block;
+    }
+
+    statistics.heapAllocations++;
+    if (statistics.bytesInUse + statistics.bytesCached > statistics.peakBytes)
+        statistics.peakBytes = statistics.bytesInUse + statistics.bytesCached;
+
+    return ::operator new (capacity);
+}
+
+void BufferPool::release (void *block, size_t bytes) {
+
+    if (block == NULL) return;
+
+    size_t capacity = sizeClass(bytes);
+    std::lock_guard<std::mutex> lock (mutex);
+
+    statistics.releases++;
+    statistics.bytesInUse -= capacity;
+    statistics.bytesCached += capacity;
+
+    freeBlocks[capacity].push_back(block);
+}
+
+void BufferPool::trim () {
+
+    std::lock_guard<std::mutex> lock (mutex);
+
+    for (std::map<size_t, std::vector<void *> >::iterator it = freeBlocks.begin(); it != freeBlocks.end(); ++it)
+        for (size_t i=0; i<it->second.size(); i++)
+            ::operator delete (it->second[i]);
+
+    freeBlocks.clear();
+    statistics.bytesCached = 0;
+}
+
+BufferPoolStatistics BufferPool::getStatistics () {
+
+    std::lock_guard<std::mutex> lock (mutex);
+    return statistics;
+}
+
+void BufferPool::resetStatistics () {
+
+    std::lock_guard<std::mutex> lock (mutex);
+
+    statistics.acquires = 0;
+    statistics.releases = 0;
+    statistics.reuses = 0;
+    statistics.heapAllocations = 0;
+}
+
+
+PooledBlock::PooledBlock (BufferPool *pool) : pool(pool), data(NULL), capacity(0) {}
+
+PooledBlock::~PooledBlock () {
+
+    free();
+}
+
+void PooledBlock::reserve (size_t bytes) {
+
+    if (bytes <= capacity) return;
+
+    free();
+    if (pool != NULL) {
+        data = pool->acquire(bytes);
+        capacity = BufferPool::sizeClass(bytes);
+    }
+    else {
+        data = ::operator new (bytes);
+        capacity = bytes;
+    }
+}
+
+size_t PooledBlock::getCapacity () const {
+
+    return capacity;
+}
+
+void PooledBlock::free () {
+
+    if (data == NULL) return;
+
+    if (pool != NULL) pool->release(data, capacity);
+    else ::operator delete (data);
+
+    data = NULL;
+    capacity = 0;
+}
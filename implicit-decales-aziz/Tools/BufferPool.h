@@ -0,0 +1,112 @@
+//
+// Pool of memory blocks for the field buffers and UV buffers of the Decales and of the Gamut.
+//
+// Blocks are rounded up to size classes (m * 2^k bytes with m in {4,5,6,7}), which gives up to 25% of
+// capacity headroom. Released blocks are kept per size class and handed out again, so that resizing the
+// Decale buffers (e.g. during a pinch-scale) reuses memory instead of allocating it.
+//
+
+#ifndef TEST_BUFFERPOOL_H
+#define TEST_BUFFERPOOL_H
+
+#include <stddef.h>
+#include <map>
+#include <vector>
+#include <mutex>
+
+
+struct BufferPoolStatistics {
+
+    // Number of blocks requested to the pool
+    size_t acquires;
+    // Number of blocks released to the pool
+    size_t releases;
+    // Number of requests served with a released block
+    size_t reuses;
+    // Number of blocks allocated on the heap
+    size_t heapAllocations;
+    // Bytes of the blocks currently handed out
+    size_t bytesInUse;
+    // Bytes of the released blocks kept for reuse
+    size_t bytesCached;
+    // Largest value of bytesInUse + bytesCached
+    size_t peakBytes;
+};
+
+
+class BufferPool {
+
+public:
+
+    BufferPool ();
+    /**
+     * Free the cached blocks. The blocks still handed out have to be released before.
+     */
+    ~BufferPool ();
+
+    /**
+     * Size class (capacity) of a block of at least bytes bytes
+     */
+    static size_t sizeClass (size_t bytes);
+
+    /**
+     * Hand out a block of sizeClass(bytes) bytes
+     */
+    void *acquire (size_t bytes);
+    /**
+     * Give back a block handed out by acquire(bytes)
+     */
+    void release (void *block, size_t bytes);
+
+    /**
+     * Free all the cached blocks
+     */
+    void trim ();
+
+    BufferPoolStatistics getStatistics ();
+    void resetStatistics ();
+
+private:
+
+    BufferPool (const BufferPool &);
+    BufferPool &operator = (const BufferPool &);
+
+    std::map<size_t, std::vector<void *> > freeBlocks;
+    BufferPoolStatistics statistics;
+    std::mutex mutex;
+};
+
+
+/**
+ * Memory block taken from a BufferPool (from the heap when there is no pool).
+ * The block keeps its capacity when it shrinks, and goes back to the pool when it grows or is destroyed.
+ */
+class PooledBlock {
+
+public:
+
+    explicit PooledBlock (BufferPool *pool);
+    ~PooledBlock ();
+
+    /**
+     * Make the block at least bytes long. Its content is lost when it has to grow.
+     */
+    void reserve (size_t bytes);
+
+    void *getData () const { return data; }
+    size_t getCapacity () const;
+
+private:
+
+    PooledBlock (const PooledBlock &);
+    PooledBlock &operator = (const PooledBlock &);
+
+    void free ();
+
+    BufferPool *pool;
+    void *data;
+    size_t capacity;
+};
+
+
+#endif //TEST_BUFFERPOOL_H
@@ -3,26 +3,39 @@
 //
 
 #include "ColorImage.h"
+#include "ScanlineKernels.h"
 #include <iostream>
+#include <algorithm>
+#include <string.h>
+#include <math.h>
 
 
-ColorImage::ColorImage (const QString &fileName, unsigned int decaleId){
+ColorImage::ColorImage (const QString &fileName, unsigned int decaleId) : atlas(NULL), atlasTexture(-1) {
 
-    piximg = QPixmap(fileName);
-    width = piximg.width();
-    height = piximg.height();
+    /***********************************
+    // Decoded as a QImage (no QPixmap), so that the images can be loaded without display (headless rendering)
+    ***********************************/
+    qimg = QImage(fileName).convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    width = qimg.width();
+    height = qimg.height();
 
-    qimg = piximg.toImage();
+    this->decaleId = decaleId;
+}
+
+ColorImage::ColorImage (const QImage &image, unsigned int decaleId) : atlas(NULL), atlasTexture(-1) {
+
+    qimg = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    width = qimg.width();
+    height = qimg.height();
 
     this->decaleId = decaleId;
 }
 
-ColorImage::ColorImage (const int w, const int h){
-    piximg = QPixmap(w, h);
+ColorImage::ColorImage (const int w, const int h) : atlas(NULL), atlasTexture(-1) {
     width = w;
     height = h;
 
-    qimg = piximg.toImage();
+    qimg = QImage(w, h, QImage::Format_ARGB32_Premultiplied);
     setBlack();
 
     this->decaleId = decaleId;
@@ -42,75 +55,174 @@ void ColorImage::setPixelColor (const unsigned int i, const unsigned int j, Colo
 
 void ColorImage::setBlack(){
 
-    QColor qc;
-    qc.setRgbF(0.,0.,0.);
+    setColor(Color(0.,0.,0.));
+}
+
+QPixmap ColorImage::getQPixmap (){
 
-    for (int i=0; i<width; i++)
-       for (int j=0; j<height; j++)
-           qimg.setPixelColor(i, j, qc);
+    return QPixmap::fromImage(qimg, Qt::AutoColor);
 }
 
-QPixmap &ColorImage::getQPixmap (){
+const QImage &ColorImage::getQImage (){
 
-    piximg=piximg.fromImage(qimg, Qt::AutoColor);
-    return piximg;
+    return qimg;
 }
 
 void ColorImage::setBlackGamut(GamutField2D *gf) {
 
-    QColor qc;
-    qc.setRgbF(0.,0.,0.);
-
-    for (int i=0; i<width; i++)
-        for (int j=0; j<height; j++)
-            if (gf->eval(i,j) < gf->getIso()) qimg.setPixelColor(i, j, qc);
+    setColorGamut(gf, Color(0.,0.,0.));
 }
 
 void ColorImage::setColorGamut(GamutField2D *gf, Color c) {
 
-    QColor qc;
-    qc.setRgbF(c.r,c.g,c.b);
+    uint32_t color = scanlinePixel(c.r, c.g, c.b);
+    std::vector<unsigned char> inside (width);
 
-    for (int i=0; i<width; i++)
-        for (int j=0; j<height; j++)
-            if (gf->eval(i,j) < gf->getIso()) qimg.setPixelColor(i, j, qc);
+    for (int j=0; j<height; j++) {
+        for (int i=0; i<width; i++)
+            inside[i] = (gf->getPixelValue(i,j) < gf->getIso()) ? 1 : 0;
+        maskedFillRow(scanline(j), width, inside.data(), color);
+    }
 }
 
 void ColorImage::setColor(Color c) {
 
-    QColor qc;
-    qc.setRgbF(c.r,c.g,c.b);
+    uint32_t color = scanlinePixel(c.r, c.g, c.b);
+
+    for (int j=0; j<height; j++)
+        fillRow(scanline(j), width, color);
+}
+
+uint32_t *ColorImage::scanline (int j) {
+
+    return reinterpret_cast<uint32_t *>(qimg.scanLine(j));
+}
+
+uint32_t *ColorImage::detachedScanline (int j) {
 
-    for (int i=0; i<width; i++)
-        for (int j=0; j<height; j++)
-           qimg.setPixelColor(i, j, qc);
+    return reinterpret_cast<uint32_t *>(const_cast<unsigned char *>(qimg.constScanLine(j)));
+}
+
+void ColorImage::detach () {
+
+    qimg.detach();
+}
+
+bool ColorImage::decaleRows (DecaleScalarField2D *decale, const QRect &clip, int &x0, int &x1, int &y0, int &y1) {
+
+    /***********************************
+    // Pixels of the image covered by the Decale buffers (the first column and row of the image are never drawn)
+    ***********************************/
+    int cornerx = (int)decale->getCornerX();
+    int cornery = (int)decale->getCornerY();
+
+    x0 = std::max(std::max(cornerx, 1), clip.left());
+    y0 = std::max(std::max(cornery, 1), clip.top());
+    x1 = std::min(std::min(cornerx + (int)decale->getIWidth(), width), clip.right() + 1);
+    y1 = std::min(std::min(cornery + (int)decale->getIHeight(), height), clip.bottom() + 1);
+
+    return (x0 < x1) && (y0 < y1);
 }
 
 void ColorImage::addColorImageWithDecaleUV(DecaleScalarField2D *decale, ColorImage *imgDecale) {
 
-    QColor qc, qcwhite, qcgray, qcblack, qcred;
-    qcwhite.setRgbF(1.,1.,1.);
-    qcblack.setRgbF(0.,0.,0.);
-    qcred.setRgbF(1.,0.,0.);
-    qcgray.setRgbF(0.5,0.5,0.5);
-    Vector2D uv;
-    int xu, yu;
-
-    for (int i=0; i<decale->getIWidth(); i++)
-        for (int j=0; j<decale->getIHeight(); j++) {
-            uv=decale->getUV(i,j);
-
-            if ((uv.x >= 0.) && (uv.y >= 0.) && (uv.x < 1.) && (uv.y < 1.)
-                && ((int)decale->getCornerX() + i > 0) && ((int)decale->getCornerY() + j > 0)
-                && ((int)decale->getCornerX() + i < width) && ((int)decale->getCornerY() + j < height)) {
-                xu = (int)(uv.x*imgDecale->getWidth());
-                yu = (int)(uv.y*imgDecale->getHeight());
-                //std::cout<<uv.x<<" "<<uv.y<<"  "<<decale->getSize()<<"  "<<imgDecale->getWidth()<<" "<<imgDecale->getHeight()<<std::endl;
-                Color c = imgDecale->getColor(xu,yu);
-                qc.setRgbF(c.r,c.g,c.b);
-                qimg.setPixelColor((int)decale->getCornerX() + i,(int)decale->getCornerY() + j,qc);
+    addColorImageWithDecaleUV(decale, imgDecale, QRect(0, 0, width, height));
+}
+
+void ColorImage::addColorImageWithDecaleUV(DecaleScalarField2D *decale, ColorImage *imgDecale, const QRect &clip) {
+
+    int x0, x1, y0, y1;
+    if (!decaleRows(decale, clip, x0, x1, y0, y1)) return;
+    detach();
+
+    int cornerx = (int)decale->getCornerX();
+    int cornery = (int)decale->getCornerY();
+    int bufferx1 = cornerx + (int)decale->getIWidth();
+    int buffery1 = cornery + (int)decale->getIHeight();
+
+    /***********************************
+    // Per strip of scanlines: UVs read in the Decale UV buffer (with the next column and scanline), then drawn
+    ***********************************/
+    const int rowsPerStrip = 16;
+    int stride = x1 - x0 + 1;
+    std::vector<Vector2D> uvs (stride * (rowsPerStrip + 1));
+
+    for (int ys=y0; ys<y1; ys+=rowsPerStrip) {
+        int ye = std::min(ys + rowsPerStrip, y1);
+
+        for (int y=ys; y<=ye; y++)
+            for (int x=x0; x<=x1; x++)
+                uvs[(y - ys) * stride + (x - x0)] = ((x < bufferx1) && (y < buffery1)) ?
+                        decale->getUV(x - cornerx, y - cornery) : Vector2D(-1., -1.);
+
+        addColorImageWithUV(imgDecale, x0, x1, ys, ye, uvs.data(), stride);
+    }
+}
+
+void ColorImage::addColorImageWithUV(ColorImage *imgDecale, int x0, int x1, int y0, int y1, const Vector2D *uvs, int stride) {
+
+    if (imgDecale->atlas == NULL) {
+
+        /***********************************
+        // Per scanline: texel indexes in the Decale image from the UVs (-1 outside the image), then texture fetch,
+        // the translucent texels being composited over the image
+        ***********************************/
+        const uint32_t *texture = reinterpret_cast<const uint32_t *>(imgDecale->qimg.constBits());
+        int textureStride = imgDecale->qimg.bytesPerLine() / 4;
+        std::vector<int> texels (x1 - x0);
+
+        for (int y=y0; y<y1; y++) {
+            const Vector2D *row = uvs + (y - y0) * stride;
+            for (int x=x0; x<x1; x++) {
+                const Vector2D &uv = row[x - x0];
+
+                if ((uv.x >= 0.) && (uv.y >= 0.) && (uv.x < 1.) && (uv.y < 1.))
+                    texels[x - x0] = (int)(uv.y*imgDecale->getHeight()) * textureStride + (int)(uv.x*imgDecale->getWidth());
+                else
+                    texels[x - x0] = -1;
             }
+            fetchBlendRow(detachedScanline(y) + x0, x1 - x0, texels.data(), texture);
         }
+        return;
+    }
+
+    TextureAtlas *textures = imgDecale->atlas;
+    int texture = imgDecale->atlasTexture;
+    float textureWidth = (float)textures->getWidth(texture);
+    float textureHeight = (float)textures->getHeight(texture);
+
+    for (int y=y0; y<y1; y++) {
+        const Vector2D *row = uvs + (y - y0) * stride;
+        const Vector2D *next = row + stride;
+        uint32_t *dst = detachedScanline(y);
+
+        for (int x=x0; x<x1; x++) {
+            const Vector2D &uv = row[x - x0];
+            if (!((uv.x >= 0.) && (uv.y >= 0.) && (uv.x < 1.) && (uv.y < 1.))) continue;
+
+            /***********************************
+            // Footprint of the pixel in texels: the longest of its UV differences along x and along y
+            // (a neighbour out of the Decale does not count)
+            ***********************************/
+            const Vector2D &ux = row[x - x0 + 1];
+            const Vector2D &uy = next[x - x0];
+
+            float footprint2 = 0.f;
+            if ((ux.x >= 0.) && (ux.y >= 0.) && (ux.x < 1.) && (ux.y < 1.)) {
+                float du = (float)(ux.x - uv.x) * textureWidth;
+                float dv = (float)(ux.y - uv.y) * textureHeight;
+                footprint2 = du*du + dv*dv;
+            }
+            if ((uy.x >= 0.) && (uy.y >= 0.) && (uy.x < 1.) && (uy.y < 1.)) {
+                float du = (float)(uy.x - uv.x) * textureWidth;
+                float dv = (float)(uy.y - uv.y) * textureHeight;
+                footprint2 = std::max(footprint2, du*du + dv*dv);
+            }
+
+            float level = textures->levelOfDetail(texture, sqrtf(footprint2));
+            dst[x] = blendPixel(textures->sample(texture, level, (float)uv.x, (float)uv.y), dst[x]);
+        }
+    }
 }
 
 int ColorImage::getWidth() {
@@ -123,63 +235,85 @@ int ColorImage::getHeight() {
     return height;
 }
 
+void ColorImage::setTextureAtlas(TextureAtlas *atlas) {
+
+    this->atlas = atlas;
+    atlasTexture = (atlas != NULL) ? atlas->addTexture(qimg) : -1;
+}
+
 int ColorImage::getId(){
     return decaleId;
 }
 
 void ColorImage::clearDecaleColorImage(DecaleScalarField2D *decale, ColorImage *imgDecale, GamutField2D *gamut, Color gamutColor, Color bgColor) {
 
-    Vector2D uv;
-    QColor qgamutColor, qbgColor;
-    qgamutColor.setRgbF(gamutColor.r,gamutColor.g,gamutColor.b);
-    qbgColor.setRgbF(bgColor.r, bgColor.g, bgColor.b);
-
-    for (int i=0; i<decale->getIWidth(); i++)
-        for (int j=0; j<decale->getIHeight(); j++) {
-            uv=decale->getUV(i,j);
-
-            if ((uv.x > 0.) && (uv.y > 0.) && (uv.x < 1.) && (uv.y < 1.)
-                && ((int)decale->getCornerX() + i > 0) && ((int)decale->getCornerY() + j > 0)
-                && ((int)decale->getCornerX() + i < width) && ((int)decale->getCornerY() + j < height)){
-                if (gamut->eval(decale->getCornerX() +i,decale->getCornerY() + j) > gamut->getIso())
-                    qimg.setPixelColor(decale->getCornerX() + i, decale->getCornerY() + j, qbgColor);
-                else
-                    qimg.setPixelColor(decale->getCornerX() + i, decale->getCornerY() + j, qgamutColor);
-            }
-        }
-
-
+    clearDecaleColorImage(decale, gamut, gamutColor, bgColor);
 }
 
 
 void ColorImage::clearDecaleColorImage(DecaleScalarField2D *decale, GamutField2D *gamut, Color gamutColor, Color bgColor) {
 
-    std::cout<<"ClearDecaleColorImage call"<<std::endl;
-    Vector2D uv;
-    QColor qgamutColor, qbgColor;
-    qgamutColor.setRgbF(gamutColor.r,gamutColor.g,gamutColor.b);
-    qbgColor.setRgbF(bgColor.r, bgColor.g, bgColor.b);
+    int x0, x1, y0, y1;
+    if (!decaleRows(decale, QRect(0, 0, width, height), x0, x1, y0, y1)) return;
 
-    for (int i=0; i<decale->getIWidth(); i++)
-        for (int j=0; j<decale->getIHeight(); j++) {
-            uv=decale->getUV(i,j);
+    if (background.isNull()) computeBackground(gamut, gamutColor, bgColor);
 
-            if ((uv.x > 0.) && (uv.y > 0.) && (uv.x < 1.) && (uv.y < 1.)
-                && ((int)decale->getCornerX() + i > 0) && ((int)decale->getCornerY() + j > 0)
-                && ((int)decale->getCornerX() + i < width) && ((int)decale->getCornerY() + j < height)){
+    int cornerx = (int)decale->getCornerX();
+    int cornery = (int)decale->getCornerY();
 
-                if (gamut->eval(decale->getCornerX() +i,decale->getCornerY() + j) > gamut->getIso()){
-                    qimg.setPixelColor(decale->getCornerX() + i, decale->getCornerY() + j, qbgColor);
+    /***********************************
+    // Fetch from the background scanline, -1 for the pixels out of the Decale
+    ***********************************/
+    std::vector<int> columns (x1 - x0);
+    Vector2D uv;
 
-                }else{
-                    qimg.setPixelColor(decale->getCornerX() + i, decale->getCornerY() + j, qgamutColor);
+    for (int y=y0; y<y1; y++) {
+        for (int x=x0; x<x1; x++) {
+            uv=decale->getUV(x - cornerx, y - cornery);
 
-                }
-            }
+            if ((uv.x > 0.) && (uv.y > 0.) && (uv.x < 1.) && (uv.y < 1.))
+                columns[x - x0] = x - x0;
+            else
+                columns[x - x0] = -1;
         }
+        fetchRow(scanline(y) + x0, x1 - x0, columns.data(), reinterpret_cast<const uint32_t *>(background.constScanLine(y)) + x0);
+    }
+}
+
+void ColorImage::clearColorImage(const QRect &rect) {
+
+    QRect r = rect & QRect(0, 0, width, height);
+    if (r.isEmpty() || background.isNull()) return;
+
+    for (int y=r.top(); y<=r.bottom(); y++)
+        memcpy(scanline(y) + r.left(), reinterpret_cast<const uint32_t *>(background.constScanLine(y)) + r.left(),
+               r.width() * sizeof(uint32_t));
+}
+
+void ColorImage::setBackground(GamutField2D *gf, Color gamutColor, Color bgColor) {
+
+    computeBackground(gf, gamutColor, bgColor);
+    qimg = background.copy();
+}
+
+void ColorImage::computeBackground(GamutField2D *gf, Color gamutColor, Color bgColor) {
+
+    /***********************************
+    // Background color on the scanline, then gamut color where the Gamut field is below its iso (as in setColorGamut)
+    ***********************************/
+    background = QImage(width, height, QImage::Format_ARGB32_Premultiplied);
 
-    std::cout<<"ClearDecaleColorImage ENDcall"<<std::endl;
+    uint32_t bg = scanlinePixel(bgColor.r, bgColor.g, bgColor.b);
+    uint32_t color = scanlinePixel(gamutColor.r, gamutColor.g, gamutColor.b);
+    std::vector<unsigned char> inside (width);
 
+    for (int j=0; j<height; j++) {
+        uint32_t *row = reinterpret_cast<uint32_t *>(background.scanLine(j));
+        for (int i=0; i<width; i++)
+            inside[i] = (gf->getPixelValue(i,j) < gf->getIso()) ? 1 : 0;
+        fillRow(row, width, bg);
+        maskedFillRow(row, width, inside.data(), color);
+    }
 }
 
 double ColorImage::getRatioHW() {
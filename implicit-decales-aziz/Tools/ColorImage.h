@@ -6,9 +6,12 @@
 #define TEST_COLORIMAGE_H
 
 #include "Color.h"
+#include "TextureAtlas.h"
 #include "../Gamut/GamutField2D.h"
 #include "../Decale/DecaleDiskField2D.h"
 #include <QPixmap>
+#include <QRect>
+#include <stdint.h>
 
 class ColorImage {
 public:
@@ -16,6 +19,10 @@ public:
     ColorImage ();
 
     ColorImage (const QString &fileName, unsigned int decaleId);
+    /**
+     * Decale image of an image already decoded
+     */
+    ColorImage (const QImage &image, unsigned int decaleId);
     ColorImage (const int w, const int h);
 
     Color getColor (const unsigned int i, const unsigned int j);
@@ -38,22 +45,65 @@ public:
      * Draw the Gamut in the image with the gamut color c
      */
     void setColorGamut (GamutField2D *gf, Color c);
+    /**
+     * Compute the background layer (gamut color inside the Gamut, background color outside) and copy it in the image.
+     * The Decales are then cleared by copying the layer, without evaluating the Gamut.
+     */
+    void setBackground (GamutField2D *gf, Color gamutColor, Color bgColor);
 
     /**
      * Clear the color at the location of the Decale with the background color outside the Gamut and the gaut color inside
+     * (copied from the background layer, computed at the first call if setBackground was not called)
      */
     void clearDecaleColorImage(DecaleScalarField2D *decale, ColorImage *imgDecale, GamutField2D *gamut, Color gamutColor, Color bgColor);
 
     void clearDecaleColorImage(DecaleScalarField2D *decale, GamutField2D *gamut, Color gamutColor, Color bgColor);
+    /**
+     * Clear the color in the rectangle rect by copying the background layer. Require setBackground to be called.
+     */
+    void clearColorImage(const QRect &rect);
     /**
      * Require the Decale UV buffer to be computed. Draw the Decale image deformed with the decale UV buffer
      */
     void addColorImageWithDecaleUV(DecaleScalarField2D *decale, ColorImage *imgDecale);
+    /**
+     * Same as above, only in the rectangle clip of the image
+     */
+    void addColorImageWithDecaleUV(DecaleScalarField2D *decale, ColorImage *imgDecale, const QRect &clip);
+    /**
+     * Draw the Decale image in the rectangle [x0,x1)x[y0,y1) of the image from the UVs of its pixels, its translucent
+     * and transparent pixels being composited over the image (src-over):
+     * uvs[(y-y0)*stride + (x-x0)] for x in [x0,x1] and y in [y0,y1] (the next column and scanline giving the footprints,
+     * -1 out of the Decale). The rectangle has to be inside the image.
+     * Distinct rectangles can be drawn from several threads, once the image is detached (see detach).
+     */
+    void addColorImageWithUV(ColorImage *imgDecale, int x0, int x1, int y0, int y1, const Vector2D *uvs, int stride);
+
+    /**
+     * Make the image data owned by this image only (it is copied if it is shared, e.g. with a QPixmap)
+     */
+    void detach ();
+
+    /**
+     * Rectangle [x0,x1)x[y0,y1) of the image drawn by a Decale, inside the rectangle clip.
+     * @return false if it is empty
+     */
+    bool decaleRows (DecaleScalarField2D *decale, const QRect &clip, int &x0, int &x1, int &y0, int &y1);
+
+    /**
+     * Decode the image in the texture atlas: drawn as a Decale, it is then sampled bilinearly in the mip level matching
+     * the footprint of the pixels (NULL for the nearest texel of the image).
+     */
+    void setTextureAtlas (TextureAtlas *atlas);
 
     /**
-     * Compute the QPixmap from the Qimage and return the QPixmap
+     * Compute the QPixmap from the Qimage and return the QPixmap (needs a QGuiApplication, unlike the QImage)
      */
-    QPixmap &getQPixmap ();
+    QPixmap getQPixmap ();
+    /**
+     * The image itself (premultiplied ARGB32), for drawing parts of it without converting the whole image
+     */
+    const QImage &getQImage ();
 
     int getWidth();
     int getHeight();
@@ -65,12 +115,32 @@ public:
 
 private:
 
-    QPixmap piximg;
+    /**
+     * Pixels of the scanline j (premultiplied ARGB32)
+     */
+    uint32_t *scanline (int j);
+    /**
+     * Same as scanline, without detaching the image (see detach): can be called from several threads
+     */
+    uint32_t *detachedScanline (int j);
+
+    /**
+     * Compute the background layer, without changing the image
+     */
+    void computeBackground (GamutField2D *gf, Color gamutColor, Color bgColor);
+
+    // Premultiplied ARGB32 image, written by scanlines
     QImage qimg;
+    // Background layer (same size and format as qimg), null until computed
+    QImage background;
 
     int width;
     int height;
     unsigned int decaleId;
+
+    // Texture of the image in the atlas (NULL and -1 if not in an atlas)
+    TextureAtlas *atlas;
+    int atlasTexture;
 };
 
 typedef std::vector<ColorImage *> VectorOfColorImages;
@@ -0,0 +1,72 @@
+//
+// Damaged (dirty) region of an image: the union of the rectangles that have to be redrawn and presented.
+//
+
+#include "DamageRegion.h"
+
+
+DamageRegion::DamageRegion (int width, int height) : bounds (0, 0, width, height) {}
+
+void DamageRegion::add (const QRect &rect) {
+
+    QRect r = rect & bounds;
+    if (r.isEmpty()) return;
+
+    /***********************************
+    // Merge the new rectangle with the rectangles it overlaps or touches, until it overlaps none of them
+    ***********************************/
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        QRect grown = r.adjusted(-1, -1, 1, 1);
+        for (unsigned int i=0; i<rects.size(); i++)
+            if (rects[i].intersects(grown)) {
+                r |= rects[i];
+                rects[i] = rects.back();
+                rects.pop_back();
+                merged = true;
+                break;
+            }
+    }
+    rects.push_back(r);
+
+    if (rects.size() > maxRects) {
+        QRect all;
+        for (unsigned int i=0; i<rects.size(); i++) all |= rects[i];
+        rects.assign(1, all);
+    }
+}
+
+void DamageRegion::addAll () {
+
+    rects.assign(1, bounds);
+}
+
+bool DamageRegion::isEmpty () const {
+
+    return rects.empty();
+}
+
+bool DamageRegion::intersects (const QRect &rect) const {
+
+    for (unsigned int i=0; i<rects.size(); i++)
+        if (rects[i].intersects(rect)) return true;
+    return false;
+}
+
+const std::vector<QRect> &DamageRegion::getRects () const {
+
+    return rects;
+}
+
+QRegion DamageRegion::getRegion () const {
+
+    QRegion region;
+    for (unsigned int i=0; i<rects.size(); i++) region += rects[i];
+    return region;
+}
+
+void DamageRegion::clear () {
+
+    rects.clear();
+}
@@ -0,0 +1,55 @@
+//
+// Damaged (dirty) region of an image: the union of the rectangles that have to be redrawn and presented.
+//
+// Overlapping or touching rectangles are merged into their bounding rectangle, and the whole set is merged
+// into a single bounding rectangle when it gets too fragmented, so that the region stays a few rectangles.
+//
+
+#ifndef TEST_DAMAGEREGION_H
+#define TEST_DAMAGEREGION_H
+
+#include <QRect>
+#include <QRegion>
+#include <vector>
+
+
+class DamageRegion {
+
+public:
+
+    /**
+     * Creates an empty region over an image of size width x height (the rectangles are clipped to the image).
+     */
+    DamageRegion (int width, int height);
+
+    /**
+     * Add a rectangle to the region
+     */
+    void add (const QRect &rect);
+    /**
+     * Damage the whole image
+     */
+    void addAll ();
+
+    bool isEmpty () const;
+    bool intersects (const QRect &rect) const;
+
+    /**
+     * Disjoint rectangles of the region
+     */
+    const std::vector<QRect> &getRects () const;
+    QRegion getRegion () const;
+
+    void clear ();
+
+private:
+
+    // Number of rectangles beyond which they are merged into their bounding rectangle
+    static const unsigned int maxRects = 16;
+
+    QRect bounds;
+    std::vector<QRect> rects;
+};
+
+
+#endif //TEST_DAMAGEREGION_H
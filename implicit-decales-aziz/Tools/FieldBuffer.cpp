@@ -0,0 +1,104 @@
+//
+// Storage of the discrete field buffers and UV buffers of the Decales and of the Gamut.
+//
+
+#include "FieldBuffer.h"
+
+
+FieldBuffer::FieldBuffer (unsigned int size, FieldStorage storage, BufferPool *pool)
+        : size(size), storage(storage), block(pool) {
+
+    block.reserve(size*bytesPerValue(storage));
+    data = block.getData();
+}
+
+FieldBuffer::FieldBuffer (unsigned int size, FieldStorage storage, void *values)
+        : size(size), storage(storage), block(NULL), data(values) {}
+
+size_t FieldBuffer::bytesPerValue (FieldStorage storage) {
+
+    switch (storage) {
+        case FIELD_STORAGE_FLOAT: return sizeof(float);
+        case FIELD_STORAGE_FIXED16: return sizeof(unsigned short);
+        default: return sizeof(double);
+    }
+}
+
+void FieldBuffer::copy (const FieldBuffer &source) {
+
+    if (source.storage == storage) {
+        memcpy(data, source.data, size*bytesPerValue(storage));
+        return;
+    }
+    for (unsigned int k=0; k<size; k++) set(k, source.get(k));
+}
+
+void FieldBuffer::resize (unsigned int size) {
+
+    this->size = size;
+    block.reserve(size*bytesPerValue(storage));
+    data = block.getData();
+}
+
+void FieldBuffer::setRow (unsigned int k0, unsigned int count, const double *values) {
+
+    switch (storage) {
+        case FIELD_STORAGE_FLOAT: {
+            float *out = ((float *) data) + k0;
+            for (unsigned int k=0; k<count; k++) out[k] = float(values[k]);
+        } break;
+        case FIELD_STORAGE_FIXED16: {
+            unsigned short *out = ((unsigned short *) data) + k0;
+            for (unsigned int k=0; k<count; k++) out[k] = toFixed16(values[k]);
+        } break;
+        default:
+            memcpy(((double *) data) + k0, values, count*sizeof(double));
+            break;
+    }
+}
+
+unsigned int FieldBuffer::getSize () const {
+
+    return size;
+}
+
+FieldStorage FieldBuffer::getStorage () const {
+
+    return storage;
+}
+
+const void *FieldBuffer::getData () const {
+
+    return data;
+}
+
+
+UVBuffer::UVBuffer (unsigned int size, UVStorage storage, BufferPool *pool)
+        : size(size), storage(storage), block(pool) {
+
+    block.reserve(size*bytesPerUV(storage));
+    data = block.getData();
+}
+
+size_t UVBuffer::bytesPerUV (UVStorage storage) {
+
+    if (storage == UV_STORAGE_HALF) return 2*sizeof(unsigned short);
+    return 2*sizeof(double);
+}
+
+void UVBuffer::resize (unsigned int size) {
+
+    this->size = size;
+    block.reserve(size*bytesPerUV(storage));
+    data = block.getData();
+}
+
+unsigned int UVBuffer::getSize () const {
+
+    return size;
+}
+
+UVStorage UVBuffer::getStorage () const {
+
+    return storage;
+}
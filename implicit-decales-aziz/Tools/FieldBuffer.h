@@ -0,0 +1,211 @@
+//
+// Storage of the discrete field buffers and UV buffers of the Decales and of the Gamut.
+//
+// A FieldBuffer stores field values in [0,1] either as doubles, floats or 16-bit fixed-point values.
+// A UVBuffer stores (u,v) parameterizations either as two doubles or two half-precision floats.
+// Values are always read and written as doubles: the conversion is done on access, so that the buffers
+// take 8, 4 or 2 bytes per field value and 16 or 4 bytes per UV.
+// The memory of the buffers is taken from a BufferPool when one is given, and is kept when a buffer shrinks.
+//
+
+#ifndef TEST_FIELDBUFFER_H
+#define TEST_FIELDBUFFER_H
+
+#include <string.h>
+#include "Vector2D.h"
+#include "BufferPool.h"
+
+
+enum FieldStorage {
+    FIELD_STORAGE_DOUBLE,
+    FIELD_STORAGE_FLOAT,
+    // 16-bit fixed point over [0,1] (values are clamped to [0,1])
+    FIELD_STORAGE_FIXED16
+};
+
+enum UVStorage {
+    UV_STORAGE_DOUBLE,
+    UV_STORAGE_HALF
+};
+
+
+/**
+ * IEEE 754 half-precision conversions (rounded to the nearest)
+ */
+inline unsigned short floatToHalf (float f) {
+
+    unsigned int x;
+    memcpy(&x, &f, sizeof(x));
+
+    unsigned int sign = (x >> 16) & 0x8000u;
+    int exponent = int((x >> 23) & 0xffu) - 127 + 15;
+    unsigned int mantissa = x & 0x7fffffu;
+
+    if (exponent <= 0) {
+        if (exponent < -10) return (unsigned short) sign;
+        mantissa |= 0x800000u;
+        unsigned int shift = (unsigned int)(14 - exponent);
+        unsigned int half = mantissa >> shift;
+        if ((mantissa >> (shift-1)) & 1u) half++;
+        return (unsigned short)(sign | half);
+    }
+    if (exponent >= 31) return (unsigned short)(sign | 0x7c00u);
+
+    unsigned int half = sign | ((unsigned int) exponent << 10) | (mantissa >> 13);
+    if (mantissa & 0x1000u) half++;
+    return (unsigned short) half;
+}
+
+inline float halfToFloat (unsigned short h) {
+
+    unsigned int sign = (unsigned int)(h & 0x8000u) << 16;
+    unsigned int exponent = (h >> 10) & 0x1fu;
+    unsigned int mantissa = h & 0x3ffu;
+    unsigned int x;
+
+    if (exponent == 0) {
+        if (mantissa == 0) x = sign;
+        else {
+            exponent = 127 - 15 + 1;
+            while (!(mantissa & 0x400u)) {
+                mantissa <<= 1;
+                exponent--;
+            }
+            x = sign | (exponent << 23) | ((mantissa & 0x3ffu) << 13);
+        }
+    }
+    else if (exponent == 31) x = sign | 0x7f800000u | (mantissa << 13);
+    else x = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+
+    float f;
+    memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+
+class FieldBuffer {
+
+public:
+
+    FieldBuffer (unsigned int size, FieldStorage storage, BufferPool *pool = NULL);
+
+    /**
+     * Buffer on size values stored in memory it does not own (e.g. a mapped cache file), which has to outlive it.
+     * Its values are taken from a block of its own if it is resized.
+     */
+    FieldBuffer (unsigned int size, FieldStorage storage, void *values);
+
+    double get (unsigned int k) const {
+
+        switch (storage) {
+            case FIELD_STORAGE_FLOAT: return double(((const float *) data)[k]);
+            case FIELD_STORAGE_FIXED16: return double(((const unsigned short *) data)[k]) * (1./65535.);
+            default: return ((const double *) data)[k];
+        }
+    }
+
+    void set (unsigned int k, double value) {
+
+        switch (storage) {
+            case FIELD_STORAGE_FLOAT: ((float *) data)[k] = float(value); break;
+            case FIELD_STORAGE_FIXED16: ((unsigned short *) data)[k] = toFixed16(value); break;
+            default: ((double *) data)[k] = value; break;
+        }
+    }
+
+    /**
+     * Store count consecutive values starting at the index k0
+     */
+    void setRow (unsigned int k0, unsigned int count, const double *values);
+
+    /**
+     * Copy the values of a buffer of the same size (converted if the storage differs)
+     */
+    void copy (const FieldBuffer &source);
+
+    /**
+     * Change the number of values of the buffer. The values are lost (they have to be recomputed).
+     */
+    void resize (unsigned int size);
+
+    unsigned int getSize () const;
+    FieldStorage getStorage () const;
+
+    /**
+     * The values, in the storage of the buffer (getSize()*bytesPerValue(getStorage()) bytes)
+     */
+    const void *getData () const;
+
+    static size_t bytesPerValue (FieldStorage storage);
+
+private:
+
+    static unsigned short toFixed16 (double value) {
+
+        if (value <= 0.) return 0;
+        if (value >= 1.) return 65535;
+        return (unsigned short)(value * 65535. + 0.5);
+    }
+
+    FieldBuffer (const FieldBuffer &);
+    FieldBuffer &operator = (const FieldBuffer &);
+
+    unsigned int size;
+    FieldStorage storage;
+    PooledBlock block;
+    void *data;
+};
+
+
+class UVBuffer {
+
+public:
+
+    UVBuffer (unsigned int size, UVStorage storage, BufferPool *pool = NULL);
+
+    Vector2D get (unsigned int k) const {
+
+        if (storage == UV_STORAGE_HALF) {
+            const unsigned short *uv = ((const unsigned short *) data) + 2*k;
+            return Vector2D(halfToFloat(uv[0]), halfToFloat(uv[1]));
+        }
+        const double *uv = ((const double *) data) + 2*k;
+        return Vector2D(uv[0], uv[1]);
+    }
+
+    void set (unsigned int k, double u, double v) {
+
+        if (storage == UV_STORAGE_HALF) {
+            unsigned short *uv = ((unsigned short *) data) + 2*k;
+            uv[0] = floatToHalf(float(u));
+            uv[1] = floatToHalf(float(v));
+            return;
+        }
+        double *uv = ((double *) data) + 2*k;
+        uv[0] = u;
+        uv[1] = v;
+    }
+
+    /**
+     * Change the number of UVs of the buffer. The UVs are lost (they have to be recomputed).
+     */
+    void resize (unsigned int size);
+
+    unsigned int getSize () const;
+    UVStorage getStorage () const;
+
+private:
+
+    static size_t bytesPerUV (UVStorage storage);
+
+    UVBuffer (const UVBuffer &);
+    UVBuffer &operator = (const UVBuffer &);
+
+    unsigned int size;
+    UVStorage storage;
+    PooledBlock block;
+    void *data;
+};
+
+
+#endif //TEST_FIELDBUFFER_H
@@ -0,0 +1,116 @@
+//
+// On-disk cache of a precomputed buffer (distance field of the Gamut mask, field buffer of the Gamut).
+//
+
+#include "FieldCache.h"
+#include <QFile>
+#include <QSaveFile>
+#include <QString>
+#include <string.h>
+
+
+/***********************************
+// Header of a cache file, followed by the buffer (the header size keeps the buffer 8-byte aligned)
+***********************************/
+struct FieldCacheHeader {
+
+    char magic[8];
+    uint64_t version;
+    uint64_t key;
+    uint64_t bytes;
+};
+
+static const char fieldCacheMagic[8] = {'D', 'E', 'C', 'A', 'L', 'E', 'F', 'C'};
+// Version 2: d and dn of the distance fields are stored as floats
+static const uint64_t fieldCacheVersion = 2;
+
+
+FieldCache::FieldCache () : file(NULL), mapped(NULL) {}
+
+FieldCache::~FieldCache () {
+
+    unmap();
+}
+
+void FieldCache::setFileName (const std::string &fileName) {
+
+    unmap();
+    this->fileName = fileName;
+}
+
+bool FieldCache::isEnabled () const {
+
+    return !fileName.empty();
+}
+
+void *FieldCache::map (uint64_t key, size_t bytes) {
+
+    unmap();
+    if (!isEnabled()) return NULL;
+
+    file = new QFile(QString::fromStdString(fileName));
+    if (!file->open(QIODevice::ReadOnly) || (file->size() != qint64(sizeof(FieldCacheHeader) + bytes))) {
+        unmap();
+        return NULL;
+    }
+
+    mapped = file->map(0, file->size(), QFileDevice::MapPrivateOption);
+    if (mapped == NULL) {
+        unmap();
+        return NULL;
+    }
+
+    FieldCacheHeader header;
+    memcpy(&header, mapped, sizeof(header));
+    if ((memcmp(header.magic, fieldCacheMagic, sizeof(fieldCacheMagic)) != 0) || (header.version != fieldCacheVersion)
+        || (header.key != key) || (header.bytes != bytes)) {
+        unmap();
+        return NULL;
+    }
+
+    return mapped + sizeof(FieldCacheHeader);
+}
+
+bool FieldCache::store (uint64_t key, const void *data, size_t bytes) {
+
+    if (!isEnabled()) return false;
+
+    FieldCacheHeader header;
+    memcpy(header.magic, fieldCacheMagic, sizeof(fieldCacheMagic));
+    header.version = fieldCacheVersion;
+    header.key = key;
+    header.bytes = bytes;
+
+    /***********************************
+    // The file is replaced once fully written, so that an interrupted write never leaves a truncated cache
+    ***********************************/
+    QSaveFile out (QString::fromStdString(fileName));
+    if (!out.open(QIODevice::WriteOnly)) return false;
+    if (out.write((const char *) &header, sizeof(header)) != qint64(sizeof(header))) return false;
+    if (out.write((const char *) data, qint64(bytes)) != qint64(bytes)) return false;
+
+    return out.commit();
+}
+
+uint64_t FieldCache::hash (const void *data, size_t bytes, uint64_t seed) {
+
+    const unsigned char *p = (const unsigned char *) data;
+    uint64_t h = seed;
+    for (size_t i=0; i<bytes; i++) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+void FieldCache::unmap () {
+
+    if (file == NULL) return;
+
+    if (mapped != NULL) file->unmap(mapped);
+    file->close();
+    delete file;
+
+    file = NULL;
+    mapped = NULL;
+}
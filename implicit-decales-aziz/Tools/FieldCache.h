@@ -0,0 +1,69 @@
+//
+// On-disk cache of a precomputed buffer (distance field of the Gamut mask, field buffer of the Gamut).
+//
+// A cache file holds a single buffer and the key of the data it was computed from (a hash of the inputs).
+// When the key matches, the file is memory-mapped and its content used in place, instead of being recomputed.
+// The mapping is private (copy on write): the buffer can be modified without changing the file.
+//
+
+#ifndef TEST_FIELDCACHE_H
+#define TEST_FIELDCACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+class QFile;
+
+
+class FieldCache {
+
+public:
+
+    /**
+     * Creates a disabled cache (no file name).
+     */
+    FieldCache ();
+    /**
+     * Unmaps the cached buffer: it must not be used anymore.
+     */
+    ~FieldCache ();
+
+    /**
+     * Set the cache file. The cache is disabled with an empty name.
+     */
+    void setFileName (const std::string &fileName);
+    bool isEnabled () const;
+
+    /**
+     * Maps the buffer of the cache file if it was stored with the same key and size.
+     * The buffer stays mapped until the cache is mapped again or destroyed.
+     * @return the buffer, NULL if the file does not hold it
+     */
+    void *map (uint64_t key, size_t bytes);
+
+    /**
+     * Replaces the content of the cache file by the buffer of the given key.
+     * @return false if the file could not be written
+     */
+    bool store (uint64_t key, const void *data, size_t bytes);
+
+    /**
+     * 64-bit FNV-1a hash of bytes bytes, to be chained through seed to hash several inputs.
+     */
+    static uint64_t hash (const void *data, size_t bytes, uint64_t seed = 14695981039346656037ULL);
+
+private:
+
+    FieldCache (const FieldCache &);
+    FieldCache &operator = (const FieldCache &);
+
+    void unmap ();
+
+    std::string fileName;
+    QFile *file;
+    unsigned char *mapped;
+};
+
+
+#endif //TEST_FIELDCACHE_H
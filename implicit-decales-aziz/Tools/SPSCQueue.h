@@ -0,0 +1,74 @@
+//
+// Bounded lock-free queue between one producer thread and one consumer thread.
+//
+// The values are copied in a ring of preallocated slots. The producer only writes the tail index and the consumer the
+// head index, so that neither push nor pop ever waits for the other thread: push fails when the ring is full.
+//
+
+#ifndef TEST_SPSCQUEUE_H
+#define TEST_SPSCQUEUE_H
+
+#include <vector>
+#include <atomic>
+#include <stddef.h>
+
+
+template <typename T>
+class SPSCQueue {
+
+public:
+
+    /**
+     * Creates an empty queue of capacity values
+     */
+    explicit SPSCQueue (size_t capacity) : slots(capacity + 1), head(0), tail(0) {}
+
+    /**
+     * Copy a value at the back of the queue (producer thread only).
+     * @return false if the queue is full (the value is not pushed)
+     */
+    bool push (const T &value) {
+
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t next = (t + 1) % slots.size();
+        if (next == head.load(std::memory_order_acquire)) return false;
+
+        slots[t] = value;
+        tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Copy the value at the front of the queue in value and remove it (consumer thread only).
+     * @return false if the queue is empty (value is unchanged)
+     */
+    bool pop (T &value) {
+
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) return false;
+
+        value = slots[h];
+        head.store((h + 1) % slots.size(), std::memory_order_release);
+        return true;
+    }
+
+    bool isEmpty () const {
+
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+private:
+
+    SPSCQueue (const SPSCQueue &);
+    SPSCQueue &operator = (const SPSCQueue &);
+
+    // One slot is always free, to tell a full ring from an empty one
+    std::vector<T> slots;
+    // Next slot to pop (written by the consumer)
+    std::atomic<size_t> head;
+    // Next slot to push (written by the producer)
+    std::atomic<size_t> tail;
+};
+
+
+#endif //TEST_SPSCQUEUE_H
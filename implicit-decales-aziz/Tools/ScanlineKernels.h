@@ -0,0 +1,153 @@
+//
+// Scanline kernels of the ColorImage compositing.
+//
+// The images are stored as premultiplied ARGB32 (one 32-bit word per pixel), and a scanline is a line of
+// constant y, contiguous in memory. The kernels below write a run of pixels of a scanline with packs of pixels:
+// 8 lanes with AVX2, 4 lanes with SSE2, and a scalar path for the remaining pixels (or when no SIMD
+// instruction set is enabled at compile time).
+//
+
+#ifndef TEST_SCANLINEKERNELS_H
+#define TEST_SCANLINEKERNELS_H
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SCANLINE_LANES 8
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SCANLINE_LANES 4
+#else
+#define SCANLINE_LANES 1
+#endif
+
+
+/**
+ * Opaque premultiplied ARGB32 pixel of the color (r, g, b) in [0,1]
+ */
+inline uint32_t scanlinePixel (float r, float g, float b) {
+
+    uint32_t ir = (uint32_t)(r * 255.f + 0.5f);
+    uint32_t ig = (uint32_t)(g * 255.f + 0.5f);
+    uint32_t ib = (uint32_t)(b * 255.f + 0.5f);
+    return 0xff000000u | (ir << 16) | (ig << 8) | ib;
+}
+
+/**
+ * Premultiplied ARGB32 pixel src composited over dst (src-over): src + dst * (255 - alpha of src) / 255
+ */
+inline uint32_t blendPixel (uint32_t src, uint32_t dst) {
+
+    uint32_t alpha = src >> 24;
+    if (alpha == 0xff) return src;
+    if (alpha == 0) return dst;
+
+    /***********************************
+    // Two channels per 32-bit operation, divided by 255 with rounding: (t + (t >> 8)) >> 8 with t = x + 128
+    ***********************************/
+    uint32_t inv = 255 - alpha;
+    uint32_t rb = (dst & 0x00ff00ffu) * inv + 0x00800080u;
+    rb = ((rb + ((rb >> 8) & 0x00ff00ffu)) >> 8) & 0x00ff00ffu;
+    uint32_t ag = ((dst >> 8) & 0x00ff00ffu) * inv + 0x00800080u;
+    ag = (ag + ((ag >> 8) & 0x00ff00ffu)) & 0xff00ff00u;
+    return src + rb + ag;
+}
+
+/**
+ * dst[k] = color for k in [0, count)
+ */
+inline void fillRow (uint32_t *dst, unsigned int count, uint32_t color) {
+
+    unsigned int k = 0;
+#if SCANLINE_LANES == 8
+    __m256i c = _mm256_set1_epi32((int) color);
+    for (; k + 8 <= count; k += 8) _mm256_storeu_si256((__m256i *) (dst + k), c);
+#elif SCANLINE_LANES == 4
+    __m128i c = _mm_set1_epi32((int) color);
+    for (; k + 4 <= count; k += 4) _mm_storeu_si128((__m128i *) (dst + k), c);
+#endif
+    for (; k < count; k++) dst[k] = color;
+}
+
+/**
+ * dst[k] = color where mask[k] != 0, for k in [0, count)
+ */
+inline void maskedFillRow (uint32_t *dst, unsigned int count, const unsigned char *mask, uint32_t color) {
+
+    unsigned int k = 0;
+#if SCANLINE_LANES == 8
+    __m256i c = _mm256_set1_epi32((int) color);
+    __m256i zero = _mm256_setzero_si256();
+    for (; k + 8 <= count; k += 8) {
+        long long bytes;
+        memcpy(&bytes, mask + k, 8);
+        __m256i m = _mm256_cvtepu8_epi32(_mm_cvtsi64_si128(bytes));
+        m = _mm256_xor_si256(_mm256_cmpeq_epi32(m, zero), _mm256_set1_epi32(-1));
+        __m256i d = _mm256_loadu_si256((const __m256i *) (dst + k));
+        _mm256_storeu_si256((__m256i *) (dst + k), _mm256_blendv_epi8(d, c, m));
+    }
+#elif SCANLINE_LANES == 4
+    __m128i c = _mm_set1_epi32((int) color);
+    __m128i zero = _mm_setzero_si128();
+    for (; k + 4 <= count; k += 4) {
+        int bytes;
+        memcpy(&bytes, mask + k, 4);
+        __m128i m = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero);
+        m = _mm_cmpeq_epi32(m, zero);
+        __m128i d = _mm_loadu_si128((const __m128i *) (dst + k));
+        _mm_storeu_si128((__m128i *) (dst + k), _mm_or_si128(_mm_and_si128(m, d), _mm_andnot_si128(m, c)));
+    }
+#endif
+    for (; k < count; k++) if (mask[k]) dst[k] = color;
+}
+
+/**
+ * dst[k] = src[index[k]] where index[k] >= 0, for k in [0, count): texture fetch (the indexes being computed from UVs)
+ * or palette lookup.
+ */
+inline void fetchRow (uint32_t *dst, unsigned int count, const int *index, const uint32_t *src) {
+
+    unsigned int k = 0;
+#if SCANLINE_LANES == 8
+    __m256i minusOne = _mm256_set1_epi32(-1);
+    for (; k + 8 <= count; k += 8) {
+        __m256i i = _mm256_loadu_si256((const __m256i *) (index + k));
+        __m256i m = _mm256_cmpgt_epi32(i, minusOne);
+        __m256i d = _mm256_loadu_si256((const __m256i *) (dst + k));
+        d = _mm256_mask_i32gather_epi32(d, (const int *) src, i, m, 4);
+        _mm256_storeu_si256((__m256i *) (dst + k), d);
+    }
+#endif
+    for (; k < count; k++) if (index[k] >= 0) dst[k] = src[index[k]];
+}
+
+/**
+ * dst[k] = src[index[k]] over dst[k] (see blendPixel) where index[k] >= 0, for k in [0, count): texture fetch of a
+ * texture with transparent or translucent texels. The packs of opaque texels are stored without blending.
+ */
+inline void fetchBlendRow (uint32_t *dst, unsigned int count, const int *index, const uint32_t *src) {
+
+    unsigned int k = 0;
+#if SCANLINE_LANES == 8
+    __m256i minusOne = _mm256_set1_epi32(-1);
+    __m256i opaque = _mm256_set1_epi32((int) 0xff000000u);
+    for (; k + 8 <= count; k += 8) {
+        __m256i i = _mm256_loadu_si256((const __m256i *) (index + k));
+        __m256i m = _mm256_cmpgt_epi32(i, minusOne);
+        __m256i d = _mm256_loadu_si256((const __m256i *) (dst + k));
+        __m256i s = _mm256_mask_i32gather_epi32(d, (const int *) src, i, m, 4);
+        __m256i o = _mm256_cmpeq_epi32(_mm256_and_si256(s, opaque), opaque);
+        if (_mm256_movemask_epi8(_mm256_andnot_si256(o, m)) == 0) {
+            _mm256_storeu_si256((__m256i *) (dst + k), s);
+            continue;
+        }
+        for (unsigned int l = k; l < k + 8; l++) if (index[l] >= 0) dst[l] = blendPixel(src[index[l]], dst[l]);
+    }
+#endif
+    for (; k < count; k++) if (index[k] >= 0) dst[k] = blendPixel(src[index[k]], dst[k]);
+}
+
+
+#endif //TEST_SCANLINEKERNELS_H
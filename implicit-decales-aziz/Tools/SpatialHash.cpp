@@ -0,0 +1,57 @@
+//
+// Uniform grid hashing 2D points by cell, to find the pairs of close points without testing all the pairs.
+//
+
+#include "SpatialHash.h"
+#include <algorithm>
+#include <cmath>
+
+SpatialHash::SpatialHash () : cellSize(1.) {}
+
+int64_t SpatialHash::key (int64_t cx, int64_t cy) {
+
+    return (cx << 32) ^ (cy & 0xffffffff);
+}
+
+void SpatialHash::build (const std::vector<double> &posx, const std::vector<double> &posy, double cellSize) {
+
+    this->cellSize = cellSize;
+    cells.clear();
+    filled.clear();
+
+    for (size_t i = 0; i < posx.size(); i++) {
+        int64_t cx = int64_t(std::floor(posx[i] / cellSize));
+        int64_t cy = int64_t(std::floor(posy[i] / cellSize));
+        std::vector<size_t> &cell = cells[key(cx, cy)];
+        if (cell.empty()) filled.push_back({{cx, cy}});
+        cell.push_back(i);
+    }
+}
+
+void SpatialHash::candidatePairs (std::vector< std::array<size_t, 2> > &pairs) const {
+
+    /***********************************
+    // The pairs of a cell, then the ones with half of its neighbours (the other half finds this cell as neighbour)
+    ***********************************/
+    static const int64_t neighbours[4][2] = {{1, 0}, {-1, 1}, {0, 1}, {1, 1}};
+
+    for (const std::array<int64_t, 2> &c : filled) {
+        const std::vector<size_t> &cell = cells.at(key(c[0], c[1]));
+
+        for (size_t a = 0; a < cell.size(); a++) {
+            for (size_t b = a + 1; b < cell.size(); b++) {
+                pairs.push_back({{std::min(cell[a], cell[b]), std::max(cell[a], cell[b])}});
+            }
+        }
+
+        for (const int64_t *n : neighbours) {
+            std::unordered_map< int64_t, std::vector<size_t> >::const_iterator it = cells.find(key(c[0] + n[0], c[1] + n[1]));
+            if (it == cells.end()) continue;
+            for (size_t i : cell) {
+                for (size_t j : it->second) {
+                    pairs.push_back({{std::min(i, j), std::max(i, j)}});
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,46 @@
+//
+// Uniform grid hashing 2D points by cell, to find the pairs of close points without testing all the pairs.
+//
+// The points are bucketed in square cells of a given size: two points closer than the cell size (along both axes) are
+// in the same cell or in adjacent ones. Only the pairs of these neighbouring cells are candidates.
+//
+
+#ifndef TEST_SPATIALHASH_H
+#define TEST_SPATIALHASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <array>
+#include <unordered_map>
+#include <vector>
+
+
+class SpatialHash {
+
+public:
+
+    SpatialHash ();
+
+    /**
+     * Bucket the points (posx[i], posy[i]) in cells of cellSize (> 0). The previous points are forgotten.
+     */
+    void build (const std::vector<double> &posx, const std::vector<double> &posy, double cellSize);
+
+    /**
+     * Append to pairs each pair of points (i < j) in the same or adjacent cells, once.
+     * Every pair closer than the cell size along both axes is in, farther ones may be.
+     */
+    void candidatePairs (std::vector< std::array<size_t, 2> > &pairs) const;
+
+private:
+
+    static int64_t key (int64_t cx, int64_t cy);
+
+    double cellSize;
+    // Points of each non empty cell, and the cells in the order they were filled (for a deterministic output)
+    std::unordered_map< int64_t, std::vector<size_t> > cells;
+    std::vector< std::array<int64_t, 2> > filled;
+};
+
+
+#endif //TEST_SPATIALHASH_H
@@ -0,0 +1,133 @@
+//
+// Atlas of the Decale textures, with their mip chains, and their sampler.
+//
+
+#include "TextureAtlas.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+
+/***********************************
+// Interpolation of two premultiplied ARGB32 texels with the weight w in [0,256] of b (two channels per 32-bit operation)
+***********************************/
+static inline uint32_t lerpTexel (uint32_t a, uint32_t b, uint32_t w) {
+
+    uint32_t rb = (((a & 0x00ff00ffu) * (256 - w) + (b & 0x00ff00ffu) * w) >> 8) & 0x00ff00ffu;
+    uint32_t ag = (((a >> 8) & 0x00ff00ffu) * (256 - w) + ((b >> 8) & 0x00ff00ffu) * w) & 0xff00ff00u;
+    return rb | ag;
+}
+
+/***********************************
+// Mean of four premultiplied ARGB32 texels
+***********************************/
+static inline uint32_t meanTexel (uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+
+    uint32_t mean = 0;
+    for (int shift=0; shift<32; shift+=8) {
+        uint32_t sum = ((a >> shift) & 0xff) + ((b >> shift) & 0xff) + ((c >> shift) & 0xff) + ((d >> shift) & 0xff);
+        mean |= ((sum + 2) >> 2) << shift;
+    }
+    return mean;
+}
+
+
+TextureAtlas::TextureAtlas () {}
+
+int TextureAtlas::addTexture (const QImage &image) {
+
+    QImage argb = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+    std::vector<Level> levels;
+    Level level;
+    level.offset = texels.size();
+    level.width = std::max(argb.width(), 1);
+    level.height = std::max(argb.height(), 1);
+
+    /***********************************
+    // Level 0: the image
+    ***********************************/
+    texels.resize(level.offset + (size_t)level.width * level.height, 0);
+    for (int j=0; j<argb.height(); j++)
+        memcpy(&texels[level.offset + (size_t)j * level.width], argb.constScanLine(j), argb.width() * sizeof(uint32_t));
+    levels.push_back(level);
+
+    /***********************************
+    // Halved levels down to 1x1 (the last row or column of an odd level is clamped)
+    ***********************************/
+    while ((level.width > 1) || (level.height > 1)) {
+        Level previous = level;
+        level.offset = texels.size();
+        level.width = std::max(previous.width / 2, 1);
+        level.height = std::max(previous.height / 2, 1);
+        texels.resize(level.offset + (size_t)level.width * level.height);
+
+        const uint32_t *src = &texels[previous.offset];
+        uint32_t *dst = &texels[level.offset];
+        for (int j=0; j<level.height; j++) {
+            int j0 = std::min(2*j, previous.height - 1);
+            int j1 = std::min(2*j + 1, previous.height - 1);
+            for (int i=0; i<level.width; i++) {
+                int i0 = std::min(2*i, previous.width - 1);
+                int i1 = std::min(2*i + 1, previous.width - 1);
+                dst[j*level.width + i] = meanTexel(src[j0*previous.width + i0], src[j0*previous.width + i1],
+                                                   src[j1*previous.width + i0], src[j1*previous.width + i1]);
+            }
+        }
+        levels.push_back(level);
+    }
+
+    textures.push_back(levels);
+    return (int)textures.size() - 1;
+}
+
+int TextureAtlas::getNbTextures () const {
+
+    return (int)textures.size();
+}
+
+int TextureAtlas::getNbLevels (int texture) const {
+
+    return (int)textures[texture].size();
+}
+
+int TextureAtlas::getWidth (int texture) const {
+
+    return textures[texture][0].width;
+}
+
+int TextureAtlas::getHeight (int texture) const {
+
+    return textures[texture][0].height;
+}
+
+float TextureAtlas::levelOfDetail (int texture, float footprint) const {
+
+    if (!(footprint > 1.f)) return 0.f;
+    return std::min(log2f(footprint), (float)(textures[texture].size() - 1));
+}
+
+uint32_t TextureAtlas::sample (int texture, float level, float u, float v) const {
+
+    const Level &l = textures[texture][std::min((size_t)(level + 0.5f), textures[texture].size() - 1)];
+    const uint32_t *t = &texels[l.offset];
+
+    /***********************************
+    // Texel centers around (u,v), and the weights (in 1/256) of the second ones
+    ***********************************/
+    float x = u * l.width - 0.5f;
+    float y = v * l.height - 0.5f;
+    float fx = floorf(x);
+    float fy = floorf(y);
+    uint32_t wx = (uint32_t)((x - fx) * 256.f);
+    uint32_t wy = (uint32_t)((y - fy) * 256.f);
+
+    int i0 = std::min(std::max((int)fx, 0), l.width - 1);
+    int i1 = std::min(std::max((int)fx + 1, 0), l.width - 1);
+    int j0 = std::min(std::max((int)fy, 0), l.height - 1);
+    int j1 = std::min(std::max((int)fy + 1, 0), l.height - 1);
+
+    uint32_t top = lerpTexel(t[j0*l.width + i0], t[j0*l.width + i1], wx);
+    uint32_t bottom = lerpTexel(t[j1*l.width + i0], t[j1*l.width + i1], wx);
+    return lerpTexel(top, bottom, wy);
+}
@@ -0,0 +1,63 @@
+//
+// Atlas of the Decale textures, with their mip chains, and their sampler.
+//
+// The images are decoded once in a single contiguous buffer of premultiplied ARGB32 texels: per texture, the level 0
+// (the image) followed by the levels halved down to 1x1 (each texel being the mean of 2x2 texels of the level above).
+// The sampler picks the level from the footprint of a pixel in the texture and interpolates it bilinearly, so that
+// minified Decales read a few texels close in memory, whatever the resolution of their image.
+//
+
+#ifndef TEST_TEXTUREATLAS_H
+#define TEST_TEXTUREATLAS_H
+
+#include <QImage>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+
+class TextureAtlas {
+
+public:
+
+    TextureAtlas ();
+
+    /**
+     * Decode the image in the atlas and compute its mip chain.
+     * @return the index of the texture in the atlas
+     */
+    int addTexture (const QImage &image);
+
+    int getNbTextures () const;
+    int getNbLevels (int texture) const;
+    int getWidth (int texture) const;
+    int getHeight (int texture) const;
+
+    /**
+     * Level of detail of a pixel whose footprint in the texture (level 0) spans footprint texels:
+     * log2 of the footprint, clamped to the levels of the texture
+     */
+    float levelOfDetail (int texture, float footprint) const;
+
+    /**
+     * Bilinear sample of the level (rounded to the nearest one) of the texture at (u,v) in [0,1)x[0,1),
+     * the texture being clamped to its edges
+     */
+    uint32_t sample (int texture, float level, float u, float v) const;
+
+private:
+
+    struct Level {
+        size_t offset;
+        int width;
+        int height;
+    };
+
+    // Per texture, its levels (the first one being the image)
+    std::vector<std::vector<Level>> textures;
+    // Texels of all the levels of all the textures
+    std::vector<uint32_t> texels;
+};
+
+
+#endif //TEST_TEXTUREATLAS_H
@@ -0,0 +1,142 @@
+//
+// Work-stealing pool of threads for the data parallel passes (Deformers).
+//
+
+#include "ThreadPool.h"
+
+
+ThreadPool::ThreadPool (unsigned int nbThreads) : pending (0), stopping (false) {
+
+    if (nbThreads == 0) {
+        unsigned int hardware = std::thread::hardware_concurrency();
+        nbThreads = (hardware > 1) ? hardware - 1 : 0;
+    }
+
+    for (unsigned int i=0; i<nbThreads; i++) queues.push_back(new Queue());
+    for (unsigned int i=0; i<nbThreads; i++) threads.push_back(std::thread(&ThreadPool::work, this, i));
+}
+
+ThreadPool::~ThreadPool () {
+
+    {
+        std::lock_guard<std::mutex> lock (sleepMutex);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+
+    for (unsigned int i=0; i<threads.size(); i++) threads[i].join();
+    for (unsigned int i=0; i<queues.size(); i++) delete queues[i];
+}
+
+unsigned int ThreadPool::getNbThreads () {
+
+    return threads.size();
+}
+
+void ThreadPool::parallelFor (unsigned int count, const std::function<void (unsigned int)> &task) {
+
+    if (count == 0) return;
+
+    /***********************************
+    // Without workers (or with a single task) the tasks are run by the calling thread
+    ***********************************/
+    if (threads.empty() || (count == 1)) {
+        for (unsigned int t=0; t<count; t++) task(t);
+        return;
+    }
+
+    /***********************************
+    // Split the tasks into a few jobs per thread, so that the threads running short jobs can steal the remaining ones
+    ***********************************/
+    unsigned int nbJobs = 4 * (threads.size() + 1);
+    if (nbJobs > count) nbJobs = count;
+
+    std::atomic<unsigned int> remaining (count);
+
+    for (unsigned int j=0; j<nbJobs; j++) {
+        Job job;
+        job.task = &task;
+        job.begin = (unsigned int) ((unsigned long long) count * j / nbJobs);
+        job.end = (unsigned int) ((unsigned long long) count * (j + 1) / nbJobs);
+        job.remaining = &remaining;
+
+        Queue *queue = queues[j % queues.size()];
+        std::lock_guard<std::mutex> lock (queue->mutex);
+        queue->jobs.push_back(job);
+        pending++;
+    }
+    {
+        std::lock_guard<std::mutex> lock (sleepMutex);
+    }
+    wakeUp.notify_all();
+
+    /***********************************
+    // The calling thread steals jobs (not only its own ones) until all its jobs are done
+    ***********************************/
+    while (remaining > 0) {
+        Job job;
+        if (steal(queues.size(), job)) {
+            run(job);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock (sleepMutex);
+        jobsDone.wait(lock, [&remaining] { return remaining == 0; });
+    }
+}
+
+bool ThreadPool::pop (unsigned int queue, Job &job) {
+
+    std::lock_guard<std::mutex> lock (queues[queue]->mutex);
+    if (queues[queue]->jobs.empty()) return false;
+
+    job = queues[queue]->jobs.back();
+    queues[queue]->jobs.pop_back();
+    pending--;
+    return true;
+}
+
+bool ThreadPool::steal (unsigned int thief, Job &job) {
+
+    for (unsigned int i=1; i<=queues.size(); i++) {
+        unsigned int q = (thief + i) % queues.size();
+        if (q == thief) continue;
+
+        std::lock_guard<std::mutex> lock (queues[q]->mutex);
+        if (queues[q]->jobs.empty()) continue;
+
+        job = queues[q]->jobs.front();
+        queues[q]->jobs.pop_front();
+        pending--;
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::run (const Job &job) {
+
+    for (unsigned int t=job.begin; t<job.end; t++) (*job.task)(t);
+
+    /***********************************
+    // The remaining counter belongs to the parallelFor call: it must not be used once it reaches 0
+    ***********************************/
+    unsigned int done = job.end - job.begin;
+    if (job.remaining->fetch_sub(done) == done) {
+        std::lock_guard<std::mutex> lock (sleepMutex);
+        jobsDone.notify_all();
+    }
+}
+
+void ThreadPool::work (unsigned int index) {
+
+    while (true) {
+        Job job;
+        if (pop(index, job) || steal(index, job)) {
+            run(job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock (sleepMutex);
+        wakeUp.wait(lock, [this] { return stopping || (pending > 0); });
+        if (stopping && (pending == 0)) return;
+    }
+}
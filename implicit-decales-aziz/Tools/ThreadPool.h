@@ -0,0 +1,78 @@
+//
+// Work-stealing pool of threads for the data parallel passes (Deformers).
+//
+// Each worker owns a queue of jobs (ranges of task indexes). A worker takes the jobs of its own queue from the back,
+// and steals the jobs of the other queues from the front when its queue is empty. The thread calling parallelFor
+// also steals jobs until all the jobs of its call are done, so that parallelFor can be called from a job.
+//
+
+#ifndef TEST_THREADPOOL_H
+#define TEST_THREADPOOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+
+class ThreadPool {
+
+public:
+
+    /**
+     * Creates the pool and starts its workers.
+     * @param nbThreads: number of worker threads. With 0, one per hardware thread but the calling one.
+     */
+    explicit ThreadPool (unsigned int nbThreads = 0);
+    /**
+     * Stops and joins the workers. No parallelFor must be running.
+     */
+    ~ThreadPool ();
+
+    /**
+     * Calls task(t) for every t in [0, count) on the workers and on the calling thread, and returns when all the calls are done.
+     * The calls must be independent.
+     */
+    void parallelFor (unsigned int count, const std::function<void (unsigned int)> &task);
+
+    unsigned int getNbThreads ();
+
+private:
+
+    ThreadPool (const ThreadPool &);
+    ThreadPool &operator = (const ThreadPool &);
+
+    struct Job {
+        const std::function<void (unsigned int)> *task;
+        unsigned int begin;
+        unsigned int end;
+        std::atomic<unsigned int> *remaining;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    bool pop (unsigned int queue, Job &job);
+    bool steal (unsigned int thief, Job &job);
+    void run (const Job &job);
+    void work (unsigned int index);
+
+    std::vector<std::thread> threads;
+    std::vector<Queue *> queues;
+
+    // Number of jobs pushed and not yet taken
+    std::atomic<unsigned int> pending;
+    bool stopping;
+
+    std::mutex sleepMutex;
+    std::condition_variable wakeUp;
+    std::condition_variable jobsDone;
+};
+
+
+#endif //TEST_THREADPOOL_H
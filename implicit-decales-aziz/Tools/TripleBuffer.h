@@ -0,0 +1,79 @@
+//
+// Lock-free hand-off of the newest value from one producer thread to one consumer thread.
+//
+// The producer writes in its back slot and publishes it, the consumer reads its front slot, and the third slot is the
+// one exchanged between them (atomically, with a flag telling whether it holds a value not yet taken by the consumer).
+// Neither thread ever waits for the other: the values published in between two updates of the consumer are dropped,
+// only the newest one is taken.
+//
+
+#ifndef TEST_TRIPLEBUFFER_H
+#define TEST_TRIPLEBUFFER_H
+
+#include <atomic>
+
+
+template <typename T>
+class TripleBuffer {
+
+public:
+
+    TripleBuffer () : backIndex(0), middle(1), frontIndex(2) {}
+
+    /**
+     * Slot written by the producer, published by publish()
+     */
+    T &back () {
+
+        return slots[backIndex];
+    }
+
+    /**
+     * Make the back slot the newest value (producer thread only). The producer gets another slot to write.
+     */
+    void publish () {
+
+        unsigned int previous = middle.exchange(backIndex | fresh, std::memory_order_acq_rel);
+        backIndex = previous & indexMask;
+    }
+
+    /**
+     * Take the newest published value in the front slot (consumer thread only).
+     * @return false if no value was published since the last update (the front slot is unchanged)
+     */
+    bool update () {
+
+        if ((middle.load(std::memory_order_relaxed) & fresh) == 0) return false;
+
+        unsigned int previous = middle.exchange(frontIndex, std::memory_order_acq_rel);
+        frontIndex = previous & indexMask;
+        return true;
+    }
+
+    /**
+     * Slot read by the consumer, holding the value taken by the last update()
+     */
+    const T &front () const {
+
+        return slots[frontIndex];
+    }
+
+private:
+
+    TripleBuffer (const TripleBuffer &);
+    TripleBuffer &operator = (const TripleBuffer &);
+
+    static const unsigned int indexMask = 3;
+    static const unsigned int fresh = 4;
+
+    T slots[3];
+    // Slot of the producer
+    unsigned int backIndex;
+    // Exchanged slot, and the fresh flag when it holds a value published since the last update
+    std::atomic<unsigned int> middle;
+    // Slot of the consumer
+    unsigned int frontIndex;
+};
+
+
+#endif //TEST_TRIPLEBUFFER_H
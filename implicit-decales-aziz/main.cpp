@@ -1,8 +1,6 @@
 #include <iostream>
 #include <QApplication>
 #include <Qwidget>
-#include <QLabel>
-#include <QGridLayout>
 #include "Tools/ColorImage.h"
 #include "Decale/DecaleDiskField2D.h"
 #include "Decale/DecaleSquareField2D.h"
@@ -24,6 +22,7 @@
 #include "GUI-Decale/QWidgetMyDecale.h"
 #include <math.h>
 #include "Field2D/imagefield.h"
+#include "Solver/scene.h"
 
 
 unsigned int wi_width=1024;
@@ -34,6 +33,7 @@ VectorOfColorImages decaleImages;
 VectorOfFields gamutComponentFields;
 GamutField2D *gamut;
 VectorOfDeformers deformers;
+Scene scene;
 
 
 /*****************************************************************************/
@@ -49,6 +49,14 @@ void buildFields (){
     **********************************/
     int n = 2;
 
+    /***********************************
+    // Storage of the field buffers and UV buffers (Decales and Gamut)
+    // double is exact, float or 16-bit fixed point fields (FIELD_STORAGE_FLOAT, FIELD_STORAGE_FIXED16) and half UVs
+    // (UV_STORAGE_HALF) reduce the memory bandwidth at the cost of accuracy
+    **********************************/
+    FieldStorage fieldStorage = FIELD_STORAGE_DOUBLE;
+    UVStorage uvStorage = UV_STORAGE_DOUBLE;
+
 /***********************************
 // BEGIN GAMUT
 ***********************************/
@@ -96,7 +104,11 @@ void buildFields (){
     QString path = "C:/Users/mbenkhel/Documents/Internship/dev/Qt/implicit-decales-aziz/Images/gamut_images/test4";
     std::cout<< "Hello"<<std::endl;
 
-    Field2D *gamutSDF = new ImageField(path);
+    /***********************************
+    // The distance field of the mask and the gamut field buffer are cached next to the mask:
+    // they are only computed when the mask, the falloff or the window change
+    ***********************************/
+    ImageField *gamutSDF = new ImageField(path, scene.getThreadPool(), path + ".sdf.cache");
 
 
     /***********************************
@@ -104,6 +116,9 @@ void buildFields (){
     // the size for the falloff function is the size from the center to isosurface
     ***********************************/
     gamut = new GamutField2D(gamutSDF, 0, 0, wi_width, wi_height, sizeFallOff, n);
+    gamut->setStorage(fieldStorage);
+    gamut->setBufferPool(scene.getBufferPool());
+    gamut->setCache((path + ".gamut.cache").toStdString(), gamutSDF->getMaskKey());
 
     /***********************************
     // Pre-computation of the gamut field values in a buffer of size wi_width*wi_height
@@ -165,10 +180,20 @@ void buildFields (){
 //    fields.push_back(new DecaleDiskField2D (490.,140.,decaleSize3, n));
 //    decaleImages.push_back(new ColorImage ("../Images/round-whatsapp.png"));
 
+    /***********************************
+    // Decode the Decale images in the texture atlas of the scene (mip-mapped sampling)
+    ***********************************/
+    for (int i = 0; i < decaleImages.size(); i++)
+        decaleImages[i]->setTextureAtlas(scene.getTextureAtlas());
+
     /***********************************
     // Pre-compute the field values of each Decale in a buffer
     ***********************************/
-    for (int i = 0; i < fields.size(); i++) fields[i]->computeDiscreteField();
+    for (int i = 0; i < fields.size(); i++) {
+        fields[i]->setStorage(fieldStorage, uvStorage);
+        fields[i]->setBufferPool(scene.getBufferPool());
+        fields[i]->computeDiscreteField();
+    }
 
 /***********************************
 // END DECALS
@@ -193,6 +218,11 @@ void buildFields (){
     deformers.push_back(new GamutDeformer2DBinaryHardContactMax(gamut, fields[0], 1));
     for (int i = 1; i < fields.size(); i++) deformers[deformers.size()-1]->addField(fields[i], 1);
 
+    /***********************************
+    // The Deformers compute the field buffers of the Decales on the threads of the scene
+    ***********************************/
+    for (int i = 0; i < deformers.size(); i++)  deformers[i]->setThreadPool(scene.getThreadPool());
+
     /***********************************
     //Apply the Deformers to the field values stored in the top buffers (the one with the larger index)
     //of all the Decales it deforms and store it for each Decale in a new buffer.
@@ -230,19 +260,13 @@ int main(int argc, char** argv)
 //    app.setAttribute(Qt::AA_SynthesizeTouchForUnhandledMouseEvents, false );
 
     QWidgetMyDecale myWidget (wi_width, wi_height, Color("#D3D3D3"));
-    QLabel  *label  = new QLabel(&myWidget);
-    QGridLayout *gridLayout = new QGridLayout;
-
-    gridLayout->addWidget(label);
-
-    myWidget.setLayout(gridLayout);
-    myWidget.setLabel(label);
 
     buildFields();
 
     myWidget.setDecales(fields);
     myWidget.setDeformers(deformers);
     myWidget.setDecaleImages(decaleImages);
+    myWidget.setThreadPool(scene.getThreadPool());
     myWidget.setGamut(gamut);
     myWidget.setGamutColor(Color(0.,0.,0.));
     myWidget.prepareSolver(gamut);
@@ -0,0 +1,104 @@
+//
+// Headless renderer of scene files: decale_render [-j threads] [-o directory] scene...
+//
+// Each scene is rendered in the image of its output statement (or <scene>.png), in the directory given by -o when
+// there is one. The scenes are rendered in parallel, one scene per worker, without display.
+// The exit code is 1 if a scene could not be rendered (the others are rendered anyway), 0 otherwise.
+//
+
+#include <iostream>
+#include <atomic>
+#include <mutex>
+#include <functional>
+#include <stdlib.h>
+#include <QCoreApplication>
+#include <QFileInfo>
+#include <QDir>
+#include "Render/SceneFile.h"
+#include "Render/SceneRenderer.h"
+#include "Tools/ThreadPool.h"
+
+
+static void usage () {
+
+    std::cerr << "usage: decale_render [-j threads] [-o directory] scene..." << std::endl;
+}
+
+/***********************************
+// Image of a scene: its output statement (default <scene>.png), in the output directory if there is one
+***********************************/
+static std::string outputPath (const std::string &sceneFile, const SceneDescription &scene, const std::string &directory) {
+
+    QFileInfo output (QString::fromStdString(scene.output.empty() ? sceneFile : scene.output));
+    QString name = scene.output.empty() ? output.completeBaseName() + ".png" : output.fileName();
+
+    if (directory.empty()) return (output.dir().filePath(name)).toStdString();
+    return QDir(QString::fromStdString(directory)).filePath(name).toStdString();
+}
+
+
+int main (int argc, char **argv) {
+
+    /***********************************
+    // A core application (no GUI): the image format plugins are loaded, no display is needed
+    ***********************************/
+    QCoreApplication app(argc, argv);
+
+    unsigned int nbThreads = 0;
+    std::string directory;
+    std::vector<std::string> sceneFiles;
+
+    for (int a=1; a<argc; a++) {
+        std::string arg = argv[a];
+        if ((arg == "-j") && (a+1 < argc)) nbThreads = (unsigned int)atoi(argv[++a]);
+        else if ((arg == "-o") && (a+1 < argc)) directory = argv[++a];
+        else if (arg[0] == '-') {
+            usage();
+            return ((arg == "-h") || (arg == "--help")) ? 0 : 1;
+        }
+        else sceneFiles.push_back(arg);
+    }
+    if (sceneFiles.empty()) {
+        usage();
+        return 1;
+    }
+    if (!directory.empty() && !QDir().mkpath(QString::fromStdString(directory))) {
+        std::cerr << directory << ": cannot create the directory" << std::endl;
+        return 1;
+    }
+
+    /***********************************
+    // One scene per task: each worker builds and draws its scene on its own thread (-j 1 renders on the calling thread)
+    ***********************************/
+    std::atomic<int> failures (0);
+    std::mutex logMutex;
+
+    std::function<void (unsigned int)> renderScene = [&] (unsigned int s) {
+
+        SceneDescription scene;
+        SceneRenderer renderer;
+        std::string error, output;
+
+        bool rendered = readSceneFile(sceneFiles[s], scene, error);
+        if (rendered) {
+            output = outputPath(sceneFiles[s], scene, directory);
+            rendered = renderer.render(scene, error) && renderer.save(output, error);
+        }
+
+        std::lock_guard<std::mutex> lock (logMutex);
+        if (rendered) std::cout << sceneFiles[s] << " -> " << output << std::endl;
+        else {
+            std::cerr << error << std::endl;
+            failures++;
+        }
+    };
+
+    if (nbThreads == 1) {
+        for (unsigned int s=0; s<sceneFiles.size(); s++) renderScene(s);
+    } else {
+        ThreadPool pool (nbThreads > 1 ? nbThreads - 1 : 0);
+        pool.parallelFor(sceneFiles.size(), renderScene);
+    }
+
+    return (failures > 0) ? 1 : 0;
+}